@@ -1069,21 +1069,25 @@ def delete_connection(cli, module, ogate):
 
 
 def _show_worker_header(cli):
-    cli.fout.write('  %10s%10s%10s%10s%16s\n' % (
+    cli.fout.write('  %10s%10s%10s%10s%16s%14s%16s\n' % (
         'Worker ID',
         'Status',
         'CPU core',
         '# of TCs',
-        'Deadend pkts'))
+        'Deadend pkts',
+        'Idle sleeps',
+        'Max wakeup(us)'))
 
 
 def _show_worker(cli, w):
-    cli.fout.write('  %10d%10s%10d%10d%16d\n' % (
+    cli.fout.write('  %10d%10s%10d%10d%16d%14d%16.1f\n' % (
         w.wid,
         'RUNNING' if w.running else 'PAUSED',
         w.core,
         w.num_tcs,
-        w.silent_drops))
+        w.silent_drops,
+        w.idle_sleeps,
+        w.wakeup_latency_max_ns / 1000.0))
 
 
 @cmd('show worker', 'Show the status of all worker threads')
@@ -1421,6 +1425,49 @@ def show_pipeline_bit(cli, opts):
     cli.fout.write(_draw_pipeline(cli, 'bytes', 'Mb', graph_args=opts))
 
 
+@cmd('show pipeline profile',
+     'Show the CPU cycles spent in each module (see "profile")')
+def show_pipeline_profile(cli):
+    profile = cli.bess.get_module_profile()
+    if not profile.enabled:
+        cli.fout.write('  Profiling is disabled (see "profile enable").\n')
+
+    modules = sorted(profile.modules, key=lambda m: m.total.cycles,
+                     reverse=True)
+    all_cycles = sum(m.total.cycles for m in modules)
+
+    cli.fout.write('  %-24s%16s%16s%16s%12s%12s%8s\n' % (
+        'Module',
+        'Class',
+        'Batches',
+        'Packets',
+        'Cycles/batch',
+        'Cycles/pkt',
+        'CPU%'))
+
+    for m in modules:
+        t = m.total
+        cli.fout.write('  %-24s%16s%16d%16d%12.1f%12.1f%8.1f\n' % (
+            m.name,
+            m.mclass,
+            t.batches,
+            t.packets,
+            t.cycles / t.batches if t.batches else 0.0,
+            t.cycles / t.packets if t.packets else 0.0,
+            t.cycles * 100.0 / all_cycles if all_cycles else 0.0))
+
+
+@cmd('profile ENABLE_DISABLE',
+     'Enable/disable accounting CPU cycles per module')
+def profile_modules(cli, flag):
+    cli.bess.set_profiling(flag == 'enable')
+
+
+@cmd('profile reset', 'Reset the per-module CPU cycle counters')
+def profile_reset(cli):
+    cli.bess.get_module_profile(clear=True)
+
+
 def _show_port(cli, port):
     link_status = cli.bess.get_link_status(port.name)
 
@@ -79,6 +79,29 @@ class BessAclTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[0]), 1)
         self.assertSamePackets(pkt_outs[0][0], pkt_in2)
 
+    def test_acl_priority(self):
+        fw = ACL(rules=[{'src_ip': '96.22.0.0/16',
+                         'dst_port': 80,
+                         'drop': True},
+                        {'src_ip': '96.0.0.0/8', 'drop': False}])
+        pkt_in1 = get_tcp_packet(sip='96.22.22.22', dip='22.22.22.22',
+                                 dport=80)
+        pkt_in2 = get_tcp_packet(sip='96.22.22.22', dip='22.22.22.22',
+                                 dport=8080)
+        pkt_in3 = get_tcp_packet(sip='96.33.22.22', dip='22.22.22.22',
+                                 dport=80)
+
+        pkt_outs = self.run_module(fw, 0, [pkt_in1], [0])
+        self.assertEquals(len(pkt_outs[0]), 0)
+
+        pkt_outs = self.run_module(fw, 0, [pkt_in2], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt_in2)
+
+        pkt_outs = self.run_module(fw, 0, [pkt_in3], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt_in3)
+
     def test_run_acl_custom(self):
         fw = ACL(rules=[{'src_ip': '172.12.0.0/16',
                          'drop': False},
@@ -64,6 +64,25 @@ class BessBufferTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[0]), BATCH_SIZE)
         self.assertSamePackets(pkt_outs[0][0], pkt1)
 
+    def test_buffer_deadline(self):
+        buf = Buffer(max_hold_ns=10000)
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+
+        # A partial batch should be flushed once the deadline passes.
+        pkt_outs = self.run_module(buf, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt)
+
+        stats = buf.get_stats(clear=True, hold_percentiles=[50.0])
+        self.assertEquals(stats.batches, 1)
+        self.assertEquals(stats.packets, 1)
+        self.assertEquals(stats.timeout_batches, 1)
+        self.assertEquals(stats.batch_size_hist[1], 1)
+        self.assertGreaterEqual(stats.hold_time.min_ns, 10000)
+
+        stats = buf.get_stats()
+        self.assertEquals(stats.batches, 0)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessBufferTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
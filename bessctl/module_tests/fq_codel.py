@@ -0,0 +1,227 @@
+# Copyright (c) 2016-2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+class BessFQCodelTest(BessModuleTestCase):
+
+    def test_run_fq_codel(self):
+        fq = FQCodel()
+        self.run_for(fq, [0], 3)
+        self.assertBessAlive()
+
+    def test_fq_codel_single(self):
+        fq = FQCodel(num_flows=4)
+        fq.attach_task(wid=0)
+
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        pkt_outs = self.run_module(fq, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt)
+
+        stats = fq.get_stats(clear=True, sojourn_percentiles=[50.0, 99.0])
+        self.assertEquals(stats.enqueued, 1)
+        self.assertEquals(stats.dequeued, 1)
+        self.assertEquals(stats.new_flows, 1)
+        self.assertEquals(stats.backlog_packets, 0)
+        self.assertEquals(stats.sojourn_time.count, 1)
+        self.assertEquals(len(stats.sojourn_time.percentile_values_ns), 2)
+
+        stats = fq.get_stats()
+        self.assertEquals(stats.enqueued, 0)
+
+    def test_fq_codel_batch(self):
+        fq = FQCodel(num_flows=16)
+        fq.attach_task(wid=0)
+
+        pkt_lists = [('22.22.22.1', '22.22.22.1'),
+                     ('22.22.22.1', '22.22.22.1'),
+                     ('22.22.11.1', '22.22.11.1'),
+                     ('22.11.11.1', '22.1.11.1')
+                     ]
+        for (src, dst) in pkt_lists:
+            pkt = get_tcp_packet(sip=src, dip=dst)
+            pkt_outs = self.run_module(fq, 0, [pkt], [0])
+            self.assertEquals(len(pkt_outs[0]), 1)
+            self.assertSamePackets(pkt_outs[0][0], pkt)
+
+    def test_fq_codel_overlimit(self):
+        # The pool holds 8 packets: once full, packets are dropped from the
+        # head of the (only, hence fattest) flow.
+        fq = FQCodel(num_flows=4, limit=8)
+        fq.attach_task(wid=0)
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+
+        pkt_outs = self.run_module(fq, 0, [pkt] * 20, [0])
+
+        stats = fq.get_stats()
+        self.assertEquals(stats.enqueued, 20)
+        self.assertEquals(stats.dequeued, len(pkt_outs[0]))
+        self.assertEquals(stats.dequeued + stats.overlimit_drops +
+                          stats.codel_drops + stats.backlog_packets, 20)
+        self.assertLessEqual(stats.backlog_packets, 8)
+
+    def test_fq_codel_conservation(self):
+        # With a 1ns target every standing queue is above target, so CoDel
+        # drops, but every packet must still be accounted for.
+        fq = FQCodel(num_flows=4, quantum=60, target_ns=1, interval_ns=1)
+        fq.attach_task(wid=0)
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+
+        for i in range(10):
+            self.run_module(fq, 0, [pkt] * 32, [0])
+
+        stats = fq.get_stats()
+        self.assertEquals(stats.enqueued,
+                          stats.dequeued + stats.codel_drops +
+                          stats.overlimit_drops + stats.backlog_packets)
+
+    def test_fq_codel_standing_queue(self):
+        # A single flow offered 20% more than the output drains. Without AQM
+        # its queue would grow by ~2000 packets per second; CoDel must keep
+        # it close to the target instead.
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        fq = FQCodel(num_flows=4, target_ns=1000000, interval_ns=10000000)
+        src = Source()
+        src -> Rewrite(templates=[bytes(pkt)]) -> fq -> Sink()
+
+        bess.add_tc('in', policy='rate_limit', resource='packet',
+                    limit={'packet': 12000})
+        src.attach_task(parent='in')
+        bess.add_tc('out', policy='rate_limit', resource='packet',
+                    limit={'packet': 10000})
+        fq.attach_task(parent='out')
+
+        bess.resume_all()
+        time.sleep(2)
+        bess.pause_all()
+
+        stats = fq.get_stats()
+        self.assertGreater(stats.codel_drops, 0)
+        self.assertEquals(stats.overlimit_drops, 0)
+        self.assertEquals(stats.ecn_marks, 0)
+        self.assertLess(stats.backlog_packets, 1000)
+
+    def test_fq_codel_ecn(self):
+        # With ECN, ECN-capable packets of a standing queue are marked
+        # Congestion Experienced instead of being dropped, and their IPv4
+        # checksum stays valid.
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        pkt[scapy.IP].tos = 0x02  # ECT(0)
+        fq = FQCodel(num_flows=4, target_ns=1000000, interval_ns=10000000,
+                     ecn=True)
+        ipc = IPChecksum(verify=True)
+        em = ExactMatch(fields=[{'offset': 15, 'num_bytes': 1}])  # ToS
+        em.add(fields=[{'value_bin': b'\x03'}], gate=1)
+        em.set_default_gate(gate=0)
+
+        src = Source()
+        src -> Rewrite(templates=[bytes(pkt)]) -> fq -> ipc -> em
+        ipc:1 -> Sink()
+        em:0 -> Sink()
+        em:1 -> Sink()
+
+        bess.add_tc('in', policy='rate_limit', resource='packet',
+                    limit={'packet': 12000})
+        src.attach_task(parent='in')
+        bess.add_tc('out', policy='rate_limit', resource='packet',
+                    limit={'packet': 10000})
+        fq.attach_task(parent='out')
+
+        bess.resume_all()
+        time.sleep(2)
+        bess.pause_all()
+
+        stats = fq.get_stats()
+        self.assertGreater(stats.ecn_marks, 0)
+        self.assertEquals(stats.codel_drops, 0)
+
+        ipc_ogates = {g.ogate: g.pkts for g in
+                      bess.get_module_info(ipc.name).ogates}
+        em_ogates = {g.ogate: g.pkts for g in
+                     bess.get_module_info(em.name).ogates}
+        self.assertEquals(ipc_ogates[1], 0)
+        self.assertEquals(em_ogates[1], stats.ecn_marks)
+
+    def test_fq_codel_sparse_flow(self):
+        # A sparse flow is served from the new flow list, ahead of the
+        # backlog of a flow that sends twice the output rate.
+        pkt_fat = get_tcp_packet(sip='22.22.22.1', dip='22.22.22.22')
+        pkt_sparse = get_tcp_packet(sip='22.22.22.2', dip='22.22.22.22')
+
+        # A target of 1s leaves the backlog to the pool limit
+        fq = FQCodel(num_flows=16, quantum=60, limit=512,
+                     target_ns=1000000000)
+        ts = Timestamp()
+        em = ExactMatch(fields=[{'offset': 26, 'num_bytes': 4}])
+        em.add(fields=[{'value_bin': socket.inet_aton('22.22.22.1')}], gate=1)
+        em.add(fields=[{'value_bin': socket.inet_aton('22.22.22.2')}], gate=2)
+        em.set_default_gate(gate=0)
+        m_fat = Measure(latency_ns_max=1000000000)
+        m_sparse = Measure(latency_ns_max=1000000000)
+
+        src_fat = Source()
+        src_sparse = Source()
+        src_fat -> Rewrite(templates=[bytes(pkt_fat)]) -> ts
+        src_sparse -> Rewrite(templates=[bytes(pkt_sparse)]) -> ts
+        ts -> fq -> em
+        em:0 -> Sink()
+        em:1 -> m_fat -> Sink()
+        em:2 -> m_sparse -> Sink()
+
+        bess.add_tc('fat', policy='rate_limit', resource='packet',
+                    limit={'packet': 20000})
+        src_fat.attach_task(parent='fat')
+        bess.add_tc('sparse', policy='rate_limit', resource='packet',
+                    limit={'packet': 100})
+        src_sparse.attach_task(parent='sparse')
+        bess.add_tc('out', policy='rate_limit', resource='packet',
+                    limit={'packet': 10000})
+        fq.attach_task(parent='out')
+
+        bess.resume_all()
+        # Let the fat flow fill the pool first
+        time.sleep(0.5)
+        m_fat.clear()
+        m_sparse.clear()
+        time.sleep(2)
+        bess.pause_all()
+
+        stats_fat = m_fat.get_summary(latency_percentiles=[50.0])
+        stats_sparse = m_sparse.get_summary(latency_percentiles=[50.0])
+        self.assertGreater(stats_sparse.packets, 0)
+        self.assertLess(stats_sparse.latency.percentile_values_ns[0] * 4,
+                        stats_fat.latency.percentile_values_ns[0])
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessFQCodelTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -0,0 +1,112 @@
+# Copyright (c) 2016-2017, Nefeli Networks, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+class BessHQoSTest(BessModuleTestCase):
+
+    def _classify(self, pipe, queue):
+        return SetMetadata(attrs=[
+            {'name': 'qos_pipe', 'size': 4, 'value_int': pipe},
+            {'name': 'qos_queue', 'size': 1, 'value_int': queue}])
+
+    def test_run_hqos(self):
+        hqos = HQoS(num_subports=2, pipes_per_subport=4)
+        self.run_for(hqos, [0], 3)
+        self.assertBessAlive()
+
+    def test_hqos_single(self):
+        hqos = HQoS(num_subports=2, pipes_per_subport=4)
+        hqos.attach_task(wid=0)
+        metadata = self._classify(5, 3)
+        metadata -> hqos
+
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        pkt_outs = self.run_pipeline(metadata, hqos, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt)
+
+        stats = hqos.get_stats(clear=True)
+        self.assertEquals(stats.enqueued, 1)
+        self.assertEquals(stats.dequeued, 1)
+        self.assertEquals(stats.backlog, 0)
+
+        stats = hqos.get_stats()
+        self.assertEquals(stats.enqueued, 0)
+
+    def test_hqos_invalid(self):
+        hqos = HQoS(num_subports=2, pipes_per_subport=4)
+        hqos.attach_task(wid=0)
+        metadata = self._classify(8, 0)
+        metadata -> hqos
+
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+        pkt_outs = self.run_pipeline(metadata, hqos, 0, [pkt], [0])
+        self.assertEquals(len(pkt_outs[0]), 0)
+        self.assertEquals(hqos.get_stats().invalid_drops, 1)
+
+    def test_hqos_shaping(self):
+        # 1538 bytes of burst, and then one packet every 10 seconds
+        hqos = HQoS(num_subports=1, pipes_per_subport=2,
+                    pipe_profiles=[{'rate': 100, 'burst': 1538}])
+        hqos.attach_task(wid=0)
+        metadata = self._classify(1, 0)
+        metadata -> hqos
+
+        pkt = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22',
+                             pkt_len=1000)
+        pkt_outs = self.run_pipeline(metadata, hqos, 0, [pkt] * 4, [0],
+                                     time_out=1)
+        self.assertEquals(len(pkt_outs[0]), 1)
+
+        stats = hqos.get_stats()
+        self.assertEquals(stats.backlog, 3)
+        self.assertEquals(stats.pipe_throttles, 1)
+
+    def test_hqos_commands(self):
+        hqos = HQoS(num_subports=2, pipes_per_subport=4,
+                    pipe_profiles=[{'rate': 1000000}, {'rate': 2000000}])
+        hqos.set_pipe(pipe=7, profile=1)
+        hqos.set_subport(subport=1, profile={'rate': 10000000})
+
+        with self.assertRaises(bess.Error):
+            hqos.set_pipe(pipe=8, profile=0)
+        with self.assertRaises(bess.Error):
+            hqos.set_pipe(pipe=0, profile=2)
+        with self.assertRaises(bess.Error):
+            hqos.set_subport(subport=2, profile={'rate': 10000000})
+        with self.assertRaises(bess.Error):
+            hqos.set_subport(subport=0, profile={'rate': 1, 'burst': 1})
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessHQoSTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -73,6 +73,25 @@ class BessIpChecksumTest(BessModuleTestCase):
             self.assertEquals(len(pkt_outs[0]), 1)
             self.assertSamePackets(pkt_outs[0][0], qinq_out)
 
+    def test_verify(self):
+        wmodule = IPChecksum(verify=True)
+
+        eth = scapy.Ether(src='de:ad:be:ef:12:34', dst='12:34:de:ad:be:ef')
+        ip_wrong = scapy.IP(
+            src="1.2.3.4", dst="2.3.4.5", ttl=98, chksum=0x0000)
+        ip_right = scapy.IP(src="1.2.3.4", dst="2.3.4.5", ttl=98)
+        udp = scapy.UDP(sport=10001, dport=10002)
+        payload = 'helloworldhelloworldhelloworld'
+
+        pkt_right = eth / ip_right / udp / payload
+        pkt_wrong = eth / ip_wrong / udp / payload
+
+        pkt_outs = self.run_module(wmodule, 0, [pkt_right, pkt_wrong], [0, 1])
+        self.assertEquals(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt_right)
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt_wrong)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessIpChecksumTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
@@ -0,0 +1,81 @@
+# Copyright (c) 2017  Tamas Levai <levait@tmit.bme.hu>
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+from test_utils import *
+
+
+def get_tcp6_packet(sip, dip, pkt_len=80):
+    eth = scapy.Ether(src=scapy.RandMAC()._fix(),
+                      dst=scapy.RandMAC()._fix())
+    ip = scapy.IPv6(src=sip, dst=dip)
+    tcp = scapy.TCP(sport=10001, dport=10002)
+    pkt = eth / ip / tcp
+    return pkt / ('\x00' * max(0, pkt_len - len(pkt)))
+
+
+class BessIPv6LookupTest(BessModuleTestCase):
+
+    def test_ipv6lookup(self):
+        ipl = IPv6Lookup()
+        pkts = [get_tcp6_packet(sip='2001:db8::1', dip='2001:db8:1::1'),
+                get_tcp6_packet(sip='2001:db8::1', dip='2001:db8:2::1'),
+                get_tcp6_packet(sip='2001:db8::1', dip='2001:db8:3::1'),
+                get_tcp6_packet(sip='2001:db8::1', dip='2001:db9::1')]
+
+        ipl.add(prefix='2001:db8::', prefix_len=32, gate=0)
+        ipl.add(prefix='2001:db8:2::', prefix_len=48, gate=1)
+        ipl.add(prefix='2001:db8:3::', prefix_len=48, gate=1)
+        ipl.add(prefix='::', prefix_len=0, gate=2)
+
+        ipl.delete(prefix='2001:db8:3::', prefix_len=48)
+        with self.assertRaises(bess.Error):
+            ipl.delete(prefix='2001:db8:4::', prefix_len=48)
+
+        pkt_outs = self.run_module(ipl, 0, pkts, [0, 1, 2])
+        self.assertEquals(len(pkt_outs[0]), 2)
+        self.assertEquals(len(pkt_outs[1]), 1)
+        self.assertEquals(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkts[1])
+        self.assertSamePackets(pkt_outs[2][0], pkts[3])
+
+    def test_prefix(self):
+        ipl = IPv6Lookup()
+        with self.assertRaises(bess.Error):
+            ipl.add(prefix='2001:db8:1::', prefix_len=32, gate=0)
+        with self.assertRaises(bess.Error):
+            ipl.add(prefix='2001:db8::', prefix_len=129, gate=0)
+        with self.assertRaises(bess.Error):
+            ipl.add(prefix='10.0.0.0', prefix_len=8, gate=0)
+
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessIPv6LookupTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -106,6 +106,34 @@ class BessNatTest(BessModuleTestCase):
         nat = NAT(ext_addrs=nat_config)
         self._test_l4(nat, scapy.ICMP(), '192.168.1.1')
 
+    def test_nat_port_exhaustion(self):
+        # One usable port for each protocol in each of the 64 partitions. An
+        # internal endpoint is only given ports of its own partition, so some
+        # of the flows must fail.
+        nat_config = [{'ext_addr': '192.168.1.1',
+                       'port_ranges': [{'begin': 2000, 'end': 2064}]}]
+        nat = NAT(ext_addrs=nat_config)
+
+        eth = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='06:16:3e:1b:72:32')
+        ip = scapy.IP(src='172.16.0.2', dst='8.8.8.8')
+        pkts = [eth / ip / scapy.UDP(sport=sport, dport=53) / 'helloworld'
+                for sport in range(10000, 10100)]
+
+        pkt_outs = self.run_module(nat, 0, pkts, [0, 1])
+        sports = [pkt[scapy.UDP].sport for pkt in pkt_outs[1]]
+        self.assertEquals(len(set(sports)), len(sports))
+        self.assertTrue(all(2000 <= sport < 2064 for sport in sports))
+
+        stats = nat.get_stats()
+        self.assertEquals(stats.entries, len(sports))
+        self.assertEquals(stats.created, len(sports))
+        self.assertEquals(stats.expired, 0)
+        self.assertEquals(stats.alloc_failures, len(pkts) - len(sports))
+        self.assertGreaterEqual(stats.alloc_failures, len(pkts) - 64)
+        self.assertEquals(stats.free_ports, 3 * 64 - len(sports))
+        self.assertEquals(stats.shards, 1)
+        self.assertEquals(stats.handoffs, 0)
+
     def test_nat_selfconfig(self):
         # Send initial conf unsorted, see that it comes back sorted
         # (note that this is a bit different from other modules
@@ -59,6 +59,16 @@ class BessReplicateTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[2]), 1)
         self.assertSamePackets(pkt_outs[2][0], pkt_in)
 
+    def test_replicate_zero_copy(self):
+        rep3 = Replicate(gates=[0, 1, 2], zero_copy=True, header_len=32)
+        pkt_in = get_tcp_packet(sip='22.22.22.22', dip='22.22.22.22')
+
+        pkt_outs = self.run_module(rep3, 0, [pkt_in], [0, 1, 2])
+
+        for ogate in range(3):
+            self.assertEquals(len(pkt_outs[ogate]), 1)
+            self.assertSamePackets(pkt_outs[ogate][0], pkt_in)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessReplicateTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
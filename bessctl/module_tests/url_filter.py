@@ -99,6 +99,29 @@ class BessUrlFilterTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[1]), 2)
         self.assertSamePackets(pkt_outs[1][0], err_pkt)
 
+    # The flow table is bounded: the least recently used flow is evicted
+    def test_urlfilter_flow_eviction(self):
+        uf = UrlFilter(max_flows=1)
+
+        eth = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='06:16:3e:1b:72:32')
+        ip1 = scapy.IP(src='192.168.0.1', dst='10.0.0.1')
+        ip2 = scapy.IP(src='192.168.0.2', dst='10.0.0.2')
+        tcp = scapy.TCP(sport=10001, dport=80, seq=12345)  # has syn
+        syn_pkt1 = bytes(eth / ip1 / tcp)
+        syn_pkt2 = bytes(eth / ip2 / tcp)
+
+        pkt_outs = self.run_pipeline(src_module=uf, dst_module=uf,
+                                     igate=0,
+                                     input_pkts=[syn_pkt1, syn_pkt2],
+                                     ogates=[0, 1])
+        self.assertEquals(len(pkt_outs[0]), 2)
+
+        stats = uf.get_stats()
+        self.assertEquals(stats.flows, 1)
+        self.assertEquals(stats.max_flows, 1)
+        self.assertEquals(stats.evictions, 1)
+        self.assertEquals(stats.expirations, 0)
+
     def test_urlfilter_selfconfig(self):
         iconf = {}
         uf = UrlFilter(**iconf)
@@ -28,6 +28,7 @@
 # POSSIBILITY OF SUCH DAMAGE.
 
 import socket
+import struct
 import sys
 from test_utils import *
 from pybess import protobuf_to_dict as pb_conv
@@ -101,6 +102,43 @@ class BessWildcardMatchTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[3]), 1)
         self.assertSamePackets(pkt_outs[3][0], pkt_nomatch)
 
+    def test_wildcardmatch_many_masks(self):
+        # One pattern per source IP prefix length. The longest prefix has the
+        # highest priority and must win, regardless of the number of masks.
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                           use_bloom_filter=True)
+        sip = '10.20.30.40'
+        sip_int = struct.unpack('!I', socket.inet_aton(sip))[0]
+        for plen in range(1, 33):
+            mask = (0xffffffff << (32 - plen)) & 0xffffffff
+            wm.add(gate=plen % 5, priority=plen,
+                   masks=[{'value_bin': struct.pack('!I', mask)}],
+                   values=[{'value_bin': struct.pack('!I', sip_int & mask)}])
+        wm.set_default_gate(gate=5)
+
+        pkt_exact = get_tcp_packet(sip=sip, dip='1.2.3.4')
+        pkt_24 = get_tcp_packet(sip='10.20.30.200', dip='1.2.3.4')
+        pkt_nomatch = get_tcp_packet(sip='138.20.30.40', dip='1.2.3.4')
+
+        pkt_outs = self.run_module(wm, 0, [pkt_exact], range(6))
+        self.assertEquals(len(pkt_outs[2]), 1)   # /32
+        self.assertSamePackets(pkt_outs[2][0], pkt_exact)
+
+        pkt_outs = self.run_module(wm, 0, [pkt_24], range(6))
+        self.assertEquals(len(pkt_outs[4]), 1)   # /24
+        self.assertSamePackets(pkt_outs[4][0], pkt_24)
+
+        pkt_outs = self.run_module(wm, 0, [pkt_nomatch], range(6))
+        self.assertEquals(len(pkt_outs[5]), 1)
+        self.assertSamePackets(pkt_outs[5][0], pkt_nomatch)
+
+        # Once the /32 rule is gone, the /31 rule takes over
+        wm.delete(masks=[{'value_bin': b'\xff\xff\xff\xff'}],
+                  values=[{'value_bin': socket.inet_aton(sip)}])
+        pkt_outs = self.run_module(wm, 0, [pkt_exact], range(6))
+        self.assertEquals(len(pkt_outs[1]), 1)   # /31
+        self.assertSamePackets(pkt_outs[1][0], pkt_exact)
+
     def test_wildcardmatch_with_metadata(self):
         # One wildcard match field
         mask = vstring([0xff, 0xff])
@@ -107,6 +107,26 @@ class BessWorkerSplitTest(BessModuleTestCase):
 
         bess.reset_all()
 
+    def test_worker_split_hash(self):
+        # Packets from sockets/PCAP have no NIC RSS hash, so WorkerSplit falls
+        # back to hashing the 5-tuple in software.
+        ws = WorkerSplit(hash_gates=[0, 1, 2, 3])
+        flows = [get_udp_packet() for _ in range(64)]
+        pkt_outs = self.run_module(ws, 0, flows + flows, [0, 1, 2, 3])
+
+        self.assertEquals(sum(len(out) for out in pkt_outs), 128)
+        gate_of_flow = {}
+        for gate, out in enumerate(pkt_outs):
+            for pkt in out:
+                key = bytes(pkt)
+                # both packets of a flow must leave through the same gate
+                self.assertEquals(gate_of_flow.setdefault(key, gate), gate)
+        self.assertEquals(len(gate_of_flow), 64)
+        self.assertGreater(len(set(gate_of_flow.values())), 1)
+
+        with self.assertRaises(bess.Error):
+            WorkerSplit(worker_gates={0: 0}, hash_gates=[0, 1])
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessWorkerSplitTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
@@ -58,6 +58,7 @@
 #include "resume_hook.h"
 #include "scheduler.h"
 #include "shared_obj.h"
+#include "steal_queue.h"
 #include "traffic_class.h"
 #include "utils/ether.h"
 #include "utils/time.h"
@@ -551,6 +552,19 @@ class BESSControlImpl final : public BESSControl::Service {
       status->set_core(workers[wid]->core());
       status->set_num_tcs(workers[wid]->scheduler()->NumTcs());
       status->set_silent_drops(workers[wid]->silent_drops());
+
+      const bess::sched_stats& stats = workers[wid]->scheduler()->stats();
+      status->set_idle_sleeps(stats.cnt_sleep);
+      status->set_idle_sleep_ns(stats.ns_sleep);
+      status->set_idle_notified(stats.cnt_sleep_notified);
+      status->set_wakeup_latency_ns(stats.ns_wakeup_latency);
+      status->set_wakeup_latency_max_ns(stats.ns_wakeup_latency_max);
+
+      const bess::StealQueue* steal_queue = bess::StealQueue::Get(wid);
+      if (steal_queue) {
+        status->set_steal_offloaded(steal_queue->pushed());
+        status->set_steal_stolen(steal_queue->stolen());
+      }
     }
     return Status::OK;
   }
@@ -577,7 +591,20 @@ class BESSControlImpl final : public BESSControl::Service {
                                scheduler.c_str());
     }
 
-    launch_worker(wid, core, scheduler);
+    bess::IdleConfig idle = {.rounds = request->idle_rounds(),
+                             .max_sleep_ns = request->idle_max_sleep_ns()};
+    if (idle.rounds) {
+      if (scheduler != "") {
+        return return_with_error(
+            response, EINVAL,
+            "Idle mode is only supported by the default scheduler");
+      }
+      if (!idle.max_sleep_ns) {
+        idle.max_sleep_ns = 1000000;
+      }
+    }
+
+    launch_worker(wid, core, scheduler, idle);
     return Status::OK;
   }
 
@@ -1309,6 +1336,63 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status SetProfiling(ServerContext*, const SetProfilingRequest* request,
+                      EmptyResponse*) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    if (request->reset()) {
+      for (const auto& it : ModuleGraph::GetAllModules()) {
+        it.second->ResetProfile();
+      }
+    }
+
+    Module::set_profiling(request->enable());
+
+    return Status::OK;
+  }
+
+  Status GetModuleProfile(ServerContext*,
+                          const GetModuleProfileRequest* request,
+                          GetModuleProfileResponse* response) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    response->set_timestamp(get_epoch_time());
+    response->set_enabled(Module::profiling());
+
+    for (const auto& it : ModuleGraph::GetAllModules()) {
+      Module* m = it.second;
+      GetModuleProfileResponse_Module* module = response->add_modules();
+      GetModuleProfileResponse_Profile* total = module->mutable_total();
+
+      module->set_name(m->name());
+      module->set_mclass(m->module_builder()->class_name());
+      total->set_wid(-1);
+
+      for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+        const ModuleProfile& p = m->profile(wid);
+        if (p.batches == 0) {
+          continue;
+        }
+
+        GetModuleProfileResponse_Profile* worker = module->add_workers();
+        worker->set_wid(wid);
+        worker->set_cycles(p.cycles);
+        worker->set_batches(p.batches);
+        worker->set_packets(p.packets);
+
+        total->set_cycles(total->cycles() + p.cycles);
+        total->set_batches(total->batches() + p.batches);
+        total->set_packets(total->packets() + p.packets);
+      }
+
+      if (request->clear()) {
+        m->ResetProfile();
+      }
+    }
+
+    return Status::OK;
+  }
+
   Status ConnectModules(ServerContext*, const ConnectModulesRequest* request,
                         EmptyResponse* response) override {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
@@ -30,18 +30,25 @@
 
 #include "pmd.h"
 
+#include <fcntl.h>
 #include <rte_bus_pci.h>
 #include <rte_ethdev.h>
+#include <unistd.h>
 
+#include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/tcp.h"
+#include "../utils/udp.h"
 
 static const rte_eth_conf default_eth_conf(const rte_eth_dev_info &dev_info,
-                                           int nb_rxq) {
+                                           int nb_rxq, bool rss_hash) {
   rte_eth_conf ret = {};
 
   ret.link_speeds = ETH_LINK_SPEED_AUTONEG;
-  ret.rxmode.mq_mode = (nb_rxq > 1) ? ETH_MQ_RX_RSS : ETH_MQ_RX_NONE;
+  ret.rxmode.mq_mode =
+      (nb_rxq > 1 || rss_hash) ? ETH_MQ_RX_RSS : ETH_MQ_RX_NONE;
   ret.rxmode.offloads = 0;
 
   ret.rx_adv_conf.rss_conf = {
@@ -54,6 +61,24 @@ static const rte_eth_conf default_eth_conf(const rte_eth_dev_info &dev_info,
   return ret;
 }
 
+// Returns the subset of the requested offloads that the device supports.
+// Unsupported ones are reported and left disabled.
+static uint64_t negotiate_offloads(dpdk_port_t port_id, const char *dir,
+                                   uint64_t requested, uint64_t capa,
+                                   const char *(*name_of)(uint64_t)) {
+  uint64_t missing = requested & ~capa;
+
+  while (missing) {
+    uint64_t offload = missing & -missing;
+    LOG(WARNING) << "PMD port " << static_cast<int>(port_id) << ": " << dir
+                 << " offload " << name_of(offload)
+                 << " is not supported by the device, disabled";
+    missing &= ~offload;
+  }
+
+  return requested & capa;
+}
+
 void PMDPort::InitDriver() {
   dpdk_port_t num_dpdk_ports = rte_eth_dev_count_avail();
 
@@ -241,11 +266,47 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
    * with minor tweaks */
   rte_eth_dev_info_get(ret_port_id, &dev_info);
 
-  eth_conf = default_eth_conf(dev_info, num_rxq);
+  eth_conf = default_eth_conf(dev_info, num_rxq, arg.rss_hash());
   if (arg.loopback()) {
     eth_conf.lpbk_mode = 1;
   }
 
+  uint64_t rx_offloads = 0;
+  if (arg.rx_checksum_offload()) {
+    rx_offloads |= DEV_RX_OFFLOAD_IPV4_CKSUM | DEV_RX_OFFLOAD_UDP_CKSUM |
+                   DEV_RX_OFFLOAD_TCP_CKSUM;
+  }
+  rx_offloads |= arg.lro() ? DEV_RX_OFFLOAD_TCP_LRO : 0;
+  rx_offloads |= arg.vlan_offload_rx_strip() ? DEV_RX_OFFLOAD_VLAN_STRIP : 0;
+  rx_offloads |= arg.vlan_offload_rx_filter() ? DEV_RX_OFFLOAD_VLAN_FILTER : 0;
+  rx_offloads |= arg.vlan_offload_rx_qinq() ? DEV_RX_OFFLOAD_VLAN_EXTEND : 0;
+  rx_offloads |= arg.rss_hash() ? DEV_RX_OFFLOAD_RSS_HASH : 0;
+
+  uint64_t tx_offloads = 0;
+  if (arg.tx_checksum_offload()) {
+    tx_offloads |= DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |
+                   DEV_TX_OFFLOAD_TCP_CKSUM;
+  }
+  // Clones (see Packet::clone()) are multi-segment. Ask for it only if the
+  // device has it; otherwise SendPackets() linearizes them.
+  tx_offloads |= dev_info.tx_offload_capa & DEV_TX_OFFLOAD_MULTI_SEGS;
+
+  rx_offloads_ = negotiate_offloads(ret_port_id, "RX", rx_offloads,
+                                    dev_info.rx_offload_capa,
+                                    rte_eth_dev_rx_offload_name);
+  tx_offloads_ = negotiate_offloads(ret_port_id, "TX", tx_offloads,
+                                    dev_info.tx_offload_capa,
+                                    rte_eth_dev_tx_offload_name);
+  eth_conf.rxmode.offloads = rx_offloads_;
+  eth_conf.txmode.offloads = tx_offloads_;
+  eth_conf.intr_conf.rxq = arg.rx_interrupt();
+
+  // Checksum requests on outgoing packets (see IPChecksum and L4Checksum)
+  // that the device cannot serve are fulfilled in software.
+  tx_sw_cksum_ = (DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |
+                  DEV_TX_OFFLOAD_TCP_CKSUM) &
+                 ~tx_offloads_;
+
   ret = rte_eth_dev_configure(ret_port_id, num_rxq, num_txq, &eth_conf);
   if (ret != 0) {
     return CommandFailure(-ret, "rte_eth_dev_configure() failed");
@@ -310,23 +371,25 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
 
   rte_eth_promiscuous_enable(ret_port_id);
 
-  int offload_mask = 0;
-  offload_mask |= arg.vlan_offload_rx_strip() ? ETH_VLAN_STRIP_OFFLOAD : 0;
-  offload_mask |= arg.vlan_offload_rx_filter() ? ETH_VLAN_FILTER_OFFLOAD : 0;
-  offload_mask |= arg.vlan_offload_rx_qinq() ? ETH_VLAN_EXTEND_OFFLOAD : 0;
-  if (offload_mask) {
-    ret = rte_eth_dev_set_vlan_offload(ret_port_id, offload_mask);
-    if (ret != 0) {
-      return CommandFailure(-ret, "rte_eth_dev_set_vlan_offload() failed");
-    }
-  }
-
   ret = rte_eth_dev_start(ret_port_id);
   if (ret != 0) {
     return CommandFailure(-ret, "rte_eth_dev_start() failed");
   }
   dpdk_port_id_ = ret_port_id;
 
+  if (arg.rx_interrupt()) {
+    for (int i = 0; i < num_rxq; i++) {
+      int fd = rte_eth_dev_rx_intr_ctl_q_get_fd(ret_port_id, i);
+      if (fd < 0) {
+        return CommandFailure(ENOTSUP, "RX interrupt of queue %d unavailable",
+                              i);
+      }
+      // Pending interrupts are drained after wakeup without blocking
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      rx_intr_fds_[i] = fd;
+    }
+  }
+
   int numa_node = rte_eth_dev_socket_id(static_cast<int>(ret_port_id));
   node_placement_ =
       numa_node == -1 ? UNCONSTRAINED_SOCKET : (1ull << numa_node);
@@ -476,23 +539,127 @@ void PMDPort::CollectStats(bool reset) {
   }
 }
 
+// With RSS enabled, the PMD stores the flow hash in each packet and sets
+// PKT_RX_RSS_HASH (see Packet::rss_hash()).
 int PMDPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   return rte_eth_rx_burst(dpdk_port_id_, qid,
                           reinterpret_cast<rte_mbuf **>(pkts), cnt);
 }
 
+void PMDPort::FixupTxChecksum(bess::Packet *pkt) const {
+  using bess::utils::Ipv4;
+  using bess::utils::Tcp;
+  using bess::utils::Udp;
+
+  uint64_t ol_flags = pkt->ol_flags();
+  Ipv4 *ip = pkt->head_data<Ipv4 *>(pkt->l2_len());
+
+  if ((ol_flags & PKT_TX_IP_CKSUM) &&
+      (tx_sw_cksum_ & DEV_TX_OFFLOAD_IPV4_CKSUM)) {
+    ip->checksum = CalculateIpv4Checksum(*ip);
+    ol_flags &= ~PKT_TX_IP_CKSUM;
+  }
+
+  void *l4 = pkt->head_data<uint8_t *>(pkt->l2_len() + pkt->l3_len());
+  uint64_t l4_cksum = ol_flags & PKT_TX_L4_MASK;
+
+  if (l4_cksum == PKT_TX_UDP_CKSUM &&
+      (tx_sw_cksum_ & DEV_TX_OFFLOAD_UDP_CKSUM)) {
+    Udp *udp = reinterpret_cast<Udp *>(l4);
+    udp->checksum = CalculateIpv4UdpChecksum(*ip, *udp);
+    ol_flags &= ~PKT_TX_L4_MASK;
+  } else if (l4_cksum == PKT_TX_TCP_CKSUM &&
+             (tx_sw_cksum_ & DEV_TX_OFFLOAD_TCP_CKSUM)) {
+    Tcp *tcp = reinterpret_cast<Tcp *>(l4);
+    tcp->checksum = CalculateIpv4TcpChecksum(*ip, *tcp);
+    ol_flags &= ~PKT_TX_L4_MASK;
+  }
+
+  if (!(ol_flags & (PKT_TX_IP_CKSUM | PKT_TX_L4_MASK | PKT_TX_TCP_SEG))) {
+    ol_flags &= ~PKT_TX_IPV4;
+  }
+
+  pkt->set_ol_flags(ol_flags);
+}
+
 int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  int to_send = cnt;
+
+  if (!(tx_offloads_ & DEV_TX_OFFLOAD_MULTI_SEGS)) {
+    // The device would send only the first segment. Packets that cannot be
+    // linearized are moved to the tail, in order, and are not sent.
+    bess::Packet *failed[bess::PacketBatch::kMaxBurst];
+    int num_failed = 0;
+
+    to_send = 0;
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *pkt = pkts[i];
+      if (unlikely(pkt->nb_segs() > 1) && !pkt->linearize()) {
+        failed[num_failed++] = pkt;
+      } else {
+        pkts[to_send++] = pkt;
+      }
+    }
+
+    for (int i = 0; i < num_failed; i++) {
+      pkts[to_send + i] = failed[i];
+    }
+  }
+
+  if (tx_sw_cksum_) {
+    for (int i = 0; i < to_send; i++) {
+      if (unlikely(pkts[i]->ol_flags() & (PKT_TX_IP_CKSUM | PKT_TX_L4_MASK))) {
+        FixupTxChecksum(pkts[i]);
+      }
+    }
+  }
+
+  if (tx_offloads_ & ~DEV_TX_OFFLOAD_MULTI_SEGS) {
+    // Let the driver fix up headers (e.g., L4 pseudo-header checksums) for
+    // the offloads. Packets after the first invalid one are not sent.
+    to_send = rte_eth_tx_prepare(dpdk_port_id_, qid,
+                                 reinterpret_cast<rte_mbuf **>(pkts), to_send);
+  }
+
   int sent = rte_eth_tx_burst(dpdk_port_id_, qid,
-                              reinterpret_cast<rte_mbuf **>(pkts), cnt);
+                              reinterpret_cast<rte_mbuf **>(pkts), to_send);
+
+  // Unsent packets are counted as dropped by the caller once it frees them,
+  // as it may also retry them later (see PortOut).
   auto &stats = queue_stats[PACKET_DIR_OUT][qid];
-  int dropped = cnt - sent;
-  stats.dropped += dropped;
   stats.requested_hist[cnt]++;
   stats.actual_hist[sent]++;
-  stats.diff_hist[dropped]++;
   return sent;
 }
 
+int PMDPort::EnableRxNotification(queue_t qid) {
+  int fd = rx_intr_fds_[qid];
+
+  if (fd >= 0 && rte_eth_dev_rx_intr_enable(dpdk_port_id_, qid) != 0) {
+    return -1;
+  }
+  return fd;
+}
+
+bool PMDPort::RxPending(queue_t qid) {
+  // Interrupts are raised only for packets received once they are enabled
+  return rx_intr_fds_[qid] >= 0 &&
+         rte_eth_rx_descriptor_status(dpdk_port_id_, qid, 0) ==
+             RTE_ETH_RX_DESC_DONE;
+}
+
+void PMDPort::DisableRxNotification(queue_t qid) {
+  int fd = rx_intr_fds_[qid];
+
+  if (fd >= 0) {
+    rte_eth_dev_rx_intr_disable(dpdk_port_id_, qid);
+
+    uint64_t cnt;
+    while (read(fd, &cnt, sizeof(cnt)) > 0) {
+    }
+  }
+}
+
 Port::LinkStatus PMDPort::GetLinkStatus() {
   rte_eth_link status;
   // rte_eth_link_get() may block up to 9 seconds, so use _nowait() variant.
@@ -31,6 +31,8 @@
 #ifndef BESS_DRIVERS_PMD_H_
 #define BESS_DRIVERS_PMD_H_
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #include <rte_config.h>
@@ -53,7 +55,12 @@ class PMDPort final : public Port {
       : Port(),
         dpdk_port_id_(DPDK_PORT_UNKNOWN),
         hot_plugged_(false),
-        node_placement_(UNCONSTRAINED_SOCKET) {}
+        node_placement_(UNCONSTRAINED_SOCKET),
+        rx_offloads_(),
+        tx_offloads_(),
+        tx_sw_cksum_() {
+    std::fill(std::begin(rx_intr_fds_), std::end(rx_intr_fds_), -1);
+  }
 
   void InitDriver() override;
 
@@ -70,6 +77,9 @@ class PMDPort final : public Port {
    *
    * EXPECTS:
    * * Must specify exactly one of port_id or PCI or vdev.
+   *
+   * Requested hardware offloads (checksum, LRO, VLAN) are enabled only
+   * if the device supports them.
    */
   CommandResponse Init(const bess::pb::PMDPortArg &arg);
 
@@ -127,6 +137,20 @@ class PMDPort final : public Port {
 
   LinkStatus GetLinkStatus() override;
 
+  /*!
+   * Arms the RX interrupt of the queue, if enabled with the rx_interrupt
+   * option, and returns its event fd.
+   */
+  int EnableRxNotification(queue_t qid) override;
+
+  /*!
+   * True if a packet is already waiting on the queue, which its RX interrupt
+   * would not report.
+   */
+  bool RxPending(queue_t qid) override;
+
+  void DisableRxNotification(queue_t qid) override;
+
   CommandResponse UpdateConf(const Conf &conf) override;
 
   /*!
@@ -155,6 +179,28 @@ class PMDPort final : public Port {
   placement_constraint node_placement_;
 
   std::string driver_;  // ixgbe, i40e, ...
+
+  /*!
+   * Calculates the checksums requested by the PKT_TX_* flags of pkt that the
+   * device cannot offload, and clears the corresponding flags.
+   */
+  void FixupTxChecksum(bess::Packet *pkt) const;
+
+  /*!
+   * Negotiated offloads (DEV_RX_OFFLOAD_* and DEV_TX_OFFLOAD_*)
+   */
+  uint64_t rx_offloads_;
+  uint64_t tx_offloads_;
+
+  /*!
+   * DEV_TX_OFFLOAD_*_CKSUM offloads to be emulated in software
+   */
+  uint64_t tx_sw_cksum_;
+
+  /*!
+   * Event fds of RX interrupts, -1 if not enabled
+   */
+  int rx_intr_fds_[MAX_QUEUES_PER_DIR];
 };
 
 #endif  // BESS_DRIVERS_PMD_H_
@@ -98,6 +98,12 @@ class UnixSocketPort final : public Port {
   int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
   int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
+  // The socket becomes readable when packets arrive (-1 if not connected).
+  int EnableRxNotification(queue_t) override { return client_fd_; }
+
+  // Skip min_rx_interval_ns for the first poll after an idle sleep
+  void DisableRxNotification(queue_t) override { last_idle_ns_ = 0; }
+
  private:
   void ReplenishRecvVector(int cnt);
 
@@ -40,16 +40,17 @@ namespace bess {
 
 /*
  * An Event is a lightweight notification of some activity in the BESS core.
- * Currently these are only "sent" to Modules via `Module::OnEvent()`, but they
- * could easily be extended to other entities in the system. See below for a
- * description of
+ * Currently these are only "sent" to Modules via `Module::OnEvent()` and to
+ * gate hooks via `GateHook::OnEvent()`, but they could easily be extended to
+ * other entities in the system. See below for a description of
  *
  * PreResume
  * ---------
  * Modules will receive the PreResume event immediately before a call to
  * `resume_worker()` or `resume_all_workers()`. If a Module is attached to
  * multiple workers which are being resumed at the same time (e.g., via
- * WorkerPauser) it will recieve PreResume exactly once.
+ * WorkerPauser) it will recieve PreResume exactly once. Every gate hook
+ * receives it before modules do, whichever workers are resumed.
  */
 enum class Event { PreResume };
 
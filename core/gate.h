@@ -38,6 +38,7 @@
 #include <grpc/grpc.h>
 
 #include "commands.h"
+#include "event.h"
 #include "message.h"
 #include "pktbatch.h"
 #include "utils/common.h"
@@ -101,6 +102,9 @@ class GateHook {
 
   virtual void ProcessBatch(const bess::PacketBatch *) {}
 
+  // Like Module::OnEvent(), for PreResume only (see event.h)
+  virtual int OnEvent(bess::Event) { return -ENOTSUP; }
+
   CommandResponse RunCommand(const std::string &cmd,
                              const google::protobuf::Any &arg);
 
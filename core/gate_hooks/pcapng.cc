@@ -40,8 +40,8 @@
 
 #include "../message.h"
 #include "../utils/common.h"
+#include "../utils/copy.h"
 #include "../utils/pcapng.h"
-#include "../utils/time.h"
 
 using namespace bess::utils::pcapng;
 
@@ -82,15 +82,28 @@ void BytesToHexDump(const void *src, size_t len, char *dst) {
   }
 }
 
+// Sum of the sizes of the attributes, each preceded by a "valid" byte
+size_t MetadataSize(const std::vector<PcapngRing::Attr> &attrs) {
+  size_t size = 0;
+  for (const auto &attr : attrs) {
+    size += 1 + attr.size;
+  }
+  return size;
+}
+
 }  // namespace
 
 const std::string Pcapng::kName = "PcapNg";
 
+const GateHookCommands Pcapng::cmds = {
+    {"get_stats", "CaptureCommandGetStatsArg",
+     GATE_HOOK_CMD_FUNC(&Pcapng::CommandGetStats),
+     GateHookCommand::THREAD_UNSAFE}};
+
 Pcapng::Pcapng()
     : bess::GateHook(Pcapng::kName, "pcapng", Pcapng::kPriority),
       opener_(),
-      attrs_(),
-      attr_template_() {}
+      ring_() {}
 
 // Send the initialization data on the FIFO, once it's open.
 bool PcapngOpener::InitFifo(int fd) {
@@ -110,7 +123,7 @@ bool PcapngOpener::InitFifo(int fd) {
       .tot_len = sizeof(idb) + sizeof(uint32_t),
       .link_type = InterfaceDescriptionBlock::kEthernet,
       .reserved = 0,
-      .snap_len = 1518,
+      .snap_len = snaplen_,
   };
 
   uint32_t idb_tot_len = idb.tot_len;
@@ -125,10 +138,109 @@ bool PcapngOpener::InitFifo(int fd) {
   return writev(fd, vec, 4) > 0;
 }
 
+PcapngRing::PcapngRing(bess::utils::FifoOpener *opener, uint32_t snaplen,
+                       const std::vector<Attr> &attrs, const std::string &tmpl)
+    : CaptureRing(opener, snaplen, MetadataSize(attrs)),
+      attrs_(attrs),
+      attr_template_(tmpl.begin(), tmpl.end()) {}
+
+void PcapngRing::CopyMetadata(const bess::Packet *pkt, char *dst) const {
+  for (const Attr &attr : attrs_) {
+    char *valid = dst + attr.rec_offset;
+    if (bess::metadata::IsValidOffset(attr.md_offset)) {
+      *valid = 1;
+      bess::utils::Copy(valid + 1,
+                        _ptr_attr_with_offset<char>(attr.md_offset, pkt),
+                        attr.size);
+    } else {
+      *valid = 0;
+    }
+  }
+}
+
+size_t PcapngRing::MaxFormattedSize() const {
+  return sizeof(EnhancedPacketBlock) + RoundUp<size_t>(snaplen(), 4) +
+         sizeof(Option) + RoundUp<size_t>(attr_template_.size(), 4) +
+         sizeof(Option) + sizeof(uint32_t);
+}
+
+size_t PcapngRing::Format(const Record &rec, char *buf) {
+  const char *md = metadata(rec);
+  uint16_t comment_size = static_cast<uint16_t>(attr_template_.size());
+  uint64_t ts = rec.ts_ns / 1000;
+
+  for (const Attr &attr : attrs_) {
+    const char *valid = md + attr.rec_offset;
+    if (*valid) {
+      BytesToHexDump(valid + 1, attr.size, &attr_template_[attr.tmpl_offset]);
+    } else {
+      auto string_it = attr_template_.begin() + attr.tmpl_offset;
+      std::fill(string_it, string_it + attr.size * 2, 'X');
+    }
+  }
+
+  uint32_t data_len = RoundUp<uint32_t>(rec.incl_len, 4);
+  uint32_t comment_len = RoundUp<uint32_t>(comment_size, 4);
+
+  EnhancedPacketBlock epb = {
+      .type = EnhancedPacketBlock::kType,
+      .tot_len = static_cast<uint32_t>(sizeof(epb) + sizeof(uint32_t) +
+                                       data_len + sizeof(Option) +
+                                       comment_len + sizeof(Option)),
+      .interface_id = 0,
+      .timestamp_high = static_cast<uint32_t>(ts >> 32),
+      .timestamp_low = static_cast<uint32_t>(ts),
+      .captured_len = rec.incl_len,
+      .orig_len = rec.orig_len,
+  };
+
+  Option opt_comment = {
+      .code = Option::kComment,
+      .len = comment_size,
+  };
+
+  Option opt_end = {
+      .code = Option::kEndOfOpts,
+      .len = 0,
+  };
+
+  char *p = buf;
+
+  bess::utils::Copy(p, &epb, sizeof(epb));
+  p += sizeof(epb);
+
+  bess::utils::Copy(p, rec.data, rec.incl_len);
+  memset(p + rec.incl_len, 0, data_len - rec.incl_len);
+  p += data_len;
+
+  bess::utils::Copy(p, &opt_comment, sizeof(opt_comment));
+  p += sizeof(opt_comment);
+
+  bess::utils::Copy(p, attr_template_.data(), comment_size);
+  memset(p + comment_size, 0, comment_len - comment_size);
+  p += comment_len;
+
+  bess::utils::Copy(p, &opt_end, sizeof(opt_end));
+  p += sizeof(opt_end);
+
+  bess::utils::Copy(p, &epb.tot_len, sizeof(epb.tot_len));
+  p += sizeof(epb.tot_len);
+
+  return p - buf;
+}
+
 CommandResponse Pcapng::Init(const bess::Gate *gate,
                              const bess::pb::PcapngArg &arg) {
   Module *m = gate->module();
+  std::vector<PcapngRing::Attr> attrs;
   std::string tmpl;
+  size_t rec_offset = 0;
+
+  uint32_t snaplen = arg.snaplen() ?: bess::utils::CaptureRing::kDefaultSnaplen;
+  if (snaplen > std::numeric_limits<uint16_t>::max()) {
+    return CommandFailure(EINVAL, "snaplen must be at most %d",
+                          std::numeric_limits<uint16_t>::max());
+  }
 
   size_t i = 0;
   for (const auto &it : m->all_attrs()) {
@@ -143,9 +255,11 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
       break;
     }
 
-    attrs_.emplace_back(Attr{.md_offset = m->attr_offset(i),
-                             .size = it.size,
-                             .tmpl_offset = tmpl_offset});
+    attrs.emplace_back(PcapngRing::Attr{.md_offset = m->attr_offset(i),
+                                        .size = it.size,
+                                        .tmpl_offset = tmpl_offset,
+                                        .rec_offset = rec_offset});
+    rec_offset += 1 + it.size;
     i++;
   }
 
@@ -157,12 +271,23 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
     tmpl.resize(std::numeric_limits<uint16_t>::max());
   }
 
-  attr_template_ = std::vector<char>(tmpl.begin(), tmpl.end());
-
   int ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
   }
+  opener_.set_snaplen(snaplen);
+
+  ring_.reset(new PcapngRing(&opener_, snaplen, attrs, tmpl));
+  if (!ring_->SetFilter(arg.filter())) {
+    return CommandFailure(EINVAL, "BPF compilation error");
+  }
+  ring_->SetSampling(arg.sample_one_in_n(), arg.sample_pps());
+  ring_->Prepare(m->active_workers());
+
+  if (!ring_->Start()) {
+    return CommandFailure(errno, "Failed to start the writer thread");
+  }
+
   ret = arg.defer() ? opener_.OpenInThread() : opener_.OpenNow();
   if (ret < 0) {
     return CommandFailure(-errno, "Failed to open FIFO");
@@ -172,81 +297,35 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
 }
 
 void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
-  int fd;
-  uint32_t gen;
-  std::tie(fd, gen) = opener_.GetCurrentFd();
-  if (!opener_.IsValidFd(fd)) {
-    return;
-  }
+  ring_->Capture(batch);
+}
 
-  struct timeval tv;
+int Pcapng::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
 
-  gettimeofday(&tv, nullptr);
+  // The module may have been scheduled on other workers since
+  ring_->Prepare(gate_->module()->active_workers());
+  return 0;
+}
 
-  uint64_t ts = tv.tv_sec * 1000000 + tv.tv_usec;
-  uint16_t comment_size = static_cast<uint16_t>(attr_template_.size());
+CommandResponse Pcapng::CommandGetStats(
+    const bess::pb::CaptureCommandGetStatsArg &arg) {
+  bess::pb::CaptureCommandGetStatsResponse r;
+  bess::utils::CaptureRing::Stats stats = ring_->stats();
 
-  for (int i = 0; i < batch->cnt(); i++) {
-    bess::Packet *pkt = batch->pkts()[i];
-
-    Option opt_comment = {
-        .code = Option::kComment,
-        .len = comment_size,
-    };
-
-    for (const Attr &attr : attrs_) {
-      const char *attr_data = ptr_attr_with_offset<char>(attr.md_offset, pkt);
-      if (attr_data != nullptr) {
-        BytesToHexDump(attr_data, attr.size, &attr_template_[attr.tmpl_offset]);
-      } else {
-        auto string_it = attr_template_.begin() + attr.tmpl_offset;
-        std::fill(string_it, string_it + attr.size * 2, 'X');
-      }
-    }
+  r.set_captured(stats.captured);
+  r.set_dropped(stats.dropped);
+  r.set_bytes(stats.bytes);
+  r.set_lost(stats.lost);
+  r.set_skipped(stats.skipped);
 
-    Option opt_end = {
-        .code = Option::kEndOfOpts,
-        .len = 0,
-    };
-
-    EnhancedPacketBlock epb = {
-        .type = EnhancedPacketBlock::kType,
-        .tot_len = static_cast<uint32_t>(
-            sizeof(epb) + sizeof(uint32_t) +
-            RoundUp<uint32_t>(pkt->head_len(), 4) + sizeof(opt_comment) +
-            RoundUp<uint32_t>(comment_size, 4) + sizeof(opt_end)),
-        .interface_id = 0,
-        .timestamp_high = static_cast<uint32_t>(ts >> 32),
-        .timestamp_low = static_cast<uint32_t>(ts),
-        .captured_len = static_cast<uint32_t>(pkt->head_len()),
-        .orig_len = static_cast<uint32_t>(pkt->total_len()),
-    };
-
-    uint32_t padding = 0;
-
-    uint32_t epb_tot_len = epb.tot_len;
-
-    struct iovec vec[8] = {
-        {&epb, sizeof(epb)},
-        {pkt->head_data(), static_cast<size_t>(pkt->head_len())},
-        {&padding, static_cast<size_t>(PadSize(pkt->head_len(), 4))},
-
-        {&opt_comment, sizeof(opt_comment)},
-        {attr_template_.data(), comment_size},
-        {&padding, static_cast<size_t>(PadSize<uint32_t>(comment_size, 4))},
-        {&opt_end, sizeof(opt_end)},
-
-        {&epb_tot_len, sizeof(epb_tot_len)}};
-
-    int ret = writev(fd, vec, 8);
-    if (ret < 0) {
-      if (errno == EPIPE) {
-        DLOG(WARNING) << "Broken pipe: stopping pcapng";
-        opener_.MarkDead(fd, gen);
-      }
-      return;
-    }
+  if (arg.clear()) {
+    ring_->ResetStats();
   }
+
+  return CommandSuccess(r);
 }
 
 ADD_GATE_HOOK(Pcapng, "pcapng", "metadata-dump-able packet dump")
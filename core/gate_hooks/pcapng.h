@@ -31,19 +31,64 @@
 #ifndef BESS_GATE_HOOKS_PCAPNG_
 #define BESS_GATE_HOOKS_PCAPNG_
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_ring.h"
 #include "../utils/fifo_opener.h"
 
 class PcapngOpener final : public bess::utils::FifoOpener {
  public:
-  PcapngOpener() : FifoOpener() {}
+  PcapngOpener() : FifoOpener(), snaplen_(1518) {}
   bool InitFifo(int fd) override;
+
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
+};
+
+// Formats captured packets as pcapng Enhanced Packet Blocks, with a hex dump
+// of the metadata attributes in the comment.
+class PcapngRing final : public bess::utils::CaptureRing {
+ public:
+  struct Attr {
+    // Attribute offset in the packet metadata.
+    int md_offset;
+    // Size in bytes of the attribute.
+    size_t size;
+    // Offset where this attribute hex dump should go inside `attr_template_`.
+    size_t tmpl_offset;
+    // Offset of the attribute in the captured record metadata.  The value is
+    // preceded by a byte telling whether the attribute was valid.
+    size_t rec_offset;
+  };
+
+  PcapngRing(bess::utils::FifoOpener *opener, uint32_t snaplen,
+             const std::vector<Attr> &attrs, const std::string &tmpl);
+  ~PcapngRing() { Stop(); }
+
+ protected:
+  void CopyMetadata(const bess::Packet *pkt, char *dst) const override;
+  size_t Format(const Record &rec, char *buf) override;
+  size_t MaxFormattedSize() const override;
+
+ private:
+  // List of attributes to dump.
+  const std::vector<Attr> attrs_;
+  // Preallocated string with attribute names and values.  For each packet,
+  // the writer thread changes in place the values and copies the string out,
+  // without doing any memory allocation.
+  std::vector<char> attr_template_;
 };
 
 // Pcapng dumps copies of the packets seen by a gate (data + metadata) in
-// pcapng format.  Useful for debugging.
+// pcapng format.  Useful for debugging.  Packets are written out by a
+// separate thread (see CaptureRing).
 class Pcapng final : public bess::GateHook {
  public:
   Pcapng();
@@ -54,28 +99,21 @@ class Pcapng final : public bess::GateHook {
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  int OnEvent(bess::Event e) override;
+
+  CommandResponse CommandGetStats(
+      const bess::pb::CaptureCommandGetStatsArg &arg);
+
   static constexpr uint16_t kPriority = 2;
   static const std::string kName;
+  static const GateHookCommands cmds;
 
  private:
-  struct Attr {
-    // Attribute offset in the packet metadata.
-    int md_offset;
-    // Size in bytes of the attribute.
-    size_t size;
-    // Offset where this attribute hex dump should go inside `attr_template_`.
-    size_t tmpl_offset;
-  };
-
   // The opener instance for the FIFO for the captured packets.
   PcapngOpener opener_;
 
-  // List of attributes to dump.
-  std::vector<Attr> attrs_;
-  // Preallocated string with attribute names and values.  For each packet,
-  // we will change in place the values and send the string out, without
-  // doing any memory allocation.
-  std::vector<char> attr_template_;
+  // Declared after opener_, so that the writer thread stops first
+  std::unique_ptr<PcapngRing> ring_;
 };
 
 #endif  // BESS_GATE_HOOKS_PCAPNG_
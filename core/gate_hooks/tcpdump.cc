@@ -31,37 +31,72 @@
 #include "tcpdump.h"
 
 #include <fcntl.h>
-#include <sys/uio.h>
 #include <unistd.h>
 
 #include <glog/logging.h>
 
 #include "../message.h"
+#include "../module.h"
 #include "../utils/common.h"
-#include "../utils/pcap.h"
-#include "../utils/time.h"
+#include "../utils/copy.h"
 
 const std::string Tcpdump::kName = "TcpDump";
 
+const GateHookCommands Tcpdump::cmds = {
+    {"get_stats", "CaptureCommandGetStatsArg",
+     GATE_HOOK_CMD_FUNC(&Tcpdump::CommandGetStats),
+     GateHookCommand::THREAD_UNSAFE}};
+
 bool TcpdumpOpener::InitFifo(int fd) {
-  static const struct pcap_hdr hdr = {
+  const struct pcap_hdr hdr = {
       .magic_number = PCAP_MAGIC_NUMBER,
       .version_major = PCAP_VERSION_MAJOR,
       .version_minor = PCAP_VERSION_MINOR,
       .thiszone = PCAP_THISZONE,
       .sigfigs = PCAP_SIGFIGS,
-      .snaplen = PCAP_SNAPLEN,
+      .snaplen = snaplen_,
       .network = PCAP_NETWORK,
   };
   return write(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
 }
 
-CommandResponse Tcpdump::Init(const bess::Gate *,
+size_t TcpdumpRing::Format(const Record &rec, char *buf) {
+  struct pcap_rec_hdr hdr = {
+      .ts_sec = static_cast<uint32_t>(rec.ts_ns / 1000000000),
+      .ts_usec = static_cast<uint32_t>(rec.ts_ns % 1000000000 / 1000),
+      .incl_len = rec.incl_len,
+      .orig_len = rec.orig_len,
+  };
+
+  bess::utils::Copy(buf, &hdr, sizeof(hdr));
+  bess::utils::Copy(buf + sizeof(hdr), rec.data, rec.incl_len);
+  return sizeof(hdr) + rec.incl_len;
+}
+
+CommandResponse Tcpdump::Init(const bess::Gate *gate,
                               const bess::pb::TcpdumpArg &arg) {
+  uint32_t snaplen = arg.snaplen() ?: bess::utils::CaptureRing::kDefaultSnaplen;
+  if (snaplen > PCAP_SNAPLEN) {
+    return CommandFailure(EINVAL, "snaplen must be at most %d", PCAP_SNAPLEN);
+  }
+
   int ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
   }
+  opener_.set_snaplen(snaplen);
+
+  ring_.reset(new TcpdumpRing(&opener_, snaplen));
+  if (!ring_->SetFilter(arg.filter())) {
+    return CommandFailure(EINVAL, "BPF compilation error");
+  }
+  ring_->SetSampling(arg.sample_one_in_n(), arg.sample_pps());
+  ring_->Prepare(gate->module()->active_workers());
+
+  if (!ring_->Start()) {
+    return CommandFailure(errno, "Failed to start the writer thread");
+  }
+
   ret = arg.defer() ? opener_.OpenInThread() : opener_.OpenNow();
   if (ret < 0) {
     return CommandFailure(-errno, "Failed to open FIFO");
@@ -71,37 +106,35 @@ CommandResponse Tcpdump::Init(const bess::Gate *,
 }
 
 void Tcpdump::ProcessBatch(const bess::PacketBatch *batch) {
-  int fd;
-  uint32_t gen;
-  std::tie(fd, gen) = opener_.GetCurrentFd();
-  if (!opener_.IsValidFd(fd)) {
-    return;
+  ring_->Capture(batch);
+}
+
+int Tcpdump::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
   }
 
-  struct timeval tv;
-  gettimeofday(&tv, nullptr);
-
-  for (int i = 0; i < batch->cnt(); i++) {
-    bess::Packet *pkt = batch->pkts()[i];
-    struct pcap_rec_hdr rec = {
-        .ts_sec = (uint32_t)tv.tv_sec,
-        .ts_usec = (uint32_t)tv.tv_usec,
-        .incl_len = (uint32_t)pkt->head_len(),
-        .orig_len = (uint32_t)pkt->total_len(),
-    };
-
-    struct iovec vec[2] = {{&rec, sizeof(rec)},
-                           {pkt->head_data(), (size_t)pkt->head_len()}};
-
-    int ret = writev(fd, vec, 2);
-    if (ret < 0) {
-      if (errno == EPIPE) {
-        DLOG(WARNING) << "Broken pipe: stopping tcpdump";
-        opener_.MarkDead(fd, gen);
-      }
-      return;
-    }
+  // The module may have been scheduled on other workers since
+  ring_->Prepare(gate_->module()->active_workers());
+  return 0;
+}
+
+CommandResponse Tcpdump::CommandGetStats(
+    const bess::pb::CaptureCommandGetStatsArg &arg) {
+  bess::pb::CaptureCommandGetStatsResponse r;
+  bess::utils::CaptureRing::Stats stats = ring_->stats();
+
+  r.set_captured(stats.captured);
+  r.set_dropped(stats.dropped);
+  r.set_bytes(stats.bytes);
+  r.set_lost(stats.lost);
+  r.set_skipped(stats.skipped);
+
+  if (arg.clear()) {
+    ring_->ResetStats();
   }
+
+  return CommandSuccess(r);
 }
 
 ADD_GATE_HOOK(Tcpdump, "tcpdump", "dump traffic on a network")
@@ -31,23 +31,48 @@
 #ifndef BESS_GATE_HOOKS_TCPDUMP_
 #define BESS_GATE_HOOKS_TCPDUMP_
 
+#include <memory>
+
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_ring.h"
 #include "../utils/fifo_opener.h"
+#include "../utils/pcap.h"
 
 class TcpdumpOpener final : public bess::utils::FifoOpener {
  public:
-  TcpdumpOpener() : FifoOpener() {}
+  TcpdumpOpener() : FifoOpener(), snaplen_(PCAP_SNAPLEN) {}
   bool InitFifo(int fd) override;
+
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
+};
+
+// Formats captured packets as pcap records.
+class TcpdumpRing final : public bess::utils::CaptureRing {
+ public:
+  TcpdumpRing(bess::utils::FifoOpener *opener, uint32_t snaplen)
+      : CaptureRing(opener, snaplen) {}
+  ~TcpdumpRing() { Stop(); }
+
+ protected:
+  size_t Format(const Record &rec, char *buf) override;
+  size_t MaxFormattedSize() const override {
+    return sizeof(struct pcap_rec_hdr) + snaplen();
+  }
 };
 
 // Tcpdump dumps copies of the packets seen by a gate. Useful for debugging.
+// Packets are written out by a separate thread (see CaptureRing).
 class Tcpdump final : public bess::GateHook {
  public:
   Tcpdump()
       : bess::GateHook(Tcpdump::kName, "tcpdump", Tcpdump::kPriority),
-        opener_() {}
+        opener_(),
+        ring_() {}
 
   virtual ~Tcpdump() {}
 
@@ -55,11 +80,20 @@ class Tcpdump final : public bess::GateHook {
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  int OnEvent(bess::Event e) override;
+
+  CommandResponse CommandGetStats(
+      const bess::pb::CaptureCommandGetStatsArg &arg);
+
   static constexpr uint16_t kPriority = 1;
   static const std::string kName;
+  static const GateHookCommands cmds;
 
  private:
   TcpdumpOpener opener_;
+
+  // Declared after opener_, so that the writer thread stops first
+  std::unique_ptr<TcpdumpRing> ring_;
 };
 
 #endif  // BESS_GATE_HOOKS_TCPDUMP_
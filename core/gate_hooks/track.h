@@ -34,7 +34,8 @@
 #include "../message.h"
 #include "../module.h"
 
-// TrackGate counts the number of packets, batches and bytes seen by a gate.
+// Track counts the number of packets, batches and bytes seen by a gate. It
+// only keeps per-worker totals, not distributions: for latencies, see Measure.
 class Track final : public bess::GateHook {
  public:
   Track();
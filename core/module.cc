@@ -43,6 +43,8 @@
 
 const Commands Module::cmds;
 
+std::atomic<bool> Module::profiling_(false);
+
 bool ModuleBuilder::RegisterModuleClass(
     std::function<Module *()> module_generator, const std::string &class_name,
     const std::string &name_template, const std::string &help_text,
@@ -153,6 +155,11 @@ void Module::ProcessBatch(Context *, bess::PacketBatch *) {
   CHECK(0);  // You must override this function
 }
 
+uint32_t Module::Poll(Context *) {
+  CHECK(0);  // You must override this function
+  return 0;
+}
+
 task_id_t Module::RegisterTask(void *arg) {
   std::string leafname = std::string("!leaf_") + name_ + std::string(":") +
                          std::to_string(tasks_.size());
@@ -189,6 +196,48 @@ placement_constraint Module::ComputePlacementConstraints(
   return constraint;
 }
 
+bool Module::AllowsAnyWorker(
+    std::unordered_set<const Module *> *visited) const {
+  if (max_allowed_workers_ < Worker::kMaxWorkers) {
+    return false;
+  }
+  if (!visited->insert(this).second || !propagate_workers_) {
+    return true;
+  }
+  for (const auto ogate : ogates_) {
+    if (ogate &&
+        !static_cast<Module *>(ogate->next())->AllowsAnyWorker(visited)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t Module::CommonActiveWorkers(
+    std::unordered_set<const Module *> *visited) const {
+  if (!visited->insert(this).second) {
+    return ~0ull;
+  }
+
+  uint64_t mask = 0;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (active_workers_[wid]) {
+      mask |= 1ull << wid;
+    }
+  }
+  if (!propagate_workers_) {
+    return mask;
+  }
+
+  for (const auto ogate : ogates_) {
+    if (ogate) {
+      auto next = static_cast<Module *>(ogate->next());
+      mask &= next->CommonActiveWorkers(visited);
+    }
+  }
+  return mask;
+}
+
 void Module::AddActiveWorker(int wid, const Task *t) {
   if (!HaveVisitedWorker(t)) {  // Have not already accounted for
                                 // worker.
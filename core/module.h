@@ -181,6 +181,14 @@ enum CheckConstraintResult {
   CHECK_FATAL_ERROR = 2
 };
 
+// Per-worker cost of a module, accumulated by Task while profiling is enabled
+// (see Module::set_profiling()). RunTask() calls are accounted as batches too.
+struct alignas(64) ModuleProfile {
+  uint64_t cycles;   // TSC cycles spent in ProcessBatch() and RunTask()
+  uint64_t batches;  // # of calls
+  uint64_t packets;  // # of packets processed (or generated by RunTask())
+};
+
 class alignas(64) Module {
   // overide this section to create a new module -----------------------------
  public:
@@ -195,6 +203,7 @@ class alignas(64) Module {
         igates_(),
         ogates_(),
         deadends_(),
+        profile_(),
         active_workers_(Worker::kMaxWorkers, false),
         visited_tasks_(),
         is_task_(false),
@@ -225,6 +234,12 @@ class alignas(64) Module {
   // 1) forwards to the next modules, or 2) free
   virtual void ProcessBatch(Context *ctx, bess::PacketBatch *batch);
 
+  // Called on every scheduling round of every worker, once the module has
+  // been registered with bess::StealQueue::SetPolled(), whether or not any
+  // packet comes in (e.g., to process packets handed over by other workers).
+  // Returns the number of packets processed.
+  virtual uint32_t Poll(Context *ctx);
+
   // If a derived Module overrides OnEvent and doesn't return  -ENOTSUP for a
   // particular Event `e` it will be invoked for each instance of the derived
   // Module whenever `e` occours. See `event.h` for details about the various
@@ -233,6 +248,20 @@ class alignas(64) Module {
 
   virtual std::string GetDesc() const { return ""; }
 
+  // Before an idle worker goes to sleep, ArmIdleWakeup() is called for each of
+  // its tasks. A module may arm a notification for new work of the task 'arg'
+  // and return a file descriptor that becomes readable then. If it returns -1,
+  // the task will be polled again only after the worker wakes up for another
+  // reason (at latest after IdleConfig::max_sleep_ns).
+  // Once all notifications are armed, HasIdleWork() is called for the tasks
+  // that armed one: it returns true if the task already has new work that
+  // the notification may not report (e.g., it arrived before being armed),
+  // in which case the worker does not sleep.
+  // DisarmIdleWakeup() is called after the worker wakes up.
+  virtual int ArmIdleWakeup(void *) { return -1; }
+  virtual bool HasIdleWork(void *) { return false; }
+  virtual void DisarmIdleWakeup(void *) {}
+
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
 
@@ -336,11 +365,39 @@ class alignas(64) Module {
     return std::accumulate(deadends_.begin(), deadends_.end(), 0);
   }
 
+  // Per-module profiling is disabled by default, as it costs two rdtsc() per
+  // module per batch. When disabled, the overhead is a single (predicted)
+  // branch per batch.
+  static bool profiling() {
+    return profiling_.load(std::memory_order_relaxed);
+  }
+  static void set_profiling(bool enable) { profiling_ = enable; }
+
+  void AddProfile(int wid, uint64_t cycles, uint64_t packets) {
+    ModuleProfile &p = profile_[wid];
+    p.cycles += cycles;
+    p.batches++;
+    p.packets += packets;
+  }
+
+  const ModuleProfile &profile(int wid) const { return profile_[wid]; }
+
+  void ResetProfile() { profile_.fill(ModuleProfile()); }
+
   // Compute placement constraints based on the current module and all
   // downstream modules (i.e., modules connected to out ports.
   placement_constraint ComputePlacementConstraints(
       std::unordered_set<const Module *> *visited) const;
 
+  // True if this module and all downstream modules may run on any worker.
+  // Modules that do not propagate workers (e.g., Queue) end the pipeline.
+  bool AllowsAnyWorker(std::unordered_set<const Module *> *visited) const;
+
+  // Bitmask of the workers that are active in this module and in every
+  // downstream module it propagates workers to.
+  uint64_t CommonActiveWorkers(
+      std::unordered_set<const Module *> *visited) const;
+
   // Reset the set of active workers.
   void ResetActiveWorkerSet() {
     std::fill(active_workers_.begin(), active_workers_.end(), false);
@@ -453,6 +510,9 @@ class alignas(64) Module {
   std::vector<bess::IGate *> igates_;
   std::vector<bess::OGate *> ogates_;
   std::array<uint64_t, Worker::kMaxWorkers> deadends_;
+  std::array<ModuleProfile, Worker::kMaxWorkers> profile_;
+
+  static std::atomic<bool> profiling_;
 
  protected:
   // Set of active workers accessing this module.
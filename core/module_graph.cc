@@ -36,6 +36,7 @@
 #include "gate_hooks/track.h"
 #include "module.h"
 #include "scheduler.h"
+#include "steal_queue.h"
 #include "utils/extended_priority_queue.h"
 
 std::map<std::string, Module *> ModuleGraph::all_modules_;
@@ -195,6 +196,8 @@ void ModuleGraph::ConfigureTasks() {
       }
     }
   }
+
+  bess::StealQueue::UpdatePerGateBatch(gate_cnt_);
 }
 
 void ModuleGraph::UpdateTaskGraph() {
@@ -409,4 +412,7 @@ void ModuleGraph::PropagateActiveWorker() {
       }
     }
   }
+
+  // Idle workers may run batches offloaded by a task on another worker
+  bess::StealQueue::PropagateActiveWorkers();
 }
@@ -33,6 +33,67 @@
 #include "../utils/ip.h"
 #include "../utils/udp.h"
 
+bool ACLClassifier::Add(const Ipv4Prefix &src_ip, const Ipv4Prefix &dst_ip,
+                        be16_t src_port, be16_t dst_port, uint32_t id) {
+  be16_t src_port_mask = (src_port == be16_t(0)) ? be16_t(0) : be16_t(0xffff);
+  be16_t dst_port_mask = (dst_port == be16_t(0)) ? be16_t(0) : be16_t(0xffff);
+
+  Key mask = MakeKey(src_ip.mask, dst_ip.mask, src_port_mask, dst_port_mask);
+  Key key = MakeKey(src_ip.addr & src_ip.mask, dst_ip.addr & dst_ip.mask,
+                    src_port, dst_port);
+
+  Tuple *tuple = nullptr;
+  for (auto &t : tuples_) {
+    if (t.mask.ips == mask.ips && t.mask.ports == mask.ports) {
+      tuple = &t;
+      break;
+    }
+  }
+
+  if (tuple == nullptr) {
+    // Since IDs only grow, appending keeps tuples_ sorted by min_id.
+    tuples_.emplace_back();
+    tuple = &tuples_.back();
+    tuple->mask = mask;
+    tuple->min_id = id;
+  }
+
+  if (tuple->rules.Find(key) != nullptr) {
+    return true;
+  }
+
+  return tuple->rules.Insert(key, id) != nullptr;
+}
+
+void ACLClassifier::Lookup(const Key *keys, int cnt, uint32_t *ids) const {
+  for (int i = 0; i < cnt; i++) {
+    ids[i] = kNoMatch;
+  }
+
+  for (const auto &tuple : tuples_) {
+    bool pending = false;
+
+    for (int i = 0; i < cnt; i++) {
+      // Neither this nor any later tuple can improve on the current match
+      if (ids[i] < tuple.min_id) {
+        continue;
+      }
+
+      pending = true;
+      Key masked = {keys[i].ips & tuple.mask.ips,
+                    keys[i].ports & tuple.mask.ports};
+      const auto *entry = tuple.rules.Find(masked);
+      if (entry != nullptr && entry->second < ids[i]) {
+        ids[i] = entry->second;
+      }
+    }
+
+    if (!pending) {
+      break;
+    }
+  }
+}
+
 const Commands ACL::cmds = {
     {"add", "ACLArg", MODULE_CMD_FUNC(&ACL::CommandAdd),
      Command::THREAD_UNSAFE},
@@ -47,18 +108,22 @@ CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
         .src_port = be16_t(static_cast<uint16_t>(rule.src_port())),
         .dst_port = be16_t(static_cast<uint16_t>(rule.dst_port())),
         .drop = rule.drop()};
+    if (!classifier_.Add(new_rule.src_ip, new_rule.dst_ip, new_rule.src_port,
+                         new_rule.dst_port, rules_.size())) {
+      return CommandFailure(ENOMEM, "failed to insert rule");
+    }
     rules_.push_back(new_rule);
   }
   return CommandSuccess();
 }
 
 CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
-  Init(arg);
-  return CommandSuccess();
+  return Init(arg);
 }
 
 CommandResponse ACL::CommandClear(const bess::pb::EmptyArg &) {
   rules_.clear();
+  classifier_.Clear();
   return CommandSuccess();
 }
 
@@ -69,6 +134,9 @@ void ACL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   gate_idx_t incoming_gate = ctx->current_igate;
 
+  ACLClassifier::Key keys[bess::PacketBatch::kMaxBurst];
+  uint32_t ids[bess::PacketBatch::kMaxBurst];
+
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
@@ -79,18 +147,18 @@ void ACL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     Udp *udp =
         reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
 
-    bool emitted = false;
-    for (const auto &rule : rules_) {
-      if (rule.Match(ip->src, ip->dst, udp->src_port, udp->dst_port)) {
-        if (!rule.drop) {
-          emitted = true;
-          EmitPacket(ctx, pkt, incoming_gate);
-        }
-        break;  // Stop matching other rules
-      }
-    }
+    keys[i] = ACLClassifier::MakeKey(ip->src, ip->dst, udp->src_port,
+                                     udp->dst_port);
+  }
+
+  classifier_.Lookup(keys, cnt, ids);
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
 
-    if (!emitted) {
+    if (ids[i] != ACLClassifier::kNoMatch && !rules_[ids[i]].drop) {
+      EmitPacket(ctx, pkt, incoming_gate);
+    } else {
       DropPacket(ctx, pkt);
     }
   }
@@ -32,14 +32,82 @@
 
 #include <vector>
 
+#include <rte_hash_crc.h>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/cuckoo_map.h"
 #include "../utils/ip.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 using bess::utils::Ipv4Prefix;
 
+// Compiled form of an ACL rule set, based on tuple space search.
+// Rules with the same shape (source/destination prefix lengths and whether
+// each port is a wildcard) share one exact-match hash table, keyed by the
+// masked header fields. Rule IDs double as priorities (a lower ID wins), and
+// tuples are kept sorted by the lowest rule ID they hold, so a lookup stops
+// as soon as no remaining tuple can beat the best match found so far.
+// Lookup cost thus depends on the number of distinct rule shapes rather than
+// on the number of rules.
+class ACLClassifier {
+ public:
+  static const uint32_t kNoMatch = UINT32_MAX;
+
+  struct Key {
+    uint64_t ips;    // source and destination addresses
+    uint64_t ports;  // source and destination ports
+  };
+
+  static Key MakeKey(be32_t sip, be32_t dip, be16_t sport, be16_t dport) {
+    return {(static_cast<uint64_t>(sip.raw_value()) << 32) | dip.raw_value(),
+            (static_cast<uint64_t>(sport.raw_value()) << 16) |
+                dport.raw_value()};
+  }
+
+  // Inserts a rule. A port of 0 matches any port. IDs must be added in
+  // increasing order; if an identical rule already exists, the older one
+  // shadows the new one, as it would in a linear scan. Returns false if the
+  // rule could not be inserted.
+  bool Add(const Ipv4Prefix &src_ip, const Ipv4Prefix &dst_ip, be16_t src_port,
+           be16_t dst_port, uint32_t id);
+
+  void Clear() { tuples_.clear(); }
+
+  // Classifies a batch of 'cnt' keys. For each key, stores the ID of the
+  // first matching rule in 'ids', or kNoMatch if none matches. Tuples are
+  // visited in the outer loop so that each hash table stays cache-hot while
+  // the whole batch is probed against it.
+  void Lookup(const Key *keys, int cnt, uint32_t *ids) const;
+
+  size_t num_tuples() const { return tuples_.size(); }
+
+ private:
+  struct KeyHash {
+    uint32_t operator()(const Key &key) const {
+      uint32_t init_val = 0;
+      init_val = crc32c_sse42_u64(key.ips, init_val);
+      init_val = crc32c_sse42_u64(key.ports, init_val);
+      return init_val;
+    }
+  };
+
+  struct KeyEq {
+    bool operator()(const Key &lhs, const Key &rhs) const {
+      return lhs.ips == rhs.ips && lhs.ports == rhs.ports;
+    }
+  };
+
+  struct Tuple {
+    Key mask;
+    uint32_t min_id;  // the highest-priority rule in this tuple
+    bess::utils::CuckooMap<Key, uint32_t, KeyHash, KeyEq> rules;
+  };
+
+  std::vector<Tuple> tuples_;
+};
+
 class ACL final : public Module {
  public:
   struct ACLRule {
@@ -68,7 +136,9 @@ class ACL final : public Module {
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
 
  private:
+  // Rules in priority order. Indices are the rule IDs in classifier_.
   std::vector<ACLRule> rules_;
+  ACLClassifier classifier_;
 };
 
 #endif  // BESS_MODULES_ACL_H_
@@ -0,0 +1,167 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for the ACL module classifier.
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include <string>
+#include <vector>
+
+#include "../utils/random.h"
+#include "acl.h"
+
+using bess::utils::ToIpv4Address;
+
+namespace {
+
+static const int kBatchSize = bess::PacketBatch::kMaxBurst;
+static const int kNumPackets = 1024;
+
+// Prefix lengths of real rule sets cluster on octet boundaries and host
+// addresses, but any length shows up. Half of the prefixes take one of the
+// common lengths, the others any length in 0-32, so the number of distinct
+// (source, destination) length pairs grows with the rule set.
+static int RandomPrefixLen(Random *rd) {
+  static const int kCommonLens[] = {0, 8, 16, 24, 32};
+
+  if (rd->GetRange(2)) {
+    return kCommonLens[rd->GetRange(5)];
+  }
+  return rd->GetRange(33);
+}
+
+class ACLFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    Random rd;
+    const int num_rules = state.range(0);
+
+    for (int i = 0; i < num_rules; i++) {
+      std::string src = ToIpv4Address(be32_t(rd.Get())) + "/" +
+                        std::to_string(RandomPrefixLen(&rd));
+      std::string dst = ToIpv4Address(be32_t(rd.Get())) + "/" +
+                        std::to_string(RandomPrefixLen(&rd));
+      ACL::ACLRule rule = {
+          .src_ip = Ipv4Prefix(src),
+          .dst_ip = Ipv4Prefix(dst),
+          .src_port = be16_t(rd.GetRange(2) ? 0 : 1 + rd.GetRange(65535)),
+          .dst_port = be16_t(rd.GetRange(2) ? 0 : 1 + rd.GetRange(65535)),
+          .drop = false};
+      CHECK(classifier_.Add(rule.src_ip, rule.dst_ip, rule.src_port,
+                            rule.dst_port, rules_.size()));
+      rules_.push_back(rule);
+    }
+
+    // Half of the packets hit a rule, the other half is random traffic
+    for (int i = 0; i < kNumPackets; i++) {
+      Packet p;
+      if (i % 2 == 0) {
+        const ACL::ACLRule &rule = rules_[rd.GetRange(num_rules)];
+        p.sip = rule.src_ip.addr | (be32_t(rd.Get()) & ~rule.src_ip.mask);
+        p.dip = rule.dst_ip.addr | (be32_t(rd.Get()) & ~rule.dst_ip.mask);
+        p.sport = rule.src_port;
+        p.dport = rule.dst_port;
+      } else {
+        p.sip = be32_t(rd.Get());
+        p.dip = be32_t(rd.Get());
+        p.sport = be16_t(rd.GetRange(65536));
+        p.dport = be16_t(rd.GetRange(65536));
+      }
+      packets_.push_back(p);
+      keys_.push_back(ACLClassifier::MakeKey(p.sip, p.dip, p.sport, p.dport));
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    rules_.clear();
+    classifier_.Clear();
+    packets_.clear();
+    keys_.clear();
+  }
+
+ protected:
+  struct Packet {
+    be32_t sip;
+    be32_t dip;
+    be16_t sport;
+    be16_t dport;
+  };
+
+  std::vector<ACL::ACLRule> rules_;
+  ACLClassifier classifier_;
+  std::vector<Packet> packets_;
+  std::vector<ACLClassifier::Key> keys_;
+};
+
+}  // namespace
+
+// Per-packet linear scan over all rules, as ACL::ProcessBatch used to do.
+BENCHMARK_DEFINE_F(ACLFixture, LinearScan)(benchmark::State &state) {
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    for (int j = 0; j < kBatchSize; j++) {
+      const Packet &p = packets_[(i + j) % kNumPackets];
+      uint32_t id = ACLClassifier::kNoMatch;
+      for (size_t k = 0; k < rules_.size(); k++) {
+        if (rules_[k].Match(p.sip, p.dip, p.sport, p.dport)) {
+          id = k;
+          break;
+        }
+      }
+      benchmark::DoNotOptimize(id);
+    }
+    i = (i + kBatchSize) % kNumPackets;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+// Batched lookups with the compiled classifier.
+BENCHMARK_DEFINE_F(ACLFixture, Classifier)(benchmark::State &state) {
+  uint32_t ids[kBatchSize];
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    classifier_.Lookup(&keys_[i], kBatchSize, ids);
+    benchmark::DoNotOptimize(ids[0]);
+    i = (i + kBatchSize) % kNumPackets;
+  }
+  state.counters["tuples"] = classifier_.num_tuples();
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(ACLFixture, LinearScan)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000);
+BENCHMARK_REGISTER_F(ACLFixture, Classifier)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000);
+
+BENCHMARK_MAIN();
@@ -30,11 +30,60 @@
 
 #include "buffer.h"
 
+const Commands Buffer::cmds = {
+    {"get_stats", "BufferCommandGetStatsArg",
+     MODULE_CMD_FUNC(&Buffer::CommandGetStats), Command::THREAD_UNSAFE},
+};
+
+CommandResponse Buffer::Init(const bess::pb::BufferArg &arg) {
+  max_hold_ns_ = arg.max_hold_ns();
+
+  if (max_hold_ns_) {
+    if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+      return CommandFailure(ENOMEM, "Task creation failed");
+    }
+
+    // Cover up to twice the deadline, as the task may run late
+    hold_hist_.Resize(kHoldBuckets, std::max<uint64_t>(max_hold_ns_ / 500, 1));
+  }
+
+  return CommandSuccess();
+}
+
 void Buffer::DeInit() {
   bess::PacketBatch *buf = &buf_;
   bess::Packet::Free(buf);
 }
 
+void Buffer::Flush(Context *ctx, bess::PacketBatch *batch, bool timeout) {
+  bess::PacketBatch *buf = &buf_;
+  int cnt = buf->cnt();
+
+  stats_.batches++;
+  stats_.packets += cnt;
+  stats_.timeout_batches += timeout;
+  stats_.batch_size_hist[cnt]++;
+  hold_hist_.Insert(ctx->current_ns - first_ns_);
+
+  batch->Copy(buf);
+  buf->clear();
+  RunNextModule(ctx, batch);
+}
+
+struct task_result Buffer::RunTask(Context *ctx, bess::PacketBatch *batch,
+                                   void *) {
+  bess::PacketBatch *buf = &buf_;
+  uint32_t cnt = buf->cnt();
+
+  if (cnt == 0 || ctx->current_ns - first_ns_ < max_hold_ns_) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  Flush(ctx, batch, true);
+
+  return {.block = false, .packets = cnt, .bits = 0};
+}
+
 void Buffer::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   bess::PacketBatch *buf = &buf_;
 
@@ -44,6 +93,10 @@ void Buffer::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   bess::Packet **p_buf = &buf->pkts()[buf->cnt()];
   bess::Packet **p_batch = &batch->pkts()[0];
 
+  if (buf->cnt() == 0) {
+    first_ns_ = ctx->current_ns;
+  }
+
   if (left >= free_slots) {
     buf->set_cnt(bess::PacketBatch::kMaxBurst);
     bess::utils::CopyInlined(p_buf, p_batch,
@@ -53,14 +106,64 @@ void Buffer::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     p_batch += free_slots;
     left -= free_slots;
 
-    bess::PacketBatch *new_batch = ctx->task->AllocPacketBatch();
-    new_batch->Copy(buf);
-    buf->clear();
-    RunNextModule(ctx, new_batch);
+    Flush(ctx, ctx->task->AllocPacketBatch(), false);
+    first_ns_ = ctx->current_ns;
   }
 
   buf->incr_cnt(left);
   bess::utils::CopyInlined(p_buf, p_batch, left * sizeof(bess::Packet *));
+
+  // Do not wait for the task if the deadline has already passed
+  if (max_hold_ns_ && buf->cnt() > 0 &&
+      ctx->current_ns - first_ns_ >= max_hold_ns_) {
+    Flush(ctx, ctx->task->AllocPacketBatch(), true);
+  }
+}
+
+CommandResponse Buffer::CommandGetStats(
+    const bess::pb::BufferCommandGetStatsArg &arg) {
+  bess::pb::BufferCommandGetStatsResponse r;
+  std::vector<double> percentiles;
+
+  std::copy(arg.hold_percentiles().begin(), arg.hold_percentiles().end(),
+            back_inserter(percentiles));
+  for (size_t i = 0; i < percentiles.size(); i++) {
+    if (percentiles[i] < 0.0 || percentiles[i] > 100.0 ||
+        (i > 0 && percentiles[i] <= percentiles[i - 1])) {
+      return CommandFailure(EINVAL, "invalid 'hold_percentiles'");
+    }
+  }
+
+  r.set_batches(stats_.batches);
+  r.set_packets(stats_.packets);
+  r.set_timeout_batches(stats_.timeout_batches);
+  if (stats_.batches) {
+    r.set_avg_fill_ratio(static_cast<double>(stats_.packets) /
+                         (stats_.batches * bess::PacketBatch::kMaxBurst));
+  }
+  for (uint64_t n : stats_.batch_size_hist) {
+    r.add_batch_size_hist(n);
+  }
+
+  const auto &hold = hold_hist_.Summarize(percentiles);
+  auto *h = r.mutable_hold_time();
+  h->set_count(hold.count);
+  h->set_above_range(hold.above_range);
+  h->set_resolution_ns(hold_hist_.bucket_width());
+  h->set_min_ns(hold.min);
+  h->set_max_ns(hold.max);
+  h->set_avg_ns(hold.avg);
+  h->set_total_ns(hold.total);
+  for (const auto &val : hold.percentile_values) {
+    h->add_percentile_values_ns(val);
+  }
+
+  if (arg.clear()) {
+    stats_ = {};
+    hold_hist_.Reset();
+  }
+
+  return CommandSuccess(r);
 }
 
 ADD_MODULE(Buffer, "buffer", "buffers packets into larger batches")
@@ -32,18 +32,55 @@
 #define BESS_MODULES_BUFFER_H_
 
 #include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/histogram.h"
 
-/* TODO: timer-triggered flush */
 class Buffer final : public Module {
  public:
-  Buffer() : Module(), buf_() {}
+  static const Commands cmds;
+
+  Buffer()
+      : Module(),
+        buf_(),
+        max_hold_ns_(),
+        first_ns_(),
+        stats_(),
+        hold_hist_(kHoldBuckets, 1000) {}
+
+  CommandResponse Init(const bess::pb::BufferArg &arg);
 
   void DeInit() override;
 
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  CommandResponse CommandGetStats(
+      const bess::pb::BufferCommandGetStatsArg &arg);
+
  private:
+  static const size_t kHoldBuckets = 1000;
+
+  // Emits the buffered packets through 'batch'
+  void Flush(Context *ctx, bess::PacketBatch *batch, bool timeout);
+
   bess::PacketBatch buf_;
+
+  // 0 if partial batches are never flushed
+  uint64_t max_hold_ns_;
+
+  // Arrival time of the oldest packet in buf_
+  uint64_t first_ns_;
+
+  struct {
+    uint64_t batches;
+    uint64_t packets;
+    uint64_t timeout_batches;
+    uint64_t batch_size_hist[bess::PacketBatch::kMaxBurst + 1];
+  } stats_;
+
+  Histogram<uint64_t> hold_hist_;
 };
 
 #endif  // BESS_MODULES_BUFFER_H_
@@ -30,6 +30,7 @@
 
 #include "drr.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -37,6 +38,7 @@
 
 #include "../utils/ether.h"
 #include "../utils/ip.h"
+#include "../utils/time.h"
 #include "../utils/udp.h"
 
 uint32_t RoundToPowerTwo(uint32_t v) {
@@ -59,17 +61,26 @@ const Commands DRR::cmds = {
 DRR::DRR()
     : quantum_(kDefaultQuantum),
       max_queue_size_(kFlowQueueMax),
-      max_number_flows_(kDefaultNumFlows),
+      max_number_flows_(kDefaultNumFlows - 1),
+      max_packets_(kDefaultMaxPackets),
+      ttl_cycles_(),
       flow_ring_(nullptr),
-      current_flow_(nullptr) {
+      current_flow_(nullptr),
+      flow_slab_(),
+      free_flows_(nullptr),
+      idle_head_(nullptr),
+      idle_tail_(nullptr),
+      descs_(),
+      free_desc_(kNone) {
   is_task_ = true;
   max_allowed_workers_ = Worker::kMaxWorkers;
 }
 
 DRR::~DRR() {
-  for (auto it = flows_.begin(); it != flows_.end();) {
-    RemoveFlow(it->second);
-    it++;
+  for (const PacketDesc &desc : descs_) {
+    if (desc.pkt) {
+      bess::Packet::Free(desc.pkt);
+    }
   }
   std::free(flow_ring_);
 }
@@ -79,7 +90,19 @@ CommandResponse DRR::Init(const bess::pb::DRRArg &arg) {
   task_id_t tid;
 
   if (arg.num_flows() != 0) {
-    max_number_flows_ = RoundToPowerTwo(arg.num_flows() + 1);
+    if (arg.num_flows() > kMaxNumFlows) {
+      return CommandFailure(EINVAL, "num_flows must be at most %d",
+                            kMaxNumFlows);
+    }
+    max_number_flows_ = arg.num_flows();
+  }
+
+  if (arg.max_packets() != 0) {
+    if (arg.max_packets() > kMaxPackets) {
+      return CommandFailure(EINVAL, "max_packets must be at most %d",
+                            kMaxPackets);
+    }
+    max_packets_ = arg.max_packets();
   }
 
   if (arg.max_flow_queue_size() != 0) {
@@ -102,12 +125,33 @@ CommandResponse DRR::Init(const bess::pb::DRRArg &arg) {
     return CommandFailure(ENOMEM, "task creation failed");
   }
 
+  // the round robin ring holds every flow with queued packets
   int err_num = 0;
-  flow_ring_ = AddQueue(max_number_flows_, &err_num);
+  flow_ring_ = AddQueue(RoundToPowerTwo(max_number_flows_ + 1), &err_num);
   if (err_num != 0) {
     return CommandFailure(-err_num);
   }
 
+  flows_ = CuckooMap<FlowId, Flow *, Hash, EqualTo>(
+      RoundToPowerTwo(std::max<uint32_t>(max_number_flows_ / 2, 4)),
+      max_number_flows_);
+
+  flow_slab_.resize(max_number_flows_);
+  free_flows_ = nullptr;
+  for (Flow &f : flow_slab_) {
+    f.next = free_flows_;
+    free_flows_ = &f;
+  }
+
+  descs_.resize(max_packets_);
+  for (uint32_t i = 0; i < max_packets_; i++) {
+    descs_[i].pkt = nullptr;
+    descs_[i].next = (i + 1 < max_packets_) ? i + 1 : kNone;
+  }
+  free_desc_ = 0;
+
+  ttl_cycles_ = kTtl * tsc_hz;
+
   return CommandSuccess();
 }
 
@@ -120,31 +164,47 @@ CommandResponse DRR::CommandMaxFlowQueueSize(
   return SetMaxFlowQueueSize(arg.max_queue_size());
 }
 
-void DRR::ProcessBatch(Context *, bess::PacketBatch *batch) {
-  int err = 0;
+void DRR::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  uint64_t now = ctx->current_tsc;
 
   // insert packets in the batch into their corresponding flows
   int cnt = batch->cnt();
-  for (int i = 0; i < cnt; i++) {
-    bess::Packet *pkt = batch->pkts()[i];
 
+  FlowId ids[bess::PacketBatch::kMaxBurst];
+  CuckooMap<FlowId, Flow *, Hash, EqualTo>::Entry
+      *entries[bess::PacketBatch::kMaxBurst];
+
+  for (int i = 0; i < cnt; i++) {
     // TODO(joshua): Add support for fragmented packets.
-    FlowId id = GetId(pkt);
-    auto it = flows_.Find(id);
+    ids[i] = GetId(batch->pkts()[i]);
+  }
+
+  flows_.FindBatch(ids, cnt, entries);
+
+  // Once a flow is added, the remaining results may be stale: the new flow
+  // may recur later in this batch, or it may have recycled a flow that does.
+  bool stale = false;
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    FlowId &id = ids[i];
+    auto it = stale ? flows_.Find(id) : entries[i];
+    Flow *f;
 
     // if the Flow doesn't exist create one
     // and add the packet to the new Flow
     if (it == nullptr) {
-      if (llring_full(flow_ring_)) {
+      f = AddNewFlow(id, now);
+      if (f == nullptr) {
         bess::Packet::Free(pkt);
-      } else {
-        AddNewFlow(pkt, id, &err);
-        assert(err == 0);
+        continue;
       }
+      stale = true;
     } else {
-      Enqueue(it->second, pkt, &err);
-      assert(err == 0);
+      f = it->second;
     }
+
+    Enqueue(f, pkt);
   }
 }
 
@@ -156,13 +216,14 @@ struct task_result DRR::RunTask(Context *ctx, bess::PacketBatch *batch,
     };
   }
 
-  int err = 0;
+  uint64_t now = ctx->current_tsc;
+  ExpireFlows(now);
+
   batch->clear();
   uint32_t total_bytes = 0;
   if (flow_ring_ != NULL) {
-    total_bytes = GetNextBatch(batch, &err);
+    total_bytes = GetNextBatch(batch, now);
   }
-  assert(err >= 0);  // TODO(joshua) do proper error checking
 
   if (total_bytes > 0) {
     RunNextModule(ctx, batch);
@@ -174,116 +235,68 @@ struct task_result DRR::RunTask(Context *ctx, bess::PacketBatch *batch,
   return {.block = (cnt == 0), .packets = cnt, .bits = bits_retrieved};
 }
 
-uint32_t DRR::GetNextBatch(bess::PacketBatch *batch, int *err) {
+uint32_t DRR::GetNextBatch(bess::PacketBatch *batch, uint64_t now) {
   Flow *f;
   uint32_t total_bytes = 0;
-  uint32_t count = llring_count(flow_ring_);
-  if (current_flow_) {
-    count++;
-  }
-  int batch_size = batch->cnt();
 
-  // iterate through flows in round robin fashion until batch is full
+  // iterate through flows in round robin fashion until batch is full. Every
+  // flow in the ring has packets, so this ends once they have all been
+  // drained, at the latest.
   while (!batch->full()) {
-    // checks to see if there has been no update after a full round
-    // ensures that if every flow is empty or if there are no flows
-    // that will terminate with a non-full batch.
-    if (count == 0) {
-      if (batch_size == batch->cnt()) {
+    if (current_flow_) {
+      f = current_flow_;
+      current_flow_ = nullptr;
+    } else {
+      if (llring_dequeue(flow_ring_, reinterpret_cast<void **>(&f)) != 0) {
         break;
-      } else {
-        count = llring_count(flow_ring_);
-        batch_size = batch->cnt();
       }
+      f->deficit += quantum_;
     }
-    count--;
 
-    f = GetNextFlow(err);
-    if (*err != 0) {
-      return total_bytes;
-    } else if (f == nullptr) {
-      continue;
-    }
-
-    uint32_t bytes = GetNextPackets(batch, f, err);
-    total_bytes += bytes;
-    if (*err != 0) {
-      return total_bytes;
-    }
+    total_bytes += GetNextPackets(batch, f);
 
-    if (llring_empty(f->queue) && !f->next_packet) {
+    if (f->queue_len == 0) {
+      // the flow has nothing more to give: it leaves the round robin
       f->deficit = 0;
-    }
-
-    // if the flow doesn't have any more packets to give, reenqueue it
-    if (!f->next_packet || f->next_packet->total_len() > f->deficit) {
-      *err = llring_enqueue(flow_ring_, f);
-      if (*err != 0) {
-        return total_bytes;
-      }
-    } else {
+      IdleLink(f, now);
+    } else if (batch->full() &&
+               descs_[f->head].pkt->total_len() <=
+                   static_cast<uint32_t>(f->deficit)) {
       // knowing that the while statement will exit, keep the flow that still
-      // has packets at the front
+      // has allocated bytes at the front
       current_flow_ = f;
+    } else {
+      int ret = llring_enqueue(flow_ring_, f);
+      DCHECK_EQ(ret, 0);  // the ring has room for every flow
     }
   }
   return total_bytes;
 }
 
-DRR::Flow *DRR::GetNextFlow(int *err) {
-  Flow *f;
-  double now = get_epoch_time();
+uint32_t DRR::GetNextPackets(bess::PacketBatch *batch, Flow *f) {
+  uint32_t total_bytes = 0;
 
-  if (!current_flow_) {
-    *err = llring_dequeue(flow_ring_, reinterpret_cast<void **>(&f));
-    if (*err < 0) {
-      return nullptr;
-    }
+  while (!batch->full() && f->head != kNone) {
+    uint32_t d = f->head;
+    bess::Packet *pkt = descs_[d].pkt;
+    uint32_t len = pkt->total_len();
 
-    if (llring_empty(f->queue) && !f->next_packet) {
-      // if the flow expired, remove it
-      if (now - f->timer > kTtl) {
-        RemoveFlow(f);
-      } else {
-        *err = llring_enqueue(flow_ring_, f);
-        if (*err < 0) {
-          return nullptr;
-        }
-      }
-      return nullptr;
+    if (len > static_cast<uint32_t>(f->deficit)) {
+      break;
     }
 
-    f->deficit += quantum_;
-  } else {
-    f = current_flow_;
-    current_flow_ = nullptr;
-  }
-  return f;
-}
-
-uint32_t DRR::GetNextPackets(bess::PacketBatch *batch, Flow *f, int *err) {
-  uint32_t total_bytes = 0;
-  bess::Packet *pkt;
-
-  while (!batch->full() && (!llring_empty(f->queue) || f->next_packet)) {
-    // makes sure there isn't already a packet at the front
-    if (!f->next_packet) {
-      *err = llring_dequeue(f->queue, reinterpret_cast<void **>(&pkt));
-      if (*err < 0) {
-        return total_bytes;
-      }
-    } else {
-      pkt = f->next_packet;
-      f->next_packet = nullptr;
+    f->head = descs_[d].next;
+    if (f->head == kNone) {
+      f->tail = kNone;
     }
+    f->queue_len--;
 
-    if (pkt->total_len() > f->deficit) {
-      f->next_packet = pkt;
-      break;
-    }
+    descs_[d].pkt = nullptr;
+    descs_[d].next = free_desc_;
+    free_desc_ = d;
 
-    f->deficit -= pkt->total_len();
-    total_bytes += pkt->total_len();
+    f->deficit -= len;
+    total_bytes += len;
     batch->add(pkt);
   }
 
@@ -306,34 +319,73 @@ DRR::FlowId DRR::GetId(bess::Packet *pkt) {
   return id;
 }
 
-void DRR::AddNewFlow(bess::Packet *pkt, FlowId id, int *err) {
-  // creates flow
-  Flow *f = new Flow(id);
-
-  // TODO(joshua) do proper error checking
-  f->queue = AddQueue(static_cast<int>(kFlowQueueSize), err);
-
-  if (*err != 0) {
-    return;
+DRR::Flow *DRR::AddNewFlow(const FlowId &id, uint64_t now) {
+  if (!free_flows_) {
+    if (!idle_head_) {
+      return nullptr;
+    }
+    // recycle the flow that has been idle the longest
+    RemoveFlow(idle_head_);
   }
 
-  flows_.Insert(id, f);
-
-  Enqueue(f, pkt, err);
-  if (*err != 0) {
-    return;
+  Flow *f = free_flows_;
+  if (flows_.Insert(id, f) == nullptr) {
+    return nullptr;
   }
+  free_flows_ = f->next;
 
-  // puts flow in round robin
-  *err = llring_enqueue(flow_ring_, f);
+  f->id = id;
+  f->deficit = 0;
+  IdleLink(f, now);
+  return f;
 }
 
 void DRR::RemoveFlow(Flow *f) {
+  DCHECK_EQ(f->queue_len, 0);
   if (f == current_flow_) {
     current_flow_ = nullptr;
   }
   flows_.Remove(f->id);
-  delete f;
+  IdleUnlink(f);
+  f->next = free_flows_;
+  free_flows_ = f;
+}
+
+void DRR::ExpireFlows(uint64_t now) {
+  while (idle_head_ && now - idle_head_->timer > ttl_cycles_) {
+    RemoveFlow(idle_head_);
+  }
+}
+
+void DRR::IdleLink(Flow *f, uint64_t now) {
+  f->idle = true;
+  f->timer = now;
+  f->prev = idle_tail_;
+  f->next = nullptr;
+  if (idle_tail_) {
+    idle_tail_->next = f;
+  } else {
+    idle_head_ = f;
+  }
+  idle_tail_ = f;
+}
+
+void DRR::IdleUnlink(Flow *f) {
+  if (!f->idle) {
+    return;
+  }
+  f->idle = false;
+  if (f->prev) {
+    f->prev->next = f->next;
+  } else {
+    idle_head_ = f->next;
+  }
+  if (f->next) {
+    f->next->prev = f->prev;
+  } else {
+    idle_tail_ = f->prev;
+  }
+  f->prev = f->next = nullptr;
 }
 
 llring *DRR::AddQueue(uint32_t slots, int *err) {
@@ -355,57 +407,30 @@ llring *DRR::AddQueue(uint32_t slots, int *err) {
   return queue;
 }
 
-void DRR::Enqueue(Flow *f, bess::Packet *newpkt, int *err) {
-  // if the queue is full. drop the packet.
-  if (llring_count(f->queue) >= max_queue_size_) {
+void DRR::Enqueue(Flow *f, bess::Packet *newpkt) {
+  // if the queue or the packet pool is full. drop the packet.
+  if (f->queue_len >= max_queue_size_ || free_desc_ == kNone) {
     bess::Packet::Free(newpkt);
     return;
   }
 
-  // creates a new queue if there is not enough space for the new packet
-  // in the old queue
-  if (llring_full(f->queue)) {
-    uint32_t slots =
-        RoundToPowerTwo(llring_count(f->queue) * kQueueGrowthFactor);
-    f->queue = ResizeQueue(f->queue, slots, err);
-    if (*err != 0) {
-      bess::Packet::Free(newpkt);
-      return;
-    }
-  }
+  uint32_t d = free_desc_;
+  free_desc_ = descs_[d].next;
+  descs_[d] = {newpkt, kNone};
 
-  *err = llring_enqueue(f->queue, reinterpret_cast<void *>(newpkt));
-  if (*err == 0) {
-    f->timer = get_epoch_time();
+  if (f->tail == kNone) {
+    f->head = d;
   } else {
-    bess::Packet::Free(newpkt);
-  }
-}
-
-llring *DRR::ResizeQueue(llring *old_queue, uint32_t new_size, int *err) {
-  llring *new_queue = AddQueue(new_size, err);
-  if (*err != 0) {
-    return nullptr;
+    descs_[f->tail].next = d;
   }
+  f->tail = d;
 
-  // migrates packets from the old queue
-  if (old_queue) {
-    bess::Packet *pkt;
-
-    while (llring_dequeue(old_queue, reinterpret_cast<void **>(&pkt)) == 0) {
-      *err = llring_enqueue(new_queue, pkt);
-      if (*err == -LLRING_ERR_NOBUF) {
-        bess::Packet::Free(pkt);
-        *err = 0;
-      } else if (*err != 0) {
-        std::free(new_queue);
-        return nullptr;
-      }
-    }
-
-    std::free(old_queue);
+  // puts the flow back in round robin
+  if (f->queue_len++ == 0) {
+    IdleUnlink(f);
+    int ret = llring_enqueue(flow_ring_, f);
+    DCHECK_EQ(ret, 0);  // the ring has room for every flow
   }
-  return new_queue;
 }
 
 CommandResponse DRR::SetQuantumSize(uint32_t size) {
@@ -32,6 +32,7 @@
 #define BESS_MODULES_DRR_H_
 
 #include <cstdlib>
+#include <vector>
 
 #include <rte_hash_crc.h>
 
@@ -54,6 +55,13 @@ using bess::utils::CuckooMap;
 // deficit falls below the next packet's size. After a obtaining a 32
 // packets(a full batch), the module passes these packets onto the next module.
 //
+// All state is allocated at Init: flows come from a fixed-size slab, and
+// packets are queued in per-flow FIFOs linked through a descriptor pool shared
+// by all flows. Only flows with queued packets take part in the round robin;
+// the others wait on an idle list, oldest first, until they receive a packet,
+// expire after kTtl seconds, or are recycled for a new flow when the slab
+// runs out.
+//
 // based on this:
 //  https://en.wikipedia.org/wiki/Deficit_round_robin
 // EXPECTS: Input packets in any format
@@ -69,6 +77,7 @@ using bess::utils::CuckooMap;
 //    * Max Number of flows: max number of flows the module will handle
 //    * Max Flow Queue Size: the maximum size that any Flows queue can get
 //          before the module will start dropping the flows packets
+//    * Max Packets: the maximum number of packets queued over all flows
 // COMMANDS
 //    update quantum: cannot not be done live
 //    update Max Flow Queue Size: can be done live
@@ -77,16 +86,18 @@ class DRR final : public Module {
  public:
   // the default max number of flows allowed + 1
   static const int kDefaultNumFlows = 4096;
-  static const int kFlowQueueSize = 2048;  // initial queue size for a flow
-  static const int kQueueGrowthFactor =
-      2;  // the scale at which a flow's queue grows
+  static const int kMaxNumFlows = 1 << 24;  // upper bound on num_flows
   static const int kFlowQueueMax =
-      8192;                     // the max flow queue size if non-specified
-  static const int kTtl = 300;  // time to live for flow entries
+      8192;  // the max flow queue size if non-specified
+  static const int kDefaultMaxPackets =
+      65536;  // packet pool size if non-specified
+  static const int kMaxPackets = 1 << 26;  // upper bound on packet pool size
+  static const int kTtl = 300;  // time to live for idle flow entries
   static const int kDefaultQuantum =
       1500;  // default value to initialize qauntum_ to
   static const int kPacketOverhead =
       24;  // additional bytes associated with packets
+  static const uint32_t kNone = UINT32_MAX;  // end of a descriptor list
 
   // 5 tuple id to identify a flow from a packet header information.
   struct FlowId {
@@ -97,31 +108,34 @@ class DRR final : public Module {
     uint8_t protocol;
   };
 
-  // stores the metrics of the flow, a timer and the queue to store the packets
-  // in.
+  // a queued packet, linked to the next one of the same flow (or to the next
+  // free descriptor)
+  struct PacketDesc {
+    bess::Packet *pkt;
+    uint32_t next;
+  };
+
+  // stores the metrics of the flow, a timer and the FIFO of its packets.
   struct Flow {
-    int deficit;                // the allocated bytes to the flow
-    double timer;               // to determine if TTL should be used
-    FlowId id;                  // allows the flow to remove itself from the map
-    struct llring *queue;       // queue to store current packets for flow
-    bess::Packet *next_packet;  // buffer to store next packet from the queue.
-    Flow() : deficit(0), timer(0), id(), next_packet(nullptr){};
-    Flow(FlowId new_id)
-        : deficit(0), timer(0), id(new_id), next_packet(nullptr){};
-    ~Flow() {
-      if (queue) {
-        bess::Packet *pkt;
-        while (llring_sc_dequeue(queue, reinterpret_cast<void **>(&pkt)) == 0) {
-          bess::Packet::Free(pkt);
-        }
-
-        std::free(queue);
-      }
-
-      if (next_packet) {
-        bess::Packet::Free(next_packet);
-      }
-    }
+    int deficit;         // the allocated bytes to the flow
+    uint64_t timer;      // TSC when the flow became idle, for TTL
+    FlowId id;           // allows the flow to remove itself from the map
+    uint32_t head;       // first packet descriptor of the flow's queue
+    uint32_t tail;       // last packet descriptor of the flow's queue
+    uint32_t queue_len;  // number of queued packets
+    bool idle;           // true if on the idle list
+    Flow *prev;          // idle list links (next also links the free list)
+    Flow *next;
+    Flow()
+        : deficit(0),
+          timer(0),
+          id(),
+          head(kNone),
+          tail(kNone),
+          queue_len(0),
+          idle(false),
+          prev(nullptr),
+          next(nullptr){};
   };
 
   // hashes a FlowId
@@ -181,57 +195,45 @@ class DRR final : public Module {
   //  Returns 0 on success and error value otherwise.
   CommandResponse SetMaxFlowQueueSize(uint32_t queue_size);
 
-  //  Creates a new larger llring queue of the specifed size and moves over all
-  //  of the entries from the old queue and frees the old_queue. Takes a pointer
-  //  to the
-  //  location of the  current queue, the new size of the queue and integer
-  //  pointer
-  //  to set on error. If the integer pointer is set than the return value will
-  //  be
-  //  a
-  //  nullptr. Returns a pointer to the new llring otherwise.
-  llring *ResizeQueue(llring *old_queue, uint32_t new_size, int *err);
-
-  //  Puts the packet into the llring queue within the flow. Takes the flow to
-  //  enqueue the packet into, the packet to enqueue into the flow's queue
-  //  and integer pointer to be set on error.
-  void Enqueue(Flow *f, bess::Packet *pkt, int *err);
+  //  Puts the packet at the tail of the flow's queue, and puts the flow in
+  //  round robin if it was idle. Drops the packet if the flow's queue or the
+  //  descriptor pool is full.
+  void Enqueue(Flow *f, bess::Packet *pkt);
 
   //  Takes a Packet to get a flow id for. Returns the 5 element identifier for
   //  the flow that the packet belongs to
   FlowId GetId(bess::Packet *pkt);
 
-  //  Creates a new flow and adds it to the round robin queue. Takes the first
-  //  pkt
-  //  to be enqueued in the new flow, the id of the new flow to be created and
-  //  integer pointer to set on error.
-  void AddNewFlow(bess::Packet *pkt, FlowId id, int *err);
+  //  Takes a flow from the slab (recycling the oldest idle flow if there are
+  //  no free ones) and adds it to the hash table as idle. Returns nullptr if
+  //  every flow has packets queued.
+  Flow *AddNewFlow(const FlowId &id, uint64_t now);
 
-  //  Removes the flow from the hash table and frees all the packets within its
-  //  queue. Takes the pointer to the flow to remove
+  //  Removes an idle flow from the hash table and returns it to the slab.
   void RemoveFlow(Flow *f);
 
+  //  Removes the flows that have been idle for longer than the TTL.
+  void ExpireFlows(uint64_t now);
+
+  //  Appends the flow to the idle list, as of 'now'.
+  void IdleLink(Flow *f, uint64_t now);
+
+  //  Unlinks the flow from the idle list.
+  void IdleUnlink(Flow *f);
+
   //  Obtain the next batch of packets from the next flows in round robin.
-  //  Takes a PacketBatch to insert the packets into and integer pointer
-  //  to set on error. Returns total bytes added to batch.
-  uint32_t GetNextBatch(bess::PacketBatch *batch, int *err);
+  //  Takes a PacketBatch to insert the packets into and the current TSC.
+  //  Returns total bytes added to batch.
+  uint32_t GetNextBatch(bess::PacketBatch *batch, uint64_t now);
 
   //  gets the next set of packets from flow given allocated bytes
   //  Takes the PacketBatch to put the packets into and the flow to get the
-  //  packets
-  //  from and integer pointer to set on error. Returns the total bytes put in
-  //  batch
-  uint32_t GetNextPackets(bess::PacketBatch *batch, Flow *f, int *err);
-
-  //  gets the next flow from the queue of flows. Returns nullptr if the next
-  //  flow is empty or if the flow is deleted. If there is a an error returns
-  //  an error and sets the integer pointer to error value.
-  Flow *GetNextFlow(int *err);
-
-  //  allocates llring queue space and adds the queue to the specified flow with
-  //  size indicated by slots. Takes the Flow to add the queue, the number
-  //  of slots for the queue to have and the integer pointer to set on error.
-  //  Returns a llring queue.
+  //  packets from. Returns the total bytes put in batch
+  uint32_t GetNextPackets(bess::PacketBatch *batch, Flow *f);
+
+  //  allocates llring queue space with size indicated by slots. Takes the
+  //  number of slots for the queue to have and the integer pointer to set on
+  //  error. Returns a llring queue.
   llring *AddQueue(uint32_t slots, int *err);
 
   // the number of bytes to allocate to each flow in each round.
@@ -244,9 +246,22 @@ class DRR final : public Module {
   // max number of flow's that the module will handle.
   uint32_t max_number_flows_;
 
+  // max number of packets queued over all flows
+  uint32_t max_packets_;
+
+  // TTL of idle flows, in TSC cycles
+  uint64_t ttl_cycles_;
+
   // state map used to reunite packets with their flow
   CuckooMap<FlowId, Flow *, Hash, EqualTo> flows_;
   llring *flow_ring_;   // llring used for round robin.
   Flow *current_flow_;  // store current flow between batch rounds.
+
+  std::vector<Flow> flow_slab_;    // all flows, allocated at Init
+  Flow *free_flows_;               // unused flows in flow_slab_
+  Flow *idle_head_;                // least recently idle flow
+  Flow *idle_tail_;                // most recently idle flow
+  std::vector<PacketDesc> descs_;  // packet descriptor pool
+  uint32_t free_desc_;             // first unused descriptor
 };
 #endif  // BESS_MODULES_DRR_H_
@@ -0,0 +1,212 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for the DRR module with many concurrent flows.
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../module_graph.h"
+#include "../packet_pool.h"
+#include "../utils/ether.h"
+#include "../utils/ip.h"
+#include "../utils/random.h"
+#include "../utils/time.h"
+#include "../utils/udp.h"
+#include "drr.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::Udp;
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+
+namespace {
+
+static const size_t kBatchSize = bess::PacketBatch::kMaxBurst;
+static const size_t kPacketSize = 60;
+
+// state.range(0) flows, all present in the flow table. Every batch carries
+// packets of kBatchSize different flows, visited in a random order, so that
+// flow lookups and per-flow state miss the cache as they would with real
+// traffic.
+class DRRFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const uint32_t num_flows = state.range(0);
+
+    CreateDRR(num_flows, kBatchSize * 64, 0);
+
+    // Populate the flow table
+    for (size_t i = 0; i < num_flows; i += kBatchSize) {
+      RunOnce();
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    ModuleGraph::DestroyModule(drr_);
+    pool_.reset();
+    order_.clear();
+  }
+
+ protected:
+  // Creates the module and a pool that can hold 'max_packets' queued packets
+  // on top of a batch in flight. quantum 0 stands for the default one.
+  void CreateDRR(uint32_t num_flows, uint32_t max_packets, uint32_t quantum) {
+    static int instance = 0;
+
+    const ModuleBuilder &builder =
+        ModuleBuilder::all_module_builders().find("DRR")->second;
+
+    bess::pb::DRRArg arg;
+    arg.set_num_flows(num_flows);
+    arg.set_max_packets(max_packets);
+    arg.set_quantum(quantum);
+    google::protobuf::Any any;
+    any.PackFrom(arg);
+
+    pb_error_t perr;
+    drr_ = static_cast<DRR *>(ModuleGraph::CreateModule(
+        builder, "drr_bench" + std::to_string(instance++), any, &perr));
+    CHECK(drr_) << perr.errmsg();
+
+    pool_.reset(new bess::PlainPacketPool(max_packets + kBatchSize));
+
+    Random rng;
+    order_.resize(num_flows);
+    for (uint32_t i = 0; i < num_flows; i++) {
+      order_[i] = i;
+    }
+    for (uint32_t i = num_flows - 1; i > 0; i--) {
+      std::swap(order_[i], order_[rng.GetRange(i + 1)]);
+    }
+    next_ = 0;
+
+    ctx_ = {};
+    ctx_.current_tsc = rdtsc();
+  }
+
+  // Enqueues a batch of packets of the next kBatchSize flows.
+  void Enqueue() {
+    bess::PacketBatch batch;
+
+    CHECK(pool_->AllocBulk(batch.pkts(), kBatchSize, kPacketSize));
+    batch.set_cnt(kBatchSize);
+    for (size_t i = 0; i < kBatchSize; i++) {
+      SetFlow(batch.pkts()[i], order_[next_++ % order_.size()]);
+    }
+
+    drr_->ProcessBatch(&ctx_, &batch);
+  }
+
+  // Enqueues a batch of packets of new flows, and dequeues a batch.
+  void RunOnce() {
+    bess::PacketBatch batch;
+
+    Enqueue();
+    drr_->RunTask(&ctx_, &batch, nullptr);
+  }
+
+  static void SetFlow(bess::Packet *pkt, uint32_t flow) {
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    Udp *udp = reinterpret_cast<Udp *>(ip + 1);
+
+    eth->ether_type = be16_t(Ethernet::Type::kIpv4);
+    ip->header_length = 5;
+    ip->protocol = Ipv4::Proto::kUdp;
+    ip->src = be32_t(0x0a000000 | (flow >> 8));
+    ip->dst = be32_t(0x0b000001);
+    udp->src_port = be16_t(1024 + (flow & 0xff));
+    udp->dst_port = be16_t(80);
+  }
+
+  std::unique_ptr<bess::PlainPacketPool> pool_;
+  DRR *drr_;
+  Context ctx_;
+  std::vector<uint32_t> order_;
+  size_t next_ = 0;
+};
+
+// Like DRRFixture, but every one of the state.range(0) flows is kept
+// backlogged. With a quantum of one packet, each dequeued batch takes a
+// packet from each of the next kBatchSize flows in the round robin, and the
+// next enqueued batch refills the same flows, so the whole flow ring and
+// descriptor pool stay in use.
+class DRRBacklogFixture : public DRRFixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const uint32_t num_flows = state.range(0);
+
+    CreateDRR(num_flows, num_flows + kBatchSize, kPacketSize);
+
+    // One packet queued for every flow, round robin in the order of order_
+    for (size_t i = 0; i < num_flows; i += kBatchSize) {
+      Enqueue();
+    }
+  }
+};
+
+}  // namespace
+
+// Each iteration enqueues and dequeues a batch (packet allocation and header
+// writes included).
+BENCHMARK_DEFINE_F(DRRFixture, EnqueueDequeue)(benchmark::State &state) {
+  while (state.KeepRunning()) {
+    RunOnce();
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(DRRFixture, EnqueueDequeue)
+    ->Arg(1 << 10)
+    ->Arg(1 << 16)
+    ->Arg(1 << 20);
+
+// Same as EnqueueDequeue, in the steady state of all flows backlogged. Every
+// flow holds a packet buffer, hence the smaller maximum.
+BENCHMARK_DEFINE_F(DRRBacklogFixture, EnqueueDequeue)
+(benchmark::State &state) {
+  while (state.KeepRunning()) {
+    RunOnce();
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(DRRBacklogFixture, EnqueueDequeue)
+    ->Arg(1 << 10)
+    ->Arg(1 << 14)
+    ->Arg(1 << 18);
+
+BENCHMARK_MAIN();
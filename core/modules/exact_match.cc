@@ -50,11 +50,11 @@ const Commands ExactMatch::cmds = {
     {"set_runtime_config", "ExactMatchConfig",
      MODULE_CMD_FUNC(&ExactMatch::SetRuntimeConfig), Command::THREAD_UNSAFE},
     {"add", "ExactMatchCommandAddArg", MODULE_CMD_FUNC(&ExactMatch::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"delete", "ExactMatchCommandDeleteArg",
-     MODULE_CMD_FUNC(&ExactMatch::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&ExactMatch::CommandDelete), Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&ExactMatch::CommandClear),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"set_default_gate", "ExactMatchCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&ExactMatch::CommandSetDefaultGate),
      Command::THREAD_SAFE}};
@@ -73,12 +73,13 @@ CommandResponse ExactMatch::AddFieldOne(const bess::pb::Field &field,
 
   Error ret;
   if (field.position_case() == bess::pb::Field::kAttrName) {
-    ret = table_.AddField(this, field.attr_name(), size, mask64, idx);
+    ret = table_.Standby().AddField(this, field.attr_name(), size, mask64,
+                                    idx);
     if (ret.first) {
       return CommandFailure(ret.first, "%s", ret.second.c_str());
     }
   } else if (field.position_case() == bess::pb::Field::kOffset) {
-    ret = table_.AddField(field.offset(), size, mask64, idx);
+    ret = table_.Standby().AddField(field.offset(), size, mask64, idx);
     if (ret.first) {
       return CommandFailure(ret.first, "%s", ret.second.c_str());
     }
@@ -113,6 +114,14 @@ CommandResponse ExactMatch::Init(const bess::pb::ExactMatchArg &arg) {
     }
   }
 
+  // Both copies of the table share the same field layout.
+  const ExactMatchTable<gate_idx_t> &proto = table_.Standby();
+  table_.ForEach([&proto](ExactMatchTable<gate_idx_t> *t) {
+    if (t != &proto) {
+      t->CopyFields(proto);
+    }
+  });
+
   default_gate_ = DROP_GATE;
 
   return CommandSuccess();
@@ -121,9 +130,10 @@ CommandResponse ExactMatch::Init(const bess::pb::ExactMatchArg &arg) {
 // Retrieves an ExactMatchArg that would reconstruct this module.
 CommandResponse ExactMatch::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::ExactMatchArg r;
+  const auto &table = table_.Standby();
 
-  for (size_t i = 0; i < table_.num_fields(); i++) {
-    const ExactMatchField &f = table_.get_field(i);
+  for (size_t i = 0; i < table.num_fields(); i++) {
+    const ExactMatchField &f = table.get_field(i);
     bess::pb::Field *ret_field = r.add_fields();
     if (f.attr_id >= 0) {
       ret_field->set_attr_name(all_attrs().at(f.attr_id).name);
@@ -150,16 +160,17 @@ CommandResponse ExactMatch::GetInitialArg(const bess::pb::EmptyArg &) {
 CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   bess::pb::ExactMatchConfig r;
   using rule_t = bess::pb::ExactMatchCommandAddArg;
+  auto &table = table_.Standby();
 
   r.set_default_gate(default_gate_);
-  for (auto const &kv : table_) {
+  for (auto const &kv : table) {
     auto const &key = kv.first;
     auto const &value = kv.second;
     rule_t *rule = r.add_rules();
 
     rule->set_gate(value);
-    for (size_t i = 0; i < table_.num_fields(); i++) {
-      const ExactMatchField &f = table_.get_field(i);
+    for (size_t i = 0; i < table.num_fields(); i++) {
+      const ExactMatchField &f = table.get_field(i);
       bess::pb::FieldData *field = rule->add_fields();
 
       // See GetInitialArg above for why we only set_value_bin here.
@@ -168,13 +179,13 @@ CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
     }
   }
   std::sort(r.mutable_rules()->begin(), r.mutable_rules()->end(),
-            [this](const rule_t &a, const rule_t &b) {
+            [&table](const rule_t &a, const rule_t &b) {
               // Primary sort key is gate number.
               if (a.gate() != b.gate()) {
                 return a.gate() < b.gate();
               }
               // After that, sort by value-to-be-matched, in field order.
-              for (size_t i = 0; i < table_.num_fields(); i++) {
+              for (size_t i = 0; i < table.num_fields(); i++) {
                 if (a.fields(i).value_bin() != b.fields(i).value_bin()) {
                   return a.fields(i).value_bin() < b.fields(i).value_bin();
                 }
@@ -201,7 +212,9 @@ Error ExactMatch::AddRule(const bess::pb::ExactMatchCommandAddArg &arg) {
   ExactMatchRuleFields rule;
   RuleFieldsFromPb(arg.fields(), &rule);
 
-  return table_.AddRule(gate, rule);
+  return table_.Update([&](ExactMatchTable<gate_idx_t> *t) {
+    return t->AddRule(gate, rule);
+  });
 }
 
 // Uses an ExactMatchConfig to restore this module's runtime config.
@@ -210,7 +223,7 @@ Error ExactMatch::AddRule(const bess::pb::ExactMatchCommandAddArg &arg) {
 CommandResponse ExactMatch::SetRuntimeConfig(
     const bess::pb::ExactMatchConfig &arg) {
   default_gate_ = arg.default_gate();
-  table_.ClearRules();
+  table_.Update([](ExactMatchTable<gate_idx_t> *t) { t->ClearRules(); });
 
   for (auto i = 0; i < arg.rules_size(); i++) {
     Error ret = AddRule(arg.rules(i));
@@ -226,6 +239,7 @@ void ExactMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   ExactMatchKey keys[bess::PacketBatch::kMaxBurst] __ymm_aligned;
 
   default_gate = ACCESS_ONCE(default_gate_);
+  const auto &table = table_.Get();
 
   const auto buffer_fn = [&](bess::Packet *pkt, const ExactMatchField &f) {
     int attr_id = f.attr_id;
@@ -234,25 +248,26 @@ void ExactMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     }
     return pkt->head_data<uint8_t *>() + f.offset;
   };
-  table_.MakeKeys(batch, buffer_fn, keys);
+  table.MakeKeys(batch, buffer_fn, keys);
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    EmitPacket(ctx, pkt, table_.Find(keys[i], default_gate));
+    EmitPacket(ctx, pkt, table.Find(keys[i], default_gate));
   }
 }
 
 std::string ExactMatch::GetDesc() const {
-  return bess::utils::Format("%zu fields, %zu rules", table_.num_fields(),
-                             table_.Size());
+  const auto &table = table_.Standby();
+  return bess::utils::Format("%zu fields, %zu rules", table.num_fields(),
+                             table.Size());
 }
 
 void ExactMatch::RuleFieldsFromPb(
     const RepeatedPtrField<bess::pb::FieldData> &fields,
     bess::utils::ExactMatchRuleFields *rule) {
   for (auto i = 0; i < fields.size(); i++) {
-    int field_size = table_.get_field(i).size;
+    int field_size = table_.Standby().get_field(i).size;
 
     bess::pb::FieldData current = fields.Get(i);
 
@@ -291,7 +306,9 @@ CommandResponse ExactMatch::CommandDelete(
   ExactMatchRuleFields rule;
   RuleFieldsFromPb(arg.fields(), &rule);
 
-  Error ret = table_.DeleteRule(rule);
+  Error ret = table_.Update([&](ExactMatchTable<gate_idx_t> *t) {
+    return t->DeleteRule(rule);
+  });
   if (ret.first) {
     return CommandFailure(ret.first, "%s", ret.second.c_str());
   }
@@ -300,7 +317,7 @@ CommandResponse ExactMatch::CommandDelete(
 }
 
 CommandResponse ExactMatch::CommandClear(const bess::pb::EmptyArg &) {
-  table_.ClearRules();
+  table_.Update([](ExactMatchTable<gate_idx_t> *t) { t->ClearRules(); });
   return CommandSuccess();
 }
 
@@ -36,6 +36,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/exact_match_table.h"
 
 using google::protobuf::RepeatedPtrField;
@@ -80,7 +81,8 @@ class ExactMatch final : public Module {
   gate_idx_t default_gate_;
   bool empty_masks_;  // mainly for GetInitialArg
 
-  ExactMatchTable<gate_idx_t> table_;
+  // Rules are updated without pausing workers; see rcu.h
+  bess::rcu::DoubleBuffer<ExactMatchTable<gate_idx_t>> table_;
 };
 
 #endif  // BESS_MODULES_EXACTMATCH_H_
@@ -0,0 +1,489 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "fq_codel.h"
+
+#include <cmath>
+
+#include <rte_hash_crc.h>
+
+#include "../utils/checksum.h"
+#include "../utils/common.h"
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::be16_t;
+
+const Commands FQCodel::cmds = {
+    {"get_stats", "FQCodelCommandGetStatsArg",
+     MODULE_CMD_FUNC(&FQCodel::CommandGetStats), Command::THREAD_UNSAFE},
+};
+
+CommandResponse FQCodel::Init(const bess::pb::FQCodelArg &arg) {
+  uint32_t num_flows = arg.num_flows() ?: kDefaultNumFlows;
+  if (num_flows > kMaxNumFlows) {
+    return CommandFailure(EINVAL, "'num_flows' must be no greater than %u",
+                          kMaxNumFlows);
+  }
+
+  limit_ = arg.limit() ?: kDefaultLimit;
+  if (limit_ > kMaxLimit) {
+    return CommandFailure(EINVAL, "'limit' must be no greater than %u",
+                          kMaxLimit);
+  }
+
+  quantum_ = arg.quantum() ?: kDefaultQuantum;
+  target_ns_ = arg.target_ns() ?: kDefaultTargetNs;
+  interval_ns_ = arg.interval_ns() ?: kDefaultIntervalNs;
+  ecn_ = arg.ecn();
+
+  uint64_t max_sojourn_ns = arg.max_sojourn_ns() ?: kDefaultMaxSojournNs;
+  if (max_sojourn_ns < kSojournResolutionNs) {
+    return CommandFailure(EINVAL, "'max_sojourn_ns' must be at least %lu",
+                          kSojournResolutionNs);
+  }
+  sojourn_hist_.Resize(max_sojourn_ns, kSojournResolutionNs);
+
+  if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+    return CommandFailure(ENOMEM, "Task creation failed");
+  }
+
+  num_flows_ = align_ceil_pow2(num_flows);
+  flows_.assign(num_flows_, Flow());
+  for (Flow &f : flows_) {
+    f.head = f.tail = f.next = kNone;
+  }
+
+  descs_.resize(limit_);
+  for (uint32_t i = 0; i < limit_; i++) {
+    descs_[i].pkt = nullptr;
+    descs_[i].next = (i + 1 < limit_) ? i + 1 : kNone;
+  }
+  free_desc_ = 0;
+
+  new_flows_ = {kNone, kNone};
+  old_flows_ = {kNone, kNone};
+
+  return CommandSuccess();
+}
+
+void FQCodel::DeInit() {
+  for (Flow &f : flows_) {
+    uint32_t d;
+    while ((d = DescDequeue(&f)) != kNone) {
+      bess::Packet::Free(descs_[d].pkt);
+      DescFree(d);
+    }
+  }
+}
+
+std::string FQCodel::GetDesc() const {
+  return bess::utils::Format("%u/%u", backlog_packets_, limit_);
+}
+
+uint32_t FQCodel::FlowIndex(bess::Packet *pkt) const {
+  Ethernet *eth = pkt->head_data<Ethernet *>();
+  uint32_t hash;
+
+  if (eth->ether_type == be16_t(Ethernet::Type::kIpv4)) {
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+
+    hash = rte_hash_crc_4byte(ip->src.raw_value(), ip->protocol);
+    hash = rte_hash_crc_4byte(ip->dst.raw_value(), hash);
+
+    // TCP and UDP ports are only present in the first fragment
+    if ((ip->protocol == Ipv4::Proto::kTcp ||
+         ip->protocol == Ipv4::Proto::kUdp) &&
+        (ip->fragment_offset.value() & 0x1fff) == 0) {
+      const uint32_t *ports = reinterpret_cast<const uint32_t *>(
+          reinterpret_cast<uint8_t *>(ip) + (ip->header_length << 2));
+      hash = rte_hash_crc_4byte(*ports, hash);
+    }
+  } else {
+    hash = rte_hash_crc(eth, sizeof(Ethernet::Address) * 2, 0);
+  }
+
+  return hash & (num_flows_ - 1);
+}
+
+void FQCodel::PushBack(FlowList *list, uint32_t idx) {
+  flows_[idx].next = kNone;
+  if (list->tail == kNone) {
+    list->head = idx;
+  } else {
+    flows_[list->tail].next = idx;
+  }
+  list->tail = idx;
+}
+
+uint32_t FQCodel::PopFront(FlowList *list) {
+  uint32_t idx = list->head;
+  list->head = flows_[idx].next;
+  if (list->head == kNone) {
+    list->tail = kNone;
+  }
+  return idx;
+}
+
+uint32_t FQCodel::DescDequeue(Flow *f) {
+  uint32_t d = f->head;
+  if (d == kNone) {
+    return kNone;
+  }
+
+  uint32_t len = descs_[d].pkt->total_len();
+  f->head = descs_[d].next;
+  if (f->head == kNone) {
+    f->tail = kNone;
+  }
+  f->packets--;
+  f->bytes -= len;
+  backlog_packets_--;
+  backlog_bytes_ -= len;
+  return d;
+}
+
+void FQCodel::DescFree(uint32_t d) {
+  descs_[d].pkt = nullptr;
+  descs_[d].next = free_desc_;
+  free_desc_ = d;
+}
+
+bool FQCodel::DropFattest() {
+  uint32_t fattest = kNone;
+
+  // Linear in the number of flows, but amortized over up to
+  // kMaxOverlimitDrops packets, as in Linux's fq_codel_drop()
+  for (uint32_t i = 0; i < num_flows_; i++) {
+    if (flows_[i].packets > 0 &&
+        (fattest == kNone || flows_[i].bytes > flows_[fattest].bytes)) {
+      fattest = i;
+    }
+  }
+
+  if (fattest == kNone) {
+    return false;
+  }
+
+  // Drop up to half of the backlog of the fattest flow
+  Flow *f = &flows_[fattest];
+  uint32_t threshold = f->bytes / 2;
+  uint32_t dropped_bytes = 0;
+  for (uint32_t i = 0; i < kMaxOverlimitDrops; i++) {
+    uint32_t d = DescDequeue(f);
+    if (d == kNone) {
+      break;
+    }
+    dropped_bytes += descs_[d].pkt->total_len();
+    bess::Packet::Free(descs_[d].pkt);
+    DescFree(d);
+    stats_.overlimit_drops++;
+    if (dropped_bytes >= threshold) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+void FQCodel::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  uint64_t now = ctx->current_ns;
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    if (free_desc_ == kNone) {
+      DropFattest();
+    }
+
+    uint32_t idx = FlowIndex(pkt);
+    Flow *f = &flows_[idx];
+    uint32_t len = pkt->total_len();
+
+    uint32_t d = free_desc_;
+    free_desc_ = descs_[d].next;
+    descs_[d] = {pkt, now, kNone};
+
+    if (f->tail == kNone) {
+      f->head = d;
+    } else {
+      descs_[f->tail].next = d;
+    }
+    f->tail = d;
+    f->packets++;
+    f->bytes += len;
+    backlog_packets_++;
+    backlog_bytes_ += len;
+
+    if (!f->active) {
+      f->active = true;
+      f->deficit = quantum_;
+      PushBack(&new_flows_, idx);
+      stats_.new_flows++;
+    }
+  }
+
+  stats_.enqueued += cnt;
+}
+
+uint64_t FQCodel::ControlLaw(uint64_t t, uint32_t count) const {
+  return t + static_cast<uint64_t>(interval_ns_ / std::sqrt(count));
+}
+
+bool FQCodel::MarkCongestion(bess::Packet *pkt) {
+  Ethernet *eth = pkt->head_data<Ethernet *>();
+  if (eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+    return false;
+  }
+
+  Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+  uint8_t ecn = ip->type_of_service & 0x3;
+  if (ecn == 0x0) {
+    return false;  // Not ECN-Capable Transport
+  } else if (ecn == 0x3) {
+    return true;  // Already marked
+  }
+
+  // The ToS byte shares a 16-bit checksum word with version/header length
+  uint16_t *word = reinterpret_cast<uint16_t *>(ip);
+  uint16_t old_word = *word;
+  ip->type_of_service |= 0x3;
+  ip->checksum = bess::utils::UpdateChecksum16(ip->checksum, old_word, *word);
+  return true;
+}
+
+bool FQCodel::CodelSignal(bess::Packet *pkt) {
+  if (ecn_ && MarkCongestion(pkt)) {
+    stats_.ecn_marks++;
+    return true;
+  }
+
+  stats_.codel_drops++;
+  bess::Packet::Free(pkt);
+  return false;
+}
+
+bess::Packet *FQCodel::CodelDoDequeue(Flow *f, uint64_t now,
+                                       bool *ok_to_drop) {
+  *ok_to_drop = false;
+
+  uint32_t d = DescDequeue(f);
+  if (d == kNone) {
+    f->first_above_ns = 0;
+    return nullptr;
+  }
+
+  bess::Packet *pkt = descs_[d].pkt;
+  uint64_t enqueue_ns = descs_[d].enqueue_ns;
+  uint64_t sojourn_ns = now > enqueue_ns ? now - enqueue_ns : 0;
+  DescFree(d);
+
+  sojourn_hist_.Insert(sojourn_ns);
+
+  // Never drop the last (full-sized) packet of a flow: it cannot be a standing
+  // queue
+  if (sojourn_ns < target_ns_ || f->bytes <= quantum_) {
+    f->first_above_ns = 0;
+  } else if (f->first_above_ns == 0) {
+    f->first_above_ns = now + interval_ns_;
+  } else if (now >= f->first_above_ns) {
+    *ok_to_drop = true;
+  }
+
+  return pkt;
+}
+
+bess::Packet *FQCodel::CodelDequeue(Flow *f, uint64_t now) {
+  bool ok_to_drop;
+  bess::Packet *pkt = CodelDoDequeue(f, now, &ok_to_drop);
+
+  if (!pkt) {
+    f->dropping = false;
+    return nullptr;
+  }
+
+  if (f->dropping) {
+    if (!ok_to_drop) {
+      // sojourn time fell below target: leave the dropping state
+      f->dropping = false;
+    }
+
+    while (f->dropping && now >= f->drop_next_ns) {
+      f->count++;
+      if (CodelSignal(pkt)) {
+        f->drop_next_ns = ControlLaw(f->drop_next_ns, f->count);
+        return pkt;
+      }
+
+      pkt = CodelDoDequeue(f, now, &ok_to_drop);
+      if (!ok_to_drop) {
+        f->dropping = false;
+      } else {
+        f->drop_next_ns = ControlLaw(f->drop_next_ns, f->count);
+      }
+    }
+  } else if (ok_to_drop) {
+    if (!CodelSignal(pkt)) {
+      pkt = CodelDoDequeue(f, now, &ok_to_drop);
+    }
+    f->dropping = true;
+
+    // If we were dropping recently, resume at a drop rate close to the
+    // previous one rather than starting over
+    uint32_t delta = f->count - f->lastcount;
+    if (delta > 1 &&
+        static_cast<int64_t>(now - f->drop_next_ns) <
+            static_cast<int64_t>(16 * interval_ns_)) {
+      f->count = delta;
+    } else {
+      f->count = 1;
+    }
+    f->lastcount = f->count;
+    f->drop_next_ns = ControlLaw(now, f->count);
+  }
+
+  return pkt;
+}
+
+struct task_result FQCodel::RunTask(Context *ctx, bess::PacketBatch *batch,
+                                    void *) {
+  if (children_overload_ > 0) {
+    return {
+        .block = true, .packets = 0, .bits = 0,
+    };
+  }
+
+  uint64_t now = ctx->current_ns;
+  uint64_t total_bytes = 0;
+
+  batch->clear();
+
+  while (!batch->full()) {
+    FlowList *list = &new_flows_;
+    if (list->head == kNone) {
+      list = &old_flows_;
+      if (list->head == kNone) {
+        break;
+      }
+    }
+
+    uint32_t idx = list->head;
+    Flow *f = &flows_[idx];
+
+    if (f->deficit <= 0) {
+      f->deficit += quantum_;
+      PopFront(list);
+      PushBack(&old_flows_, idx);
+      continue;
+    }
+
+    bess::Packet *pkt = CodelDequeue(f, now);
+    if (!pkt) {
+      PopFront(list);
+      // An emptied new flow goes to the back of the old list, so that a flow
+      // cannot keep its precedence by sending one packet at a time
+      if (list == &new_flows_ && old_flows_.head != kNone) {
+        PushBack(&old_flows_, idx);
+      } else {
+        f->active = false;
+      }
+      continue;
+    }
+
+    f->deficit -= pkt->total_len();
+    total_bytes += pkt->total_len();
+    batch->add(pkt);
+  }
+
+  uint32_t cnt = batch->cnt();
+  if (cnt > 0) {
+    stats_.dequeued += cnt;
+    RunNextModule(ctx, batch);
+  }
+
+  uint64_t bits_retrieved = (total_bytes + cnt * kPacketOverhead) * 8;
+  return {.block = (cnt == 0), .packets = cnt, .bits = bits_retrieved};
+}
+
+CommandResponse FQCodel::CommandGetStats(
+    const bess::pb::FQCodelCommandGetStatsArg &arg) {
+  bess::pb::FQCodelCommandGetStatsResponse r;
+  std::vector<double> percentiles;
+
+  std::copy(arg.sojourn_percentiles().begin(),
+            arg.sojourn_percentiles().end(), back_inserter(percentiles));
+  for (size_t i = 0; i < percentiles.size(); i++) {
+    if (percentiles[i] < 0.0 || percentiles[i] > 100.0 ||
+        (i > 0 && percentiles[i] <= percentiles[i - 1])) {
+      return CommandFailure(EINVAL, "invalid 'sojourn_percentiles'");
+    }
+  }
+
+  uint64_t active_flows = 0;
+  for (const Flow &f : flows_) {
+    active_flows += (f.packets > 0);
+  }
+
+  r.set_enqueued(stats_.enqueued);
+  r.set_dequeued(stats_.dequeued);
+  r.set_codel_drops(stats_.codel_drops);
+  r.set_overlimit_drops(stats_.overlimit_drops);
+  r.set_ecn_marks(stats_.ecn_marks);
+  r.set_new_flows(stats_.new_flows);
+  r.set_backlog_packets(backlog_packets_);
+  r.set_backlog_bytes(backlog_bytes_);
+  r.set_active_flows(active_flows);
+
+  const auto &sojourn = sojourn_hist_.Summarize(percentiles);
+  auto *h = r.mutable_sojourn_time();
+  h->set_count(sojourn.count);
+  h->set_above_range(sojourn.above_range);
+  h->set_resolution_ns(sojourn_hist_.resolution());
+  h->set_min_ns(sojourn.min);
+  h->set_max_ns(sojourn.max);
+  h->set_avg_ns(sojourn.avg);
+  h->set_total_ns(sojourn.total);
+  for (const auto &val : sojourn.percentile_values) {
+    h->add_percentile_values_ns(val);
+  }
+
+  if (arg.clear()) {
+    stats_ = {};
+    sojourn_hist_.Reset();
+  }
+
+  return CommandSuccess(r);
+}
+
+ADD_MODULE(FQCodel, "fq_codel",
+           "fair queueing with per-flow CoDel active queue management")
@@ -0,0 +1,218 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_FQ_CODEL_H_
+#define BESS_MODULES_FQ_CODEL_H_
+
+#include <vector>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/histogram.h"
+
+// FQCodel combines per-flow Deficit Round Robin scheduling with per-flow CoDel
+// (Controlled Delay) active queue management, as in Linux's fq_codel qdisc
+// (RFC 8290).
+//
+// Packets are hashed on their 5-tuple into one of a fixed number of flow
+// buckets and timestamped as they are enqueued. On every task run the module
+// serves flows in DRR order, giving flows that just became active ("new"
+// flows) precedence over backlogged ("old") ones, so that sparse flows see
+// almost no queueing delay. As each packet is dequeued, its sojourn time is
+// fed to the CoDel state of its flow: once a flow has had a standing queue
+// above the target delay for a whole interval, it drops (or ECN marks)
+// packets at a rate that grows with the square root of the drop count until
+// the delay falls back below the target. The control law is the one
+// utils/codel.h implements for a single queue.
+//
+// Packets are held in a pool of descriptors allocated at Init, linked into
+// per-flow FIFOs, so the datapath never allocates. When the pool runs out, the
+// packets at the head of the flow with the largest backlog are dropped.
+//
+// EXPECTS: Input packets in any format; IPv4 TCP/UDP packets are classified by
+//          5-tuple, and all other packets by their Ethernet addresses
+//
+// MODIFICATIONS: The ECN field of IPv4 packets if 'ecn' is set
+//
+// INPUT GATES: 1
+//
+// OUTPUT GATES: 1
+class FQCodel final : public Module {
+ public:
+  static const uint32_t kDefaultNumFlows = 1024;
+  static const uint32_t kMaxNumFlows = 1 << 20;
+  static const uint32_t kDefaultQuantum = 1514;
+  static const uint32_t kDefaultLimit = 10240;
+  static const uint32_t kMaxLimit = 1 << 24;
+  static const uint64_t kDefaultTargetNs = 5000000;      // 5ms
+  static const uint64_t kDefaultIntervalNs = 100000000;  // 100ms
+  static const uint64_t kDefaultMaxSojournNs = 1000000000;  // 1s
+  static const uint64_t kSojournResolutionNs = 100;
+  // additional bytes associated with packets (preamble, IFG, and CRC)
+  static const uint32_t kPacketOverhead = 24;
+  // max number of packets dropped from the fattest flow on pool overflow
+  static const uint32_t kMaxOverlimitDrops = 64;
+
+  static const Commands cmds;
+
+  FQCodel()
+      : Module(),
+        num_flows_(),
+        quantum_(kDefaultQuantum),
+        limit_(kDefaultLimit),
+        target_ns_(kDefaultTargetNs),
+        interval_ns_(kDefaultIntervalNs),
+        ecn_(),
+        flows_(),
+        descs_(),
+        free_desc_(kNone),
+        backlog_packets_(),
+        backlog_bytes_(),
+        new_flows_(),
+        old_flows_(),
+        stats_(),
+        sojourn_hist_(kDefaultMaxSojournNs, kSojournResolutionNs) {
+    is_task_ = true;
+  }
+
+  CommandResponse Init(const bess::pb::FQCodelArg &arg);
+
+  void DeInit() override;
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandGetStats(
+      const bess::pb::FQCodelCommandGetStatsArg &arg);
+
+ private:
+  static const uint32_t kNone = UINT32_MAX;
+
+  // A queued packet, linked into the FIFO of its flow (or the free list)
+  struct Desc {
+    bess::Packet *pkt;
+    uint64_t enqueue_ns;
+    uint32_t next;
+  };
+
+  struct Flow {
+    // FIFO of descriptors
+    uint32_t head;
+    uint32_t tail;
+    uint32_t packets;
+    uint32_t bytes;
+
+    // DRR state. 'next' links the flow into new_flows_ or old_flows_.
+    int32_t deficit;
+    uint32_t next;
+    bool active;  // true if on either list
+
+    // CoDel state
+    bool dropping;
+    uint32_t count;      // # of drops since entering the dropping state
+    uint32_t lastcount;  // 'count' when the dropping state was last entered
+    // when the sojourn time will have been above target for an interval
+    // (0 if below target)
+    uint64_t first_above_ns;
+    uint64_t drop_next_ns;  // time of the next drop in the dropping state
+  };
+
+  struct FlowList {
+    uint32_t head;
+    uint32_t tail;
+  };
+
+  uint32_t FlowIndex(bess::Packet *pkt) const;
+
+  void PushBack(FlowList *list, uint32_t idx);
+  uint32_t PopFront(FlowList *list);
+
+  // Unlinks the head descriptor of flow 'f' and returns it (kNone if empty)
+  uint32_t DescDequeue(Flow *f);
+
+  // Returns a descriptor to the free pool
+  void DescFree(uint32_t d);
+
+  // Drops packets from the head of the flow with the largest backlog, to make
+  // room for new ones. Returns false if nothing is queued.
+  bool DropFattest();
+
+  // Dequeues the head packet of 'f' and updates its CoDel state, setting
+  // '*ok_to_drop' if the packet has been above target for long enough.
+  bess::Packet *CodelDoDequeue(Flow *f, uint64_t now, bool *ok_to_drop);
+
+  // Returns the next packet of 'f' that CoDel lets through, dropping (or
+  // marking) packets as the control law dictates. Returns nullptr once the
+  // flow is empty.
+  bess::Packet *CodelDequeue(Flow *f, uint64_t now);
+
+  // Next drop time: 'interval' after 't', shrinking with sqrt(count)
+  uint64_t ControlLaw(uint64_t t, uint32_t count) const;
+
+  // Sets the Congestion Experienced codepoint of an ECN-capable IPv4 packet.
+  // Returns false if the packet cannot be marked and must be dropped instead.
+  bool MarkCongestion(bess::Packet *pkt);
+
+  // Drops or marks 'pkt' on behalf of CoDel. Returns true if it was marked
+  // (and therefore must still be delivered).
+  bool CodelSignal(bess::Packet *pkt);
+
+  uint32_t num_flows_;  // always a power of 2
+  uint32_t quantum_;
+  uint32_t limit_;
+  uint64_t target_ns_;
+  uint64_t interval_ns_;
+  bool ecn_;
+
+  std::vector<Flow> flows_;
+  std::vector<Desc> descs_;
+  uint32_t free_desc_;  // head of the free descriptor list
+  uint32_t backlog_packets_;
+  uint64_t backlog_bytes_;
+
+  FlowList new_flows_;
+  FlowList old_flows_;
+
+  struct {
+    uint64_t enqueued;
+    uint64_t dequeued;
+    uint64_t codel_drops;
+    uint64_t overlimit_drops;
+    uint64_t ecn_marks;
+    uint64_t new_flows;
+  } stats_;
+
+  LogHistogram<uint64_t> sojourn_hist_;
+};
+
+#endif  // BESS_MODULES_FQ_CODEL_H_
@@ -33,6 +33,8 @@
 #include <utility>
 #include <vector>
 
+#include "../utils/flow_hash.h"
+
 static inline uint32_t hash_16(uint16_t val, uint32_t init_val) {
 #if __x86_64
   return crc32c_sse42_u16(val, init_val);
@@ -98,8 +100,10 @@ CommandResponse HashLB::CommandSetMode(
     mode_ = Mode::kL3;
   } else if (arg.mode() == "l4") {
     mode_ = Mode::kL4;
+  } else if (arg.mode() == "rss") {
+    mode_ = Mode::kRss;
   } else {
-    return CommandFailure(EINVAL, "available LB modes: l2, l3, l4");
+    return CommandFailure(EINVAL, "available LB modes: l2, l3, l4, rss");
   }
 
   return CommandSuccess();
@@ -208,27 +212,21 @@ inline void HashLB::DoProcessBatch<HashLB::Mode::kL3>(
 template <>
 inline void HashLB::DoProcessBatch<HashLB::Mode::kL4>(
     Context *ctx, bess::PacketBatch *batch) {
-  /* assumes untagged packets */
-  const int ip_offset = 14;
-
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *snb = batch->pkts()[i];
-    char *head = snb->head_data<char *>();
-    uint32_t l4_offset =
-        ip_offset + ((*(reinterpret_cast<uint8_t *>(head + ip_offset)) & 0x0F)
-                     << 2); /* ip_offset + IHL */
-    uint32_t hash_val;
-    uint32_t v0 =
-        *(reinterpret_cast<uint32_t *>(head + ip_offset + 12));   /* src IP */
-    v0 ^= *(reinterpret_cast<uint32_t *>(head + ip_offset + 16)); /* dst IP*/
-    v0 ^= *(reinterpret_cast<uint16_t *>(head + l4_offset));      /* src port */
-    v0 ^= *(reinterpret_cast<uint16_t *>(head + l4_offset + 2));  /* dst port */
-
-    v0 ^= *(reinterpret_cast<uint8_t *>(head + ip_offset + 9)); /* ip_proto */
-
-    hash_val = hash_32(v0, 0);
+    uint32_t hash_val = bess::utils::SoftwareL4Hash(snb);
+    EmitPacket(ctx, snb, gates_[hash_range(hash_val, num_gates_)]);
+  }
+}
 
+template <>
+inline void HashLB::DoProcessBatch<HashLB::Mode::kRss>(
+    Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *snb = batch->pkts()[i];
+    uint32_t hash_val = bess::utils::FlowHash(snb);
     EmitPacket(ctx, snb, gates_[hash_range(hash_val, num_gates_)]);
   }
 }
@@ -244,6 +242,9 @@ void HashLB::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     case Mode::kL4:
       DoProcessBatch<Mode::kL4>(ctx, batch);
       break;
+    case Mode::kRss:
+      DoProcessBatch<Mode::kRss>(ctx, batch);
+      break;
     case Mode::kOther:
       DoProcessBatch<Mode::kOther>(ctx, batch);
       break;
@@ -62,7 +62,8 @@ class HashLB final : public Module {
       const bess::pb::HashLBCommandSetGatesArg &arg);
 
  private:
-  enum class Mode { kL2, kL3, kL4, kOther };
+  // kRss uses the RSS hash of the NIC, if any, and the kL4 hash otherwise
+  enum class Mode { kL2, kL3, kL4, kRss, kOther };
   static constexpr Mode kDefaultMode = Mode::kL4;
 
   template <Mode mode>
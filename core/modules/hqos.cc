@@ -0,0 +1,217 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hqos.h"
+
+#include <algorithm>
+
+#include "../utils/endian.h"
+#include "../utils/format.h"
+
+using bess::utils::be32_t;
+
+enum {
+  ATTR_R_QOS_PIPE,
+  ATTR_R_QOS_QUEUE,
+};
+
+const Commands HQoS::cmds = {
+    {"set_pipe", "HQoSCommandSetPipeArg",
+     MODULE_CMD_FUNC(&HQoS::CommandSetPipe), Command::THREAD_UNSAFE},
+    {"set_subport", "HQoSCommandSetSubportArg",
+     MODULE_CMD_FUNC(&HQoS::CommandSetSubport), Command::THREAD_UNSAFE},
+    {"get_stats", "HQoSCommandGetStatsArg",
+     MODULE_CMD_FUNC(&HQoS::CommandGetStats), Command::THREAD_UNSAFE},
+};
+
+static bool IsValidProfile(const bess::pb::HQoSArg::Profile &profile) {
+  return profile.burst() == 0 || profile.burst() >= HQoS::kMinBurst;
+}
+
+HQoS::Scheduler::Profile HQoS::MakeProfile(
+    const bess::pb::HQoSArg::Profile &profile) {
+  uint64_t burst = profile.burst();
+  if (burst == 0) {
+    burst = std::max(profile.rate() / 100, kMinBurst);
+  }
+  return {profile.rate(), burst};
+}
+
+CommandResponse HQoS::Init(const bess::pb::HQoSArg &arg) {
+  using AccessMode = bess::metadata::Attribute::AccessMode;
+
+  uint32_t num_subports = arg.num_subports() ?: 1;
+  uint32_t pipes_per_subport =
+      arg.pipes_per_subport() ?: kDefaultPipesPerSubport;
+  if (static_cast<uint64_t>(num_subports) * pipes_per_subport > kMaxPipes) {
+    return CommandFailure(E2BIG, "at most %u pipes are supported", kMaxPipes);
+  }
+
+  uint32_t max_packets = arg.max_packets() ?: kDefaultMaxPackets;
+  if (max_packets > kMaxPackets) {
+    return CommandFailure(EINVAL, "'max_packets' must be no greater than %u",
+                          kMaxPackets);
+  }
+
+  bool valid = IsValidProfile(arg.port()) && IsValidProfile(arg.subport());
+  for (const auto &profile : arg.pipe_profiles()) {
+    valid = valid && IsValidProfile(profile);
+  }
+  if (!valid) {
+    return CommandFailure(EINVAL, "burst must be at least %lu bytes",
+                          kMinBurst);
+  }
+
+  Scheduler::Config config = {num_subports, pipes_per_subport,
+                              arg.queue_size() ?: kDefaultQueueSize,
+                              max_packets, arg.quantum() ?: kDefaultQuantum};
+  sched_.reset(new Scheduler(config));
+
+  sched_->SetPortProfile(MakeProfile(arg.port()));
+  for (uint32_t i = 0; i < num_subports; i++) {
+    sched_->SetSubportProfile(i, MakeProfile(arg.subport()));
+  }
+
+  // Scheduler profile 0 is unlimited, so pipe_profiles[i] is profile i + 1
+  for (const auto &profile : arg.pipe_profiles()) {
+    sched_->AddPipeProfile(MakeProfile(profile));
+  }
+  if (arg.pipe_profiles_size() > 0) {
+    for (uint32_t i = 0; i < sched_->num_pipes(); i++) {
+      sched_->SetPipeProfile(i, 1);
+    }
+  }
+
+  AddMetadataAttr("qos_pipe", sizeof(be32_t), AccessMode::kRead);
+  AddMetadataAttr("qos_queue", sizeof(uint8_t), AccessMode::kRead);
+
+  if (RegisterTask(nullptr) == INVALID_TASK_ID) {
+    return CommandFailure(ENOMEM, "Task creation failed");
+  }
+
+  return CommandSuccess();
+}
+
+void HQoS::DeInit() {
+  if (sched_) {
+    sched_->Flush([](bess::Packet *pkt) { bess::Packet::Free(pkt); });
+  }
+}
+
+std::string HQoS::GetDesc() const {
+  return bess::utils::Format("%u pipes, %u queued", sched_->num_pipes(),
+                             sched_->backlog());
+}
+
+void HQoS::ProcessBatch(Context *, bess::PacketBatch *batch) {
+  const uint32_t num_pipes = sched_->num_pipes();
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint32_t pipe = get_attr<be32_t>(this, ATTR_R_QOS_PIPE, pkt).value();
+    uint8_t queue = get_attr<uint8_t>(this, ATTR_R_QOS_QUEUE, pkt);
+
+    if (pipe >= num_pipes || queue >= Scheduler::kQueuesPerPipe) {
+      invalid_drops_++;
+      bess::Packet::Free(pkt);
+    } else if (!sched_->Enqueue(pkt, pipe, queue)) {
+      bess::Packet::Free(pkt);
+    }
+  }
+}
+
+struct task_result HQoS::RunTask(Context *ctx, bess::PacketBatch *batch,
+                                 void *) {
+  if (children_overload_ > 0) {
+    return {
+        .block = true, .packets = 0, .bits = 0,
+    };
+  }
+
+  uint64_t bytes;
+  uint32_t cnt = sched_->Dequeue(batch->pkts(), bess::PacketBatch::kMaxBurst,
+                                 ctx->current_ns, &bytes);
+  batch->set_cnt(cnt);
+
+  if (cnt > 0) {
+    RunNextModule(ctx, batch);
+  }
+
+  return {.block = (cnt == 0),
+          .packets = cnt,
+          .bits = (bytes + cnt * Scheduler::kFrameOverhead) * 8};
+}
+
+CommandResponse HQoS::CommandSetPipe(
+    const bess::pb::HQoSCommandSetPipeArg &arg) {
+  if (!sched_->SetPipeProfile(arg.pipe(), arg.profile() + 1)) {
+    return CommandFailure(EINVAL, "invalid pipe %u or profile %u", arg.pipe(),
+                          arg.profile());
+  }
+  return CommandSuccess();
+}
+
+CommandResponse HQoS::CommandSetSubport(
+    const bess::pb::HQoSCommandSetSubportArg &arg) {
+  if (!IsValidProfile(arg.profile())) {
+    return CommandFailure(EINVAL, "burst must be at least %lu bytes",
+                          kMinBurst);
+  }
+
+  if (!sched_->SetSubportProfile(arg.subport(), MakeProfile(arg.profile()))) {
+    return CommandFailure(EINVAL, "invalid subport %u", arg.subport());
+  }
+  return CommandSuccess();
+}
+
+CommandResponse HQoS::CommandGetStats(
+    const bess::pb::HQoSCommandGetStatsArg &arg) {
+  bess::pb::HQoSCommandGetStatsResponse r;
+  const Scheduler::Stats &stats = sched_->stats();
+
+  r.set_enqueued(stats.enqueued);
+  r.set_dequeued(stats.dequeued);
+  r.set_queue_drops(stats.queue_drops);
+  r.set_pool_drops(stats.pool_drops);
+  r.set_invalid_drops(invalid_drops_);
+  r.set_pipe_throttles(stats.pipe_throttles);
+  r.set_subport_throttles(stats.subport_throttles);
+  r.set_backlog(sched_->backlog());
+  r.set_throttled(sched_->throttled());
+
+  if (arg.clear()) {
+    sched_->ClearStats();
+    invalid_drops_ = 0;
+  }
+
+  return CommandSuccess(r);
+}
+
+ADD_MODULE(HQoS, "hqos", "hierarchical QoS scheduler for subscriber shaping")
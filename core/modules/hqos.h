@@ -0,0 +1,95 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_HQOS_H_
+#define BESS_MODULES_HQOS_H_
+
+#include <memory>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/hqos_scheduler.h"
+
+// HQoS shapes packets per subscriber with a hierarchical scheduler (port ->
+// subports -> pipes -> traffic classes -> queues; see utils/hqos_scheduler.h),
+// rather than a Queue module and a rate-limited traffic class per subscriber.
+// The cost of dequeueing does not depend on the number of pipes, so a single
+// worker can shape tens of thousands of them.
+//
+// EXPECTS: 'qos_pipe' and 'qos_queue' metadata attributes
+//
+// MODIFICATIONS: None
+//
+// INPUT GATES: 1
+//
+// OUTPUT GATES: 1
+class HQoS final : public Module {
+ public:
+  static const uint32_t kDefaultPipesPerSubport = 4096;
+  static const uint32_t kMaxPipes = 1 << 20;
+  static const uint32_t kDefaultQueueSize = 64;
+  static const uint32_t kDefaultMaxPackets = 1 << 18;
+  static const uint32_t kMaxPackets = 1 << 26;
+  // one full-size frame, with the frame overhead
+  static const uint32_t kDefaultQuantum = 1538;
+  static constexpr uint64_t kMinBurst = 1538;
+
+  static const Commands cmds;
+
+  HQoS() : Module(), sched_(), invalid_drops_() { is_task_ = true; }
+
+  CommandResponse Init(const bess::pb::HQoSArg &arg);
+
+  void DeInit() override;
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandSetPipe(const bess::pb::HQoSCommandSetPipeArg &arg);
+  CommandResponse CommandSetSubport(
+      const bess::pb::HQoSCommandSetSubportArg &arg);
+  CommandResponse CommandGetStats(const bess::pb::HQoSCommandGetStatsArg &arg);
+
+ private:
+  using Scheduler = bess::utils::HQoSScheduler<bess::Packet>;
+
+  // Fills in the default burst size
+  static Scheduler::Profile MakeProfile(
+      const bess::pb::HQoSArg::Profile &profile);
+
+  std::unique_ptr<Scheduler> sched_;
+
+  uint64_t invalid_drops_;
+};
+
+#endif  // BESS_MODULES_HQOS_H_
@@ -74,17 +74,39 @@ void IPChecksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
+    bess::Packet *pkt = batch->pkts()[i];
+
     if (verify_) {
-      EmitPacket(ctx, batch->pkts()[i], (VerifyIpv4Checksum(*ip)) ? FORWARD_GATE : FAIL_GATE);
+      // Trust the verdict of the NIC if it has already checked the checksum
+      uint64_t rx_cksum = pkt->ol_flags() & PKT_RX_IP_CKSUM_MASK;
+      bool ok;
+      if (rx_cksum == PKT_RX_IP_CKSUM_GOOD) {
+        ok = true;
+      } else if (rx_cksum == PKT_RX_IP_CKSUM_BAD) {
+        ok = false;
+      } else {
+        ok = VerifyIpv4Checksum(*ip);
+      }
+      EmitPacket(ctx, pkt, ok ? FORWARD_GATE : FAIL_GATE);
+    } else if (hw_offload_) {
+      // Leave the calculation to the NIC (or the port driver, if the NIC
+      // cannot do it) at transmission time
+      ip->checksum = 0;
+      pkt->set_l2_len(reinterpret_cast<uintptr_t>(ip) -
+                      reinterpret_cast<uintptr_t>(eth));
+      pkt->set_l3_len(ip->header_length << 2);
+      pkt->add_ol_flags(PKT_TX_IPV4 | PKT_TX_IP_CKSUM);
+      EmitPacket(ctx, pkt, FORWARD_GATE);
     } else {
       ip->checksum = CalculateIpv4Checksum(*ip);
-      EmitPacket(ctx, batch->pkts()[i], FORWARD_GATE);
+      EmitPacket(ctx, pkt, FORWARD_GATE);
     }
   }
 }
 
 CommandResponse IPChecksum::Init(const bess::pb::IPChecksumArg &arg) {
   verify_ = arg.verify();
+  hw_offload_ = arg.hw_offload();
   return CommandSuccess();
 }
 
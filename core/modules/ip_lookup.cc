@@ -47,11 +47,11 @@ static inline int is_valid_gate(gate_idx_t gate) {
 
 const Commands IPLookup::cmds = {
     {"add", "IPLookupCommandAddArg", MODULE_CMD_FUNC(&IPLookup::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"delete", "IPLookupCommandDeleteArg", MODULE_CMD_FUNC(&IPLookup::CommandDelete),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&IPLookup::CommandClear),
-     Command::THREAD_UNSAFE}};
+     Command::THREAD_SAFE}};
 
 CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
   struct rte_lpm_config conf = {
@@ -62,9 +62,14 @@ CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
 
   default_gate_ = DROP_GATE;
 
-  lpm_ = rte_lpm_create(name().c_str(), /* socket_id = */ 0, &conf);
+  // DPDK requires each LPM table to have a unique name
+  int i = 0;
+  lpm_.ForEach([&](struct rte_lpm **lpm) {
+    std::string lpm_name = bess::utils::Format("%s_%d", name().c_str(), i++);
+    *lpm = rte_lpm_create(lpm_name.c_str(), /* socket_id = */ 0, &conf);
+  });
 
-  if (!lpm_) {
+  if (!lpm_.Get() || !lpm_.Standby()) {
     return CommandFailure(rte_errno, "DPDK error: %s", rte_strerror(rte_errno));
   }
 
@@ -72,16 +77,19 @@ CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
 }
 
 void IPLookup::DeInit() {
-  if (lpm_) {
-    rte_lpm_free(lpm_);
-  }
+  lpm_.ForEach([](struct rte_lpm **lpm) {
+    if (*lpm) {
+      rte_lpm_free(*lpm);
+    }
+  });
 }
 
 void IPLookup::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
 
-  gate_idx_t default_gate = default_gate_;
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  struct rte_lpm *lpm = lpm_.Get();
 
   int cnt = batch->cnt();
   int i;
@@ -120,7 +128,7 @@ void IPLookup::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     ip_addr = _mm_set_epi32(a3, a2, a1, a0);
     ip_addr = _mm_shuffle_epi8(ip_addr, bswap_mask);
 
-    rte_lpm_lookupx4(lpm_, ip_addr, next_hops, default_gate);
+    rte_lpm_lookupx4(lpm, ip_addr, next_hops, default_gate);
 
     EmitPacket(ctx, batch->pkts()[i], next_hops[0]);
     EmitPacket(ctx, batch->pkts()[i + 1], next_hops[1]);
@@ -140,7 +148,7 @@ void IPLookup::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     eth = batch->pkts()[i]->head_data<Ethernet *>();
     ip = (Ipv4 *)(eth + 1);
 
-    ret = rte_lpm_lookup(lpm_, ip->dst.value(), &next_hop);
+    ret = rte_lpm_lookup(lpm, ip->dst.value(), &next_hop);
 
     if (ret == 0) {
       EmitPacket(ctx, batch->pkts()[i], next_hop);
@@ -201,7 +209,9 @@ CommandResponse IPLookup::CommandAdd(
     default_gate_ = gate;
   } else {
     be32_t net_addr = std::get<2>(prefix);
-    int ret = rte_lpm_add(lpm_, net_addr.value(), prefix_len, gate);
+    int ret = lpm_.Update([&](struct rte_lpm **lpm) {
+      return rte_lpm_add(*lpm, net_addr.value(), prefix_len, gate);
+    });
     if (ret) {
       return CommandFailure(-ret, "rpm_lpm_add() failed");
     }
@@ -223,7 +233,9 @@ CommandResponse IPLookup::CommandDelete(
     default_gate_ = DROP_GATE;
   } else {
     be32_t net_addr = std::get<2>(prefix);
-    int ret = rte_lpm_delete(lpm_, net_addr.value(), prefix_len);
+    int ret = lpm_.Update([&](struct rte_lpm **lpm) {
+      return rte_lpm_delete(*lpm, net_addr.value(), prefix_len);
+    });
     if (ret) {
       return CommandFailure(-ret, "rpm_lpm_delete() failed");
     }
@@ -233,7 +245,7 @@ CommandResponse IPLookup::CommandDelete(
 }
 
 CommandResponse IPLookup::CommandClear(const bess::pb::EmptyArg &) {
-  rte_lpm_delete_all(lpm_);
+  lpm_.Update([](struct rte_lpm **lpm) { rte_lpm_delete_all(*lpm); });
   return CommandSuccess();
 }
 
@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/endian.h"
 
 using bess::utils::be32_t;
@@ -59,7 +60,8 @@ class IPLookup final : public Module {
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
 
  private:
-  struct rte_lpm *lpm_;
+  // Routes are updated without pausing workers; see rcu.h
+  bess::rcu::DoubleBuffer<struct rte_lpm *> lpm_;
   gate_idx_t default_gate_;
   ParsedPrefix ParseIpv4Prefix(const std::string &prefix, uint64_t prefix_len);
 };
@@ -0,0 +1,206 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "ipv6_lookup.h"
+
+#include <x86intrin.h>
+
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+
+#define VECTOR_OPTIMIZATION 1
+
+using bess::utils::Ipv6Address;
+using bess::utils::Ipv6Prefix;
+using bess::utils::Lpm6;
+
+static inline int is_valid_gate(gate_idx_t gate) {
+  return (gate < MAX_GATES || gate == DROP_GATE);
+}
+
+// Parses prefix/prefix_len into *addr. Returns an error if the address is
+// malformed, or has bits set beyond prefix_len.
+static CommandResponse ParseIpv6Prefix(const std::string &prefix,
+                                       uint64_t prefix_len,
+                                       Ipv6Address *addr) {
+  if (!prefix.length()) {
+    return CommandFailure(EINVAL, "'prefix' is missing");
+  }
+
+  if (!bess::utils::ParseIpv6Address(prefix, addr)) {
+    return CommandFailure(EINVAL, "Invalid IPv6 prefix: %s", prefix.c_str());
+  }
+
+  if (prefix_len > 128) {
+    return CommandFailure(EINVAL, "Invalid prefix length: %" PRIu64,
+                          prefix_len);
+  }
+
+  if ((*addr & ~Ipv6Prefix::Mask(prefix_len)) != Ipv6Address()) {
+    return CommandFailure(EINVAL, "Invalid IPv6 prefix %s/%" PRIu64,
+                          prefix.c_str(), prefix_len);
+  }
+
+  return CommandSuccess();
+}
+
+const Commands IPv6Lookup::cmds = {
+    {"add", "IPv6LookupCommandAddArg",
+     MODULE_CMD_FUNC(&IPv6Lookup::CommandAdd), Command::THREAD_SAFE},
+    {"delete", "IPv6LookupCommandDeleteArg",
+     MODULE_CMD_FUNC(&IPv6Lookup::CommandDelete), Command::THREAD_SAFE},
+    {"clear", "EmptyArg", MODULE_CMD_FUNC(&IPv6Lookup::CommandClear),
+     Command::THREAD_SAFE}};
+
+CommandResponse IPv6Lookup::Init(const bess::pb::IPv6LookupArg &) {
+  default_gate_ = DROP_GATE;
+  return CommandSuccess();
+}
+
+void IPv6Lookup::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  using bess::utils::Ethernet;
+  using bess::utils::Ipv6;
+
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  const Lpm6 &lpm = lpm_.Get();
+
+  Ipv6Address addrs[bess::PacketBatch::kMaxBurst];
+  uint32_t next_hops[bess::PacketBatch::kMaxBurst];
+
+  int cnt = batch->cnt();
+  int i = 0;
+
+#if VECTOR_OPTIMIZATION
+  /* gather 4 destination addresses at a time, one 128-bit load each */
+  for (; i + 3 < cnt; i += 4) {
+    __m128i a0, a1, a2, a3;
+    Ethernet *eth;
+    Ipv6 *ip;
+
+    eth = batch->pkts()[i]->head_data<Ethernet *>();
+    ip = reinterpret_cast<Ipv6 *>(eth + 1);
+    a0 = _mm_loadu_si128(reinterpret_cast<__m128i *>(&ip->dst));
+
+    eth = batch->pkts()[i + 1]->head_data<Ethernet *>();
+    ip = reinterpret_cast<Ipv6 *>(eth + 1);
+    a1 = _mm_loadu_si128(reinterpret_cast<__m128i *>(&ip->dst));
+
+    eth = batch->pkts()[i + 2]->head_data<Ethernet *>();
+    ip = reinterpret_cast<Ipv6 *>(eth + 1);
+    a2 = _mm_loadu_si128(reinterpret_cast<__m128i *>(&ip->dst));
+
+    eth = batch->pkts()[i + 3]->head_data<Ethernet *>();
+    ip = reinterpret_cast<Ipv6 *>(eth + 1);
+    a3 = _mm_loadu_si128(reinterpret_cast<__m128i *>(&ip->dst));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&addrs[i]), a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&addrs[i + 1]), a1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&addrs[i + 2]), a2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&addrs[i + 3]), a3);
+  }
+#endif
+
+  /* process the rest one by one */
+  for (; i < cnt; i++) {
+    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    Ipv6 *ip = reinterpret_cast<Ipv6 *>(eth + 1);
+    addrs[i] = ip->dst;
+  }
+
+  lpm.LookupBatch(addrs, cnt, next_hops, default_gate);
+
+  for (i = 0; i < cnt; i++) {
+    EmitPacket(ctx, batch->pkts()[i], next_hops[i]);
+  }
+}
+
+std::string IPv6Lookup::GetDesc() const {
+  return bess::utils::Format("%zu routes", lpm_.Standby().num_routes());
+}
+
+CommandResponse IPv6Lookup::CommandAdd(
+    const bess::pb::IPv6LookupCommandAddArg &arg) {
+  gate_idx_t gate = arg.gate();
+  uint64_t prefix_len = arg.prefix_len();
+  Ipv6Address addr;
+
+  CommandResponse err = ParseIpv6Prefix(arg.prefix(), prefix_len, &addr);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  if (!is_valid_gate(gate)) {
+    return CommandFailure(EINVAL, "Invalid gate: %hu", gate);
+  }
+
+  if (prefix_len == 0) {
+    default_gate_ = gate;
+  } else {
+    int ret = lpm_.Update(
+        [&](Lpm6 *lpm) { return lpm->Add(addr, prefix_len, gate); });
+    if (ret) {
+      return CommandFailure(-ret, "failed to add a route");
+    }
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse IPv6Lookup::CommandDelete(
+    const bess::pb::IPv6LookupCommandDeleteArg &arg) {
+  uint64_t prefix_len = arg.prefix_len();
+  Ipv6Address addr;
+
+  CommandResponse err = ParseIpv6Prefix(arg.prefix(), prefix_len, &addr);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  if (prefix_len == 0) {
+    default_gate_ = DROP_GATE;
+  } else {
+    int ret =
+        lpm_.Update([&](Lpm6 *lpm) { return lpm->Delete(addr, prefix_len); });
+    if (ret) {
+      return CommandFailure(-ret, "failed to delete a route");
+    }
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse IPv6Lookup::CommandClear(const bess::pb::EmptyArg &) {
+  lpm_.Update([](Lpm6 *lpm) { lpm->Clear(); });
+  return CommandSuccess();
+}
+
+ADD_MODULE(IPv6Lookup, "ipv6_lookup",
+           "performs Longest Prefix Match on IPv6 packets")
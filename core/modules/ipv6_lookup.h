@@ -0,0 +1,66 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_MODULES_IPV6LOOKUP_H_
+#define BESS_MODULES_IPV6LOOKUP_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../rcu.h"
+#include "../utils/lpm6.h"
+
+class IPv6Lookup final : public Module {
+ public:
+  static const gate_idx_t kNumOGates = MAX_GATES;
+
+  static const Commands cmds;
+
+  IPv6Lookup() : Module(), lpm_(), default_gate_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::IPv6LookupArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandAdd(const bess::pb::IPv6LookupCommandAddArg &arg);
+  CommandResponse CommandDelete(
+      const bess::pb::IPv6LookupCommandDeleteArg &arg);
+  CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+
+ private:
+  // Routes are updated without pausing workers; see rcu.h
+  bess::rcu::DoubleBuffer<bess::utils::Lpm6> lpm_;
+  gate_idx_t default_gate_;
+};
+
+#endif  // BESS_MODULES_IPV6LOOKUP_H_
@@ -99,7 +99,8 @@ static int l2_deinit(struct l2_table *l2tbl) {
   return 0;
 }
 
-static uint32_t l2_ib_to_offset(struct l2_table *l2tbl, int index, int bucket) {
+static uint32_t l2_ib_to_offset(const struct l2_table *l2tbl, int index,
+                                int bucket) {
   return index * l2tbl->bucket + bucket;
 }
 
@@ -157,7 +158,7 @@ static inline int find_index(uint64_t addr, uint64_t *table, const uint64_t) {
 #endif
 }
 
-static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
+static inline int l2_find(const struct l2_table *l2tbl, uint64_t addr,
                           gate_idx_t *gate) {
   size_t i;
   int ret = -ENOENT;
@@ -543,15 +544,15 @@ static int parse_mac_addr(const char *str, char *addr) {
 
 const Commands L2Forward::cmds = {
     {"add", "L2ForwardCommandAddArg", MODULE_CMD_FUNC(&L2Forward::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"delete", "L2ForwardCommandDeleteArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_SAFE},
     {"set_default_gate", "L2ForwardCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&L2Forward::CommandSetDefaultGate), Command::THREAD_SAFE},
     {"lookup", "L2ForwardCommandLookupArg",
      MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
     {"populate", "L2ForwardCommandPopulateArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_SAFE},
 };
 
 CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
@@ -568,7 +569,11 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
     bucket = MAX_BUCKET_SIZE;
   }
 
-  ret = l2_init(&l2_table_, size, bucket);
+  l2_table_.ForEach([&](struct l2_table *l2tbl) {
+    if (ret == 0) {
+      ret = l2_init(l2tbl, size, bucket);
+    }
+  });
 
   if (ret != 0) {
     return CommandFailure(-ret,
@@ -581,11 +586,12 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
 }
 
 void L2Forward::DeInit() {
-  l2_deinit(&l2_table_);
+  l2_table_.ForEach([](struct l2_table *l2tbl) { l2_deinit(l2tbl); });
 }
 
 void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  const struct l2_table &l2tbl = l2_table_.Get();
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
@@ -594,7 +600,7 @@ void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     gate_idx_t out_gate;
     // read destination MAC address (first 6 bytes)
     // NOTE: assumes little endian
-    int ret = l2_find(&l2_table_,
+    int ret = l2_find(&l2tbl,
                       *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff,
                       &out_gate);
     if (ret != 0) {
@@ -607,6 +613,14 @@ void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
 CommandResponse L2Forward::CommandAdd(
     const bess::pb::L2ForwardCommandAddArg &arg) {
+  // All entries of a command become visible to workers at once.
+  return l2_table_.Update([&](struct l2_table *l2tbl) {
+    return AddEntries(l2tbl, arg);
+  });
+}
+
+CommandResponse L2Forward::AddEntries(
+    struct l2_table *l2tbl, const bess::pb::L2ForwardCommandAddArg &arg) {
   for (int i = 0; i < arg.entries_size(); i++) {
     const auto &entry = arg.entries(i);
 
@@ -623,7 +637,7 @@ CommandResponse L2Forward::CommandAdd(
       return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
     }
 
-    int r = l2_add_entry(&l2_table_, l2_addr_to_u64(addr), gate);
+    int r = l2_add_entry(l2tbl, l2_addr_to_u64(addr), gate);
 
     if (r == -EEXIST) {
       return CommandFailure(EEXIST, "MAC address '%s' already exist", str_addr);
@@ -639,6 +653,13 @@ CommandResponse L2Forward::CommandAdd(
 
 CommandResponse L2Forward::CommandDelete(
     const bess::pb::L2ForwardCommandDeleteArg &arg) {
+  return l2_table_.Update([&](struct l2_table *l2tbl) {
+    return DeleteEntries(l2tbl, arg);
+  });
+}
+
+CommandResponse L2Forward::DeleteEntries(
+    struct l2_table *l2tbl, const bess::pb::L2ForwardCommandDeleteArg &arg) {
   for (int i = 0; i < arg.addrs_size(); i++) {
     const auto &_addr = arg.addrs(i);
 
@@ -653,7 +674,7 @@ CommandResponse L2Forward::CommandDelete(
       return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
     }
 
-    int r = l2_del_entry(&l2_table_, l2_addr_to_u64(addr));
+    int r = l2_del_entry(l2tbl, l2_addr_to_u64(addr));
 
     if (r == -ENOENT) {
       return CommandFailure(ENOENT, "MAC address '%s' does not exist",
@@ -690,7 +711,7 @@ CommandResponse L2Forward::CommandLookup(
     }
 
     gate_idx_t gate;
-    int r = l2_find(&l2_table_, l2_addr_to_u64(addr), &gate);
+    int r = l2_find(&l2_table_.Standby(), l2_addr_to_u64(addr), &gate);
 
     if (r == -ENOENT) {
       return CommandFailure(ENOENT, "MAC address '%s' does not exist",
@@ -728,12 +749,13 @@ CommandResponse L2Forward::CommandPopulate(
   base_u64 = bess::utils::be64_t::swap(base_u64) >> 16;
   base_u64 = base_u64 >> 16;
 
-  for (int i = 0; i < cnt; i++) {
-    l2_add_entry(&l2_table_, bess::utils::be64_t::swap(base_u64 << 16),
-                 i % gate_cnt);
-
-    base_u64++;
-  }
+  l2_table_.Update([&](struct l2_table *l2tbl) {
+    uint64_t addr = base_u64;
+    for (int i = 0; i < cnt; i++) {
+      l2_add_entry(l2tbl, bess::utils::be64_t::swap(addr << 16), i % gate_cnt);
+      addr++;
+    }
+  });
 
   return CommandSuccess();
 }
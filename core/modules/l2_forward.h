@@ -33,6 +33,7 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 
 #if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
 #error this code assumes little endian architecture (x86)
@@ -82,7 +83,13 @@ class L2Forward final : public Module {
       const bess::pb::L2ForwardCommandPopulateArg &arg);
 
  private:
-  struct l2_table l2_table_;
+  CommandResponse AddEntries(struct l2_table *l2tbl,
+                             const bess::pb::L2ForwardCommandAddArg &arg);
+  CommandResponse DeleteEntries(
+      struct l2_table *l2tbl, const bess::pb::L2ForwardCommandDeleteArg &arg);
+
+  // Entries are updated without pausing workers; see rcu.h
+  bess::rcu::DoubleBuffer<struct l2_table> l2_table_;
   gate_idx_t default_gate_;
 };
 
@@ -48,42 +48,66 @@ void L4Checksum::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
-    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+    bess::Packet *pkt = batch->pkts()[i];
+    Ethernet *eth = pkt->head_data<Ethernet *>();
 
     // Calculate checksum only for IPv4 packets
     if (eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
-      EmitPacket(ctx, batch->pkts()[i], FORWARD_GATE);
+      EmitPacket(ctx, pkt, FORWARD_GATE);
       continue;
     }
 
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    size_t ip_bytes = (ip->header_length) << 2;
+    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
 
-    if (ip->protocol == Ipv4::Proto::kUdp) {
-      size_t ip_bytes = (ip->header_length) << 2;
-      Udp *udp =
-          reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
-      if (verify_) {
-	EmitPacket(ctx, batch->pkts()[i],
-		   (VerifyIpv4UdpChecksum(*ip, *udp)) ? FORWARD_GATE : FAIL_GATE);
+    if (ip->protocol != Ipv4::Proto::kUdp &&
+        ip->protocol != Ipv4::Proto::kTcp) {
+      EmitPacket(ctx, pkt, FORWARD_GATE);
+      continue;
+    }
+
+    if (verify_) {
+      // Trust the verdict of the NIC if it has already checked the checksum
+      uint64_t rx_cksum = pkt->ol_flags() & PKT_RX_L4_CKSUM_MASK;
+      bool ok;
+      if (rx_cksum == PKT_RX_L4_CKSUM_GOOD) {
+        ok = true;
+      } else if (rx_cksum == PKT_RX_L4_CKSUM_BAD) {
+        ok = false;
+      } else if (ip->protocol == Ipv4::Proto::kUdp) {
+        ok = VerifyIpv4UdpChecksum(*ip, *reinterpret_cast<Udp *>(l4));
+      } else {
+        ok = VerifyIpv4TcpChecksum(*ip, *reinterpret_cast<Tcp *>(l4));
+      }
+      EmitPacket(ctx, pkt, ok ? FORWARD_GATE : FAIL_GATE);
+    } else if (hw_offload_) {
+      // Leave the calculation to the NIC (or the port driver, if the NIC
+      // cannot do it) at transmission time
+      pkt->set_l2_len(sizeof(*eth));
+      pkt->set_l3_len(ip_bytes);
+      if (ip->protocol == Ipv4::Proto::kUdp) {
+        pkt->add_ol_flags(PKT_TX_IPV4 | PKT_TX_UDP_CKSUM);
+      } else {
+        pkt->add_ol_flags(PKT_TX_IPV4 | PKT_TX_TCP_CKSUM);
+      }
+      EmitPacket(ctx, pkt, FORWARD_GATE);
+    } else {
+      if (ip->protocol == Ipv4::Proto::kUdp) {
+        Udp *udp = reinterpret_cast<Udp *>(l4);
+        udp->checksum = CalculateIpv4UdpChecksum(*ip, *udp);
       } else {
-	udp->checksum = CalculateIpv4UdpChecksum(*ip, *udp);
-	EmitPacket(ctx, batch->pkts()[i], FORWARD_GATE);
+        Tcp *tcp = reinterpret_cast<Tcp *>(l4);
+        tcp->checksum = CalculateIpv4TcpChecksum(*ip, *tcp);
       }
-    } else if (ip->protocol == Ipv4::Proto::kTcp) {
-      size_t ip_bytes = (ip->header_length) << 2;
-      Tcp *tcp =
-          reinterpret_cast<Tcp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
-      if (verify_)
-	EmitPacket(ctx, batch->pkts()[i],
-		   (VerifyIpv4TcpChecksum(*ip, *tcp)) ? FORWARD_GATE : FAIL_GATE);
-      else
-	tcp->checksum = CalculateIpv4TcpChecksum(*ip, *tcp);
+      EmitPacket(ctx, pkt, FORWARD_GATE);
     }
   }
 }
 
 CommandResponse L4Checksum::Init(const bess::pb::L4ChecksumArg &arg) {
   verify_ = arg.verify();
+  hw_offload_ = arg.hw_offload();
   return CommandSuccess();
 }
 
@@ -36,7 +36,7 @@
 // Compute L4 checksum on packet
 class L4Checksum final : public Module {
  public:
- L4Checksum() : Module(), verify_(false) { max_allowed_workers_ = Worker::kMaxWorkers; }
+ L4Checksum() : Module(), verify_(false), hw_offload_(false) { max_allowed_workers_ = Worker::kMaxWorkers; }
 
   /* Gates: (0) Default, (1) Drop */
   static const gate_idx_t kNumOGates = 2;
@@ -46,6 +46,7 @@ class L4Checksum final : public Module {
 
  private:
   bool verify_;
+  bool hw_offload_;
 };
 
 #endif  // BESS_MODULES_L4_CHECKSUM_H_
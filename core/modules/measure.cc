@@ -69,18 +69,15 @@ CommandResponse Measure::Init(const bess::pb::MeasureArg &arg) {
   if (latency_ns_resolution == 0) {
     latency_ns_resolution = kDefaultNsPerBucket;
   }
-  uint64_t quotient = latency_ns_max / latency_ns_resolution;
-  if ((latency_ns_max % latency_ns_resolution) != 0) {
-    quotient += 1;  // absorb any remainder
-  }
-  if (quotient > rtt_hist_.max_num_buckets() / 2) {
-    return CommandFailure(E2BIG,
-                          "excessive latency_ns_max / latency_ns_resolution");
+  if (latency_ns_resolution > latency_ns_max) {
+    return CommandFailure(EINVAL,
+                          "latency_ns_resolution exceeds latency_ns_max");
   }
 
-  size_t num_buckets = quotient;
-  rtt_hist_.Resize(num_buckets, latency_ns_resolution);
-  jitter_hist_.Resize(num_buckets, latency_ns_resolution);
+  max_ns_ = latency_ns_max;
+  resolution_ns_ = latency_ns_resolution;
+  shared_shard_.reset(new Shard(max_ns_, resolution_ns_));
+  cleared_.reset(new Shard(max_ns_, resolution_ns_));
 
   if (arg.offset()) {
     offset_ = arg.offset();
@@ -104,15 +101,43 @@ CommandResponse Measure::Init(const bess::pb::MeasureArg &arg) {
   return CommandSuccess();
 }
 
+int Measure::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
+
+  // Shards are kept even after their workers become inactive, not to lose
+  // their samples.
+  const std::vector<bool> &actives = active_workers();
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (actives[wid] && !shards_[wid]) {
+      shards_[wid].reset(new Shard(max_ns_, resolution_ns_));
+    }
+  }
+
+  return 0;
+}
+
 void Measure::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   // We don't use ctx->current_ns here for better accuracy
   uint64_t now_ns = tsc_to_ns(rdtsc());
-  size_t offset = offset_;
+  Shard *shard = shards_[ctx->wid].get();
 
-  mcslock_node_t mynode;
-  mcs_lock(&lock_, &mynode);
+  if (likely(shard != nullptr)) {
+    Sample(shard, batch, now_ns);
+  } else {
+    mcslock_node_t mynode;
+    mcs_lock(&lock_, &mynode);
+    Sample(shared_shard_.get(), batch, now_ns);
+    mcs_unlock(&lock_, &mynode);
+  }
 
-  pkt_cnt_ += batch->cnt();
+  RunNextModule(ctx, batch);
+}
+
+void Measure::Sample(Shard *shard, bess::PacketBatch *batch, uint64_t now_ns) {
+  size_t offset = offset_;
+  uint64_t bytes_cnt = 0;
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
@@ -129,24 +154,27 @@ void Measure::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
         continue;
       }
 
-      bytes_cnt_ += batch->pkts()[i]->total_len();
+      bytes_cnt += batch->pkts()[i]->total_len();
 
-      rtt_hist_.Insert(diff);
-      if (rand_.GetRealNonzero() <= jitter_sample_prob_) {
-        if (unlikely(!last_rtt_ns_)) {
-          last_rtt_ns_ = diff;
+      shard->rtt_hist.Insert(diff);
+      if (shard->rand.GetRealNonzero() <= jitter_sample_prob_) {
+        if (unlikely(!shard->last_rtt_ns)) {
+          shard->last_rtt_ns = diff;
           continue;
         }
-        uint64_t jitter = absdiff(diff, last_rtt_ns_);
-        jitter_hist_.Insert(jitter);
-        last_rtt_ns_ = diff;
+        uint64_t jitter = absdiff(diff, shard->last_rtt_ns);
+        shard->jitter_hist.Insert(jitter);
+        shard->last_rtt_ns = diff;
       }
     }
   }
 
-  mcs_unlock(&lock_, &mynode);
-
-  RunNextModule(ctx, batch);
+  // Only this worker (or the holder of lock_) writes the counters
+  shard->pkt_cnt.store(shard->pkt_cnt.load(std::memory_order_relaxed) + cnt,
+                       std::memory_order_relaxed);
+  shard->bytes_cnt.store(
+      shard->bytes_cnt.load(std::memory_order_relaxed) + bytes_cnt,
+      std::memory_order_relaxed);
 }
 
 template <typename T>
@@ -165,21 +193,34 @@ static void SetHistogram(
   }
 }
 
+std::unique_ptr<Measure::Shard> Measure::Merge() const {
+  std::unique_ptr<Shard> total(new Shard(max_ns_, resolution_ns_));
+  uint64_t pkt_cnt = 0;
+  uint64_t bytes_cnt = 0;
+
+  auto add = [&](const Shard *shard) {
+    total->rtt_hist.Add(shard->rtt_hist);
+    total->jitter_hist.Add(shard->jitter_hist);
+    pkt_cnt += shard->pkt_cnt.load(std::memory_order_relaxed);
+    bytes_cnt += shard->bytes_cnt.load(std::memory_order_relaxed);
+  };
+
+  for (const auto &shard : shards_) {
+    if (shard) {
+      add(shard.get());
+    }
+  }
+  add(shared_shard_.get());
+
+  total->pkt_cnt = pkt_cnt;
+  total->bytes_cnt = bytes_cnt;
+  return total;
+}
+
 void Measure::Clear() {
-  // vector initialization is expensive thus should be out of critical section
-  decltype(rtt_hist_) new_rtt_hist(rtt_hist_.num_buckets(),
-                                   rtt_hist_.bucket_width());
-  decltype(jitter_hist_) new_jitter_hist(jitter_hist_.num_buckets(),
-                                         jitter_hist_.bucket_width());
-
-  // Use move semantics to minimize critical section
-  mcslock_node_t mynode;
-  mcs_lock(&lock_, &mynode);
-  pkt_cnt_ = 0;
-  bytes_cnt_ = 0;
-  rtt_hist_ = std::move(new_rtt_hist);
-  jitter_hist_ = std::move(new_jitter_hist);
-  mcs_unlock(&lock_, &mynode);
+  // Workers keep counting up in their shards, without being interrupted.
+  // What they have counted so far is subtracted when summarized.
+  cleared_ = Merge();
 }
 
 static bool IsValidPercentiles(const std::vector<double> &percentiles) {
@@ -212,19 +253,25 @@ CommandResponse Measure::CommandGetSummary(
     return CommandFailure(EINVAL, "invalid 'jitter_percentiles'");
   }
 
+  std::unique_ptr<Shard> total = Merge();
+  total->rtt_hist.Subtract(cleared_->rtt_hist);
+  total->jitter_hist.Subtract(cleared_->jitter_hist);
+  uint64_t pkt_cnt = total->pkt_cnt - cleared_->pkt_cnt;
+  uint64_t bytes_cnt = total->bytes_cnt - cleared_->bytes_cnt;
+
   r.set_timestamp(get_epoch_time());
-  r.set_packets(pkt_cnt_);
-  r.set_bits((bytes_cnt_ + pkt_cnt_ * 24) * 8);
-  const auto &rtt = rtt_hist_.Summarize(latency_percentiles);
-  const auto &jitter = jitter_hist_.Summarize(jitter_percentiles);
+  r.set_packets(pkt_cnt);
+  r.set_bits((bytes_cnt + pkt_cnt * 24) * 8);
+  const auto &rtt = total->rtt_hist.Summarize(latency_percentiles);
+  const auto &jitter = total->jitter_hist.Summarize(jitter_percentiles);
 
-  SetHistogram(r.mutable_latency(), rtt, rtt_hist_.bucket_width());
-  SetHistogram(r.mutable_jitter(), jitter, jitter_hist_.bucket_width());
+  SetHistogram(r.mutable_latency(), rtt, resolution_ns_);
+  SetHistogram(r.mutable_jitter(), jitter, resolution_ns_);
 
   if (arg.clear()) {
-    // Note that some samples might be lost due to the small gap between
-    // Summarize() and the next mcs_lock... but we posit that smaller
-    // critical section is more important.
+    // Note that samples taken between Merge() above and the one in Clear()
+    // are lost... but we posit that not stopping the workers is more
+    // important.
     Clear();
   }
 
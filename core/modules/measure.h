@@ -31,25 +31,31 @@
 #ifndef BESS_MODULES_MEASURE_H_
 #define BESS_MODULES_MEASURE_H_
 
+#include <atomic>
+#include <memory>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../utils/histogram.h"
 #include "../utils/mcslock.h"
 #include "../utils/random.h"
 
+// Latencies are kept in log-linear histograms, of a few KB each, with less
+// than 1% of error above 256 * latency_ns_resolution.
+//
+// Measure keeps its samples in per-worker shards, which workers update
+// without locking each other out. Shards are merged only when summarized.
+// A worker without a shard of its own (e.g., one running a stolen task) uses a
+// shared one, under a lock.
 class Measure final : public Module {
  public:
-  Measure(uint64_t ns_per_bucket = 1, uint64_t max_ns = 0)
+  Measure()
       : Module(),
-        rtt_hist_(max_ns / ns_per_bucket, ns_per_bucket),
-        jitter_hist_(max_ns / ns_per_bucket, ns_per_bucket),
-        rand_(),
+        max_ns_(),
+        resolution_ns_(),
         jitter_sample_prob_(),
-        last_rtt_ns_(),
         offset_(),
-        attr_id_(-1),
-        pkt_cnt_(),
-        bytes_cnt_() {
+        attr_id_(-1) {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -57,6 +63,8 @@ class Measure final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  int OnEvent(bess::Event e) override;
+
   CommandResponse CommandGetSummary(
       const bess::pb::MeasureCommandGetSummaryArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
@@ -68,21 +76,51 @@ class Measure final : public Module {
   static const uint64_t kDefaultMaxNs = 100'000'000;  // 100 ms
   static constexpr double kDefaultIpDvSampleProb = 0.05;
 
+  // Samples of a worker. Counters are only written by the worker, so they are
+  // atomic only to be read consistently by the control thread.
+  struct alignas(64) Shard {
+    Shard(uint64_t max_ns, uint64_t resolution_ns)
+        : rtt_hist(max_ns, resolution_ns),
+          jitter_hist(max_ns, resolution_ns),
+          rand(),
+          last_rtt_ns(),
+          pkt_cnt(),
+          bytes_cnt() {}
+
+    LogHistogram<uint64_t> rtt_hist;
+    LogHistogram<uint64_t> jitter_hist;
+
+    Random rand;
+    uint64_t last_rtt_ns;
+
+    std::atomic<uint64_t> pkt_cnt;
+    std::atomic<uint64_t> bytes_cnt;
+  };
+
+  void Sample(Shard *shard, bess::PacketBatch *batch, uint64_t now_ns);
+
+  // Returns the sum of all shards
+  std::unique_ptr<Shard> Merge() const;
+
   void Clear();
 
-  Histogram<uint64_t> rtt_hist_;
-  Histogram<uint64_t> jitter_hist_;
+  uint64_t max_ns_;
+  uint64_t resolution_ns_;
+
+  std::unique_ptr<Shard> shards_[Worker::kMaxWorkers];
+
+  // For workers without a shard of their own. Protected by lock_.
+  std::unique_ptr<Shard> shared_shard_;
+
+  // The sum of all shards at the last Clear(), to be subtracted from the
+  // current one
+  std::unique_ptr<Shard> cleared_;
 
-  Random rand_;
   double jitter_sample_prob_;
-  uint64_t last_rtt_ns_;
 
   size_t offset_;  // in bytes
   int attr_id_;
 
-  uint64_t pkt_cnt_;
-  uint64_t bytes_cnt_;
-
   mcslock lock_;
 };
 
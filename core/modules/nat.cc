@@ -33,6 +33,7 @@
 #include <numeric>
 #include <string>
 
+#include "../steal_queue.h"
 #include "../utils/checksum.h"
 #include "../utils/common.h"
 #include "../utils/ether.h"
@@ -40,6 +41,7 @@
 #include "../utils/icmp.h"
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
+#include "../utils/time.h"
 #include "../utils/udp.h"
 
 using bess::utils::Ethernet;
@@ -59,7 +61,74 @@ const Commands NAT::cmds = {
     {"get_runtime_config", "EmptyArg", MODULE_CMD_FUNC(&NAT::GetRuntimeConfig),
      Command::THREAD_SAFE},
     {"set_runtime_config", "EmptyArg", MODULE_CMD_FUNC(&NAT::SetRuntimeConfig),
-     Command::THREAD_SAFE}};
+     Command::THREAD_SAFE},
+    {"get_stats", "NATCommandGetStatsArg",
+     MODULE_CMD_FUNC(&NAT::CommandGetStats), Command::THREAD_UNSAFE}};
+
+void PortPool::Init(const std::vector<PortRange> &ranges, bool icmp,
+                    const std::function<bool(uint16_t)> &skip, Random *rng) {
+  std::vector<bool> added(UINT16_MAX + 1);
+
+  icmp_ = icmp;
+  free_[0].clear();
+  free_[1].clear();
+
+  for (const auto &range : ranges) {
+    // Avoid allocation from an unusable range.
+    if (range.suspended) {
+      continue;
+    }
+
+    for (uint32_t port = range.begin; port < range.end; port++) {
+      if (added[port] || (!icmp && port == 0) || skip(port)) {
+        continue;
+      }
+      added[port] = true;
+      free_[!icmp && port < 1024].push_back(port);
+    }
+  }
+
+  // Shuffle, so that ports are not predictable
+  for (auto &ports : free_) {
+    for (size_t i = ports.size(); i > 1; i--) {
+      std::swap(ports[i - 1], ports[rng->GetRange(i)]);
+    }
+  }
+}
+
+bool PortPool::Get(be16_t internal_port, be16_t *port) {
+  auto &ports = free_[!icmp_ && !(internal_port & ~be16_t(1023))];
+  if (ports.empty()) {
+    return false;
+  }
+
+  *port = be16_t(ports.back());
+  ports.pop_back();
+  return true;
+}
+
+void PortPool::Put(be16_t port) {
+  free_[!icmp_ && port.value() < 1024].push_back(port.value());
+}
+
+NAT::Shard::Shard() : timers(kTimerTickNs), stats() {
+  for (auto &ring : handoff) {
+    ring = reinterpret_cast<struct llring *>(std::aligned_alloc(
+        alignof(llring), llring_bytes_with_slots(kHandoffSlots)));
+    CHECK(ring);
+    CHECK_EQ(llring_init(ring, kHandoffSlots, 0, 1), 0);
+  }
+}
+
+NAT::Shard::~Shard() {
+  for (auto *ring : handoff) {
+    bess::Packet *pkt;
+    while (llring_sc_dequeue(ring, reinterpret_cast<void **>(&pkt)) == 0) {
+      bess::Packet::Free(pkt);
+    }
+    std::free(ring);
+  }
+}
 
 // TODO(torek): move this to set/get runtime config
 CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
@@ -74,6 +143,8 @@ CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
     }
   }
 
+  std::vector<std::pair<be32_t, std::vector<PortRange>>> addrs;
+
   for (const auto &address_range : arg.ext_addrs()) {
     auto ext_addr = address_range.ext_addr();
     be32_t addr;
@@ -83,7 +154,6 @@ CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
       return CommandFailure(EINVAL, "invalid IP address %s", ext_addr.c_str());
     }
 
-    ext_addrs_.push_back(addr);
     // Add a port range list
     std::vector<PortRange> port_list;
     if (address_range.port_ranges().size() == 0) {
@@ -98,20 +168,51 @@ CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
           // Control plane gets to decide if the port range can be used.
           .suspended = range.suspended()});
     }
-    port_ranges_.push_back(port_list);
+    addrs.emplace_back(addr, port_list);
   }
 
-  if (ext_addrs_.empty()) {
+  if (addrs.empty()) {
     return CommandFailure(EINVAL,
                           "at least one external IP address must be specified");
   }
 
   // Sort so that GetInitialArg is predictable and consistent.
-  std::sort(ext_addrs_.begin(), ext_addrs_.end());
+  std::sort(addrs.begin(), addrs.end(),
+            [](const std::pair<be32_t, std::vector<PortRange>> &a,
+               const std::pair<be32_t, std::vector<PortRange>> &b) {
+              return a.first < b.first;
+            });
+
+  for (const auto &addr : addrs) {
+    ext_addrs_.push_back(addr.first);
+    port_ranges_.push_back(addr.second);
+  }
+
+  Random rng;
+  partitions_.resize(kNumPartitions);
+  for (int i = 0; i < kNumPartitions; i++) {
+    auto &port_pools = partitions_[i].port_pools;
+    port_pools.resize(ext_addrs_.size());
+    for (size_t j = 0; j < ext_addrs_.size(); j++) {
+      for (int proto : {IpProto::kTcp, IpProto::kUdp, IpProto::kIcmp}) {
+        auto skip = [i](uint16_t port) { return port % kNumPartitions != i; };
+        port_pools[j][ProtocolIndex(proto)].Init(
+            port_ranges_[j], proto == IpProto::kIcmp, skip, &rng);
+      }
+    }
+  }
+
+  // Until workers are assigned, all of them use the same shard
+  Reshard(1);
 
   return CommandSuccess();
 }
 
+void NAT::DeInit() {
+  bess::StealQueue::SetPolled(this, false);
+  shards_.clear();
+}
+
 CommandResponse NAT::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::NATArg resp;
   for (size_t i = 0; i < ext_addrs_.size(); i++) {
@@ -135,6 +236,167 @@ CommandResponse NAT::SetRuntimeConfig(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
+CommandResponse NAT::CommandGetStats(
+    const bess::pb::NATCommandGetStatsArg &arg) {
+  bess::pb::NATCommandGetStatsResponse r;
+  Stats total = retired_stats_;
+
+  for (const auto &partition : partitions_) {
+    for (const auto &pools : partition.port_pools) {
+      for (const auto &pool : pools) {
+        r.set_free_ports(r.free_ports() + pool.Size());
+      }
+    }
+  }
+
+  for (const auto &shard : shards_) {
+    r.set_entries(r.entries() + shard->map.Count() / 2);
+
+    total.created += shard->stats.created;
+    total.expired += shard->stats.expired;
+    total.alloc_failures += shard->stats.alloc_failures;
+    total.insert_failures += shard->stats.insert_failures;
+    total.handoffs += shard->stats.handoffs;
+
+    if (arg.clear()) {
+      shard->stats = {};
+    }
+  }
+
+  r.set_created(total.created);
+  r.set_expired(total.expired);
+  r.set_alloc_failures(total.alloc_failures);
+  r.set_insert_failures(total.insert_failures);
+  r.set_handoffs(total.handoffs);
+  r.set_shards(shards_.size());
+
+  if (arg.clear()) {
+    retired_stats_ = {};
+  }
+
+  return CommandSuccess(r);
+}
+
+int NAT::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
+
+  const std::vector<bool> &actives = active_workers();
+  int worker_shard[Worker::kMaxWorkers];
+  size_t num_shards = 0;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    worker_shard[wid] = actives[wid] ? num_shards++ : -1;
+  }
+
+  if (num_shards == 0) {
+    return 0;
+  }
+
+  // Shards are self-contained, so they can be simply reassigned if only the
+  // set of workers has changed but not their number.
+  if (num_shards != shards_.size()) {
+    Reshard(num_shards);
+  }
+
+  std::copy(std::begin(worker_shard), std::end(worker_shard), worker_shard_);
+
+  // Owners must drain their handoff rings even if no packet comes in. Even a
+  // single shard may receive handoffs, from workers that own no shard.
+  bess::StealQueue::SetPolled(this, true);
+  return 0;
+}
+
+void NAT::Reshard(size_t num_shards) {
+  std::vector<std::unique_ptr<Shard>> old_shards;
+  old_shards.swap(shards_);
+
+  uint64_t now = tsc_to_ns(rdtsc());
+
+  for (size_t i = 0; i < num_shards; i++) {
+    shards_.emplace_back(new Shard());
+
+    // Start the clock of the timer wheel
+    shards_.back()->timers.Advance(now, [](const NatTimer &) {});
+  }
+
+  // Each mapping moves to the shard that now owns its partition
+  for (const auto &old_shard : old_shards) {
+    for (const auto &it : old_shard->map) {
+      const NatEntry &forward = it.second;
+      if (!forward.expiry) {
+        continue;
+      }
+
+      const Endpoint &external = forward.endpoint;
+      const auto *reverse = old_shard->map.Find(external);
+      DCHECK(reverse != nullptr);
+
+      int partition = ExternalPartition(external);
+      Shard *shard = shards_[partition % num_shards].get();
+      auto *hash_reverse = shard->map.Insert(external, reverse->second);
+      if (!hash_reverse || !shard->map.Insert(it.first, forward)) {
+        if (hash_reverse) {
+          shard->map.Remove(external);
+        }
+        GetPortPool(partition, external).Put(external.port);
+        shard->stats.insert_failures++;
+        continue;
+      }
+
+      shard->timers.Schedule(forward.expiry, {it.first, forward.expiry});
+    }
+
+    retired_stats_.created += old_shard->stats.created;
+    retired_stats_.expired += old_shard->stats.expired;
+    retired_stats_.alloc_failures += old_shard->stats.alloc_failures;
+    retired_stats_.insert_failures += old_shard->stats.insert_failures;
+    retired_stats_.handoffs += old_shard->stats.handoffs;
+  }
+
+  // Packets still in the handoff rings of the old shards are freed with them
+}
+
+size_t NAT::AddressIndex(be32_t addr) const {
+  return std::lower_bound(ext_addrs_.begin(), ext_addrs_.end(), addr) -
+         ext_addrs_.begin();
+}
+
+int NAT::ProtocolIndex(uint16_t protocol) {
+  switch (protocol) {
+    case IpProto::kTcp:
+      return 0;
+    case IpProto::kUdp:
+      return 1;
+    default:
+      DCHECK_EQ(protocol, IpProto::kIcmp);
+      return 2;
+  }
+}
+
+uint64_t NAT::TimeOut(const NatEntry &forward, const NatEntry &reverse) {
+  // forward.endpoint is the external endpoint, with the same protocol
+  switch (forward.endpoint.protocol) {
+    case IpProto::kTcp: {
+      uint8_t flags = forward.tcp_flags | reverse.tcp_flags;
+      if (flags & Tcp::kRst) {
+        return kTcpResetTimeOutNs;
+      } else if (flags & Tcp::kFin) {
+        return kTcpTransitoryTimeOutNs;
+      } else if (forward.tcp_flags & reverse.tcp_flags & Tcp::kAck) {
+        return kTcpEstablishedTimeOutNs;
+      } else {
+        return kTcpTransitoryTimeOutNs;  // handshake not completed yet
+      }
+    }
+    case IpProto::kUdp:
+      return kUdpTimeOutNs;
+    default:
+      return kIcmpTimeOutNs;
+  }
+}
+
 static inline std::pair<bool, Endpoint> ExtractEndpoint(const Ipv4 *ip,
                                                         const void *l4,
                                                         NAT::Direction dir) {
@@ -178,96 +440,151 @@ static inline std::pair<bool, Endpoint> ExtractEndpoint(const Ipv4 *ip,
 }
 
 // Not necessary to inline this function, since it is less frequently called
-NAT::HashTable::Entry *NAT::CreateNewEntry(const Endpoint &src_internal,
+NAT::HashTable::Entry *NAT::CreateNewEntry(Shard *shard,
+                                           const Endpoint &src_internal,
                                            uint64_t now) {
-  Endpoint src_external;
+  if (src_internal.protocol != IpProto::kIcmp &&
+      src_internal.port == be16_t(0)) {
+    // ignore port number 0
+    return nullptr;
+  }
 
   // An internal IP address is always mapped to the same external IP address,
   // in an deterministic manner (rfc4787 REQ-2)
   size_t hashed = rte_hash_crc(&src_internal.addr, sizeof(be32_t), 0);
   size_t ext_addr_index = hashed % ext_addrs_.size();
+  PortPool &pool = partitions_[InternalPartition(src_internal)]
+                       .port_pools[ext_addr_index]
+                                  [ProtocolIndex(src_internal.protocol)];
+
+  Endpoint src_external;
   src_external.addr = ext_addrs_[ext_addr_index];
   src_external.protocol = src_internal.protocol;
+  if (!pool.Get(src_internal.port, &src_external.port)) {
+    shard->stats.alloc_failures++;
+    return nullptr;
+  }
 
-  for (const auto &port_range : port_ranges_[ext_addr_index]) {
-    uint16_t min;
-    uint16_t range;  // consider [min, min + range) port range
-    // Avoid allocation from an unusable range. We do this even when a range is
-    // already in use since we might want to reclaim it once flows die out.
-    if (port_range.suspended) {
-      continue;
-    }
+  // Found an available src_internal <-> src_external mapping
+  NatEntry forward_entry = {};
+  NatEntry reverse_entry = {};
 
-    if (src_internal.protocol == IpProto::kIcmp) {
-      min = port_range.begin;
-      range = port_range.end - port_range.begin;
-    } else {
-      if (src_internal.port == be16_t(0)) {
-        // ignore port number 0
-        return nullptr;
-      } else if (src_internal.port & ~be16_t(1023)) {
-        if (port_range.end <= 1024u) {
-          continue;
-        }
-        min = std::max((uint16_t)1024, port_range.begin);
-        range = port_range.end - min + 1;
-      } else {
-        // Privileged ports are mapped to privileged ports (rfc4787 REQ-5-a)
-        if (port_range.begin >= 1023u) {
-          continue;
-        }
-        min = port_range.begin;
-        range = std::min((uint16_t)1023, port_range.end) - min;
-      }
-    }
+  reverse_entry.endpoint = src_internal;
+  if (!shard->map.Insert(src_external, reverse_entry)) {
+    pool.Put(src_external.port);
+    shard->stats.insert_failures++;
+    return nullptr;
+  }
 
-    // Start from a random port, then do linear probing
-    uint16_t start_port = min + rng_.GetRange(range);
-    uint16_t port = start_port;
-    int trials = 0;
-
-    do {
-      src_external.port = be16_t(port);
-      auto *hash_reverse = map_.Find(src_external);
-      if (hash_reverse == nullptr) {
-      found:
-        // Found an available src_internal <-> src_external mapping
-        NatEntry forward_entry;
-        NatEntry reverse_entry;
-
-        reverse_entry.endpoint = src_internal;
-        map_.Insert(src_external, reverse_entry);
-
-        forward_entry.endpoint = src_external;
-        return map_.Insert(src_internal, forward_entry);
-      } else {
-        // A':a' is not free, but it might have been expired.
-        // Check with the forward hash entry since timestamp refreshes only for
-        // forward direction.
-        auto *hash_forward = map_.Find(hash_reverse->second.endpoint);
-
-        // Forward and reverse entries must share the same lifespan.
-        DCHECK(hash_forward != nullptr);
-
-        if (now - hash_forward->second.last_refresh > kTimeOutNs) {
-          // Found an expired mapping. Remove A':a' <-> A'':a''...
-          map_.Remove(hash_forward->first);
-          map_.Remove(hash_reverse->first);
-          goto found;  // and go install A:a <-> A':a'
-        }
-      }
+  forward_entry.endpoint = src_external;
+  forward_entry.last_refresh = now;
+  forward_entry.expiry = now + TimeOut(forward_entry, reverse_entry);
 
-      port++;
-      trials++;
+  auto *ret = shard->map.Insert(src_internal, forward_entry);
+  if (!ret) {
+    shard->map.Remove(src_external);
+    pool.Put(src_external.port);
+    shard->stats.insert_failures++;
+    return nullptr;
+  }
 
-      // Out of range? Also check if zero due to uint16_t overflow
-      if (port == 0 || port >= min + range) {
-        port = min;
-      }
-      // FIXME: Should not try for kMaxTrials.
-    } while (port != start_port && trials < kMaxTrials);
+  shard->timers.Schedule(forward_entry.expiry,
+                         {src_internal, forward_entry.expiry});
+  shard->stats.created++;
+  return ret;
+}
+
+void NAT::Expire(Shard *shard, const NatTimer &timer, uint64_t now) {
+  auto *hash_forward = shard->map.Find(timer.internal);
+  if (hash_forward == nullptr || hash_forward->second.expiry != timer.expiry) {
+    return;  // already gone or rescheduled
+  }
+
+  Endpoint external = hash_forward->second.endpoint;
+  auto *hash_reverse = shard->map.Find(external);
+
+  // Forward and reverse entries must share the same lifespan.
+  DCHECK(hash_reverse != nullptr);
+
+  uint64_t expiry = hash_forward->second.last_refresh +
+                    TimeOut(hash_forward->second, hash_reverse->second);
+  if (expiry > now) {
+    // Refreshed since the timer was set
+    hash_forward->second.expiry = expiry;
+    shard->timers.Schedule(expiry, {timer.internal, expiry});
+    return;
+  }
+
+  shard->map.Remove(timer.internal);
+  shard->map.Remove(external);
+
+  GetPortPool(ExternalPartition(external), external).Put(external.port);
+
+  shard->stats.expired++;
+}
+
+void NAT::ShortenTimer(Shard *shard, HashTable::Entry *forward,
+                       const NatEntry &reverse) {
+  NatEntry &entry = forward->second;
+  uint64_t expiry = entry.last_refresh + TimeOut(entry, reverse);
+
+  if (expiry < entry.expiry) {
+    // The timer already set will be ignored when it fires
+    entry.expiry = expiry;
+    shard->timers.Schedule(expiry, {forward->first, expiry});
   }
-  return nullptr;
+}
+
+template <NAT::Direction dir>
+inline void NAT::TrackTcp(Shard *shard, HashTable::Entry *entry,
+                          const Ipv4 *ip, const Tcp *tcp) {
+  NatEntry &e = entry->second;
+  uint8_t flags = tcp->flags;
+
+  Endpoint remote;
+  if (dir == kForward) {
+    remote = {
+        .addr = ip->dst, .port = tcp->dst_port, .protocol = IpProto::kTcp};
+  } else {
+    remote = {
+        .addr = ip->src, .port = tcp->src_port, .protocol = IpProto::kTcp};
+  }
+
+  if (dir == kForward &&
+      ((flags & (Tcp::kSyn | Tcp::kAck)) == Tcp::kSyn || !e.peer.protocol)) {
+    // A new connection through the mapping. The state of the previous one
+    // must not affect its timeout.
+    auto *reverse = shard->map.Find(e.endpoint);
+    DCHECK(reverse != nullptr);
+    e.peer = reverse->second.peer = remote;
+    e.tcp_flags = flags;
+    reverse->second.tcp_flags = 0;
+    return;
+  }
+
+  // Other connections sharing the mapping are not tracked
+  if (!Endpoint::EqualTo()(remote, e.peer)) {
+    return;
+  }
+
+  uint8_t new_flags = flags & ~e.tcp_flags;
+  if (likely(!(new_flags & (Tcp::kFin | Tcp::kRst)))) {
+    e.tcp_flags |= flags;
+    return;
+  }
+
+  auto *peer = shard->map.Find(e.endpoint);
+  DCHECK(peer != nullptr);
+  HashTable::Entry *forward = (dir == kForward) ? entry : peer;
+
+  // Otherwise anyone could cut an idle mapping short with a spoofed RST
+  if (dir == kReverse && (new_flags & Tcp::kRst) &&
+      !(forward->second.tcp_flags & e.tcp_flags & Tcp::kAck)) {
+    flags &= ~Tcp::kRst;
+  }
+
+  e.tcp_flags |= flags;
+  ShortenTimer(shard, forward, (dir == kForward) ? peer->second : e);
 }
 
 template <NAT::Direction dir>
@@ -323,11 +640,23 @@ inline void Stamp(Ipv4 *ip, void *l4, const Endpoint &before,
 }
 
 template <NAT::Direction dir>
-inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+inline void NAT::DoProcessBatch(Context *ctx, Shard *shard,
+                                bess::PacketBatch *batch) {
   gate_idx_t ogate_idx = dir == kForward ? 1 : 0;
   int cnt = batch->cnt();
   uint64_t now = ctx->current_ns;
 
+  // Reclaim idle mappings, before looking up the table for this batch
+  shard->timers.Advance(
+      now, [this, shard, now](const NatTimer &t) { Expire(shard, t, now); });
+
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+  Ipv4 *ips[bess::PacketBatch::kMaxBurst];
+  void *l4s[bess::PacketBatch::kMaxBurst];
+  Endpoint befores[bess::PacketBatch::kMaxBurst];
+  HashTable::Entry *hash_items[bess::PacketBatch::kMaxBurst];
+  int valid_cnt = 0;
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
@@ -345,10 +674,32 @@ inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    auto *hash_item = map_.Find(before);
+    pkts[valid_cnt] = pkt;
+    ips[valid_cnt] = ip;
+    l4s[valid_cnt] = l4;
+    befores[valid_cnt] = before;
+    valid_cnt++;
+  }
+
+  shard->map.FindBatch(befores, valid_cnt, hash_items);
+
+  // Creating a new entry may move or remove existing ones, so the remaining
+  // results of FindBatch() cannot be trusted afterwards.
+  bool stale = false;
+
+  for (int i = 0; i < valid_cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    const Endpoint &before = befores[i];
+    auto *hash_item = stale ? shard->map.Find(before) : hash_items[i];
 
     if (hash_item == nullptr) {
-      if (dir != kForward || !(hash_item = CreateNewEntry(before, now))) {
+      if (dir != kForward) {
+        DropPacket(ctx, pkt);
+        continue;
+      }
+
+      stale = true;
+      if (!(hash_item = CreateNewEntry(shard, before, now))) {
         DropPacket(ctx, pkt);
         continue;
       }
@@ -359,24 +710,116 @@ inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       hash_item->second.last_refresh = now;
     }
 
-    Stamp<dir>(ip, l4, before, hash_item->second.endpoint);
+    if (before.protocol == IpProto::kTcp) {
+      TrackTcp<dir>(shard, hash_item, ips[i],
+                    static_cast<const Tcp *>(l4s[i]));
+    }
+
+    Stamp<dir>(ips[i], l4s[i], before, hash_item->second.endpoint);
     EmitPacket(ctx, pkt, ogate_idx);
   }
 }
 
+template <NAT::Direction dir>
+void NAT::SplitBatch(Context *ctx, bess::PacketBatch *batch) {
+  int shard = worker_shard_[ctx->wid];
+  size_t num_shards = shards_.size();
+
+  if (likely(num_shards == 1 && shard == 0)) {
+    DoProcessBatch<dir>(ctx, shards_[0].get(), batch);
+    return;
+  }
+
+  bess::PacketBatch local;
+  local.clear();
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    size_t ip_bytes = (ip->header_length) << 2;
+    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+
+    bool valid_protocol;
+    Endpoint before;
+    std::tie(valid_protocol, before) = ExtractEndpoint(ip, l4, dir);
+
+    int owner;
+    if (!valid_protocol) {
+      owner = shard;  // will be dropped anyway
+    } else if (dir == kForward) {
+      owner = InternalPartition(before) % num_shards;
+    } else {
+      owner = ExternalPartition(before) % num_shards;
+    }
+
+    if (owner >= 0 && owner == shard) {
+      local.add(pkt);
+    } else if (owner < 0 ||
+               llring_mp_enqueue(shards_[owner]->handoff[dir], pkt) != 0) {
+      DropPacket(ctx, pkt);
+    }
+  }
+
+  if (local.cnt() > 0) {
+    DoProcessBatch<dir>(ctx, shards_[shard].get(), &local);
+  }
+}
+
+uint32_t NAT::DrainHandoffs(Context *ctx, Shard *shard) {
+  bess::PacketBatch batch;
+  uint32_t total = 0;
+
+  for (Direction dir : {kForward, kReverse}) {
+    uint32_t cnt = llring_sc_dequeue_burst(
+        shard->handoff[dir], reinterpret_cast<void **>(batch.pkts()),
+        bess::PacketBatch::kMaxBurst);
+    if (cnt == 0) {
+      continue;
+    }
+
+    batch.set_cnt(cnt);
+    shard->stats.handoffs += cnt;
+    total += cnt;
+    if (dir == kForward) {
+      DoProcessBatch<kForward>(ctx, shard, &batch);
+    } else {
+      DoProcessBatch<kReverse>(ctx, shard, &batch);
+    }
+  }
+
+  return total;
+}
+
+uint32_t NAT::Poll(Context *ctx) {
+  int shard = worker_shard_[ctx->wid];
+  if (shard < 0) {
+    return 0;
+  }
+
+  return DrainHandoffs(ctx, shards_[shard].get());
+}
+
 void NAT::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t incoming_gate = ctx->current_igate;
 
   if (incoming_gate == 0) {
-    DoProcessBatch<kForward>(ctx, batch);
+    SplitBatch<kForward>(ctx, batch);
   } else {
-    DoProcessBatch<kReverse>(ctx, batch);
+    SplitBatch<kReverse>(ctx, batch);
   }
 }
 
 std::string NAT::GetDesc() const {
-  // Divide by 2 since the table has both forward and reverse entries
-  return bess::utils::Format("%zu entries", map_.Count() / 2);
+  size_t entries = 0;
+  for (const auto &shard : shards_) {
+    entries += shard->map.Count();
+  }
+
+  // Divide by 2 since the tables have both forward and reverse entries
+  return bess::utils::Format("%zu entries", entries / 2);
 }
 
 ADD_MODULE(NAT, "nat", "Dynamic Network address/port translator")
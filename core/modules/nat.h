@@ -30,13 +30,17 @@
 #ifndef BESS_MODULES_NAT_H_
 #define BESS_MODULES_NAT_H_
 
+#include "../kmod/llring.h"
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 
 #include <rte_config.h>
 #include <rte_hash_crc.h>
 
+#include <array>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -44,7 +48,10 @@
 
 #include "../utils/cuckoo_map.h"
 #include "../utils/endian.h"
+#include "../utils/ip.h"
 #include "../utils/random.h"
+#include "../utils/tcp.h"
+#include "../utils/timer_wheel.h"
 
 // Theory of operation:
 //
@@ -65,6 +72,33 @@
 // Then the packet is updated to A':a' ===> B:b (with entry 1).
 // When a return packet B:b ===> A':a' comes in, the destination (since it is
 // reverse dir) endpoint is B:b ===> A:a (with entry 2).
+//
+// Free external ports are kept in a pool per external address and protocol, so
+// finding A':a' takes constant time regardless of how many ports are in use.
+// Mappings are reclaimed by a timer wheel after they have been idle for a
+// protocol-specific timeout. For TCP, the timeout depends on which flags have
+// been seen in each direction (e.g., shorter before the connection is
+// established and after it is closed). As a mapping may be shared by many
+// connections, only the last one opened through it (with an outbound SYN) is
+// tracked, and inbound RSTs only count once that connection is established.
+//
+// The NAT is split into a fixed number of partitions. An internal endpoint
+// belongs to the partition given by its hash, and is only mapped to external
+// ports (or ICMP identifiers) in the same partition (port % # of partitions),
+// so both directions of a mapping can be located without a lookup.
+//
+// With multiple workers, each worker owns a shard of the NAT: its own hash
+// table and timers, for a disjoint subset of the partitions (partition % # of
+// shards). Forward packets are processed by the shard that owns their source
+// endpoint, and reverse packets by the shard that owns their destination port,
+// so an internal endpoint has a single mapping regardless of which worker it
+// arrives at (rfc4787 REQ-1). A packet that belongs to the shard of another
+// worker is handed off to that worker through a lock-free ring, which it
+// drains on every scheduling round (see Module::Poll()). No shard is ever
+// accessed by more than one worker. As partitions never change, resharding
+// only moves mappings between shards, and keeps their external endpoints.
+// For the best performance, both directions of a flow should be steered to
+// the same worker (which makes handoffs rare).
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
@@ -111,11 +145,26 @@ static_assert(sizeof(Endpoint) == sizeof(uint64_t), "Incorrect Endpoint");
 struct NatEntry {
   Endpoint endpoint;
 
+  // The remote endpoint of the TCP connection that tcp_flags are tracked for
+  // (protocol 0 if none)
+  Endpoint peer;
+
   // last_refresh is only updated for forward-direction (outbound) packets, as
   // per rfc4787 REQ-6. Reverse entries will have an garbage value.
-  // We do lazy reclaim of expired; NAT mapping entry will NOT expire unless it
-  // runs out of ports in the pool.
   uint64_t last_refresh;  // in nanoseconds (ctx.current_ns)
+
+  // When the expiry timer of the mapping is due. Forward entries only.
+  uint64_t expiry;
+
+  // All TCP flags seen so far in this direction, for the tracked connection
+  uint8_t tcp_flags;
+};
+
+// An expiry timer of a mapping, keyed by its internal endpoint.
+// It is ignored if the mapping has been rescheduled (expiry does not match).
+struct NatTimer {
+  Endpoint internal;
+  uint64_t expiry;
 };
 
 // Port ranges are used to scale out the NAT.
@@ -128,6 +177,32 @@ struct PortRange {
   bool suspended;
 };
 
+// Free ports (or ICMP identifiers) of an external address for a protocol.
+// Ports are given out in random order (rfc6056), in O(1) time.
+class PortPool {
+ public:
+  // Fills the pool with the ports of all usable ranges, except for those
+  // skip(port) returns true for
+  void Init(const std::vector<PortRange> &ranges, bool icmp,
+            const std::function<bool(uint16_t)> &skip, Random *rng);
+
+  // Takes a free port for an internal port. Privileged ports are only mapped
+  // to privileged ports (rfc4787 REQ-5-a). Returns false if none is left.
+  bool Get(be16_t internal_port, be16_t *port);
+
+  // Returns a port taken with Get() to the pool
+  void Put(be16_t port);
+
+  size_t Size() const { return free_[0].size() + free_[1].size(); }
+
+ private:
+  bool icmp_;
+
+  // Stacks of free non-privileged [0] and privileged [1] ports. ICMP
+  // identifiers have no privileged range, so they are all in [0].
+  std::vector<uint16_t> free_[2];
+};
+
 // NAT module. 2 igates and 2 ogates
 // igate/ogate 0: forward dir
 // igate/ogate 1: reverse dir
@@ -143,13 +218,25 @@ class NAT final : public Module {
 
   static const Commands cmds;
 
+  NAT() : Module(), worker_shard_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
   CommandResponse Init(const bess::pb::NATArg &arg);
+  void DeInit() override;
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
   CommandResponse SetRuntimeConfig(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandGetStats(const bess::pb::NATCommandGetStatsArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  // Processes the packets handed off to the shard of the current worker
+  uint32_t Poll(Context *ctx) override;
+
+  // Reshards the NAT across the active workers
+  int OnEvent(bess::Event e) override;
+
   // returns the number of active NAT entries (flows)
   std::string GetDesc() const override;
 
@@ -157,16 +244,114 @@ class NAT final : public Module {
   using HashTable = bess::utils::CuckooMap<Endpoint, NatEntry, Endpoint::Hash,
                                            Endpoint::EqualTo>;
 
-  // 5 minutes for entry expiration (rfc4787 REQ-5-c)
-  static const uint64_t kTimeOutNs = 300ull * 1000 * 1000 * 1000;
+  // Mappings expire after being idle (no outbound packets) for:
+  // 5 minutes for UDP (rfc4787 REQ-5-c)
+  static const uint64_t kUdpTimeOutNs = 300ull * 1000 * 1000 * 1000;
+  // 2 hours 4 minutes for established TCP connections (rfc5382 REQ-5)
+  static const uint64_t kTcpEstablishedTimeOutNs = 7440ull * 1000 * 1000 * 1000;
+  // 4 minutes for partially open or closed TCP connections (rfc5382 REQ-5)
+  static const uint64_t kTcpTransitoryTimeOutNs = 240ull * 1000 * 1000 * 1000;
+  // 10 seconds for reset TCP connections
+  static const uint64_t kTcpResetTimeOutNs = 10ull * 1000 * 1000 * 1000;
+  // 60 seconds for ICMP queries (rfc5508 REQ-1)
+  static const uint64_t kIcmpTimeOutNs = 60ull * 1000 * 1000 * 1000;
+
+  // Granularity of the expiry timers
+  static const uint64_t kTimerTickNs = 1000ull * 1000 * 1000;
+
+  // TCP, UDP, and ICMP have separate port spaces
+  static const int kNumProtocols = 3;
+
+  // Capacity of the handoff rings of each shard
+  static const uint32_t kHandoffSlots = 1024;
+
+  // Number of partitions, which bounds the number of shards. Partitions are
+  // picked by the top bits of the endpoint hash, as the hash tables use the
+  // bottom ones.
+  static const int kPartitionBits = 6;
+  static const int kNumPartitions = 1 << kPartitionBits;
+  static_assert(kNumPartitions >= Worker::kMaxWorkers, "Too few partitions");
+
+  struct Stats {
+    uint64_t created;          // # of mappings created
+    uint64_t expired;          // # of mappings reclaimed after timeout
+    uint64_t alloc_failures;   // # of new flows dropped for lack of free ports
+    uint64_t insert_failures;  // # of new flows dropped as the table was full
+    uint64_t handoffs;         // # of packets received from other workers
+  };
+
+  // The part of the NAT state owned by a worker
+  struct alignas(64) Shard {
+    Shard();
+    ~Shard();
 
-  // how many times shall we try to find a free port number?
-  static const int kMaxTrials = 128;
+    HashTable map;
+    bess::utils::TimerWheel<NatTimer> timers;
 
-  HashTable::Entry *CreateNewEntry(const Endpoint &internal, uint64_t now);
+    Stats stats;
+
+    // Packets handed off by other workers, for each direction (MP/SC)
+    struct llring *handoff[2];
+  };
+
+  // Free ports of a partition, for each external address and protocol. Only
+  // the worker owning the shard of the partition uses them.
+  struct alignas(64) Partition {
+    std::vector<std::array<PortPool, kNumProtocols>> port_pools;
+  };
+
+  static int ProtocolIndex(uint16_t protocol);
+
+  // Returns the partition of an internal endpoint, or of an external endpoint
+  static int InternalPartition(const Endpoint &internal) {
+    return static_cast<uint32_t>(Endpoint::Hash()(internal)) >>
+           (32 - kPartitionBits);
+  }
+  static int ExternalPartition(const Endpoint &external) {
+    return external.port.value() % kNumPartitions;
+  }
+
+  PortPool &GetPortPool(int partition, const Endpoint &external) {
+    return partitions_[partition]
+        .port_pools[AddressIndex(external.addr)]
+                   [ProtocolIndex(external.protocol)];
+  }
+
+  static uint64_t TimeOut(const NatEntry &forward, const NatEntry &reverse);
+
+  // Returns the index of an external address in ext_addrs_
+  size_t AddressIndex(be32_t addr) const;
+
+  // Builds the given number of shards, moving all mappings of the old ones
+  // to the shards that now own their partitions
+  void Reshard(size_t num_shards);
+
+  HashTable::Entry *CreateNewEntry(Shard *shard, const Endpoint &internal,
+                                   uint64_t now);
+
+  // Called when the timer of a mapping fires
+  void Expire(Shard *shard, const NatTimer &timer, uint64_t now);
+
+  // Called when a TCP connection is closed or reset for the first time in a
+  // direction, as its mapping may now expire earlier than its timer is set for
+  void ShortenTimer(Shard *shard, HashTable::Entry *forward,
+                    const NatEntry &reverse);
+
+  // Updates the TCP state of a mapping with a packet going through it
+  template <Direction dir>
+  void TrackTcp(Shard *shard, HashTable::Entry *entry,
+                const bess::utils::Ipv4 *ip, const bess::utils::Tcp *tcp);
+
+  // Processes the packets owned by the shard of the current worker (if any),
+  // and hands off the rest
+  template <Direction dir>
+  void SplitBatch(Context *ctx, bess::PacketBatch *batch);
+
+  // Processes packets handed off to the shard by other workers
+  uint32_t DrainHandoffs(Context *ctx, Shard *shard);
 
   template <Direction dir>
-  void DoProcessBatch(Context *ctx, bess::PacketBatch *batch);
+  void DoProcessBatch(Context *ctx, Shard *shard, bess::PacketBatch *batch);
 
   std::vector<be32_t> ext_addrs_;
 
@@ -174,8 +359,15 @@ class NAT final : public Module {
   // ext_addrs_ range.
   std::vector<std::vector<PortRange>> port_ranges_;
 
-  HashTable map_;
-  Random rng_;
+  std::vector<Partition> partitions_;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Index of the shard owned by each worker, or -1 if none
+  int worker_shard_[Worker::kMaxWorkers];
+
+  // Counters of the shards removed by Reshard()
+  Stats retired_stats_;
 };
 
 #endif  // BESS_MODULES_NAT_H_
@@ -29,6 +29,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_inc.h"
+#include "../steal_queue.h"
 #include "../utils/format.h"
 
 const Commands PortInc::cmds = {
@@ -80,6 +81,9 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
     prefetch_ = 1;
   }
 
+  steal_ = arg.steal();
+  bess::StealQueue::SetSource(this, steal_);
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_INC, nullptr, 0);
   if (ret < 0) {
@@ -93,10 +97,13 @@ CommandResponse PortInc::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::PortIncArg arg;
   arg.set_port(port_->name());
   arg.set_prefetch(prefetch_);
+  arg.set_steal(steal_);
   return CommandSuccess(arg);
 }
 
 void PortInc::DeInit() {
+  bess::StealQueue::SetSource(this, false);
+
   if (port_) {
     port_->ReleaseQueues(reinterpret_cast<const module *>(this), PACKET_DIR_INC,
                          nullptr, 0);
@@ -108,6 +115,35 @@ std::string PortInc::GetDesc() const {
                              port_->port_builder()->class_name().c_str());
 }
 
+int PortInc::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
+
+  steal_workers_ = 0;
+  if (steal_) {
+    steal_workers_ = bess::StealQueue::StealableWorkers(this);
+    if (!steal_workers_) {
+      LOG(WARNING) << name() << ": work stealing disabled, as the downstream "
+                   << "pipeline cannot run on arbitrary workers";
+    }
+  }
+
+  return 0;
+}
+
+int PortInc::ArmIdleWakeup(void *arg) {
+  return port_->EnableRxNotification((queue_t)(uintptr_t)arg);
+}
+
+bool PortInc::HasIdleWork(void *arg) {
+  return port_->RxPending((queue_t)(uintptr_t)arg);
+}
+
+void PortInc::DisarmIdleWakeup(void *arg) {
+  port_->DisableRxNotification((queue_t)(uintptr_t)arg);
+}
+
 struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
                                     void *arg) {
   if (children_overload_ > 0) {
@@ -153,7 +189,12 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
-  RunNextModule(ctx, batch);
+  // A full batch suggests that more packets are waiting in the port queue, so
+  // let idle workers help
+  if (!steal_workers_ || cnt < static_cast<uint32_t>(burst) ||
+      !bess::StealQueue::Offload(ctx, this, steal_workers_, batch)) {
+    RunNextModule(ctx, batch);
+  }
 
   return {.block = false,
           .packets = cnt,
@@ -41,7 +41,13 @@ class PortInc final : public Module {
 
   static const Commands cmds;
 
-  PortInc() : Module(), port_(), prefetch_(), burst_() {
+  PortInc()
+      : Module(),
+        port_(),
+        prefetch_(),
+        burst_(),
+        steal_(),
+        steal_workers_() {
     is_task_ = true;
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
@@ -56,6 +62,12 @@ class PortInc final : public Module {
 
   std::string GetDesc() const override;
 
+  int OnEvent(bess::Event e) override;
+
+  int ArmIdleWakeup(void *arg) override;
+  bool HasIdleWork(void *arg) override;
+  void DisarmIdleWakeup(void *arg) override;
+
   CommandResponse CommandSetBurst(
       const bess::pb::PortIncCommandSetBurstArg &arg);
 
@@ -63,6 +75,11 @@ class PortInc final : public Module {
   Port *port_;
   int prefetch_;
   int burst_;
+
+  // Whether idle workers may steal full batches, and which (see
+  // bess::StealQueue)
+  bool steal_;
+  uint64_t steal_workers_;
 };
 
 #endif  // BESS_MODULES_PORTINC_H_
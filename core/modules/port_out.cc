@@ -29,8 +29,17 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_out.h"
+
+#include <cstdlib>
+#include <cstring>
+
 #include "../utils/format.h"
 
+// Staging ring size of queues shared by multiple workers, without buffering
+static const uint32_t kDefaultStagingSize = 1024;
+
+static const uint64_t kDefaultFlushDeadlineNs = 100000;  // 100us
+
 const Commands PortOut::cmds = {
     {"get_initial_arg", "EmptyArg", MODULE_CMD_FUNC(&PortOut::GetInitialArg),
      Command::THREAD_SAFE},
@@ -56,17 +65,44 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
     return CommandFailure(ENODEV, "Port %s has no outgoing queue", port_name);
   }
 
+  uint32_t ring_size = kDefaultStagingSize;
+  if (arg.tx_buffer_size()) {
+    ring_size = arg.tx_buffer_size();
+    if (ring_size < bess::PacketBatch::kMaxBurst || ring_size > 65536 ||
+        (ring_size & (ring_size - 1))) {
+      return CommandFailure(EINVAL,
+                            "'tx_buffer_size' must be a power of 2 in "
+                            "[%zu, 65536]",
+                            bess::PacketBatch::kMaxBurst);
+    }
+    buffered_ = true;
+    flush_deadline_ns_ = arg.flush_deadline_ns() ?: kDefaultFlushDeadlineNs;
+  }
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_OUT, nullptr, 0);
+  if (ret < 0) {
+    return CommandFailure(-ret);
+  }
 
   node_constraints_ = port_->GetNodePlacementConstraint();
 
-  for (size_t i = 0; i < MAX_QUEUES_PER_DIR; i++) {
-    mcs_lock_init(&queue_locks_[i]);
+  for (queue_t qid = 0; qid < port_->num_queues[PACKET_DIR_OUT]; qid++) {
+    int bytes = llring_bytes_with_slots(ring_size);
+    llring *ring =
+        reinterpret_cast<llring *>(std::aligned_alloc(alignof(llring), bytes));
+    if (!ring) {
+      return CommandFailure(ENOMEM);
+    }
+    if (llring_init(ring, ring_size, 0, 1)) {
+      std::free(ring);
+      return CommandFailure(EINVAL);
+    }
+    queues_[qid].ring = ring;
   }
 
-  if (ret < 0) {
-    return CommandFailure(-ret);
+  if (buffered_ && RegisterTask(nullptr) == INVALID_TASK_ID) {
+    return CommandFailure(ENOMEM, "Task creation failed");
   }
 
   return CommandSuccess();
@@ -75,10 +111,28 @@ CommandResponse PortOut::Init(const bess::pb::PortOutArg &arg) {
 CommandResponse PortOut::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::PortOutArg arg;
   arg.set_port(port_->name());
+  if (buffered_) {
+    arg.set_tx_buffer_size(queues_[0].ring->common.slots);
+    arg.set_flush_deadline_ns(flush_deadline_ns_);
+  }
   return CommandSuccess(arg);
 }
 
 void PortOut::DeInit() {
+  for (TxQueue &q : queues_) {
+    if (!q.ring) {
+      continue;
+    }
+
+    bess::Packet::Free(&q.pending);
+
+    bess::Packet *pkt;
+    while (llring_sc_dequeue(q.ring, (void **)&pkt) == 0) {
+      bess::Packet::Free(pkt);
+    }
+    std::free(q.ring);
+  }
+
   if (port_) {
     port_->ReleaseQueues(reinterpret_cast<const module *>(this), PACKET_DIR_OUT,
                          nullptr, 0);
@@ -106,32 +160,141 @@ static inline int SendBatch(bess::PacketBatch *batch, Port *p, queue_t qid) {
     }
 
     p->queue_stats[dir][qid].packets += sent_pkts;
-    p->queue_stats[dir][qid].dropped += (batch->cnt() - sent_pkts);
     p->queue_stats[dir][qid].bytes += sent_bytes;
   }
 
   return sent_pkts;
 }
 
+void PortOut::DropPackets(queue_t qid, bess::Packet **pkts, int cnt,
+                          bool rejected) {
+  QueueStats &stats = port_->queue_stats[PACKET_DIR_OUT][qid];
+
+  // May be called by multiple workers at the same time for shared queues
+  __atomic_fetch_add(&stats.dropped, cnt, __ATOMIC_RELAXED);
+  if (rejected) {
+    // Only the sender of the queue gets here
+    stats.diff_hist[cnt]++;
+  }
+  bess::Packet::Free(pkts, cnt);
+}
+
+int PortOut::DrainLocked(queue_t qid, uint64_t now_ns) {
+  TxQueue &q = queues_[qid];
+  bess::PacketBatch *pending = &q.pending;
+  int sent_total = 0;
+
+  while (true) {
+    if (pending->empty()) {
+      int cnt = llring_sc_dequeue_burst(q.ring, (void **)pending->pkts(),
+                                        bess::PacketBatch::kMaxBurst);
+      if (cnt == 0) {
+        break;
+      }
+      pending->set_cnt(cnt);
+    }
+
+    int sent = SendBatch(pending, port_, qid);
+    sent_total += sent;
+
+    if (sent == pending->cnt()) {
+      pending->clear();
+      continue;
+    }
+
+    // The port is (temporarily) full
+    int left = pending->cnt() - sent;
+    if (!buffered_) {
+      DropPackets(qid, pending->pkts() + sent, left, true);
+      pending->clear();
+      continue;
+    }
+
+    if (sent > 0) {
+      memmove(pending->pkts(), pending->pkts() + sent,
+              left * sizeof(bess::Packet *));
+      pending->set_cnt(left);
+      q.stalled_since_ns = now_ns;
+    } else if (q.stalled_since_ns == 0) {
+      q.stalled_since_ns = now_ns;
+    } else if (now_ns - q.stalled_since_ns > flush_deadline_ns_) {
+      // Give up on the oldest packets, and retry later with the next ones
+      DropPackets(qid, pending->pkts(), left, true);
+      pending->clear();
+      q.stalled_since_ns = 0;
+    }
+    return sent_total;
+  }
+
+  q.stalled_since_ns = 0;
+  return sent_total;
+}
+
+int PortOut::Drain(queue_t qid, uint64_t now_ns) {
+  TxQueue &q = queues_[qid];
+  int sent = 0;
+
+  // NOTE: the seq_cst store of 'flushing' and the check of the ring below
+  // must not be reordered. Otherwise packets enqueued by a worker that failed
+  // to become the flusher in the meantime could be stranded in the ring.
+  while (!q.flushing.exchange(true, std::memory_order_acquire)) {
+    int ret = DrainLocked(qid, now_ns);
+    sent += ret;
+    q.flushing.store(false, std::memory_order_seq_cst);
+
+    // If the port is full, the remaining packets will be retried later
+    if ((buffered_ && ret == 0) || llring_empty(q.ring)) {
+      break;
+    }
+  }
+
+  return sent;
+}
+
 void PortOut::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   Port *p = port_;
 
   CHECK(worker_queues_[ctx->wid] >= 0);
   queue_t qid = worker_queues_[ctx->wid];
-  int sent_pkts = 0;
+  int cnt = batch->cnt();
+
+  if (queue_users_[qid] == 1 && !buffered_) {
+    int sent_pkts = SendBatch(batch, p, qid);
+    if (sent_pkts < cnt) {
+      DropPackets(qid, batch->pkts() + sent_pkts, cnt - sent_pkts, true);
+    }
+    return;
+  }
 
+  TxQueue &q = queues_[qid];
+  int queued;
   if (queue_users_[qid] == 1) {
-    sent_pkts = SendBatch(batch, p, qid);
+    queued = llring_sp_enqueue_burst(q.ring, (void **)batch->pkts(), cnt);
   } else {
-    mcslock_node_t me;
-    mcs_lock(&queue_locks_[qid], &me);
-    sent_pkts = SendBatch(batch, p, qid);
-    mcs_unlock(&queue_locks_[qid], &me);
+    queued = llring_mp_enqueue_burst(q.ring, (void **)batch->pkts(), cnt);
   }
 
-  if (sent_pkts < batch->cnt()) {
-    bess::Packet::Free(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
+  if (queued < cnt) {
+    DropPackets(qid, batch->pkts() + queued, cnt - queued, false);
   }
+
+  Drain(qid, ctx->current_ns);
+}
+
+struct task_result PortOut::RunTask(Context *ctx, bess::PacketBatch *,
+                                    void *) {
+  uint32_t sent = 0;
+
+  // Retry packets that the port could not take earlier, even if no more
+  // packets are coming in.
+  for (queue_t qid = 0; qid < port_->num_queues[PACKET_DIR_OUT]; qid++) {
+    TxQueue &q = queues_[qid];
+    if (!q.pending.empty() || !llring_empty(q.ring)) {
+      sent += Drain(qid, ctx->current_ns);
+    }
+  }
+
+  return {.block = (sent == 0), .packets = sent, .bits = 0};
 }
 
 int PortOut::OnEvent(bess::Event e) {
@@ -31,10 +31,12 @@
 #ifndef BESS_MODULES_PORTOUT_H_
 #define BESS_MODULES_PORTOUT_H_
 
+#include <atomic>
+
+#include "../kmod/llring.h"
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../port.h"
-#include "../utils/mcslock.h"
 #include "../worker.h"
 
 class PortOut final : public Module {
@@ -45,7 +47,13 @@ class PortOut final : public Module {
   static const Commands cmds;
 
   PortOut()
-      : Module(), port_(), worker_queues_(), queue_users_(), queue_locks_() {
+      : Module(),
+        port_(),
+        buffered_(),
+        flush_deadline_ns_(),
+        worker_queues_(),
+        queue_users_(),
+        queues_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -54,6 +62,9 @@ class PortOut final : public Module {
 
   void DeInit() override;
 
+  struct task_result RunTask(Context *ctx, bess::PacketBatch *batch,
+                             void *arg) override;
+
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
   int OnEvent(bess::Event e) override;
@@ -61,14 +72,46 @@ class PortOut final : public Module {
   std::string GetDesc() const override;
 
  private:
+  // Software staging area of an outgoing queue. Workers enqueue packets into
+  // the ring without locking, and whoever manages to set 'flushing' moves
+  // them to the port, so workers sharing a queue never wait for each other.
+  struct alignas(64) TxQueue {
+    struct llring *ring;
+
+    std::atomic<bool> flushing;
+
+    // Packets taken from the ring but not yet accepted by the port.
+    // Owned by the flusher.
+    bess::PacketBatch pending;
+
+    // Since when 'pending' has been waiting for the port. 0 if not stalled.
+    uint64_t stalled_since_ns;
+  };
+
+  // Moves packets from the staging ring of the queue to the port.
+  // Returns the number of packets sent.
+  int Drain(queue_t qid, uint64_t now_ns);
+
+  // Same as above, but the caller must own queues_[qid].flushing.
+  int DrainLocked(queue_t qid, uint64_t now_ns);
+
+  // Drops 'cnt' packets in 'pkts' that could not be sent to the queue, and
+  // counts them. 'rejected' tells if the port has seen (and refused) them.
+  void DropPackets(queue_t qid, bess::Packet **pkts, int cnt, bool rejected);
+
   Port *port_;
 
+  // If true, packets not accepted by the port right away are kept in the
+  // staging ring and retried, for up to flush_deadline_ns_.
+  bool buffered_;
+  uint64_t flush_deadline_ns_;
+
   int worker_queues_[Worker::kMaxWorkers];
 
   // Number of workers mapped to a given queue. Indexed by queue number
   int queue_users_[MAX_QUEUES_PER_DIR];
 
-  mcslock_t queue_locks_[MAX_QUEUES_PER_DIR];
+  TxQueue queues_[MAX_QUEUES_PER_DIR];
 };
 
 #endif  // BESS_MODULES_PORTOUT_H_
@@ -32,6 +32,7 @@
 
 #include <cstdlib>
 
+#include "../steal_queue.h"
 #include "../utils/format.h"
 
 #define DEFAULT_QUEUE_SIZE 1024
@@ -124,6 +125,9 @@ CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
     prefetch_ = true;
   }
 
+  steal_ = arg.steal();
+  bess::StealQueue::SetSource(this, steal_);
+
   init_arg_ = arg;
   return CommandSuccess();
 }
@@ -137,6 +141,7 @@ CommandResponse Queue::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   ret.set_size(size_);
   ret.set_prefetch(prefetch_);
   ret.set_backpressure(backpressure_);
+  ret.set_steal(steal_);
   return CommandSuccess(ret);
 }
 
@@ -149,12 +154,16 @@ CommandResponse Queue::SetRuntimeConfig(const bess::pb::QueueArg &arg) {
   }
   prefetch_ = arg.prefetch();
   backpressure_ = arg.backpressure();
+  steal_ = arg.steal();
+  bess::StealQueue::SetSource(this, steal_);
   return CommandSuccess();
 }
 
 void Queue::DeInit() {
   bess::Packet *pkt;
 
+  bess::StealQueue::SetSource(this, false);
+
   if (queue_) {
     while (llring_sc_dequeue(queue_, (void **)&pkt) == 0) {
       bess::Packet::Free(pkt);
@@ -169,6 +178,23 @@ std::string Queue::GetDesc() const {
   return bess::utils::Format("%u/%u", llring_count(ring), ring->common.slots);
 }
 
+int Queue::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
+
+  steal_workers_ = 0;
+  if (steal_) {
+    steal_workers_ = bess::StealQueue::StealableWorkers(this);
+    if (!steal_workers_) {
+      LOG(WARNING) << name() << ": work stealing disabled, as the downstream "
+                   << "pipeline cannot run on arbitrary workers";
+    }
+  }
+
+  return 0;
+}
+
 /* from upstream */
 void Queue::ProcessBatch(Context *, bess::PacketBatch *batch) {
   int queued =
@@ -222,7 +248,11 @@ struct task_result Queue::RunTask(Context *ctx, bess::PacketBatch *batch,
     }
   }
 
-  RunNextModule(ctx, batch);
+  // Let idle workers help while we are backlogged
+  if (!steal_workers_ || llring_empty(queue_) ||
+      !bess::StealQueue::Offload(ctx, this, steal_workers_, batch)) {
+    RunNextModule(ctx, batch);
+  }
 
   if (backpressure_ && llring_count(queue_) < low_water_) {
     SignalUnderload();
@@ -48,6 +48,8 @@ class Queue : public Module {
         size_(),
         high_water_(),
         low_water_(),
+        steal_(),
+        steal_workers_(),
         stats_() {
     is_task_ = true;
     propagate_workers_ = false;
@@ -67,6 +69,8 @@ class Queue : public Module {
 
   std::string GetDesc() const override;
 
+  int OnEvent(bess::Event e) override;
+
   CommandResponse CommandSetBurst(const bess::pb::QueueCommandSetBurstArg &arg);
   CommandResponse CommandSetSize(const bess::pb::QueueCommandSetSizeArg &arg);
   CommandResponse CommandGetStatus(
@@ -102,6 +106,11 @@ class Queue : public Module {
   // Low water occupancy
   uint64_t low_water_;
 
+  // Whether idle workers may steal batches while the queue is backlogged, and
+  // which (see bess::StealQueue)
+  bool steal_;
+  uint64_t steal_workers_;
+
   // Accumulated statistics counters
   struct {
     uint64_t enqueued;
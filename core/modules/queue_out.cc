@@ -93,10 +93,13 @@ void QueueOut::ProcessBatch(Context *, bess::PacketBatch *batch) {
     }
 
     p->queue_stats[dir][qid].packets += sent_pkts;
-    p->queue_stats[dir][qid].dropped += (batch->cnt() - sent_pkts);
     p->queue_stats[dir][qid].bytes += sent_bytes;
   }
 
+  // Drivers leave it to their callers to count unsent packets as dropped
+  p->queue_stats[PACKET_DIR_OUT][qid].dropped += batch->cnt() - sent_pkts;
+  p->queue_stats[PACKET_DIR_OUT][qid].diff_hist[batch->cnt() - sent_pkts]++;
+
   if (sent_pkts < batch->cnt()) {
     bess::Packet::Free(batch->pkts() + sent_pkts, batch->cnt() - sent_pkts);
   }
@@ -47,6 +47,15 @@ CommandResponse Replicate::Init(const bess::pb::ReplicateArg &arg) {
   }
   ngates_ = arg.gates_size();
 
+  zero_copy_ = arg.zero_copy();
+  if (arg.header_len()) {
+    if (arg.header_len() > SNBUF_DATA) {
+      return CommandFailure(EINVAL, "header_len must be no more than %d",
+                            SNBUF_DATA);
+    }
+    header_len_ = arg.header_len();
+  }
+
   return CommandSuccess();
 }
 
@@ -69,7 +78,10 @@ void Replicate::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *tocopy = batch->pkts()[i];
     for (int j = 1; j < ngates_; j++) {
-      bess::Packet *newpkt = bess::Packet::copy(tocopy);
+      bess::Packet *newpkt =
+          (zero_copy_ && tocopy->is_linear())
+              ? bess::Packet::clone(tocopy, header_len_)
+              : bess::Packet::copy(tocopy);
       if (newpkt) {
         EmitPacket(ctx, newpkt, gates_[j]);
       }
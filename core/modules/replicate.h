@@ -40,7 +40,12 @@ class Replicate final : public Module {
 
   static const Commands cmds;
 
-  Replicate() : Module(), gates_(), ngates_() {
+  Replicate()
+      : Module(),
+        gates_(),
+        ngates_(),
+        zero_copy_(),
+        header_len_(bess::Packet::kCloneHeaderLen) {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -59,6 +64,10 @@ class Replicate final : public Module {
   gate_idx_t gates_[kMaxGates];
   // The total number of output gates
   int ngates_;
+  // Share the payload of the original packet with its copies?
+  bool zero_copy_;
+  // Bytes of each zero-copy replica that are not shared
+  uint16_t header_len_;
 };
 
 #endif  // BESS_MODULES_RELICATE_H_
@@ -0,0 +1,108 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for deep (Packet::copy) vs. shallow (Packet::clone) replication,
+// as done by the Replicate module in its default and zero_copy modes.
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../packet_pool.h"
+
+namespace {
+
+static const size_t kBatchSize = bess::PacketBatch::kMaxBurst;
+
+class ReplicateFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    CHECK(pool_.AllocBulk(pkts_, kBatchSize, state.range(1)));
+  }
+
+  void TearDown(benchmark::State &) override {
+    bess::Packet::Free(pkts_, kBatchSize);
+  }
+
+ protected:
+  // Makes (gates - 1) replicas of every packet in the batch, then frees them
+  // as the egress side eventually would.
+  template <bess::Packet *(*Replicate)(bess::Packet *)>
+  void Run(benchmark::State &state) {
+    const int ngates = state.range(0);
+    bess::Packet *replicas[kBatchSize];
+
+    while (state.KeepRunning()) {
+      for (int j = 1; j < ngates; j++) {
+        for (size_t i = 0; i < kBatchSize; i++) {
+          replicas[i] = Replicate(pkts_[i]);
+        }
+        bess::Packet::Free(replicas, kBatchSize);
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatchSize * (ngates - 1));
+    state.SetBytesProcessed(state.iterations() * kBatchSize * (ngates - 1) *
+                            state.range(1));
+  }
+
+  bess::PlainPacketPool pool_;
+  bess::Packet *pkts_[kBatchSize];
+};
+
+bess::Packet *Deep(bess::Packet *pkt) {
+  return bess::Packet::copy(pkt);
+}
+
+bess::Packet *Shallow(bess::Packet *pkt) {
+  return bess::Packet::clone(pkt);
+}
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(ReplicateFixture, Copy)(benchmark::State &state) {
+  Run<Deep>(state);
+}
+
+BENCHMARK_DEFINE_F(ReplicateFixture, Clone)(benchmark::State &state) {
+  Run<Shallow>(state);
+}
+
+// Arguments: number of output gates, packet size
+static void Args(benchmark::internal::Benchmark *b) {
+  for (int ngates : {2, 4, 8}) {
+    for (int size : {64, 512, 1514}) {
+      b->Args({ngates, size});
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(ReplicateFixture, Copy)->Apply(Args);
+BENCHMARK_REGISTER_F(ReplicateFixture, Clone)->Apply(Args);
+
+BENCHMARK_MAIN();
@@ -51,11 +51,13 @@ const Commands UrlFilter::cmds = {
     {"get_runtime_config", "EmptyArg",
      MODULE_CMD_FUNC(&UrlFilter::GetRuntimeConfig), Command::THREAD_SAFE},
     {"set_runtime_config", "UrlFilterConfig",
-     MODULE_CMD_FUNC(&UrlFilter::SetRuntimeConfig), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&UrlFilter::SetRuntimeConfig), Command::THREAD_SAFE},
     {"add", "UrlFilterArg", MODULE_CMD_FUNC(&UrlFilter::CommandAdd),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&UrlFilter::CommandClear),
-     Command::THREAD_UNSAFE}};
+     Command::THREAD_SAFE},
+    {"get_stats", "UrlFilterCommandGetStatsArg",
+     MODULE_CMD_FUNC(&UrlFilter::CommandGetStats), Command::THREAD_UNSAFE}};
 
 // Template for generating TCP packets without data
 struct[[gnu::packed]] PacketTemplate {
@@ -173,20 +175,69 @@ inline static bess::Packet *GenerateResetPacket(
   return pkt;
 }
 
+void UrlFilter::BuildBlacklist(
+    std::vector<Rule> rules,
+    const google::protobuf::RepeatedPtrField<bess::pb::UrlFilterArg_Url>
+        &urls) {
+  for (const auto &url : urls) {
+    rules.emplace_back(RuleKey(url.host().data(), url.host().size(),
+                               url.path().data(), url.path().size()),
+                       std::tuple<>(), false);
+  }
+
+  // Workers keep matching against the old trie while the new one is built
+  blacklist_.Update(
+      [&rules](CompactTrie<std::tuple<>> *t) { t->Build(rules); });
+
+  // Hosts are contiguous in Dump(), which is sorted
+  std::vector<Rule> built = blacklist_.Standby().Dump();
+  num_hosts_ = 0;
+  for (size_t i = 0; i < built.size(); i++) {
+    const std::string &key = std::get<0>(built[i]);
+    size_t host_len = key.find('\0');
+    if (i == 0 ||
+        std::get<0>(built[i - 1]).compare(0, host_len + 1, key, 0,
+                                           host_len + 1) != 0) {
+      num_hosts_++;
+    }
+  }
+}
+
 CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
-  for (const auto &url : arg.blacklist()) {
-    blacklist_[url.host()].Insert(url.path(), {});
+  max_flows_ = arg.max_flows() ?: kDefaultMaxFlows;
+  max_flow_bytes_ = arg.max_flow_bytes() ?: kDefaultMaxFlowBytes;
+
+  if (max_flows_ > kMaxFlows) {
+    return CommandFailure(EINVAL, "'max_flows' must be at most %u", kMaxFlows);
+  }
+
+  // Keep the hash table at most half full
+  flow_map_ = CuckooMap<Flow, uint32_t, FlowHash>(
+      align_ceil_pow2(std::max<uint32_t>(max_flows_ / 2, 4)), max_flows_);
+  flows_.clear();
+  flows_.reserve(max_flows_);
+  for (uint32_t i = 0; i < max_flows_; i++) {
+    flows_.emplace_back(&arena_);
   }
+  free_flows_.clear();
+  for (uint32_t i = max_flows_; i > 0; i--) {
+    free_flows_.push_back(i - 1);
+  }
+  lru_.resize(max_flows_ + 1);
+  lru_[max_flows_] = {max_flows_, max_flows_};
+
+  BuildBlacklist({}, arg.blacklist());
   return CommandSuccess();
 }
 
 CommandResponse UrlFilter::CommandAdd(const bess::pb::UrlFilterArg &arg) {
-  Init(arg);
+  BuildBlacklist(blacklist_.Standby().Dump(), arg.blacklist());
   return CommandSuccess();
 }
 
 CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
-  blacklist_.clear();
+  blacklist_.Update([](CompactTrie<std::tuple<>> *t) { t->Clear(); });
+  num_hosts_ = 0;
   return CommandSuccess();
 }
 
@@ -194,8 +245,14 @@ CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
 // such a way that SetRuntimeConfig would build the same one.
 CommandResponse UrlFilter::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::UrlFilterArg resp;
-  // Our return value is empty since we return
+  // Our blacklist is empty since we return
   // the current blacklist as the runtime config.
+  if (max_flows_ != kDefaultMaxFlows) {
+    resp.set_max_flows(max_flows_);
+  }
+  if (max_flow_bytes_ != kDefaultMaxFlowBytes) {
+    resp.set_max_flow_bytes(max_flow_bytes_);
+  }
   return CommandSuccess(resp);
 }
 
@@ -203,36 +260,93 @@ CommandResponse UrlFilter::GetInitialArg(const bess::pb::EmptyArg &) {
 CommandResponse UrlFilter::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   bess::pb::UrlFilterConfig resp;
   using rule_t = bess::pb::UrlFilterArg_Url;
-  for (const auto &it : blacklist_) {
-    auto entries = it.second.Dump();
-    for (auto entry : entries) {
-      rule_t *hp = resp.add_blacklist();
-      hp->set_host(it.first);
-      hp->set_path(std::get<0>(entry));
-      // For now, ignore get<1> and get<2>, which are
-      // the tuple and the prefix boolean, respectively.
-      // The tuple is (currently) always empty and the boolean
-      // is (currently) always false -- see the .Insert() above.
-    }
+  // Dump() is sorted by host, then by path.
+  for (const auto &entry : blacklist_.Standby().Dump()) {
+    const std::string &key = std::get<0>(entry);
+    size_t host_len = key.find('\0');
+    rule_t *hp = resp.add_blacklist();
+    hp->set_host(key.substr(0, host_len));
+    hp->set_path(key.substr(host_len + 1));
+    // For now, ignore get<1> and get<2>, which are
+    // the tuple and the prefix boolean, respectively.
+    // The tuple is (currently) always empty and the boolean
+    // is (currently) always false -- see BuildBlacklist().
   }
-  // Dump() is sorted, but blacklist_ is not: we use a
-  // stable sort to just sort by the host as the outer key.
-  std::stable_sort(
-      resp.mutable_blacklist()->begin(), resp.mutable_blacklist()->end(),
-      [](const rule_t &a, const rule_t &b) { return a.host() < b.host(); });
   return CommandSuccess(resp);
 }
 
 // Restores the module's configuration.
 CommandResponse UrlFilter::SetRuntimeConfig(
     const bess::pb::UrlFilterConfig &arg) {
-  blacklist_.clear();
-  for (const auto &url : arg.blacklist()) {
-    blacklist_[url.host()].Insert(url.path(), {});
-  }
+  BuildBlacklist({}, arg.blacklist());
   return CommandSuccess();
 }
 
+CommandResponse UrlFilter::CommandGetStats(
+    const bess::pb::UrlFilterCommandGetStatsArg &arg) {
+  bess::pb::UrlFilterCommandGetStatsResponse r;
+  size_t memory = max_flows_ * (sizeof(FlowEntry) + sizeof(LruLink)) +
+                  arena_.bytes_allocated();
+
+  r.set_flows(flow_map_.Count());
+  r.set_max_flows(max_flows_);
+  r.set_evictions(stats_.evictions);
+  r.set_expirations(stats_.expirations);
+  r.set_reassembly_failures(stats_.reassembly_failures);
+  r.set_memory_bytes(memory);
+
+  if (arg.clear()) {
+    stats_ = {};
+  }
+
+  return CommandSuccess(r);
+}
+
+uint32_t UrlFilter::AddFlow(const Flow &flow, uint64_t now) {
+  if (free_flows_.empty()) {
+    RemoveFlow(lru_[max_flows_].prev);
+    stats_.evictions++;
+  }
+
+  uint32_t idx = free_flows_.back();
+  if (flow_map_.Insert(flow, idx) == nullptr) {
+    return kNoFlow;
+  }
+  free_flows_.pop_back();
+
+  FlowEntry &entry = flows_[idx];
+  entry.flow = flow;
+  entry.record.Reset(max_flow_bytes_);
+  entry.record.SetExpiryTime(now + TIME_OUT_NS);
+  LruPushFront(idx);
+  return idx;
+}
+
+void UrlFilter::RemoveFlow(uint32_t idx) {
+  flow_map_.Remove(flows_[idx].flow);
+  // Return the buffer to the arena now rather than when the slot is reused
+  flows_[idx].record.GetBuffer().Reset();
+  LruUnlink(idx);
+  free_flows_.push_back(idx);
+}
+
+void UrlFilter::TouchFlow(uint32_t idx, uint64_t now) {
+  flows_[idx].record.SetExpiryTime(now + TIME_OUT_NS);
+  LruUnlink(idx);
+  LruPushFront(idx);
+}
+
+void UrlFilter::ExpireFlows(uint64_t now) {
+  // Flows are touched in the order of their expiry, so the expired ones are
+  // all at the tail of the LRU list.
+  uint32_t idx;
+  while ((idx = lru_[max_flows_].prev) != max_flows_ &&
+         now >= flows_[idx].record.ExpiryTime()) {
+    RemoveFlow(idx);
+    stats_.expirations++;
+  }
+}
+
 void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t igate = ctx->current_igate;
 
@@ -242,8 +356,11 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     return;
   }
 
+  uint64_t now = ctx->current_ns;
   int cnt = batch->cnt();
 
+  ExpireFlows(now);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
@@ -265,57 +382,51 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     flow.src_port = tcp->src_port;
     flow.dst_port = tcp->dst_port;
 
-    uint64_t now = ctx->current_ns;
-
-    // Find existing flow, if we have one.
-    std::unordered_map<Flow, FlowRecord, FlowHash>::iterator it =
-        flow_cache_.find(flow);
-
-    if (it != flow_cache_.end()) {
-      if (now >= it->second.ExpiryTime()) {
-        // Discard old flow and start over.
-        flow_cache_.erase(it);
-        it = flow_cache_.end();
-      } else if (it->second.IsAnalyzed()) {
-        // Once we're finished analyzing, we only record *blocked* flows.
-        // Continue blocking this flow for TIME_OUT_NS more ns.
-        it->second.SetExpiryTime(now + TIME_OUT_NS);
-        DropPacket(ctx, pkt);
-        continue;
-      }
+    // Find existing flow, if we have one. Expired ones are already gone.
+    const auto *found = flow_map_.Find(flow);
+    uint32_t idx = found ? found->second : kNoFlow;
+
+    if (idx != kNoFlow && flows_[idx].record.IsAnalyzed()) {
+      // Once we're finished analyzing, we only record *blocked* flows.
+      // Continue blocking this flow for TIME_OUT_NS more ns.
+      TouchFlow(idx, now);
+      DropPacket(ctx, pkt);
+      continue;
     }
 
-    if (it == flow_cache_.end()) {
-      // Don't have a flow, or threw an aged one out.  If there's no
-      // SYN in this packet the reconstruct code will fail.  This is
-      // a common case (for any flow that got analyzed and allowed);
-      // skip a pointless emplace/erase pair for such packets.
+    if (idx == kNoFlow) {
+      // Don't have a flow.  If there's no SYN in this packet the
+      // reconstruct code will fail.  This is a common case (for any flow
+      // that got analyzed and allowed); skip a pointless add/remove pair
+      // for such packets.
       if (tcp->flags & Tcp::Flag::kSyn) {
-        std::tie(it, std::ignore) = flow_cache_.emplace(
-            std::piecewise_construct, std::make_tuple(flow), std::make_tuple());
-      } else {
+        idx = AddFlow(flow, now);
+      }
+      if (idx == kNoFlow) {
         EmitPacket(ctx, pkt, 0);
         continue;
       }
     }
 
-    FlowRecord &record = it->second;
-    TcpFlowReconstruct &buffer = record.GetBuffer();
+    FlowRecord &record = flows_[idx].record;
+    ArenaTcpFlowReconstruct &buffer = record.GetBuffer();
 
     // If the reconstruct code indicates failure, treat this
     // as a flow to pass.  Note: we only get failure if there is
-    // something seriously wrong; we get success if there are holes
-    // in the data (in which case the contiguous_len() below is short).
+    // something seriously wrong, the flow is too long, or has too many
+    // holes; we get success if there are a few holes in the data (in
+    // which case the contiguous_len() below is short).
     bool success = buffer.InsertPacket(pkt);
     if (!success) {
       VLOG(1) << "Reconstruction failure";
-      flow_cache_.erase(it);
+      RemoveFlow(idx);
+      stats_.reassembly_failures++;
       EmitPacket(ctx, pkt, 0);
       continue;
     }
 
     // Have something on this flow; keep it alive for a while longer.
-    record.SetExpiryTime(now + TIME_OUT_NS);
+    TouchFlow(idx, now);
 
     // We are by definition still analyzing.  See if we can determine
     // the final disposition of this flow.
@@ -330,16 +441,12 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     // -2 means incomplete
     if (parse_result > 0 || parse_result == -2) {
-      const std::string path_str(path, path_len);
-
       // Look for the Host header
       for (size_t j = 0; j < num_headers && !matched; ++j) {
         if (strncmp(headers[j].name, HTTP_HEADER_HOST, headers[j].name_len) ==
             0) {
-          const std::string host(headers[j].value, headers[j].value_len);
-          const auto rule_iterator = blacklist_.find(host);
-          matched = rule_iterator != blacklist_.end() &&
-                    rule_iterator->second.Match(path_str);
+          matched = blacklist_.Get().Match(RuleKey(
+              headers[j].value, headers[j].value_len, path, path_len));
         }
       }
     }
@@ -352,12 +459,12 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       // NOTE: if FIN is lost on its way to destination, this will simply pass
       // the retransmitted packet.
       if (parse_result != -2 || (tcp->flags & Tcp::Flag::kFin)) {
-        flow_cache_.erase(it);
+        RemoveFlow(idx);
       }
     } else {
       // No need to keep reconstructing, just mark it as analyzed
       // (and hence blocked).
-      it->second.SetAnalyzed();
+      record.SetAnalyzed();
 
       // Inject RST to destination
       EmitPacket(ctx, GenerateResetPacket(eth->src_addr, eth->dst_addr, ip->src,
@@ -386,7 +493,7 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 }
 
 std::string UrlFilter::GetDesc() const {
-  return bess::utils::Format("%zu hosts", blacklist_.size());
+  return bess::utils::Format("%zu hosts", num_hosts_);
 }
 
 ADD_MODULE(UrlFilter, "url-filter", "Filter HTTP connection")
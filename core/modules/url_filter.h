@@ -41,12 +41,16 @@
 
 #include "../module.h"
 #include "../packet.h"
+#include "../rcu.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/compact_trie.h"
+#include "../utils/cuckoo_map.h"
 #include "../utils/tcp_flow_reconstruct.h"
-#include "../utils/trie.h"
 
-using bess::utils::TcpFlowReconstruct;
-using bess::utils::Trie;
+using bess::utils::CompactTrie;
+using bess::utils::ArenaTcpFlowReconstruct;
+using bess::utils::CuckooMap;
+using bess::utils::TcpFlowArena;
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 
@@ -91,17 +95,27 @@ struct FlowHash {
 
 class FlowRecord {
  public:
-  FlowRecord() : done_analyzing_(false), buffer_(128), expiry_time_(0) {}
+  explicit FlowRecord(TcpFlowArena *arena)
+      : done_analyzing_(false), buffer_(arena), expiry_time_(0) {}
+
+  // Prepares the record for a new flow, of which at most max_buflen bytes are
+  // to be reconstructed
+  void Reset(size_t max_buflen) {
+    done_analyzing_ = false;
+    buffer_.Reset();
+    buffer_.set_max_buf_size(max_buflen);
+    expiry_time_ = 0;
+  }
 
   bool IsAnalyzed() { return done_analyzing_; }
   void SetAnalyzed() { done_analyzing_ = true; }
-  TcpFlowReconstruct &GetBuffer() { return buffer_; }
+  ArenaTcpFlowReconstruct &GetBuffer() { return buffer_; }
   uint64_t ExpiryTime() { return expiry_time_; }
   void SetExpiryTime(uint64_t time) { expiry_time_ = time; }
 
  private:
   bool done_analyzing_;
-  TcpFlowReconstruct buffer_;
+  ArenaTcpFlowReconstruct buffer_;
   uint64_t expiry_time_;
 };
 
@@ -109,6 +123,17 @@ class FlowRecord {
 // matches the blacklist.
 // igate/ogate 0: traffic from internal network to external network
 // igate/ogate 1: traffic from external network to internal network
+//
+// TCP flows being analyzed (or blocked) are tracked in a table of a fixed
+// capacity. Flows idle for TIME_OUT_NS are expired, and when the table is full
+// the least recently used flow is evicted for a new one. At most
+// max_flow_bytes of each flow are reassembled to find its HTTP request header;
+// flows with longer headers pass.
+//
+// The blacklist is kept in a read-only CompactTrie, keyed by host and path
+// separated by '\0', which is rebuilt whenever rules are added. The new trie
+// is built off the datapath and swapped in without pausing workers. Add rules
+// in bulk, rather than one by one, when there are many.
 class UrlFilter final : public Module {
  public:
   typedef std::pair<std::string, std::string> Url;
@@ -128,10 +153,95 @@ class UrlFilter final : public Module {
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
   CommandResponse SetRuntimeConfig(const bess::pb::UrlFilterConfig &arg);
+  CommandResponse CommandGetStats(
+      const bess::pb::UrlFilterCommandGetStatsArg &arg);
 
  private:
-  std::unordered_map<std::string, Trie<std::tuple<>>> blacklist_;
-  std::unordered_map<Flow, FlowRecord, FlowHash> flow_cache_;
+  static const uint32_t kDefaultMaxFlows = 65536;
+  static const uint32_t kMaxFlows = 1 << 24;
+  static const uint32_t kDefaultMaxFlowBytes = 16384;
+
+  static const uint32_t kNoFlow = UINT32_MAX;
+
+  struct FlowEntry {
+    explicit FlowEntry(TcpFlowArena *arena) : flow(), record(arena) {}
+
+    Flow flow;
+    FlowRecord record;
+  };
+
+  struct LruLink {
+    uint32_t prev;
+    uint32_t next;
+  };
+
+  struct Stats {
+    uint64_t evictions;
+    uint64_t expirations;
+    uint64_t reassembly_failures;
+  };
+
+  // Returns the index of a new entry for flow, evicting the least recently
+  // used one if the table is full, or kNoFlow on failure.
+  uint32_t AddFlow(const Flow &flow, uint64_t now);
+
+  void RemoveFlow(uint32_t idx);
+
+  // Marks the flow as the most recently used one
+  void TouchFlow(uint32_t idx, uint64_t now);
+
+  // Removes the flows idle since before now - TIME_OUT_NS
+  void ExpireFlows(uint64_t now);
+
+  void LruUnlink(uint32_t idx) {
+    lru_[lru_[idx].prev].next = lru_[idx].next;
+    lru_[lru_[idx].next].prev = lru_[idx].prev;
+  }
+
+  void LruPushFront(uint32_t idx) {
+    uint32_t head = max_flows_;
+    lru_[idx] = {head, lru_[head].next};
+    lru_[lru_[head].next].prev = idx;
+    lru_[head].next = idx;
+  }
+
+  using Rule = CompactTrie<std::tuple<>>::Entry;
+
+  // Returns the blacklist key of the given host and path
+  static std::string RuleKey(const char *host, size_t host_len,
+                             const char *path, size_t path_len) {
+    std::string key;
+    key.reserve(host_len + 1 + path_len);
+    key.append(host, host_len);
+    key.push_back('\0');
+    key.append(path, path_len);
+    return key;
+  }
+
+  // Rebuilds the blacklist with the given rules and the new ones in urls
+  void BuildBlacklist(
+      std::vector<Rule> rules,
+      const google::protobuf::RepeatedPtrField<bess::pb::UrlFilterArg_Url>
+          &urls);
+
+  bess::rcu::DoubleBuffer<CompactTrie<std::tuple<>>> blacklist_;
+  size_t num_hosts_ = 0;
+  uint32_t max_flows_ = 0;
+  uint32_t max_flow_bytes_ = 0;
+
+  // Buffers of all flows. Must outlive flows_.
+  TcpFlowArena arena_;
+
+  // Flow -> index in flows_
+  CuckooMap<Flow, uint32_t, FlowHash> flow_map_;
+  std::vector<FlowEntry> flows_;
+  std::vector<uint32_t> free_flows_;
+
+  // Doubly-linked list of flows_ in use, the most recently used first, with
+  // lru_[max_flows_] as its head.
+  std::vector<LruLink> lru_;
+
+  Stats stats_ = {};
 };
 
 #endif  // BESS_MODULES_URL_FILTER_H_
@@ -32,9 +32,17 @@
 #include <benchmark/benchmark.h>
 #include <glog/logging.h>
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../utils/random.h"
+#include "../utils/trie.h"
 #include "url_filter.h"
 
-// Benchmarks the NAT flow hash.
+using bess::utils::Trie;
+
+// Benchmarks the flow hash.
 static void BM_FlowHash(benchmark::State& state) {
   Flow f;
   FlowHash h;
@@ -46,4 +54,102 @@ static void BM_FlowHash(benchmark::State& state) {
 
 BENCHMARK(BM_FlowHash);
 
+// Blacklists of state.range(0) synthetic URLs, with 8 paths per host on
+// average. Half of the lookups hit.
+class BlacklistFixture : public benchmark::Fixture {
+ public:
+  static const size_t kNumQueries = 1 << 16;
+
+  void SetUp(benchmark::State &state) override {
+    const size_t n = state.range(0);
+    Random rng;
+    std::vector<std::pair<std::string, std::string>> urls;
+
+    rng.SetSeed(0);
+    for (size_t i = 0; i < n; i++) {
+      std::string host =
+          "www.site" + std::to_string(rng.GetRange(n / 8 + 1)) + ".com";
+      std::string path = "/dir" + std::to_string(rng.GetRange(100)) +
+                         "/page" + std::to_string(i) + ".html";
+      urls.emplace_back(host, path);
+    }
+
+    std::vector<CompactTrie<std::tuple<>>::Entry> rules;
+    for (const auto &url : urls) {
+      rules.emplace_back(url.first + '\0' + url.second, std::tuple<>(), false);
+    }
+    compact_.Build(std::move(rules));
+
+    // Trie takes a few KB per byte of path, so only with smaller sets
+    if (n <= 10000) {
+      for (const auto &url : urls) {
+        tries_[url.first].Insert(url.second, {});
+      }
+    }
+
+    for (size_t i = 0; i < kNumQueries; i++) {
+      auto url = urls[rng.GetRange(n)];
+      if (i % 2) {
+        url.second += "x";
+      }
+      queries_.push_back(url);
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    compact_.Clear();
+    tries_.clear();
+    queries_.clear();
+  }
+
+ protected:
+  CompactTrie<std::tuple<>> compact_;
+  std::unordered_map<std::string, Trie<std::tuple<>>> tries_;
+  std::vector<std::pair<std::string, std::string>> queries_;
+};
+
+// Lookups in the blacklist of UrlFilter
+BENCHMARK_DEFINE_F(BlacklistFixture, CompactTrie)(benchmark::State &state) {
+  size_t i = 0;
+  size_t matched = 0;
+
+  while (state.KeepRunning()) {
+    const auto &url = queries_[i++ % kNumQueries];
+    std::string key;
+    key.reserve(url.first.size() + 1 + url.second.size());
+    key.append(url.first).push_back('\0');
+    key.append(url.second);
+    matched += compact_.Match(key);
+  }
+
+  CHECK_EQ(matched, (state.iterations() + 1) / 2);
+  state.SetItemsProcessed(state.iterations());
+  state.counters["MB"] = compact_.memory_usage() / 1e6;
+  state.counters["B/url"] =
+      static_cast<double>(compact_.memory_usage()) / state.range(0);
+}
+
+// Lookups in the former blacklist of UrlFilter: a Trie of paths per host
+BENCHMARK_DEFINE_F(BlacklistFixture, Trie)(benchmark::State &state) {
+  size_t i = 0;
+  size_t matched = 0;
+
+  while (state.KeepRunning()) {
+    const auto &url = queries_[i++ % kNumQueries];
+    const auto it = tries_.find(url.first);
+    matched += it != tries_.end() && it->second.Match(url.second);
+  }
+
+  CHECK_EQ(matched, (state.iterations() + 1) / 2);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BlacklistFixture, CompactTrie)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Arg(1000000);
+
+BENCHMARK_REGISTER_F(BlacklistFixture, Trie)->Arg(1000)->Arg(10000);
+
 BENCHMARK_MAIN();
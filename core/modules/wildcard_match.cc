@@ -30,6 +30,7 @@
 
 #include "wildcard_match.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -49,6 +50,32 @@ static inline void mask(wm_hkey_t *dst, const wm_hkey_t &src,
   }
 }
 
+// Each rule sets two bits of its tuple's Bloom filter, with ~16 bits per rule
+// (a false positive rate of about 1.5%)
+static const size_t kBloomBitsPerRule = 16;
+
+static inline void bloom_bits(const std::vector<uint64_t> &bloom,
+                              HashResult hash, size_t *bit1, size_t *bit2) {
+  size_t bit_mask = bloom.size() * 64 - 1;
+  *bit1 = hash & bit_mask;
+  *bit2 = ((hash >> 16) ^ (hash * 0x5bd1e995)) & bit_mask;
+}
+
+static inline bool bloom_test(const std::vector<uint64_t> &bloom,
+                              HashResult hash) {
+  size_t bit1, bit2;
+  bloom_bits(bloom, hash, &bit1, &bit2);
+  return ((bloom[bit1 / 64] >> (bit1 % 64)) & 1) &&
+         ((bloom[bit2 / 64] >> (bit2 % 64)) & 1);
+}
+
+static inline void bloom_set(std::vector<uint64_t> *bloom, HashResult hash) {
+  size_t bit1, bit2;
+  bloom_bits(*bloom, hash, &bit1, &bit2);
+  (*bloom)[bit1 / 64] |= 1ull << (bit1 % 64);
+  (*bloom)[bit2 / 64] |= 1ull << (bit2 % 64);
+}
+
 // XXX: this is repeated in many modules. get rid of them when converting .h to
 // .hh, etc... it's in defined in some old header
 static inline int is_valid_gate(gate_idx_t gate) {
@@ -63,11 +90,11 @@ const Commands WildcardMatch::cmds = {
     {"set_runtime_config", "WildcardMatchConfig",
      MODULE_CMD_FUNC(&WildcardMatch::SetRuntimeConfig), Command::THREAD_UNSAFE},
     {"add", "WildcardMatchCommandAddArg",
-     MODULE_CMD_FUNC(&WildcardMatch::CommandAdd), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&WildcardMatch::CommandAdd), Command::THREAD_SAFE},
     {"delete", "WildcardMatchCommandDeleteArg",
-     MODULE_CMD_FUNC(&WildcardMatch::CommandDelete), Command::THREAD_UNSAFE},
+     MODULE_CMD_FUNC(&WildcardMatch::CommandDelete), Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&WildcardMatch::CommandClear),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
     {"set_default_gate", "WildcardMatchCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&WildcardMatch::CommandSetDefaultGate),
      Command::THREAD_SAFE}};
@@ -129,31 +156,70 @@ CommandResponse WildcardMatch::Init(const bess::pb::WildcardMatchArg &arg) {
 
   default_gate_ = DROP_GATE;
   total_key_size_ = align_ceil(size_acc, sizeof(uint64_t));
+  use_bloom_ = arg.use_bloom_filter();
 
   return CommandSuccess();
 }
 
-inline gate_idx_t WildcardMatch::LookupEntry(const wm_hkey_t &key,
-                                             gate_idx_t def_gate) {
-  struct WmData result = {
-      .priority = INT_MIN, .ogate = def_gate,
-  };
+inline void WildcardMatch::LookupBatch(
+    const std::vector<struct WmTuple> &tuples, const wm_hkey_t *keys, int cnt,
+    gate_idx_t def_gate, gate_idx_t *ogates) {
+  struct WmData results[bess::PacketBatch::kMaxBurst];
+  bool matched[bess::PacketBatch::kMaxBurst];
+  wm_hkey_t keys_masked[bess::PacketBatch::kMaxBurst];
+  HashResult hashes[bess::PacketBatch::kMaxBurst];
+  int pending[bess::PacketBatch::kMaxBurst];
 
-  for (auto &tuple : tuples_) {
+  wm_hash hasher(total_key_size_);
+  wm_eq eq(total_key_size_);
+
+  for (int i = 0; i < cnt; i++) {
+    results[i] = {.priority = INT_MIN, .ogate = def_gate};
+    matched[i] = false;
+  }
+
+  for (const auto &tuple : tuples) {
     const auto &ht = tuple.ht;
-    wm_hkey_t key_masked;
+    int num_candidates = 0;
+    int num_pending = 0;
+
+    // Hash all remaining keys and prefetch their buckets first, so that the
+    // cache misses of the whole batch overlap.
+    for (int i = 0; i < cnt; i++) {
+      if (matched[i] && results[i].priority > tuple.max_priority) {
+        continue;
+      }
+
+      num_candidates++;
+      mask(&keys_masked[i], keys[i], tuple.mask, total_key_size_);
+      hashes[i] = ht.GetHash(keys_masked[i], hasher);
+      if (use_bloom_ && !bloom_test(tuple.bloom, hashes[i])) {
+        continue;
+      }
+
+      ht.Prefetch(hashes[i]);
+      pending[num_pending++] = i;
+    }
 
-    mask(&key_masked, key, tuple.mask, total_key_size_);
+    // No remaining tuple can override what the packets have matched
+    if (num_candidates == 0) {
+      break;
+    }
 
-    const auto *entry =
-        ht.Find(key_masked, wm_hash(total_key_size_), wm_eq(total_key_size_));
+    for (int j = 0; j < num_pending; j++) {
+      int i = pending[j];
+      const auto *entry = ht.FindByHash(hashes[i], keys_masked[i], eq);
 
-    if (entry && entry->second.priority >= result.priority) {
-      result = entry->second;
+      if (entry && entry->second.priority >= results[i].priority) {
+        results[i] = entry->second;
+        matched[i] = true;
+      }
     }
   }
 
-  return result.ogate;
+  for (int i = 0; i < cnt; i++) {
+    ogates[i] = results[i].ogate;
+  }
 }
 
 void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
@@ -196,16 +262,19 @@ void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     }
   }
 
+  gate_idx_t ogates[bess::PacketBatch::kMaxBurst];
+  LookupBatch(tuples_.Get(), keys, cnt, default_gate, ogates);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    EmitPacket(ctx, pkt, LookupEntry(keys[i], default_gate));
+    EmitPacket(ctx, pkt, ogates[i]);
   }
 }
 
 std::string WildcardMatch::GetDesc() const {
   int num_rules = 0;
 
-  for (const auto &tuple : tuples_) {
+  for (const auto &tuple : tuples_.Standby()) {
     num_rules += tuple.ht.Count();
   }
 
@@ -275,10 +344,11 @@ CommandResponse WildcardMatch::ExtractKeyMask(const T &arg, wm_hkey_t *key,
   return CommandSuccess();
 }
 
-int WildcardMatch::FindTuple(wm_hkey_t *mask) {
+int WildcardMatch::FindTuple(const std::vector<struct WmTuple> &tuples,
+                             wm_hkey_t *mask) {
   int i = 0;
 
-  for (const auto &tuple : tuples_) {
+  for (const auto &tuple : tuples) {
     if (memcmp(&tuple.mask, mask, total_key_size_) == 0) {
       return i;
     }
@@ -287,33 +357,84 @@ int WildcardMatch::FindTuple(wm_hkey_t *mask) {
   return -ENOENT;
 }
 
-int WildcardMatch::AddTuple(wm_hkey_t *mask) {
-  if (tuples_.size() >= MAX_TUPLES) {
+int WildcardMatch::AddTuple(std::vector<struct WmTuple> *tuples,
+                            wm_hkey_t *mask) {
+  if (tuples->size() >= MAX_TUPLES) {
     return -ENOSPC;
   }
 
-  tuples_.emplace_back();
-  struct WmTuple &tuple = tuples_.back();
+  tuples->emplace_back();
+  struct WmTuple &tuple = tuples->back();
   bess::utils::Copy(&tuple.mask, mask, sizeof(*mask));
+  tuple.max_priority = INT_MIN;
+  if (use_bloom_) {
+    BuildBloom(&tuple);
+  }
 
-  return int(tuples_.size() - 1);
+  return int(tuples->size() - 1);
 }
 
-int WildcardMatch::DelEntry(int idx, wm_hkey_t *key) {
-  struct WmTuple &tuple = tuples_[idx];
-  int ret =
-      tuple.ht.Remove(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
-  if (ret) {
-    return ret;
+int WildcardMatch::DelEntry(std::vector<struct WmTuple> *tuples,
+                            wm_hkey_t *mask, wm_hkey_t *key) {
+  int idx = FindTuple(*tuples, mask);
+  if (idx < 0) {
+    return idx;
+  }
+
+  struct WmTuple &tuple = (*tuples)[idx];
+  if (!tuple.ht.Remove(*key, wm_hash(total_key_size_),
+                       wm_eq(total_key_size_))) {
+    return -ENOENT;
   }
 
   if (tuple.ht.Count() == 0) {
-    tuples_.erase(tuples_.begin() + idx);
+    tuples->erase(tuples->begin() + idx);
+    return 0;
   }
 
+  tuple.max_priority = INT_MIN;
+  for (const auto &entry : tuple.ht) {
+    tuple.max_priority = std::max(tuple.max_priority, entry.second.priority);
+  }
+
+  // Before sorting, as 'tuple' refers to a position in 'tuples'
+  if (use_bloom_) {
+    BuildBloom(&tuple);
+  }
+
+  SortTuples(tuples);
+
   return 0;
 }
 
+void WildcardMatch::SortTuples(std::vector<struct WmTuple> *tuples) {
+  std::stable_sort(tuples->begin(), tuples->end(),
+                   [](const struct WmTuple &a, const struct WmTuple &b) {
+                     return a.max_priority > b.max_priority;
+                   });
+}
+
+void WildcardMatch::BuildBloom(struct WmTuple *tuple) {
+  size_t num_bits = std::max(align_ceil_pow2(tuple->ht.Count() *
+                                             kBloomBitsPerRule),
+                             uint64_t{64});
+
+  tuple->bloom.assign(num_bits / 64, 0);
+  for (const auto &entry : tuple->ht) {
+    bloom_set(&tuple->bloom,
+              tuple->ht.GetHash(entry.first, wm_hash(total_key_size_)));
+  }
+}
+
+void WildcardMatch::AddToBloom(struct WmTuple *tuple, const wm_hkey_t &key) {
+  if (tuple->bloom.size() * 64 < tuple->ht.Count() * kBloomBitsPerRule) {
+    // Grow the filter to keep the false positive rate low
+    BuildBloom(tuple);
+  } else {
+    bloom_set(&tuple->bloom, tuple->ht.GetHash(key, wm_hash(total_key_size_)));
+  }
+}
+
 CommandResponse WildcardMatch::CommandAdd(
     const bess::pb::WildcardMatchCommandAddArg &arg) {
   gate_idx_t gate = arg.gate();
@@ -336,21 +457,44 @@ CommandResponse WildcardMatch::CommandAdd(
   data.priority = priority;
   data.ogate = gate;
 
-  int idx = FindTuple(&mask);
-  if (idx < 0) {
-    idx = AddTuple(&mask);
-    if (idx < 0) {
-      return CommandFailure(-idx, "failed to add a new wildcard pattern");
-    }
-  }
-
-  auto *ret = tuples_[idx].ht.Insert(key, data, wm_hash(total_key_size_),
-                                     wm_eq(total_key_size_));
-  if (ret == nullptr) {
-    return CommandFailure(EINVAL, "failed to add a rule");
-  }
-
-  return CommandSuccess();
+  return tuples_.Update(
+      [&](std::vector<struct WmTuple> *tuples) -> CommandResponse {
+        int idx = FindTuple(*tuples, &mask);
+        if (idx < 0) {
+          idx = AddTuple(tuples, &mask);
+          if (idx < 0) {
+            return CommandFailure(-idx, "failed to add a new wildcard pattern");
+          }
+        }
+
+        struct WmTuple &tuple = (*tuples)[idx];
+        bool overwrite = tuple.ht.Find(key, wm_hash(total_key_size_),
+                                       wm_eq(total_key_size_)) != nullptr;
+
+        auto *ret = tuple.ht.Insert(key, data, wm_hash(total_key_size_),
+                                    wm_eq(total_key_size_));
+        if (ret == nullptr) {
+          return CommandFailure(EINVAL, "failed to add a rule");
+        }
+
+        if (overwrite) {
+          // The old rule may have been the one with the highest priority
+          tuple.max_priority = INT_MIN;
+          for (const auto &entry : tuple.ht) {
+            tuple.max_priority =
+                std::max(tuple.max_priority, entry.second.priority);
+          }
+        } else {
+          tuple.max_priority = std::max(tuple.max_priority, priority);
+        }
+
+        if (use_bloom_) {
+          AddToBloom(&tuple, key);
+        }
+
+        SortTuples(tuples);
+        return CommandSuccess();
+      });
 }
 
 CommandResponse WildcardMatch::CommandDelete(
@@ -363,12 +507,9 @@ CommandResponse WildcardMatch::CommandDelete(
     return err;
   }
 
-  int idx = FindTuple(&mask);
-  if (idx < 0) {
-    return CommandFailure(-idx, "failed to delete a rule");
-  }
-
-  int ret = DelEntry(idx, &key);
+  int ret = tuples_.Update([&](std::vector<struct WmTuple> *tuples) {
+    return DelEntry(tuples, &mask, &key);
+  });
   if (ret < 0) {
     return CommandFailure(-ret, "failed to delete a rule");
   }
@@ -382,9 +523,8 @@ CommandResponse WildcardMatch::CommandClear(const bess::pb::EmptyArg &) {
 }
 
 void WildcardMatch::Clear() {
-  for (auto &tuple : tuples_) {
-    tuple.ht.Clear();
-  }
+  tuples_.Update(
+      [](std::vector<struct WmTuple> *tuples) { tuples->clear(); });
 }
 
 // Retrieves a WildcardMatchArg that would reconstruct this module.
@@ -399,6 +539,7 @@ CommandResponse WildcardMatch::GetInitialArg(const bess::pb::EmptyArg &) {
     }
     f->set_num_bytes(field.size);
   }
+  resp.set_use_bloom_filter(use_bloom_);
   return CommandSuccess(resp);
 }
 
@@ -411,7 +552,7 @@ CommandResponse WildcardMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   resp.set_default_gate(default_gate_);
 
   // Each tuple provides a single mask, which may have many data-matches.
-  for (auto &tuple : tuples_) {
+  for (auto &tuple : tuples_.Standby()) {
     wm_hkey_t mask = tuple.mask;
     // Each entry in the hash table has priority, ogate, and the data
     // (one datum per field, under the mask for this field).
@@ -37,12 +37,13 @@
 #include <rte_hash_crc.h>
 
 #include "../pb/module_msg.pb.h"
+#include "../rcu.h"
 #include "../utils/cuckoo_map.h"
 
 using bess::utils::HashResult;
 using bess::utils::CuckooMap;
 
-#define MAX_TUPLES 8
+#define MAX_TUPLES 64
 #define MAX_FIELDS 8
 #define MAX_FIELD_SIZE 8
 static_assert(MAX_FIELD_SIZE <= sizeof(uint64_t),
@@ -135,7 +136,12 @@ class WildcardMatch final : public Module {
   static const Commands cmds;
 
   WildcardMatch()
-      : Module(), default_gate_(), total_key_size_(), fields_(), tuples_() {
+      : Module(),
+        default_gate_(),
+        total_key_size_(),
+        use_bloom_(),
+        fields_(),
+        tuples_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -159,18 +165,30 @@ class WildcardMatch final : public Module {
   struct WmTuple {
     CuckooMap<wm_hkey_t, struct WmData, wm_hash, wm_eq> ht;
     wm_hkey_t mask;
+    int max_priority;  // highest priority among the rules in ht
+    std::vector<uint64_t> bloom;  // Bloom filter of rule hashes, if enabled
   };
 
-  gate_idx_t LookupEntry(const wm_hkey_t &key, gate_idx_t def_gate);
+  // Tuples are sorted by max_priority in descending order, so a packet need
+  // not be looked up in the remaining tuples once it has matched a rule with
+  // a higher priority than theirs.
+  void LookupBatch(const std::vector<struct WmTuple> &tuples,
+                   const wm_hkey_t *keys, int cnt, gate_idx_t def_gate,
+                   gate_idx_t *ogates);
 
   CommandResponse AddFieldOne(const bess::pb::Field &field, struct WmField *f);
 
   template <typename T>
   CommandResponse ExtractKeyMask(const T &arg, wm_hkey_t *key, wm_hkey_t *mask);
 
-  int FindTuple(wm_hkey_t *mask);
-  int AddTuple(wm_hkey_t *mask);
-  int DelEntry(int idx, wm_hkey_t *key);
+  int FindTuple(const std::vector<struct WmTuple> &tuples, wm_hkey_t *mask);
+  int AddTuple(std::vector<struct WmTuple> *tuples, wm_hkey_t *mask);
+  int DelEntry(std::vector<struct WmTuple> *tuples, wm_hkey_t *mask,
+               wm_hkey_t *key);
+  void SortTuples(std::vector<struct WmTuple> *tuples);
+
+  void BuildBloom(struct WmTuple *tuple);
+  void AddToBloom(struct WmTuple *tuple, const wm_hkey_t &key);
 
   void Clear();
 
@@ -178,9 +196,12 @@ class WildcardMatch final : public Module {
 
   size_t total_key_size_; /* a multiple of sizeof(uint64_t) */
 
+  bool use_bloom_;
+
   // TODO(melvinw): this can be refactored to use ExactMatchTable
   std::vector<struct WmField> fields_;
-  std::vector<struct WmTuple> tuples_;
+  // Rules are updated without pausing workers; see rcu.h
+  bess::rcu::DoubleBuffer<std::vector<struct WmTuple>> tuples_;
 };
 
 #endif  // BESS_MODULES_WILDCARDMATCH_H_
@@ -30,6 +30,8 @@
 
 #include "worker_split.h"
 
+#include "../utils/flow_hash.h"
+
 const Commands WorkerSplit::cmds = {
     {"reset", "WorkerSplitArg", MODULE_CMD_FUNC(&WorkerSplit::CommandReset),
      Command::THREAD_UNSAFE}};
@@ -39,6 +41,20 @@ CommandResponse WorkerSplit::Init(const bess::pb::WorkerSplitArg &arg) {
 }
 
 CommandResponse WorkerSplit::CommandReset(const bess::pb::WorkerSplitArg &arg) {
+  if (!arg.worker_gates().empty() && !arg.hash_gates().empty()) {
+    return CommandFailure(EINVAL,
+                          "'worker_gates' and 'hash_gates' are exclusive");
+  }
+
+  hash_gates_.clear();
+  for (uint32_t ogate : arg.hash_gates()) {
+    if (ogate >= MAX_GATES) {
+      return CommandFailure(EINVAL, "output gate must be less than %" PRIu16,
+                            MAX_GATES);
+    }
+    hash_gates_.push_back(ogate);
+  }
+
   if (arg.worker_gates().empty()) {
     for (int i = 0; i < Worker::kMaxWorkers; i++) {
       gates_[i] = i;
@@ -62,7 +78,25 @@ CommandResponse WorkerSplit::CommandReset(const bess::pb::WorkerSplitArg &arg) {
   return CommandSuccess();
 }
 
+void WorkerSplit::ProcessBatchByHash(Context *ctx,
+                                     bess::PacketBatch *batch) {
+  uint64_t num_gates = hash_gates_.size();
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint32_t hash = bess::utils::FlowHash(pkt);
+    // Maps the hash to [0, num_gates) without a division
+    EmitPacket(ctx, pkt, hash_gates_[(hash * num_gates) >> 32]);
+  }
+}
+
 void WorkerSplit::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  if (!hash_gates_.empty()) {
+    ProcessBatchByHash(ctx, batch);
+    return;
+  }
+
   int gate = gates_[ctx->wid];
   if (gate >= 0) {
     RunChooseModule(ctx, gate, batch);
@@ -75,6 +109,16 @@ void WorkerSplit::AddActiveWorker(int wid, const Task *t) {
   if (!HaveVisitedWorker(t)) {  // Have not already accounted for worker.
     active_workers_[wid] = true;
     visited_tasks_.push_back(t);
+    if (!hash_gates_.empty()) {
+      // Any worker may send packets to any of the gates
+      for (gate_idx_t g : hash_gates_) {
+        bess::OGate *ogate = g < ogates().size() ? ogates()[g] : nullptr;
+        if (ogate) {
+          static_cast<Module *>(ogate->next())->AddActiveWorker(wid, t);
+        }
+      }
+      return;
+    }
     // Only propagate workers downstream on ogate mapped to `wid`
     int g = gates_[wid];
     bess::OGate *ogate = (g < 0) ? nullptr : ogates()[g];
@@ -86,4 +130,5 @@ void WorkerSplit::AddActiveWorker(int wid, const Task *t) {
 }
 
 ADD_MODULE(WorkerSplit, "ws",
-           "send packets to output gate X, the id of current worker")
+           "send packets to output gate X, the id of current worker, or split "
+           "them by flow hash")
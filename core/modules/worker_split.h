@@ -31,13 +31,17 @@
 #ifndef BESS_MODULES_WORKERSPLIT_H_
 #define BESS_MODULES_WORKERSPLIT_H_
 
+#include <vector>
+
 #include "../module.h"
 
 class WorkerSplit final : public Module {
  public:
   static const gate_idx_t kNumOGates = Worker::kMaxWorkers;
 
-  WorkerSplit() : Module(), gates_() { max_allowed_workers_ = kNumOGates; }
+  WorkerSplit() : Module(), gates_(), hash_gates_() {
+    max_allowed_workers_ = kNumOGates;
+  }
 
   static const Commands cmds;
 
@@ -50,7 +54,12 @@ class WorkerSplit final : public Module {
   void AddActiveWorker(int wid, const Task *task) override;
 
  private:
+  void ProcessBatchByHash(Context *ctx, bess::PacketBatch *batch);
+
   int gates_[Worker::kMaxWorkers];
+
+  // If not empty, packets are split over these gates by flow hash
+  std::vector<gate_idx_t> hash_gates_;
 };
 
 #endif  // BESS_MODULES_WORKERSPLIT_H_
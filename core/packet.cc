@@ -62,6 +62,36 @@ Packet *Packet::copy(const Packet *src) {
   return dst;
 }
 
+Packet *Packet::clone(Packet *src, uint16_t hdr_len) {
+  DCHECK(src->is_linear());
+
+  if (static_cast<uint32_t>(src->total_len()) <= hdr_len) {
+    return copy(src);  // nothing to share
+  }
+
+  Packet *segs[2];
+  if (rte_pktmbuf_alloc_bulk(src->pool_,
+                             reinterpret_cast<struct rte_mbuf **>(segs), 2)) {
+    return nullptr;  // FAIL.
+  }
+
+  Packet *head = segs[0];
+  Packet *tail = segs[1];
+
+  bess::utils::CopyInlined(head->append(hdr_len), src->head_data(), hdr_len,
+                           true);
+
+  // tail points to the data of src (takes a reference to it), minus the
+  // bytes already copied into head
+  rte_pktmbuf_attach(&tail->mbuf_, &src->mbuf_);
+  tail->adj(hdr_len);
+
+  int ret = rte_pktmbuf_chain(&head->mbuf_, &tail->mbuf_);
+  DCHECK_EQ(ret, 0);
+
+  return head;
+}
+
 // basically rte_hexdump() from eal_common_hexdump.c
 static std::string HexDump(const void *buffer, size_t len) {
   std::ostringstream dump;
@@ -162,12 +192,18 @@ void Packet::CheckSanity() {
   check_offset(data_off);
   check_offset(refcnt);
   check_offset(nb_segs);
+  check_offset(ol_flags);
   check_offset(rx_descriptor_fields1);
   check_offset(pkt_len);
   check_offset(data_len);
+  check_offset(vlan_tci);
+  static_assert(offsetof(Packet, rss_) == offsetof(rte_mbuf, hash.rss),
+                "Incompatibility detected between class Packet and struct "
+                "rte_mbuf");
   check_offset(buf_len);
   check_offset(pool);
   check_offset(next);
+  check_offset(tx_offload);
 
   // TODO: check runtime properties
 }
@@ -130,6 +130,27 @@ class alignas(64) Packet {
   int total_len() const { return pkt_len_; }
   void set_total_len(uint32_t len) { pkt_len_ = len; }
 
+  // Offload flags. On RX, PKT_RX_*_CKSUM_{GOOD,BAD} report the checksum
+  // verification result of the NIC. On TX, PKT_TX_* request the NIC (or the
+  // software fallback of the port driver) to fill in checksums.
+  uint64_t ol_flags() const { return ol_flags_; }
+  void set_ol_flags(uint64_t flags) { ol_flags_ = flags; }
+  void add_ol_flags(uint64_t flags) { ol_flags_ |= flags; }
+  void clear_ol_flags(uint64_t flags) { ol_flags_ &= ~flags; }
+
+  uint16_t vlan_tci() const { return vlan_tci_; }
+
+  // Flow hash computed by the NIC (e.g., Toeplitz over the 5-tuple). Only
+  // PMD ports with RSS provide it; see bess::utils::FlowHash() for a fallback.
+  bool has_rss_hash() const { return ol_flags_ & PKT_RX_RSS_HASH; }
+  uint32_t rss_hash() const { return rss_; }
+
+  uint16_t l2_len() const { return l2_len_; }
+  void set_l2_len(uint16_t len) { l2_len_ = len; }
+
+  uint16_t l3_len() const { return l3_len_; }
+  void set_l3_len(uint16_t len) { l3_len_ = len; }
+
   uint16_t headroom() const { return rte_pktmbuf_headroom(&mbuf_); }
 
   uint16_t tailroom() const { return rte_pktmbuf_tailroom(&mbuf_); }
@@ -180,6 +201,26 @@ class alignas(64) Packet {
   // Returns nullptr if memory allocation failed
   static Packet *copy(const Packet *src);
 
+  // Bytes copied into the private segment of a clone by default. Covers
+  // Ethernet/VLAN, IPv4/IPv6 and TCP headers with options.
+  static const uint16_t kCloneHeaderLen = 128;
+
+  // Like copy(), but only the first 'hdr_len' bytes of src are copied, into a
+  // private segment. It is followed by an indirect segment that references
+  // the rest of the data of src (so src is freed only after all of its clones
+  // are). The shared part must be treated as read-only by everyone. Packet
+  // metadata is not copied. Returns nullptr if memory allocation failed.
+  static Packet *clone(Packet *src, uint16_t hdr_len = kCloneHeaderLen);
+
+  // True if the data of this segment is shared with another packet
+  bool is_indirect() const { return RTE_MBUF_CLONED(&mbuf_); }
+
+  // Copies the data of all segments into the first one and frees the others,
+  // dropping any reference to data shared with other packets (see clone()).
+  // Returns false, leaving the packet intact, if the first segment is too
+  // small to hold it all.
+  bool linearize() { return rte_pktmbuf_linearize(&mbuf_) == 0; }
+
   phys_addr_t dma_addr() { return buf_physaddr_ + data_off_; }
 
   std::string Dump();
@@ -190,7 +231,8 @@ class alignas(64) Packet {
     return offset + offsetof(Packet, metadata_) - offsetof(Packet, headroom_);
   }
 
-  // pkt may be nullptr
+  // pkt may be nullptr. Segments shared with clones are released only when
+  // their last reference is gone.
   static void Free(Packet *pkt) {
     rte_pktmbuf_free(reinterpret_cast<struct rte_mbuf *>(pkt));
   }
@@ -226,7 +268,7 @@ class alignas(64) Packet {
           // offset 22:
           uint16_t _dummy0_;  // rte_mbuf.port
           // offset 24:
-          uint64_t _dummy1_;  // rte_mbuf.ol_flags
+          uint64_t ol_flags_;  // Offload features (PKT_RX_* / PKT_TX_*)
         };
       };
 
@@ -244,10 +286,10 @@ class alignas(64) Packet {
           uint16_t data_len_;  // Amount of data in this segment
 
           // offset 42:
-          uint16_t _dummy3_;  // rte_mbuf.vlan_tci
+          uint16_t vlan_tci_;  // VLAN TCI, valid if PKT_RX_VLAN_STRIPPED
 
           // offset 44:
-          uint32_t _dummy4_lo;  // rte_mbuf.fdir.lo and rte_mbuf.rss
+          uint32_t rss_;  // RSS hash, valid if PKT_RX_RSS_HASH
         };
       };
 
@@ -274,7 +316,15 @@ class alignas(64) Packet {
       Packet *next_;  // Next segment. nullptr if not scattered.
 
       // offset 88:
-      uint64_t _dummy8;   // rte_mbuf.tx_offload
+      union {
+        uint64_t tx_offload_;
+
+        struct {
+          uint64_t l2_len_ : 7;      // L2 header length for TX offloads
+          uint64_t l3_len_ : 9;      // L3 header length for TX offloads
+          uint64_t _dummy8 : 48;     // rte_mbuf.l4_len, tso_segsz, etc.
+        };
+      };
       uint16_t _dummy9;   // rte_mbuf.priv_size
       uint16_t _dummy10;  // rte_mbuf.timesync
       uint32_t _dummy11;  // rte_mbuf.seqn
@@ -0,0 +1,156 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "packet.h"
+
+#include <gtest/gtest.h>
+
+#include "packet_pool.h"
+
+namespace bess {
+namespace {
+
+class PacketCloneTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    src_ = pool_.Alloc(kLen);
+    ASSERT_NE(nullptr, src_);
+    for (int i = 0; i < kLen; i++) {
+      src_->head_data<uint8_t *>()[i] = i & 0xff;
+    }
+  }
+
+  static int refcnt(Packet *pkt) {
+    return rte_mbuf_refcnt_read(reinterpret_cast<struct rte_mbuf *>(pkt));
+  }
+
+  // Verifies that all segments of pkt together hold the pattern of src_
+  static void ExpectPattern(Packet *pkt) {
+    int off = 0;
+    for (Packet *seg = pkt; seg; seg = seg->next()) {
+      const uint8_t *data = seg->head_data<const uint8_t *>();
+      for (int i = 0; i < seg->head_len(); i++) {
+        ASSERT_EQ((off + i) & 0xff, data[i]);
+      }
+      off += seg->head_len();
+    }
+    EXPECT_EQ(kLen, off);
+  }
+
+  static constexpr int kLen = 1000;
+
+  PlainPacketPool pool_;
+  Packet *src_;
+};
+
+// Tests that a clone has a private header and shares the rest with src.
+TEST_F(PacketCloneTest, Clone) {
+  Packet *pkt = Packet::clone(src_, 64);
+  ASSERT_NE(nullptr, pkt);
+
+  EXPECT_EQ(kLen, pkt->total_len());
+  EXPECT_EQ(2, pkt->nb_segs());
+  EXPECT_EQ(64, pkt->head_len());
+  EXPECT_FALSE(pkt->is_indirect());
+  ASSERT_NE(nullptr, pkt->next());
+  EXPECT_TRUE(pkt->next()->is_indirect());
+  EXPECT_EQ(src_->head_data<uint8_t *>() + 64,
+            pkt->next()->head_data<uint8_t *>());
+  EXPECT_EQ(2, refcnt(src_));
+  ExpectPattern(pkt);
+
+  // The private part is not visible to src
+  pkt->head_data<uint8_t *>()[0] = 0xff;
+  EXPECT_EQ(0, src_->head_data<uint8_t *>()[0]);
+
+  Packet::Free(pkt);
+  EXPECT_EQ(1, refcnt(src_));
+  Packet::Free(src_);
+}
+
+// Tests that linearizing a clone copies the shared data into its first
+// segment and releases the reference to src.
+TEST_F(PacketCloneTest, Linearize) {
+  Packet *pkt = Packet::clone(src_, 64);
+  ASSERT_NE(nullptr, pkt);
+  ASSERT_EQ(2, pkt->nb_segs());
+  EXPECT_EQ(2, refcnt(src_));
+
+  ASSERT_TRUE(pkt->linearize());
+  EXPECT_EQ(1, pkt->nb_segs());
+  EXPECT_TRUE(pkt->is_simple());
+  EXPECT_EQ(nullptr, pkt->next());
+  EXPECT_EQ(kLen, pkt->total_len());
+  EXPECT_EQ(kLen, pkt->head_len());
+  EXPECT_EQ(1, refcnt(src_));
+  ExpectPattern(pkt);
+
+  Packet::Free(pkt);
+  Packet::Free(src_);
+}
+
+// Tests that packets shorter than the header are simply copied.
+TEST_F(PacketCloneTest, CloneShort) {
+  Packet *pkt = Packet::clone(src_, kLen);
+  ASSERT_NE(nullptr, pkt);
+
+  EXPECT_EQ(1, pkt->nb_segs());
+  EXPECT_TRUE(pkt->is_simple());
+  EXPECT_EQ(1, refcnt(src_));
+  ExpectPattern(pkt);
+
+  Packet::Free(pkt);
+  Packet::Free(src_);
+}
+
+// Tests that the shared data outlives src, and that every buffer goes back to
+// the pool once the last reference is dropped, whichever Free() is used.
+TEST_F(PacketCloneTest, FreeOrder) {
+  size_t avail = pool_.Size();
+
+  Packet *pkts[4];
+  for (Packet *&pkt : pkts) {
+    pkt = Packet::clone(src_);
+    ASSERT_NE(nullptr, pkt);
+  }
+  EXPECT_EQ(5, refcnt(src_));
+  EXPECT_EQ(avail - 8, pool_.Size());
+
+  Packet::Free(src_);
+  ExpectPattern(pkts[0]);
+  ExpectPattern(pkts[3]);
+
+  Packet::Free(pkts[0]);
+  Packet::Free(&pkts[1], 3);
+  EXPECT_EQ(avail + 1, pool_.Size());
+}
+
+}  // namespace
+}  // namespace bess
@@ -243,6 +243,16 @@ class Port {
   virtual int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) = 0;
   virtual int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) = 0;
 
+  // For idle workers (optional). Arms a notification for packets arriving on
+  // incoming queue 'qid' and returns a file descriptor that becomes readable
+  // then, or -1 if not supported. DisableRxNotification() is called once the
+  // worker has woken up. RxPending() is called after the notification is
+  // armed, and returns true if packets are already waiting on 'qid' that it
+  // may not report.
+  virtual int EnableRxNotification(queue_t) { return -1; }
+  virtual bool RxPending(queue_t) { return false; }
+  virtual void DisableRxNotification(queue_t) {}
+
   // For custom incoming / outgoing queue sizes (optional).
   virtual size_t DefaultIncQueueSize() const { return kDefaultIncQueueSize; }
   virtual size_t DefaultOutQueueSize() const { return kDefaultOutQueueSize; }
@@ -0,0 +1,60 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rcu.h"
+
+#include <x86intrin.h>
+
+namespace bess {
+namespace rcu {
+
+std::atomic<uint64_t> global_epoch;
+WorkerEpoch worker_epochs[Worker::kMaxWorkers];
+
+void Synchronize() {
+  uint64_t target = global_epoch.fetch_add(1) + 1;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    // A worker may only hold references while it is in its scheduling loop,
+    // i.e., running or about to pause. Never wait for ourselves.
+    if (wid == current_worker.wid()) {
+      continue;
+    }
+
+    while (workers[wid] && (workers[wid]->status() == WORKER_RUNNING ||
+                            workers[wid]->status() == WORKER_PAUSING) &&
+           !worker_epochs[wid].offline.load(std::memory_order_seq_cst) &&
+           worker_epochs[wid].value.load(std::memory_order_acquire) < target) {
+      _mm_pause();
+    }
+  }
+}
+
+}  // namespace rcu
+}  // namespace bess
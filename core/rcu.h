@@ -0,0 +1,158 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_RCU_H_
+#define BESS_RCU_H_
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "utils/common.h"
+#include "worker.h"
+
+namespace bess {
+namespace rcu {
+
+// A minimal quiescent-state-based reclamation (QSBR) scheme that lets the
+// control plane update tables read by the datapath without pausing workers.
+//
+// Each worker periodically announces that it holds no reference to any
+// RCU-protected data by copying the global epoch into its own slot (see
+// QuiescentState(), called from the scheduler loop). Synchronize() bumps the
+// global epoch and waits until every running worker has caught up, i.e.,
+// until no worker can still be looking at a version published before the
+// call. Workers sleeping in the idle mode of the scheduler are "offline" and
+// are not waited for.
+
+struct alignas(64) WorkerEpoch {
+  std::atomic<uint64_t> value;
+  std::atomic<bool> offline;
+};
+
+extern std::atomic<uint64_t> global_epoch;
+extern WorkerEpoch worker_epochs[Worker::kMaxWorkers];
+
+// Called by worker 'wid' between tasks, when it is not holding any reference.
+static inline void QuiescentState(int wid) {
+  worker_epochs[wid].value.store(global_epoch.load(std::memory_order_acquire),
+                                 std::memory_order_release);
+}
+
+// Called by worker 'wid' before it sleeps with no reference held (see
+// DefaultScheduler::Idle()). Synchronize() does not wait for offline workers.
+static inline void GoOffline(int wid) {
+  QuiescentState(wid);
+  worker_epochs[wid].offline.store(true, std::memory_order_seq_cst);
+}
+
+// Called by worker 'wid' after waking up, before it runs any task.
+static inline void GoOnline(int wid) {
+  // The seq_cst store must not be reordered with the loads of RCU-protected
+  // pointers that follow, or the worker could see a version that a concurrent
+  // Synchronize() has already considered unreferenced.
+  worker_epochs[wid].offline.store(false, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  QuiescentState(wid);
+}
+
+// Blocks the caller (a non-worker thread) until all running workers have
+// passed through a quiescent state. Returns immediately if no worker is
+// running.
+void Synchronize();
+
+// DoubleBuffer keeps two copies of a table: one visible to workers and a
+// standby one owned by the (single) control-plane writer. Update() applies a
+// change to the standby copy, publishes it, waits for the old copy to be
+// unreferenced, and then replays the same change on the old copy so both stay
+// identical. The change function must therefore be deterministic.
+//
+// Compared to copy-on-write, an update costs O(change) rather than O(table),
+// at the price of twice the memory.
+template <typename T>
+class DoubleBuffer {
+ public:
+  DoubleBuffer() : copies_(), active_(0) {}
+
+  // Datapath accessor. The reference stays valid until the next quiescent
+  // state of the calling worker.
+  const T &Get() const {
+    return copies_[active_.load(std::memory_order_acquire)];
+  }
+
+  // Control-plane accessor for the copy not visible to workers. Outside of
+  // Update() its contents are the same as Get().
+  T &Standby() { return copies_[active_.load(std::memory_order_relaxed) ^ 1]; }
+  const T &Standby() const {
+    return copies_[active_.load(std::memory_order_relaxed) ^ 1];
+  }
+
+  // Applies 'fn(T *)' to both copies and returns the result of the first
+  // application. Must not be called concurrently with itself.
+  template <typename F>
+  auto Update(F &&fn) -> decltype(fn(std::declval<T *>())) {
+    int standby = active_.load(std::memory_order_relaxed) ^ 1;
+
+    if constexpr (std::is_void<decltype(fn(std::declval<T *>()))>::value) {
+      fn(&copies_[standby]);
+      Publish(standby);
+      fn(&copies_[standby ^ 1]);
+    } else {
+      auto ret = fn(&copies_[standby]);
+      Publish(standby);
+      fn(&copies_[standby ^ 1]);
+      return ret;
+    }
+  }
+
+  // Applies 'fn(T *)' to both copies without synchronization. Only for use
+  // when no worker can be reading the table (e.g., Init() and DeInit()).
+  template <typename F>
+  void ForEach(F &&fn) {
+    fn(&copies_[0]);
+    fn(&copies_[1]);
+  }
+
+ private:
+  void Publish(int idx) {
+    active_.store(idx, std::memory_order_release);
+    Synchronize();
+  }
+
+  T copies_[2];
+  std::atomic<int> active_;
+
+  DISALLOW_COPY_AND_ASSIGN(DoubleBuffer);
+};
+
+}  // namespace rcu
+}  // namespace bess
+
+#endif  // BESS_RCU_H_
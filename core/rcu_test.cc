@@ -0,0 +1,91 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rcu.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace bess {
+namespace rcu {
+namespace {
+
+// With no running workers, Synchronize() must not block.
+TEST(RcuTest, SynchronizeWithoutWorkers) {
+  uint64_t before = global_epoch.load();
+  Synchronize();
+  EXPECT_EQ(before + 1, global_epoch.load());
+}
+
+// An offline worker has passed a quiescent state and is marked as such until
+// it comes back online.
+TEST(RcuTest, OfflineOnline) {
+  Synchronize();
+  GoOffline(0);
+  EXPECT_TRUE(worker_epochs[0].offline.load());
+  EXPECT_EQ(global_epoch.load(), worker_epochs[0].value.load());
+
+  Synchronize();
+  GoOnline(0);
+  EXPECT_FALSE(worker_epochs[0].offline.load());
+  EXPECT_EQ(global_epoch.load(), worker_epochs[0].value.load());
+}
+
+// Updates are applied to both copies and become visible through Get().
+TEST(RcuTest, DoubleBufferUpdate) {
+  DoubleBuffer<std::vector<int>> buf;
+  EXPECT_TRUE(buf.Get().empty());
+
+  size_t ret = buf.Update([](std::vector<int> *v) {
+    v->push_back(1);
+    return v->size();
+  });
+  EXPECT_EQ(1U, ret);
+  EXPECT_EQ(std::vector<int>({1}), buf.Get());
+  EXPECT_EQ(std::vector<int>({1}), buf.Standby());
+  EXPECT_NE(&buf.Get(), &buf.Standby());
+
+  const std::vector<int> *prev = &buf.Get();
+  buf.Update([](std::vector<int> *v) { v->push_back(2); });
+  EXPECT_NE(prev, &buf.Get());
+  EXPECT_EQ(std::vector<int>({1, 2}), buf.Get());
+  EXPECT_EQ(std::vector<int>({1, 2}), buf.Standby());
+}
+
+TEST(RcuTest, DoubleBufferForEach) {
+  DoubleBuffer<int> buf;
+  buf.ForEach([](int *x) { *x = 42; });
+  EXPECT_EQ(42, buf.Get());
+  EXPECT_EQ(42, buf.Standby());
+}
+
+}  // namespace
+}  // namespace rcu
+}  // namespace bess
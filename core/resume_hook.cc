@@ -35,6 +35,8 @@
 #include <string>
 #include <utility>
 
+#include "module_graph.h"
+
 namespace bess {
 
 std::set<std::unique_ptr<ResumeHook>, ResumeHook::UniquePtrLess>
@@ -71,6 +73,23 @@ void run_global_resume_hooks(bool run_modules) {
     hook->Run();
   }
 
+  // Gate hooks are not registered for events: visit every gate
+  auto notify = [](const Gate *g) {
+    if (g) {
+      for (GateHook *h : g->hooks()) {
+        h->OnEvent(Event::PreResume);
+      }
+    }
+  };
+  for (const auto &it : ModuleGraph::GetAllModules()) {
+    for (const IGate *g : it.second->igates()) {
+      notify(g);
+    }
+    for (const OGate *g : it.second->ogates()) {
+      notify(g);
+    }
+  }
+
   if (run_modules) {
     auto &resume_modules = event_modules[Event::PreResume];
     for (auto it = resume_modules.begin(); it != resume_modules.end();) {
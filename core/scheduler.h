@@ -31,12 +31,19 @@
 #ifndef BESS_SCHEDULER_H_
 #define BESS_SCHEDULER_H_
 
+#include <poll.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "module.h"
+#include "rcu.h"
+#include "steal_queue.h"
 #include "traffic_class.h"
 #include "utils/extended_priority_queue.h"
 #include "worker.h"
@@ -47,6 +54,13 @@ struct sched_stats {
   resource_arr_t usage;
   uint64_t cnt_idle;
   uint64_t cycles_idle;
+
+  // Idle mode of DefaultScheduler
+  uint64_t cnt_sleep;              // number of sleeps
+  uint64_t ns_sleep;               // total time spent sleeping
+  uint64_t cnt_sleep_notified;     // sleeps cut short by a task or a kick
+  uint64_t ns_wakeup_latency;      // total oversleep past the timeouts
+  uint64_t ns_wakeup_latency_max;  // worst oversleep past a timeout
 };
 
 class Scheduler;
@@ -72,6 +86,11 @@ class SchedWakeupQueue {
     q_.delete_single_element(del_pred);
   }
 
+  // Returns the earliest wakeup time (in TSC), or UINT64_MAX if none.
+  uint64_t earliest() const {
+    return q_.empty() ? UINT64_MAX : q_.top()->wakeup_time();
+  }
+
  private:
   friend class Scheduler;
 
@@ -177,6 +196,8 @@ class Scheduler {
   // For testing
   SchedWakeupQueue &wakeup_queue() { return wakeup_queue_; }
 
+  const struct sched_stats &stats() const { return stats_; }
+
   // Selects the next TrafficClass to run.
   LeafTrafficClass *Next(uint64_t tsc) {
     WakeTCs(tsc);
@@ -199,6 +220,38 @@ class Scheduler {
   // towards the root.
   void UnblockTowardsRoot(TrafficClass *c, uint64_t tsc);
 
+  // Runs a batch stolen from another worker, or all batches offloaded by the
+  // tasks of this worker if 'drain' (see StealQueue). Returns true if any
+  // packet was processed.
+  bool RunStolen(Context *ctx, bool drain) {
+    ctx->current_tsc = this->checkpoint_;
+    ctx->current_ns = this->checkpoint_ * this->ns_per_cycle_;
+    current_worker.set_current_tsc(ctx->current_tsc);
+    current_worker.set_current_ns(ctx->current_ns);
+
+    uint32_t cnt = drain ? StealQueue::Drain(ctx) : StealQueue::Steal(ctx);
+    if (cnt) {
+      this->checkpoint_ = rdtsc();
+    }
+    return cnt > 0;
+  }
+
+  // Runs the polls of modules that process packets handed over by other
+  // workers (see StealQueue::SetPolled()). Returns true if any packet was
+  // processed.
+  bool RunPolls(Context *ctx) {
+    ctx->current_tsc = this->checkpoint_;
+    ctx->current_ns = this->checkpoint_ * this->ns_per_cycle_;
+    current_worker.set_current_tsc(ctx->current_tsc);
+    current_worker.set_current_ns(ctx->current_ns);
+
+    uint32_t cnt = StealQueue::Poll(ctx);
+    if (cnt) {
+      this->checkpoint_ = rdtsc();
+    }
+    return cnt > 0;
+  }
+
   TrafficClass *root_;
 
   RoundRobinTrafficClass *default_rr_class_;
@@ -219,10 +272,30 @@ class Scheduler {
 // and runs the corresponding task.
 class DefaultScheduler : public Scheduler {
  public:
-  explicit DefaultScheduler(TrafficClass *root = nullptr) : Scheduler(root) {}
+  explicit DefaultScheduler(TrafficClass *root = nullptr)
+      : Scheduler(root),
+        idle_(),
+        idle_threshold_(UINT64_MAX),
+        idle_rounds_(),
+        stealing_(),
+        sleep_ns_(),
+        leaves_(),
+        pollfds_(),
+        armed_() {}
 
   virtual ~DefaultScheduler() {}
 
+  // Shortest sleep of the idle mode. It doubles with every consecutive sleep
+  // that ends without any packet processed, up to IdleConfig::max_sleep_ns.
+  static constexpr uint64_t kMinSleepNs = 1000;
+
+  // Must be called before the worker starts.
+  void set_idle_config(const IdleConfig &idle) {
+    idle_ = idle;
+    idle_.max_sleep_ns = std::max(idle_.max_sleep_ns, kMinSleepNs);
+    idle_threshold_ = idle_.rounds ? idle_.rounds : UINT64_MAX;
+  }
+
   // Runs the scheduler loop forever.
   void ScheduleLoop() override {
     uint64_t now;
@@ -236,14 +309,32 @@ class DefaultScheduler : public Scheduler {
     Context ctx = {};
     ctx.wid = current_worker.wid();
 
+    if (idle_.rounds) {
+      // The default 50us timer slack would dominate short sleeps
+      prctl(PR_SET_TIMERSLACK, 1UL);
+      CollectLeaves();
+    }
+
     // The main scheduling, running, accounting loop.
     for (uint64_t round = 0;; ++round) {
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
+        // Batches offloaded by our tasks may not have been stolen
+        this->RunStolen(&ctx, true);
+
+        // No task is running, so no RCU-protected data can be referenced.
+        rcu::QuiescentState(ctx.wid);
+
         if (current_worker.is_pause_requested()) {
+          SetStealing(false);
           if (current_worker.BlockWorker()) {
             break;
           }
+
+          // Tasks may have been added or removed while paused
+          if (idle_.rounds) {
+            CollectLeaves();
+          }
         }
       }
 
@@ -285,20 +376,178 @@ class DefaultScheduler : public Scheduler {
 
       leaf->FinishAndAccountTowardsRoot(&this->wakeup_queue_, nullptr, usage,
                                         now);
+
+      if (ret.packets) {
+        idle_rounds_ = 0;
+        sleep_ns_ = 0;
+        SetStealing(false);
+      } else {
+        ++idle_rounds_;
+      }
     } else {
-      // TODO(barath): Ideally, we wouldn't spin in this case but rather take
-      // the fact that Next() returned nullptr as an indication that everything
-      // is blocked, so we could wait until something is added that unblocks us.
-      // We currently have no functionality to support such whole-scheduler
-      // blocking/unblocking.
+      // Everything is blocked. Unless the idle mode is enabled, we spin until
+      // the earliest blocked traffic class wakes up.
       ++this->stats_.cnt_idle;
+      ++idle_rounds_;
 
       now = rdtsc();
       this->stats_.cycles_idle += (now - this->checkpoint_);
     }
 
     this->checkpoint_ = now;
+
+    if (unlikely(StealQueue::polling()) && this->RunPolls(ctx)) {
+      idle_rounds_ = 0;
+      sleep_ns_ = 0;
+      SetStealing(false);
+      return;
+    }
+
+    if (idle_rounds_ >= StealQueue::kIdleRounds && StealQueue::Get(ctx->wid)) {
+      SetStealing(true);
+      if (this->RunStolen(ctx, false)) {
+        return;
+      }
+    }
+
+    if (idle_rounds_ >= idle_threshold_) {
+      Idle();
+    }
+  }
+
+ private:
+  // Puts the worker to sleep until one of its tasks has new work to do, a
+  // blocked traffic class is due, the sleep times out, or the worker is
+  // kicked (e.g., to be paused).
+  void Idle() {
+    if (current_worker.is_pause_requested()) {
+      // Let ScheduleLoop() handle it
+      return;
+    }
+
+    sleep_ns_ = sleep_ns_ ? std::min(sleep_ns_ * 2, idle_.max_sleep_ns)
+                          : kMinSleepNs;
+
+    uint64_t timeout_ns = sleep_ns_;
+    uint64_t wakeup_tsc = this->wakeup_queue_.earliest();
+    if (wakeup_tsc != UINT64_MAX) {
+      if (wakeup_tsc <= this->checkpoint_) {
+        return;
+      }
+      timeout_ns = std::min<uint64_t>(
+          timeout_ns, (wakeup_tsc - this->checkpoint_) * this->ns_per_cycle_);
+    }
+
+    pollfds_.clear();
+    armed_.clear();
+    pollfds_.push_back({current_worker.fd_idle(), POLLIN, 0});
+    for (LeafTrafficClass *leaf : leaves_) {
+      Task *t = leaf->task();
+      int fd = t->module()->ArmIdleWakeup(t->arg());
+      if (fd >= 0) {
+        pollfds_.push_back({fd, POLLIN, 0});
+        armed_.push_back(t);
+      }
+    }
+
+    // Work that came in after a task last ran, but before its notification
+    // was armed, may never be notified. Poll once more before sleeping.
+    for (Task *t : armed_) {
+      if (t->module()->HasIdleWork(t->arg())) {
+        for (Task *armed : armed_) {
+          armed->module()->DisarmIdleWakeup(armed->arg());
+        }
+        sleep_ns_ = 0;
+        idle_rounds_ = idle_threshold_ - std::min<uint64_t>(idle_threshold_,
+                                                            leaves_.size());
+        return;
+      }
+    }
+
+    // We cannot steal while sleeping
+    SetStealing(false);
+
+    struct timespec ts = {
+        .tv_sec = static_cast<time_t>(timeout_ns / 1000000000),
+        .tv_nsec = static_cast<long>(timeout_ns % 1000000000)};
+
+    int wid = current_worker.wid();
+    rcu::GoOffline(wid);
+    uint64_t start = rdtsc();
+    int ret = ppoll(pollfds_.data(), pollfds_.size(), &ts, nullptr);
+    uint64_t end = rdtsc();
+    rcu::GoOnline(wid);
+
+    if (pollfds_[0].revents & POLLIN) {
+      uint64_t cnt;
+      [[maybe_unused]] ssize_t r = read(pollfds_[0].fd, &cnt, sizeof(cnt));
+    }
+
+    for (Task *t : armed_) {
+      t->module()->DisarmIdleWakeup(t->arg());
+    }
+
+    uint64_t slept_ns = (end - start) * this->ns_per_cycle_;
+    this->stats_.cnt_sleep++;
+    this->stats_.ns_sleep += slept_ns;
+    if (ret > 0) {
+      this->stats_.cnt_sleep_notified++;
+      sleep_ns_ = 0;
+    } else if (ret == 0 && slept_ns > timeout_ns) {
+      uint64_t latency_ns = slept_ns - timeout_ns;
+      this->stats_.ns_wakeup_latency += latency_ns;
+      this->stats_.ns_wakeup_latency_max =
+          std::max(this->stats_.ns_wakeup_latency_max, latency_ns);
+    }
+
+    // Give every task one more chance before sleeping again
+    idle_rounds_ = idle_threshold_ - std::min<uint64_t>(idle_threshold_,
+                                                        leaves_.size());
+    this->checkpoint_ = rdtsc();
   }
+
+  // Marks this worker as available for work stealing, or not.
+  void SetStealing(bool stealing) {
+    if (stealing_ != stealing) {
+      StealQueue::SetIdle(current_worker.wid(), stealing);
+      stealing_ = stealing;
+    }
+  }
+
+  void CollectLeaves() {
+    leaves_.clear();
+    if (this->root_) {
+      CollectLeaves(this->root_);
+    }
+  }
+
+  void CollectLeaves(TrafficClass *c) {
+    if (c->policy() == POLICY_LEAF) {
+      leaves_.push_back(static_cast<LeafTrafficClass *>(c));
+      return;
+    }
+    for (TrafficClass *child : c->Children()) {
+      CollectLeaves(child);
+    }
+  }
+
+  IdleConfig idle_;
+
+  // idle_.rounds, or UINT64_MAX if the idle mode is disabled
+  uint64_t idle_threshold_;
+
+  // Consecutive scheduling rounds without any packet
+  uint64_t idle_rounds_;
+
+  // Whether this worker is marked as idle for StealQueue
+  bool stealing_;
+
+  // Duration of the last sleep (0 if there was work since then)
+  uint64_t sleep_ns_;
+
+  std::vector<LeafTrafficClass *> leaves_;
+  std::vector<struct pollfd> pollfds_;
+  std::vector<Task *> armed_;
 };
 
 class ExperimentalScheduler : public Scheduler {
@@ -327,6 +576,12 @@ class ExperimentalScheduler : public Scheduler {
     for (uint64_t round = 0;; ++round) {
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
+        // Batches offloaded by our tasks may not have been stolen
+        this->RunStolen(&ctx, true);
+
+        // No task is running, so no RCU-protected data can be referenced.
+        rcu::QuiescentState(ctx.wid);
+
         if (current_worker.is_pause_requested()) {
           if (current_worker.BlockWorker()) {
             break;
@@ -391,6 +646,10 @@ class ExperimentalScheduler : public Scheduler {
     }
 
     this->checkpoint_ = now;
+
+    if (unlikely(StealQueue::polling())) {
+      this->RunPolls(ctx);
+    }
   }
 };
 
@@ -0,0 +1,307 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "steal_queue.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+namespace bess {
+
+std::atomic<StealQueue *> StealQueue::queues_[Worker::kMaxWorkers];
+std::atomic<uint64_t> StealQueue::idle_workers_;
+std::atomic<uint64_t> StealQueue::nonempty_;
+uint32_t StealQueue::gate_cnt_;
+std::set<Module *> StealQueue::sources_;
+std::vector<Module *> StealQueue::polled_;
+
+static struct llring *AllocRing(uint32_t slots) {
+  struct llring *ring = reinterpret_cast<struct llring *>(
+      std::aligned_alloc(alignof(llring), llring_bytes_with_slots(slots)));
+  CHECK(ring);
+  CHECK_EQ(llring_init(ring, slots, 0, 0), 0);
+  return ring;
+}
+
+StealQueue::StealQueue(int wid, int socket)
+    : ready_(AllocRing(kSlots * 2)),  // llring holds one less than its slots
+      free_(AllocRing(kSlots * 2)),
+      items_(new Item[kSlots]),
+      wid_(wid),
+      socket_(socket),
+      task_(nullptr, nullptr),
+      pushed_(),
+      stolen_() {
+  for (uint32_t i = 0; i < kSlots; i++) {
+    CHECK_EQ(llring_mp_enqueue(free_, &items_[i]), 0);
+  }
+  if (gate_cnt_) {
+    task_.UpdatePerGateBatch(gate_cnt_);
+  }
+}
+
+StealQueue::~StealQueue() {
+  Item *item;
+  while (llring_mc_dequeue(ready_, reinterpret_cast<void **>(&item)) == 0) {
+    bess::Packet::Free(&item->batch);
+  }
+
+  std::free(ready_);
+  std::free(free_);
+  delete[] items_;
+}
+
+bool StealQueue::Push(Module *m, uint64_t workers, PacketBatch *batch) {
+  Item *item;
+  if (llring_sc_dequeue(free_, reinterpret_cast<void **>(&item)) != 0) {
+    return false;
+  }
+
+  item->module = m;
+  item->workers = workers;
+  item->batch.Copy(batch);
+  batch->clear();
+
+  // Cannot fail, as there are fewer items than slots
+  llring_mp_enqueue(ready_, item);
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+
+  // Ordered after the enqueue, see Steal()
+  nonempty_.fetch_or(1ull << wid_);
+  return true;
+}
+
+StealQueue::Item *StealQueue::Pop() {
+  Item *item;
+  if (llring_mc_dequeue(ready_, reinterpret_cast<void **>(&item)) != 0) {
+    return nullptr;
+  }
+  return item;
+}
+
+void StealQueue::PutBack(Item *item) {
+  llring_mp_enqueue(ready_, item);
+}
+
+void StealQueue::Release(Item *item) {
+  llring_mp_enqueue(free_, item);
+}
+
+void StealQueue::Init(int wid, int socket) {
+  StealQueue *q = Get(wid);
+  if (q) {
+    // The worker may have been relaunched on another core
+    q->socket_ = socket;
+  } else {
+    queues_[wid].store(new StealQueue(wid, socket), std::memory_order_release);
+  }
+}
+
+void StealQueue::SetSource(Module *m, bool enabled) {
+  if (enabled) {
+    sources_.insert(m);
+  } else {
+    sources_.erase(m);
+  }
+}
+
+uint64_t StealQueue::EligibleWorkers(const Module *m) {
+  const auto &ogates = m->ogates();
+  if (ogates.empty() || !ogates[0]) {
+    return 0;
+  }
+
+  std::unordered_set<const Module *> visited;
+  if (!static_cast<Module *>(ogates[0]->next())->AllowsAnyWorker(&visited)) {
+    return 0;
+  }
+
+  visited.clear();
+  placement_constraint sockets = m->ComputePlacementConstraints(&visited);
+
+  uint64_t mask = 0;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (workers[wid] && (sockets & (1ull << workers[wid]->socket()))) {
+      mask |= 1ull << wid;
+    }
+  }
+  return mask;
+}
+
+void StealQueue::PropagateActiveWorkers() {
+  for (Module *m : sources_) {
+    // Nothing is offloaded by a task module that no worker runs
+    uint64_t mask = m->num_active_workers() ? EligibleWorkers(m) : 0;
+
+    for (; mask; mask &= mask - 1) {
+      int wid = __builtin_ctzll(mask);
+      StealQueue *q = Get(wid);
+      if (q) {
+        auto next = static_cast<Module *>(m->ogates()[0]->next());
+        next->AddActiveWorker(wid, &q->task_);
+      }
+    }
+  }
+}
+
+uint64_t StealQueue::StealableWorkers(const Module *m) {
+  uint64_t mask = EligibleWorkers(m);
+  if (!mask) {
+    return 0;
+  }
+
+  // Workers that were not propagated downstream (e.g., if the pipeline was
+  // resumed without checking constraints) have no per-worker state there.
+  std::unordered_set<const Module *> visited;
+  auto next = static_cast<Module *>(m->ogates()[0]->next());
+  return mask & next->CommonActiveWorkers(&visited);
+}
+
+uint32_t StealQueue::Run(Context *ctx, Item *item) {
+  uint32_t cnt = item->batch.cnt();
+
+  ctx->task = &task_;
+  ctx->silent_drops = 0;
+  task_.RunBatch(ctx, item->module, &item->batch);
+  current_worker.incr_silent_drops(ctx->silent_drops);
+
+  return cnt;
+}
+
+uint32_t StealQueue::Steal(Context *ctx) {
+  StealQueue *self = Get(ctx->wid);
+  uint64_t nonempty = nonempty_.load(std::memory_order_relaxed);
+  if (!self || !nonempty) {
+    return 0;
+  }
+
+  // Own queue first, then workers on the same socket, then the rest
+  uint64_t local = 0;
+  for (uint64_t mask = nonempty; mask; mask &= mask - 1) {
+    int wid = __builtin_ctzll(mask);
+    StealQueue *q = Get(wid);
+    if (q && q->socket_ == self->socket_) {
+      local |= 1ull << wid;
+    }
+  }
+
+  uint64_t candidates[] = {nonempty & (1ull << ctx->wid),
+                           local & ~(1ull << ctx->wid), nonempty & ~local};
+  for (uint64_t mask : candidates) {
+    for (; mask; mask &= mask - 1) {
+      int wid = __builtin_ctzll(mask);
+      StealQueue *q = Get(wid);
+      if (!q) {
+        continue;
+      }
+
+      Item *item = q->Pop();
+      if (!item) {
+        // Pairs with the fetch_or() in Push(): either we see a batch pushed
+        // after this, or its owner sets the bit again.
+        nonempty_.fetch_and(~(1ull << wid));
+        if (!q->empty()) {
+          nonempty_.fetch_or(1ull << wid);
+        }
+        continue;
+      }
+
+      // The owner runs the task module, so it can run anything downstream
+      if (q != self && !(item->workers & (1ull << ctx->wid))) {
+        q->PutBack(item);
+        continue;
+      }
+
+      if (q != self) {
+        q->stolen_.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      uint32_t cnt = self->Run(ctx, item);
+      q->Release(item);
+      return cnt;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t StealQueue::Drain(Context *ctx) {
+  StealQueue *self = Get(ctx->wid);
+  if (!self || self->empty()) {
+    return 0;
+  }
+
+  uint32_t cnt = 0;
+  Item *item;
+  while ((item = self->Pop())) {
+    cnt += self->Run(ctx, item);
+    self->Release(item);
+  }
+  return cnt;
+}
+
+void StealQueue::SetPolled(Module *m, bool enabled) {
+  auto it = std::find(polled_.begin(), polled_.end(), m);
+  if (enabled && it == polled_.end()) {
+    polled_.push_back(m);
+  } else if (!enabled && it != polled_.end()) {
+    polled_.erase(it);
+  }
+}
+
+uint32_t StealQueue::Poll(Context *ctx) {
+  StealQueue *self = Get(ctx->wid);
+  if (!self) {
+    return 0;
+  }
+
+  uint32_t cnt = 0;
+  ctx->task = &self->task_;
+  ctx->silent_drops = 0;
+  for (Module *m : polled_) {
+    cnt += self->task_.RunPoll(ctx, m);
+  }
+  current_worker.incr_silent_drops(ctx->silent_drops);
+
+  return cnt;
+}
+
+void StealQueue::UpdatePerGateBatch(uint32_t gate_cnt) {
+  gate_cnt_ = gate_cnt;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    StealQueue *q = Get(wid);
+    if (q) {
+      q->task_.UpdatePerGateBatch(gate_cnt);
+    }
+  }
+}
+
+}  // namespace bess
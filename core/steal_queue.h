@@ -0,0 +1,229 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_STEAL_QUEUE_H_
+#define BESS_STEAL_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "kmod/llring.h"
+#include "module.h"
+#include "pktbatch.h"
+#include "task.h"
+#include "worker.h"
+
+namespace bess {
+
+// Work stealing of packet batches across workers.
+//
+// Tasks are bound to a single worker, so an overloaded worker can drop
+// packets while others are idle. A task module that opts in (Queue and
+// PortInc with the "steal" option) may instead hand a ready batch over to the
+// StealQueue of its worker while it is backlogged and some other worker is
+// idle. Idle workers (see DefaultScheduler) steal batches, preferring workers
+// on their own NUMA node, and run them through output gate 0 of the module
+// that offloaded them.
+//
+// This is only allowed if every module downstream can run on any worker (see
+// StealableWorkers()), and batches are only run on workers whose socket
+// satisfies the placement constraints of the pipeline. Those workers are
+// added to the active workers of the downstream modules (see
+// PropagateActiveWorkers()), so that per-worker state such as TX queues is
+// set up for them on PreResume. A worker drains its own queue periodically
+// and before pausing, so that no batch is left behind while the pipeline is
+// being modified.
+//
+// Consecutive batches of a flow may be processed by different workers at the
+// same time, so packets can be reordered within a flow. This is why stealing
+// is opt-in for each task module.
+//
+// The same per-worker task also runs Module::Poll() of the modules that need
+// to process packets handed over by other workers (see SetPolled()).
+class StealQueue {
+ public:
+  // Maximum number of batches in flight per worker
+  static constexpr uint32_t kSlots = 64;
+
+  // A worker is considered idle after this many scheduling rounds without
+  // any packet.
+  static constexpr uint64_t kIdleRounds = 4;
+
+  struct Item {
+    Module *module;    // the batch continues from its ogate 0
+    uint64_t workers;  // workers allowed to run the batch
+    PacketBatch batch;
+  };
+
+  StealQueue(int wid, int socket);
+  ~StealQueue();
+
+  // Moves the packets of 'batch' into the queue. Returns false if it is full.
+  // Only the owner worker may push.
+  bool Push(Module *m, uint64_t workers, PacketBatch *batch);
+
+  // Dequeues the oldest batch, or returns nullptr if the queue is empty. The
+  // caller must either PutBack() the item or Release() it once processed.
+  Item *Pop();
+
+  // Returns an item that the caller is not allowed to run back to the queue.
+  void PutBack(Item *item);
+
+  // Recycles an item whose batch has been processed.
+  void Release(Item *item);
+
+  bool empty() const { return llring_empty(ready_); }
+  int socket() const { return socket_; }
+
+  // Number of batches pushed to this queue, and taken by other workers
+  uint64_t pushed() const { return pushed_.load(std::memory_order_relaxed); }
+  uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+  // Creates the queue of worker 'wid', if it does not exist yet. Queues are
+  // never freed, as other workers may be stealing from them at any time.
+  static void Init(int wid, int socket);
+
+  // Returns the queue of worker 'wid', or nullptr if not created.
+  static StealQueue *Get(int wid) {
+    return queues_[wid].load(std::memory_order_acquire);
+  }
+
+  // Registers 'm' as a task module that may offload batches, or unregisters
+  // it. Must be called from the control thread.
+  static void SetSource(Module *m, bool enabled);
+
+  // Adds the workers that may run batches offloaded by each registered task
+  // module to the active workers of its downstream modules. Called by
+  // ModuleGraph::PropagateActiveWorker().
+  static void PropagateActiveWorkers();
+
+  // Returns the bitmask of workers allowed to run batches offloaded by 'm'.
+  // Returns 0 if any module downstream of 'm' must not run on arbitrary
+  // workers. Only workers that are active in every downstream module are
+  // returned. Must be called with all workers paused (e.g., on
+  // Event::PreResume).
+  static uint64_t StealableWorkers(const Module *m);
+
+  // Called by a backlogged task module instead of RunNextModule(): hands
+  // 'batch' over to the queue of the current worker if any worker in
+  // 'workers' (see StealableWorkers()) is idle. Returns false if the caller
+  // must process the batch itself.
+  static bool Offload(Context *ctx, Module *m, uint64_t workers,
+                      PacketBatch *batch);
+
+  // Scheduler interface: marks worker 'wid' as idle (i.e., willing to steal)
+  // or not.
+  static void SetIdle(int wid, bool idle) {
+    if (idle) {
+      idle_workers_.fetch_or(1ull << wid);
+    } else {
+      idle_workers_.fetch_and(~(1ull << wid));
+    }
+  }
+
+  // Scheduler interface: runs a single batch, taken from the current worker's
+  // own queue first, then from workers on the same socket, then from the
+  // rest. Returns the number of packets processed.
+  static uint32_t Steal(Context *ctx);
+
+  // Scheduler interface: runs all batches in the current worker's own queue.
+  static uint32_t Drain(Context *ctx);
+
+  // Registers 'm' to have its Module::Poll() called by every worker on each
+  // scheduling round, or unregisters it. Must be called with all workers
+  // paused.
+  static void SetPolled(Module *m, bool enabled);
+
+  // True if any module is registered with SetPolled()
+  static bool polling() { return !polled_.empty(); }
+
+  // Scheduler interface: calls Module::Poll() of the registered modules on
+  // the current worker. Returns the number of packets processed.
+  static uint32_t Poll(Context *ctx);
+
+  // Adjusts the per-gate batch tables of the tasks that run stolen batches
+  // (see Task::UpdatePerGateBatch()).
+  static void UpdatePerGateBatch(uint32_t gate_cnt);
+
+ private:
+  // Workers whose socket satisfies the placement constraints of the
+  // pipeline downstream of 'm', regardless of whether they are active there
+  static uint64_t EligibleWorkers(const Module *m);
+
+  // Runs 'item' on the current worker with the task of this queue
+  uint32_t Run(Context *ctx, Item *item);
+
+  struct llring *ready_;  // batches to be processed
+  struct llring *free_;   // recycled items
+  Item *items_;
+  const int wid_;
+  int socket_;
+
+  // Runs batches on the worker that owns this queue, whichever queue they
+  // were taken from
+  Task task_;
+
+  std::atomic<uint64_t> pushed_;
+  std::atomic<uint64_t> stolen_;
+
+  static std::atomic<StealQueue *> queues_[Worker::kMaxWorkers];
+
+  // Bitmask of idle workers, and of workers with a non-empty queue
+  static std::atomic<uint64_t> idle_workers_;
+  static std::atomic<uint64_t> nonempty_;
+
+  static uint32_t gate_cnt_;
+
+  // Task modules with stealing enabled
+  static std::set<Module *> sources_;
+
+  // Modules registered with SetPolled()
+  static std::vector<Module *> polled_;
+
+  DISALLOW_COPY_AND_ASSIGN(StealQueue);
+};
+
+inline bool StealQueue::Offload(Context *ctx, Module *m, uint64_t workers,
+                                PacketBatch *batch) {
+  uint64_t idle = idle_workers_.load(std::memory_order_relaxed) & workers &
+                  ~(1ull << ctx->wid);
+  if (!idle) {
+    return false;
+  }
+
+  StealQueue *q = Get(ctx->wid);
+  return q && q->Push(m, workers, batch);
+}
+
+}  // namespace bess
+
+#endif  // BESS_STEAL_QUEUE_H_
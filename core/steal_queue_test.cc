@@ -0,0 +1,109 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "steal_queue.h"
+
+#include <gtest/gtest.h>
+
+namespace bess {
+namespace {
+
+// Never dereferenced
+Module *const kModule = reinterpret_cast<Module *>(0x1234);
+
+bess::Packet *FakePacket(uintptr_t i) {
+  return reinterpret_cast<bess::Packet *>(i);
+}
+
+// Batches come out in order, with their origin, and the queue holds up to
+// kSlots of them.
+TEST(StealQueueTest, PushPop) {
+  StealQueue q(0, 0);
+  PacketBatch batch;
+
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(nullptr, q.Pop());
+
+  for (uint32_t i = 0; i < StealQueue::kSlots; i++) {
+    batch.clear();
+    batch.add(FakePacket(i + 1));
+    ASSERT_TRUE(q.Push(kModule, 1, &batch));
+    EXPECT_EQ(0, batch.cnt());
+  }
+
+  batch.add(FakePacket(1000));
+  EXPECT_FALSE(q.Push(kModule, 1, &batch));
+  EXPECT_EQ(1, batch.cnt());
+  EXPECT_EQ(StealQueue::kSlots, q.pushed());
+
+  for (uint32_t i = 0; i < StealQueue::kSlots; i++) {
+    StealQueue::Item *item = q.Pop();
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(kModule, item->module);
+    EXPECT_EQ(1, item->workers);
+    ASSERT_EQ(1, item->batch.cnt());
+    EXPECT_EQ(FakePacket(i + 1), item->batch.pkts()[0]);
+    q.Release(item);
+  }
+
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(0, q.stolen());
+}
+
+// Items that are put back can be taken again, and released items are reused.
+TEST(StealQueueTest, PutBackRelease) {
+  StealQueue q(0, 0);
+  PacketBatch batch;
+
+  batch.add(FakePacket(1));
+  ASSERT_TRUE(q.Push(kModule, 2, &batch));
+
+  StealQueue::Item *item = q.Pop();
+  ASSERT_NE(nullptr, item);
+  EXPECT_TRUE(q.empty());
+
+  q.PutBack(item);
+  EXPECT_FALSE(q.empty());
+  EXPECT_EQ(item, q.Pop());
+  q.Release(item);
+
+  for (int i = 0; i < 1000; i++) {
+    batch.clear();
+    batch.add(FakePacket(i + 1));
+    ASSERT_TRUE(q.Push(kModule, 2, &batch));
+    item = q.Pop();
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(FakePacket(i + 1), item->batch.pkts()[0]);
+    q.Release(item);
+  }
+}
+
+}  // namespace
+}  // namespace bess
@@ -34,6 +34,7 @@
 
 #include "gate.h"
 #include "module.h"
+#include "utils/time.h"
 
 // Called when the leaf that owns this task is destroyed.
 void Task::Detach() {
@@ -50,7 +51,36 @@ struct task_result Task::operator()(Context *ctx) const {
   ClearPacketBatch();
 
   // Start from the first module (task module)
-  struct task_result result = module_->RunTask(ctx, &init_batch, arg_);
+  struct task_result result;
+  if (unlikely(Module::profiling())) {
+    uint64_t start = rdtsc();
+    result = module_->RunTask(ctx, &init_batch, arg_);
+    module_->AddProfile(ctx->wid, rdtsc() - start, result.packets);
+  } else {
+    result = module_->RunTask(ctx, &init_batch, arg_);
+  }
+  RunGates(ctx);
+
+  return result;
+}
+
+void Task::RunBatch(Context *ctx, Module *m, bess::PacketBatch *batch) const {
+  ClearPacketBatch();
+
+  m->RunNextModule(ctx, batch);
+  RunGates(ctx);
+}
+
+uint32_t Task::RunPoll(Context *ctx, Module *m) const {
+  ClearPacketBatch();
+
+  uint32_t cnt = m->Poll(ctx);
+  m->ProcessOGates(ctx);
+  RunGates(ctx);
+  return cnt;
+}
+
+void Task::RunGates(Context *ctx) const {
   // next_gate_: Continuously run if modules are chained
   // igates_to_run_ : If next module connection is not chained (merged),
   // check priority to choose which module run next
@@ -81,13 +111,18 @@ struct task_result Task::operator()(Context *ctx) const {
     }
 
     Module *m = igate->module();
-    m->ProcessBatch(ctx, batch);  // process module
-    m->ProcessOGates(ctx);        // process ogates
+    if (unlikely(Module::profiling())) {
+      int cnt = batch->cnt();  // the module may modify the batch
+      uint64_t start = rdtsc();
+      m->ProcessBatch(ctx, batch);
+      m->AddProfile(ctx->wid, rdtsc() - start, cnt);
+    } else {
+      m->ProcessBatch(ctx, batch);  // process module
+    }
+    m->ProcessOGates(ctx);  // process ogates
   }
 
   deadend(ctx, &dead_batch_);
-
-  return result;
 }
 
 // Compute constraints for the pipeline starting at this task.
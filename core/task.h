@@ -93,6 +93,9 @@ class Task {
 
   mutable std::vector<bess::PacketBatch *> gate_batch_;
 
+  // Runs the modules queued with AddToRun(), until there is none left.
+  void RunGates(Context *ctx) const;
+
  public:
   // When this task is scheduled it will execute 'm' with 'arg'.  When the
   // associated leaf is created/destroyed, 'module_task' will be updated.
@@ -155,6 +158,8 @@ class Task {
 
   Module *module() const { return module_; }
 
+  void *arg() const { return arg_; }
+
   bess::PacketBatch *dead_batch() const { return &dead_batch_; }
 
   bess::PacketBatch *get_gate_batch(bess::Gate *gate) const {
@@ -169,6 +174,14 @@ class Task {
 
   struct task_result operator()(Context *ctx) const;
 
+  // Runs 'batch' through output gate 0 of 'm' and everything downstream, on
+  // behalf of another task (see bess::StealQueue). 'ctx->task' must be this.
+  void RunBatch(Context *ctx, Module *m, bess::PacketBatch *batch) const;
+
+  // Calls m->Poll() and runs everything downstream of it, on behalf of no
+  // particular task (see bess::StealQueue). 'ctx->task' must be this.
+  uint32_t RunPoll(Context *ctx, Module *m) const;
+
   // Compute constraints for the pipeline starting at this task.
   placement_constraint GetSocketConstraints() const;
 
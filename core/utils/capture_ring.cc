@@ -0,0 +1,420 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "capture_ring.h"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <glog/logging.h>
+
+#include "../packet.h"
+#include "common.h"
+#include "copy.h"
+#include "time.h"
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+// Records moved from a worker ring at once
+constexpr uint32_t kBurst = 32;
+
+// Preferred size of a single write()
+constexpr size_t kWriteSize = 256 * 1024;
+
+// How long the writer sleeps when all rings are empty
+constexpr long kIdleSleepNs = 1000000;
+
+// Maximum packet length seen by the filter (as the BPF module does)
+constexpr int kFilterSnaplen = 0xffff;
+
+// Rate-based sampling allows bursts of this many packets
+constexpr uint64_t kSampleBurst = bess::PacketBatch::kMaxBurst;
+
+int64_t WallClockOffsetNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  int64_t wall_ns = ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  return wall_ns - static_cast<int64_t>(tsc_to_ns(rdtsc()));
+}
+
+struct llring *AllocRing(uint32_t slots) {
+  struct llring *ring = reinterpret_cast<struct llring *>(
+      std::aligned_alloc(alignof(llring), llring_bytes_with_slots(slots)));
+  CHECK(ring);
+  CHECK_EQ(llring_init(ring, slots, 1, 1), 0);
+  return ring;
+}
+
+}  // namespace
+
+void CaptureWriterThread::Run() {
+  owner_->RunWriter();
+}
+
+CaptureRing::CaptureRing(FifoOpener *opener, uint32_t snaplen,
+                         size_t meta_size)
+    : opener_(opener),
+      snaplen_(snaplen),
+      meta_size_(meta_size),
+      slot_size_((sizeof(Record) + snaplen + meta_size + alignof(Record) - 1) &
+                 ~(alignof(Record) - 1)),
+      wall_offset_ns_(WallClockOffsetNs()),
+      has_filter_(),
+      filter_(),
+      sample_one_in_n_(),
+      sample_interval_ns_(),
+      rings_(),
+      unprepared_(),
+      cleared_(),
+      writer_(this),
+      buf_(),
+      buf_len_(),
+      bytes_(),
+      lost_() {}
+
+CaptureRing::~CaptureRing() {
+  Stop();
+  FreeFilter();
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    WorkerRing *ring = rings_[wid].load();
+    if (ring) {
+      std::free(ring->ready);
+      std::free(ring->free);
+      std::free(ring->slots);
+      delete ring;
+    }
+  }
+}
+
+bool CaptureRing::SetFilter(const std::string &exp) {
+  FreeFilter();
+  if (exp.empty()) {
+    return true;
+  }
+
+  struct bpf_program il;
+  if (pcap_compile_nopcap(kFilterSnaplen, DLT_EN10MB, &il, exp.c_str(),
+                          1,  // optimize (IL only)
+                          PCAP_NETMASK_UNKNOWN) == -1) {
+    return false;
+  }
+
+#ifdef __x86_64
+  filter_.func = bpf_jit_compile(il.bf_insns, il.bf_len, &filter_.mmap_size);
+  pcap_freecode(&il);
+  if (!filter_.func) {
+    return false;
+  }
+#else
+  filter_.il_code = il;
+#endif
+
+  filter_.exp = exp;
+  has_filter_ = true;
+  return true;
+}
+
+void CaptureRing::FreeFilter() {
+  if (!has_filter_) {
+    return;
+  }
+
+#ifdef __x86_64
+  munmap(reinterpret_cast<void *>(filter_.func), filter_.mmap_size);
+#else
+  pcap_freecode(&filter_.il_code);
+#endif
+  filter_ = Filter();
+  has_filter_ = false;
+}
+
+void CaptureRing::SetSampling(uint32_t one_in_n, uint64_t max_pps) {
+  sample_one_in_n_ = one_in_n > 1 ? one_in_n : 0;
+  sample_interval_ns_ = max_pps ? std::max<uint64_t>(1000000000 / max_pps, 1)
+                                : 0;
+}
+
+bool CaptureRing::Start() {
+  buf_.resize(std::max(kWriteSize, 2 * MaxFormattedSize()));
+  buf_len_ = 0;
+  return writer_.Start();
+}
+
+void CaptureRing::Stop() {
+  writer_.Terminate();
+}
+
+void CaptureRing::Prepare(const std::vector<bool> &workers) {
+  for (size_t wid = 0; wid < workers.size() && wid < Worker::kMaxWorkers;
+       wid++) {
+    if (!workers[wid] || rings_[wid].load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    WorkerRing *ring = new WorkerRing();
+    // llring holds one less than its slots
+    ring->ready = AllocRing(kSlots * 2);
+    ring->free = AllocRing(kSlots * 2);
+    ring->slots = static_cast<char *>(
+        std::aligned_alloc(alignof(Record), slot_size_ * kSlots));
+    CHECK(ring->slots);
+    for (uint32_t i = 0; i < kSlots; i++) {
+      llring_sp_enqueue(ring->free, ring->slots + i * slot_size_);
+    }
+
+    rings_[wid].store(ring, std::memory_order_release);
+  }
+}
+
+void CaptureRing::Capture(const bess::PacketBatch *batch) {
+  int wid = current_worker.wid();
+  if (unlikely(wid < 0 || wid >= Worker::kMaxWorkers)) {
+    return;
+  }
+
+  // Nobody is listening
+  if (!opener_->IsValidFd(opener_->GetCurrentFd().first)) {
+    return;
+  }
+
+  WorkerRing *ring = rings_[wid].load(std::memory_order_relaxed);
+  if (unlikely(!ring)) {
+    unprepared_.fetch_add(batch->cnt(), std::memory_order_relaxed);
+    return;
+  }
+
+  bess::Packet *const *pkts = batch->pkts();
+  int cnt = batch->cnt();
+
+  bess::Packet *selected[bess::PacketBatch::kMaxBurst];
+  if (has_filter_ || sample_one_in_n_ || sample_interval_ns_) {
+    int n = Select(ring, batch, selected);
+    ring->skipped += cnt - n;
+    pkts = selected;
+    cnt = n;
+    if (cnt == 0) {
+      return;
+    }
+  }
+
+  Record *recs[bess::PacketBatch::kMaxBurst];
+  int n = llring_sc_dequeue_burst(ring->free, reinterpret_cast<void **>(recs),
+                                  cnt);
+  ring->dropped += cnt - n;
+  if (n == 0) {
+    return;
+  }
+
+  uint64_t ts_ns = current_worker.current_ns();
+  for (int i = 0; i < n; i++) {
+    const bess::Packet *pkt = pkts[i];
+    Record *rec = recs[i];
+    rec->ts_ns = ts_ns;
+    rec->orig_len = pkt->total_len();
+    rec->incl_len = std::min<uint32_t>(pkt->head_len(), snaplen_);
+    CopyInlined(rec->data, pkt->head_data(), rec->incl_len);
+    if (meta_size_) {
+      CopyMetadata(pkt, rec->data + snaplen_);
+    }
+  }
+
+  llring_sp_enqueue_burst(ring->ready, reinterpret_cast<void **>(recs), n);
+  ring->captured += n;
+}
+
+int CaptureRing::Select(WorkerRing *ring, const bess::PacketBatch *batch,
+                        bess::Packet **pkts) {
+  int cnt = 0;
+
+  if (sample_interval_ns_) {
+    uint64_t now = current_worker.current_ns();
+    ring->sample_credit = std::min(
+        ring->sample_credit + (now - ring->sample_last_ns),
+        kSampleBurst * sample_interval_ns_);
+    ring->sample_last_ns = now;
+  }
+
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    if (has_filter_) {
+#ifdef __x86_64
+      u_int ret = filter_.func(pkt->head_data<u_char *>(), pkt->total_len(),
+                               pkt->head_len());
+#else
+      u_int ret = bpf_filter(filter_.il_code.bf_insns,
+                             pkt->head_data<u_char *>(), pkt->total_len(),
+                             pkt->head_len());
+#endif
+      if (ret == 0) {
+        continue;
+      }
+    }
+
+    if (sample_one_in_n_ && ++ring->sample_cnt < sample_one_in_n_) {
+      continue;
+    }
+
+    if (sample_interval_ns_) {
+      if (ring->sample_credit < sample_interval_ns_) {
+        continue;
+      }
+      ring->sample_credit -= sample_interval_ns_;
+    }
+
+    ring->sample_cnt = 0;
+    pkts[cnt++] = pkt;
+  }
+
+  return cnt;
+}
+
+CaptureRing::Stats CaptureRing::RawStats() const {
+  Stats ret = {};
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    const WorkerRing *ring = rings_[wid].load(std::memory_order_acquire);
+    if (ring) {
+      ret.captured += ring->captured;
+      ret.dropped += ring->dropped;
+      ret.skipped += ring->skipped;
+    }
+  }
+  ret.dropped += unprepared_.load(std::memory_order_relaxed);
+  ret.bytes = bytes_.load(std::memory_order_relaxed);
+  ret.lost = lost_.load(std::memory_order_relaxed);
+  return ret;
+}
+
+CaptureRing::Stats CaptureRing::stats() const {
+  Stats ret = RawStats();
+  ret.captured -= cleared_.captured;
+  ret.dropped -= cleared_.dropped;
+  ret.skipped -= cleared_.skipped;
+  ret.bytes -= cleared_.bytes;
+  ret.lost -= cleared_.lost;
+  return ret;
+}
+
+void CaptureRing::ResetStats() {
+  // Counters are owned by workers and the writer thread: subtract instead
+  cleared_ = RawStats();
+}
+
+bool CaptureRing::Collect() {
+  bool found = false;
+  size_t max_size = MaxFormattedSize();
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    WorkerRing *ring = rings_[wid].load(std::memory_order_acquire);
+    if (!ring) {
+      continue;
+    }
+
+    Record *recs[kBurst];
+    uint32_t n;
+    while ((n = llring_sc_dequeue_burst(
+                ring->ready, reinterpret_cast<void **>(recs), kBurst)) > 0) {
+      found = true;
+      for (uint32_t i = 0; i < n; i++) {
+        if (buf_len_ + max_size > buf_.size()) {
+          Flush();
+        }
+        recs[i]->ts_ns += wall_offset_ns_;
+        buf_len_ += Format(*recs[i], buf_.data() + buf_len_);
+      }
+      llring_sp_enqueue_burst(ring->free, reinterpret_cast<void **>(recs), n);
+    }
+  }
+
+  return found;
+}
+
+void CaptureRing::Flush() {
+  size_t off = 0;
+
+  while (off < buf_len_ && !writer_.IsExitRequested()) {
+    int fd;
+    uint32_t gen;
+    std::tie(fd, gen) = opener_->GetCurrentFd();
+    if (!opener_->IsValidFd(fd)) {
+      break;
+    }
+
+    ssize_t ret = write(fd, buf_.data() + off, buf_len_ - off);
+    if (ret > 0) {
+      off += ret;
+      bytes_.fetch_add(ret, std::memory_order_relaxed);
+    } else if (ret < 0 && errno == EAGAIN) {
+      // The reader is slow. Meanwhile, the worker rings may overflow.
+      struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+      struct timespec ts = {.tv_sec = 0, .tv_nsec = kIdleSleepNs};
+      ppoll(&pfd, 1, &ts, writer_.Sigmask());
+    } else if (ret < 0 && errno != EINTR) {
+      if (errno == EPIPE) {
+        DLOG(WARNING) << "Broken pipe: stopping capture";
+        opener_->MarkDead(fd, gen);
+      }
+      break;
+    }
+  }
+
+  lost_.fetch_add(buf_len_ - off, std::memory_order_relaxed);
+  buf_len_ = 0;
+}
+
+void CaptureRing::RunWriter() {
+  while (!writer_.IsExitRequested()) {
+    if (Collect()) {
+      continue;
+    }
+
+    // Nothing new: write out what we have, then wait a bit
+    if (buf_len_) {
+      Flush();
+      continue;
+    }
+
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = kIdleSleepNs};
+    ppoll(nullptr, 0, &ts, writer_.Sigmask());
+  }
+
+  writer_.BeginExiting();
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,227 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_CAPTURE_RING_H_
+#define BESS_UTILS_CAPTURE_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../kmod/llring.h"
+#include "../pktbatch.h"
+#include "../worker.h"
+#include "bpf.h"
+#include "fifo_opener.h"
+#include "syscallthread.h"
+
+namespace bess {
+namespace utils {
+
+class CaptureRing;
+
+// Internal: the writer thread of a CaptureRing.
+class CaptureWriterThread final : public SyscallThreadPfuncs {
+ public:
+  explicit CaptureWriterThread(CaptureRing *owner) : owner_(owner) {}
+  void Run() override;
+
+ private:
+  CaptureRing *owner_;
+};
+
+/*!
+ * Asynchronous packet capture to a FIFO, for the Tcpdump and Pcapng gate
+ * hooks.
+ *
+ * Workers copy up to `snaplen` bytes of each packet (plus some per-packet
+ * metadata, see CopyMetadata()) into fixed-size slots of a per-worker
+ * single-producer/single-consumer ring, and never make system calls. A writer
+ * thread formats the records (see Format()) into a large buffer and writes
+ * it out with a single write(). If the reader is too slow, the rings fill up
+ * and further packets are dropped and counted, rather than stalling the
+ * pipeline.
+ *
+ * Optionally, only the packets matching a pcap-filter expression are
+ * captured, and of those only a sample (see SetFilter() and SetSampling()).
+ * Both are evaluated by the worker before copying anything.
+ */
+class CaptureRing {
+ public:
+  // Slots per worker
+  static constexpr uint32_t kSlots = 1024;
+
+  // Covers the whole data area of default packet buffers
+  static constexpr uint32_t kDefaultSnaplen = 2048;
+
+  struct Record {
+    uint64_t ts_ns;     // wall clock time, in nanoseconds
+    uint32_t orig_len;  // length of the packet
+    uint32_t incl_len;  // bytes of packet data captured
+    char data[];        // packet data, followed by the metadata
+  };
+
+  struct Stats {
+    uint64_t captured;  // packets copied into the rings
+    uint64_t dropped;   // packets dropped, as the ring was full or missing
+    uint64_t skipped;   // packets not matching the filter or not sampled
+    uint64_t bytes;     // bytes written to the FIFO
+    uint64_t lost;      // bytes not written, as the FIFO was closed
+  };
+
+  // 'opener' provides the FIFO to write to. 'meta_size' is the size of the
+  // metadata copied by CopyMetadata().
+  CaptureRing(FifoOpener *opener, uint32_t snaplen, size_t meta_size = 0);
+  virtual ~CaptureRing();
+
+  // Captures only the packets matching the pcap-filter expression 'exp', or
+  // all packets if it is empty. Returns false if 'exp' is invalid. Must not
+  // be called while workers are running.
+  bool SetFilter(const std::string &exp);
+
+  // Among the packets matching the filter, captures only one in 'one_in_n'
+  // (if nonzero) and at most 'max_pps' packets per second per worker (if
+  // nonzero). Must not be called while workers are running.
+  void SetSampling(uint32_t one_in_n, uint64_t max_pps);
+
+  // Allocates the rings of the workers set in 'workers' (indexed by worker
+  // ID), if not done yet. Rings are never allocated on the datapath: packets
+  // seen by other workers are counted as dropped. Must not be called while
+  // these workers are running.
+  void Prepare(const std::vector<bool> &workers);
+
+  // Starts the writer thread. Returns false (with errno set) on failure.
+  bool Start();
+
+  // Stops the writer thread, discarding records not yet written. Must be
+  // called in the destructor of the class overriding Format().
+  void Stop();
+
+  // Captures the packets of 'batch'. Called by workers.
+  void Capture(const bess::PacketBatch *batch);
+
+  uint32_t snaplen() const { return snaplen_; }
+
+  Stats stats() const;
+
+  // Only the control thread may call stats() and ResetStats(), but counters
+  // keep being updated by workers and the writer thread.
+  void ResetStats();
+
+ protected:
+  // Copies the metadata of 'pkt' into 'dst' (of 'meta_size' bytes). Called
+  // by workers.
+  virtual void CopyMetadata(const bess::Packet *, char *) const {}
+
+  // Writes the file format representation of 'rec' into 'buf' and returns
+  // its length, at most MaxFormattedSize(). Called by the writer thread.
+  virtual size_t Format(const Record &rec, char *buf) = 0;
+
+  // Upper bound of what Format() writes
+  virtual size_t MaxFormattedSize() const = 0;
+
+  const char *metadata(const Record &rec) const {
+    return rec.data + snaplen_;
+  }
+
+ private:
+  friend class CaptureWriterThread;
+
+  struct alignas(64) WorkerRing {
+    struct llring *ready;  // worker to writer
+    struct llring *free;   // writer to worker
+    char *slots;
+
+    // Updated by the worker only
+    uint64_t captured;
+    uint64_t dropped;
+    uint64_t skipped;
+
+    // Sampling state
+    uint32_t sample_cnt;      // packets since the last one sampled
+    uint64_t sample_credit;   // rate limiter credit, in nanoseconds
+    uint64_t sample_last_ns;  // last refill of 'sample_credit'
+  };
+
+  // Current values of all counters, since the ring was created
+  Stats RawStats() const;
+
+  // Stores in 'pkts' the packets of 'batch' that match the filter and are
+  // sampled. Returns their count.
+  int Select(WorkerRing *ring, const bess::PacketBatch *batch,
+             bess::Packet **pkts);
+
+  void FreeFilter();
+
+  // Body of the writer thread
+  void RunWriter();
+
+  // Moves records from the rings to 'buf_'. Returns false if there was none.
+  bool Collect();
+
+  // Writes out 'buf_', waiting for the FIFO if it is full
+  void Flush();
+
+  FifoOpener *opener_;
+  const uint32_t snaplen_;
+  const size_t meta_size_;
+  const size_t slot_size_;
+
+  // Offset from the TSC-based clock of workers to the wall clock
+  const int64_t wall_offset_ns_;
+
+  // Packet selection
+  bool has_filter_;
+  Filter filter_;
+  uint32_t sample_one_in_n_;
+  uint64_t sample_interval_ns_;  // 1 / max_pps
+
+  std::atomic<WorkerRing *> rings_[Worker::kMaxWorkers];
+
+  // Packets seen by workers without a ring
+  std::atomic<uint64_t> unprepared_;
+
+  // RawStats() at the last ResetStats()
+  Stats cleared_;
+
+  // Writer thread state
+  CaptureWriterThread writer_;
+  std::vector<char> buf_;
+  size_t buf_len_;
+  std::atomic<uint64_t> bytes_;
+  std::atomic<uint64_t> lost_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureRing);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CAPTURE_RING_H_
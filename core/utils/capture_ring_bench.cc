@@ -0,0 +1,172 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for the worker-side cost of packet capture: synchronous writev()
+// per packet (as the Tcpdump hook used to do) vs. CaptureRing.
+
+#include "capture_ring.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../packet_pool.h"
+#include "copy.h"
+#include "pcap.h"
+
+namespace {
+
+using bess::utils::CaptureRing;
+using bess::utils::FifoOpener;
+
+static const int kPacketSize = 1514;
+
+class NullOpener final : public FifoOpener {
+ public:
+  bool InitFifo(int) override { return true; }
+};
+
+class PcapRing final : public CaptureRing {
+ public:
+  PcapRing(FifoOpener *opener, uint32_t snaplen)
+      : CaptureRing(opener, snaplen) {}
+  ~PcapRing() { Stop(); }
+
+ protected:
+  size_t Format(const Record &rec, char *buf) override {
+    struct pcap_rec_hdr hdr = {
+        .ts_sec = static_cast<uint32_t>(rec.ts_ns / 1000000000),
+        .ts_usec = static_cast<uint32_t>(rec.ts_ns % 1000000000 / 1000),
+        .incl_len = rec.incl_len,
+        .orig_len = rec.orig_len,
+    };
+    bess::utils::Copy(buf, &hdr, sizeof(hdr));
+    bess::utils::Copy(buf + sizeof(hdr), rec.data, rec.incl_len);
+    return sizeof(hdr) + rec.incl_len;
+  }
+
+  size_t MaxFormattedSize() const override {
+    return sizeof(struct pcap_rec_hdr) + snaplen();
+  }
+};
+
+class CaptureFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &) override {
+    batch_.clear();
+    for (size_t i = 0; i < bess::PacketBatch::kMaxBurst; i++) {
+      bess::Packet *pkt = pool_.Alloc(kPacketSize);
+      CHECK(pkt);
+      memset(pkt->head_data(), i, kPacketSize);
+      batch_.add(pkt);
+    }
+
+    CHECK_EQ(opener_.Init("/dev/null", false), 0);
+    CHECK_EQ(opener_.OpenNow(), 0);
+  }
+
+  void TearDown(benchmark::State &) override {
+    opener_.Shutdown();
+    bess::Packet::Free(&batch_);
+  }
+
+ protected:
+  bess::PlainPacketPool pool_;
+  bess::PacketBatch batch_;
+  NullOpener opener_;
+};
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(CaptureFixture, Writev)(benchmark::State &state) {
+  uint32_t snaplen = state.range(0);
+  int fd = opener_.GetCurrentFd().first;
+
+  while (state.KeepRunning()) {
+    for (int i = 0; i < batch_.cnt(); i++) {
+      bess::Packet *pkt = batch_.pkts()[i];
+      uint32_t len = std::min<uint32_t>(pkt->head_len(), snaplen);
+      struct pcap_rec_hdr hdr = {
+          .ts_sec = 0,
+          .ts_usec = 0,
+          .incl_len = len,
+          .orig_len = static_cast<uint32_t>(pkt->total_len()),
+      };
+      struct iovec vec[2] = {{&hdr, sizeof(hdr)}, {pkt->head_data(), len}};
+      benchmark::DoNotOptimize(writev(fd, vec, 2));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_DEFINE_F(CaptureFixture, Ring)(benchmark::State &state) {
+  PcapRing ring(&opener_, state.range(0));
+  ring.Prepare({true});  // for worker 0, as which the benchmark runs
+  CHECK(ring.Start());
+
+  while (state.KeepRunning()) {
+    ring.Capture(&batch_);
+  }
+
+  CaptureRing::Stats stats = ring.stats();
+  uint64_t total = stats.captured + stats.dropped;
+  state.SetLabel("dropped " +
+                 std::to_string(total ? stats.dropped * 100 / total : 0) +
+                 "%");
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+// Cost of the BPF pre-filter and 1-in-N sampling (arg), which reject most
+// packets before they are copied.
+BENCHMARK_DEFINE_F(CaptureFixture, RingSampled)(benchmark::State &state) {
+  PcapRing ring(&opener_, CaptureRing::kDefaultSnaplen);
+  CHECK(ring.SetFilter("not tcp port 22"));
+  ring.SetSampling(state.range(0), 0);
+  ring.Prepare({true});
+  CHECK(ring.Start());
+
+  while (state.KeepRunning()) {
+    ring.Capture(&batch_);
+  }
+
+  state.SetItemsProcessed(state.iterations() * batch_.cnt());
+}
+
+BENCHMARK_REGISTER_F(CaptureFixture, Writev)->Arg(64)->Arg(128)->Arg(1514);
+BENCHMARK_REGISTER_F(CaptureFixture, Ring)->Arg(64)->Arg(128)->Arg(1514);
+BENCHMARK_REGISTER_F(CaptureFixture, RingSampled)->Arg(1)->Arg(100)->Arg(10000);
+
+BENCHMARK_MAIN();
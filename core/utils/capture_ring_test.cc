@@ -0,0 +1,244 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "capture_ring.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../packet_pool.h"
+#include "ether.h"
+#include "ip.h"
+
+using bess::utils::be16_t;
+using bess::utils::CaptureRing;
+using bess::utils::Ethernet;
+using bess::utils::FifoOpener;
+using bess::utils::Ipv4;
+
+namespace {
+
+class NullOpener final : public FifoOpener {
+ public:
+  bool InitFifo(int) override { return true; }
+};
+
+// Remembers the packets copied into the ring, in order. The writer thread is
+// never started, so the rings hold up to kSlots records.
+class TestRing final : public CaptureRing {
+ public:
+  explicit TestRing(FifoOpener *opener)
+      : CaptureRing(opener, kDefaultSnaplen, 1), captured_() {}
+  ~TestRing() { Stop(); }
+
+  const std::vector<const bess::Packet *> &captured() const {
+    return captured_;
+  }
+
+ protected:
+  void CopyMetadata(const bess::Packet *pkt, char *) const override {
+    captured_.push_back(pkt);
+  }
+
+  size_t Format(const Record &, char *) override { return 0; }
+  size_t MaxFormattedSize() const override { return 0; }
+
+ private:
+  mutable std::vector<const bess::Packet *> captured_;
+};
+
+class CaptureRingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_EQ(0, opener_.Init("/dev/null", false));
+    ASSERT_EQ(0, opener_.OpenNow());
+
+    // Tests run as worker 0, whose clock is set by hand
+    current_worker.set_current_ns(kStartNs);
+    ring_.reset(new TestRing(&opener_));
+    ring_->Prepare({true});
+
+    // Packets alternate between UDP (even) and TCP (odd)
+    batch_.clear();
+    for (size_t i = 0; i < kBatch; i++) {
+      bess::Packet *pkt = pool_.Alloc(kPacketSize);
+      ASSERT_NE(nullptr, pkt);
+      memset(pkt->head_data(), 0, kPacketSize);
+
+      Ethernet *eth = pkt->head_data<Ethernet *>();
+      eth->ether_type = be16_t(Ethernet::Type::kIpv4);
+      Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+      ip->version = 4;
+      ip->header_length = 5;
+      ip->length = be16_t(kPacketSize - sizeof(*eth));
+      ip->ttl = 64;
+      ip->protocol = (i % 2) ? Ipv4::Proto::kTcp : Ipv4::Proto::kUdp;
+
+      batch_.add(pkt);
+    }
+  }
+
+  virtual void TearDown() {
+    ring_.reset();
+    opener_.Shutdown();
+    bess::Packet::Free(&batch_);
+  }
+
+  static constexpr size_t kBatch = bess::PacketBatch::kMaxBurst;
+  static constexpr int kPacketSize = 64;
+  static constexpr uint64_t kStartNs = 1000000000;
+
+  bess::PlainPacketPool pool_;
+  bess::PacketBatch batch_;
+  NullOpener opener_;
+  std::unique_ptr<TestRing> ring_;
+};
+
+TEST_F(CaptureRingTest, All) {
+  ring_->Capture(&batch_);
+
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(kBatch, stats.captured);
+  EXPECT_EQ(0u, stats.skipped);
+  EXPECT_EQ(0u, stats.dropped);
+  ASSERT_EQ(kBatch, ring_->captured().size());
+  for (size_t i = 0; i < kBatch; i++) {
+    EXPECT_EQ(batch_.pkts()[i], ring_->captured()[i]);
+  }
+}
+
+TEST_F(CaptureRingTest, Filter) {
+  EXPECT_FALSE(ring_->SetFilter("udp port"));
+  ASSERT_TRUE(ring_->SetFilter("udp"));
+  ring_->Capture(&batch_);
+
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(kBatch / 2, stats.captured);
+  EXPECT_EQ(kBatch / 2, stats.skipped);
+  EXPECT_EQ(0u, stats.dropped);
+  ASSERT_EQ(kBatch / 2, ring_->captured().size());
+  for (size_t i = 0; i < kBatch / 2; i++) {
+    EXPECT_EQ(batch_.pkts()[i * 2], ring_->captured()[i]);
+  }
+
+  // An empty expression removes the filter
+  ASSERT_TRUE(ring_->SetFilter(""));
+  ring_->Capture(&batch_);
+  EXPECT_EQ(kBatch / 2 * 3, ring_->stats().captured);
+}
+
+// Every Nth packet is kept, also across batches
+TEST_F(CaptureRingTest, OneInN) {
+  const size_t kN = 5;
+  const size_t kBatches = 4;
+
+  ring_->SetSampling(kN, 0);
+  for (size_t i = 0; i < kBatches; i++) {
+    ring_->Capture(&batch_);
+  }
+
+  size_t total = kBatch * kBatches;
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(total / kN, stats.captured);
+  EXPECT_EQ(total - total / kN, stats.skipped);
+  ASSERT_EQ(total / kN, ring_->captured().size());
+  for (size_t i = 0; i < total / kN; i++) {
+    size_t seq = (i + 1) * kN - 1;
+    EXPECT_EQ(batch_.pkts()[seq % kBatch], ring_->captured()[i]);
+  }
+}
+
+// 1-in-N applies to the packets that match the filter only
+TEST_F(CaptureRingTest, FilterOneInN) {
+  ASSERT_TRUE(ring_->SetFilter("tcp"));
+  ring_->SetSampling(4, 0);
+  ring_->Capture(&batch_);
+
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(kBatch / 8, stats.captured);
+  EXPECT_EQ(kBatch - kBatch / 8, stats.skipped);
+  ASSERT_EQ(kBatch / 8, ring_->captured().size());
+  for (size_t i = 0; i < kBatch / 8; i++) {
+    EXPECT_EQ(batch_.pkts()[i * 8 + 7], ring_->captured()[i]);
+  }
+}
+
+// At most a burst, then max_pps packets per second
+TEST_F(CaptureRingTest, MaxPps) {
+  const uint64_t kPps = 1000;  // one per millisecond
+  const uint64_t kBurst = kBatch;
+
+  ring_->SetSampling(0, kPps);
+
+  // The credit starts full
+  for (int i = 0; i < 4; i++) {
+    ring_->Capture(&batch_);
+  }
+  EXPECT_EQ(kBurst, ring_->stats().captured);
+
+  // Packets keep coming for 10 ms
+  for (int i = 1; i <= 10; i++) {
+    current_worker.set_current_ns(kStartNs + i * 1000000);
+    ring_->Capture(&batch_);
+  }
+  EXPECT_EQ(kBurst + 10, ring_->stats().captured);
+
+  // The credit refills up to a burst
+  current_worker.set_current_ns(kStartNs + 1000000000);
+  for (int i = 0; i < 4; i++) {
+    ring_->Capture(&batch_);
+  }
+
+  uint64_t total = kBatch * 18;
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(kBurst * 2 + 10, stats.captured);
+  EXPECT_EQ(total - stats.captured, stats.skipped);
+  EXPECT_EQ(0u, stats.dropped);
+  EXPECT_EQ(stats.captured, ring_->captured().size());
+}
+
+TEST_F(CaptureRingTest, ResetStats) {
+  ASSERT_TRUE(ring_->SetFilter("udp"));
+  ring_->Capture(&batch_);
+  ring_->ResetStats();
+
+  CaptureRing::Stats stats = ring_->stats();
+  EXPECT_EQ(0u, stats.captured);
+  EXPECT_EQ(0u, stats.skipped);
+
+  ring_->Capture(&batch_);
+  stats = ring_->stats();
+  EXPECT_EQ(kBatch / 2, stats.captured);
+  EXPECT_EQ(kBatch / 2, stats.skipped);
+}
+
+}  // namespace
@@ -0,0 +1,375 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_UTILS_COMPACT_TRIE_H_
+#define BESS_UTILS_COMPACT_TRIE_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace bess {
+namespace utils {
+
+// A read-only counterpart of Trie, with the same lookup semantics, for large
+// sets of keys (e.g., millions of URLs).
+//
+// It is a path-compressed trie built at once from all keys: chains of nodes
+// with a single child are merged into one node, labeled with a string. All
+// nodes are kept in a single array, with the children of a node next to each
+// other (sorted, and indexed by the first byte of their labels), and all labels
+// in another. A node takes 16 bytes, instead of 256 pointers with Trie, and a
+// lookup touches a few cache lines per node instead of one node per byte.
+template <typename T>
+class CompactTrie {
+ public:
+  // <key, value, prefix flag>. See Trie::Insert() for the prefix flag.
+  using Entry = std::tuple<std::string, T, bool>;
+
+  CompactTrie() { Clear(); }
+
+  // Replaces the contents of the trie with the given entries. If there are
+  // entries with the same key, the last one is effective.
+  void Build(std::vector<Entry> entries);
+
+  // Removes all keys
+  void Clear();
+
+  // Returns true if the key is in the trie.
+  bool Match(const char *key, size_t len) const;
+  bool Match(const std::string &key) const {
+    return Match(key.data(), key.size());
+  }
+
+  // Returns true if there is a key in the trie that begins with the given
+  // prefix.
+  bool MatchPrefix(const char *prefix, size_t len) const;
+  bool MatchPrefix(const std::string &prefix) const {
+    return MatchPrefix(prefix.data(), prefix.size());
+  }
+
+  // Look up the value associated with the given key.
+  // Returns the pair {true, <value>} if the key is in the trie.
+  // Returns a pair whose first element is false if the key is not found.
+  std::pair<bool, T> Lookup(const char *key, size_t len) const;
+  std::pair<bool, T> Lookup(const std::string &key) const {
+    return Lookup(key.data(), key.size());
+  }
+
+  // Returns all entries, sorted by key
+  std::vector<Entry> Dump() const {
+    std::vector<Entry> ret;
+    std::string prelude;
+    DumpNode(0, &prelude, &ret);
+    return ret;
+  }
+
+  // Returns the number of keys
+  size_t size() const { return values_.size(); }
+
+  // Returns the number of bytes allocated for the trie
+  size_t memory_usage() const {
+    return nodes_.capacity() * sizeof(Node) + first_.capacity() +
+           labels_.capacity() + values_.capacity() * sizeof(T);
+  }
+
+ private:
+  struct Node {
+    uint32_t label;     // offset of the label in labels_
+    uint32_t children;  // index of the first child in nodes_
+    uint32_t value;     // index of the value in values_, if leaf
+    uint16_t label_len;
+    uint16_t num_children : 9;
+    uint16_t leaf : 1;
+    uint16_t prefix : 1;
+  };
+
+  static_assert(sizeof(Node) == 16, "Node must be 16 bytes");
+
+  static const uint32_t kNone = UINT32_MAX;
+
+  // Longer labels are split into multiple nodes
+  static const size_t kMaxLabelLen = UINT16_MAX;
+
+  // Children are found with linear search up to this many, binary otherwise
+  static const int kMaxLinearSearch = 8;
+
+  // Returns the index of the child of node whose label starts with c, or kNone
+  uint32_t FindChild(const Node &node, uint8_t c) const {
+    const uint8_t *first = &first_[node.children];
+    int n = node.num_children;
+
+    if (n <= kMaxLinearSearch) {
+      for (int i = 0; i < n && first[i] <= c; i++) {
+        if (first[i] == c) {
+          return node.children + i;
+        }
+      }
+      return kNone;
+    }
+
+    const uint8_t *it = std::lower_bound(first, first + n, c);
+    return (it != first + n && *it == c) ? node.children + (it - first) : kNone;
+  }
+
+  // Returns true if the label of node is a prefix of key
+  bool MatchLabel(const Node &node, const char *key, size_t len) const {
+    return len >= node.label_len &&
+           memcmp(&labels_[node.label], key, node.label_len) == 0;
+  }
+
+  // Builds the subtree of node idx, for entries[lo, hi), all of which share
+  // their first 'depth' bytes.
+  void BuildNode(const std::vector<Entry> &entries, size_t lo, size_t hi,
+                 size_t depth, uint32_t idx);
+
+  void DumpNode(uint32_t idx, std::string *prelude,
+                std::vector<Entry> *ret) const;
+
+  // nodes_[0] is the root, with an empty label
+  std::vector<Node> nodes_;
+
+  // The first byte of the label of each node, for faster search of children
+  std::vector<uint8_t> first_;
+
+  std::string labels_;
+  std::vector<T> values_;
+};
+
+template <typename T>
+inline void CompactTrie<T>::Build(std::vector<Entry> entries) {
+  Clear();
+
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry &a, const Entry &b) {
+                     return std::get<0>(a) < std::get<0>(b);
+                   });
+
+  // Of the entries with the same key, keep the last one
+  size_t cnt = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i + 1 < entries.size() &&
+        std::get<0>(entries[i]) == std::get<0>(entries[i + 1])) {
+      continue;
+    }
+    if (cnt != i) {
+      entries[cnt] = std::move(entries[i]);
+    }
+    cnt++;
+  }
+  entries.resize(cnt);
+
+  if (!entries.empty()) {
+    BuildNode(entries, 0, entries.size(), 0, 0);
+  }
+
+  CHECK_LT(nodes_.size(), kNone);
+  CHECK_LT(labels_.size(), kNone);
+
+  nodes_.shrink_to_fit();
+  first_.shrink_to_fit();
+  labels_.shrink_to_fit();
+  values_.shrink_to_fit();
+}
+
+template <typename T>
+inline void CompactTrie<T>::Clear() {
+  nodes_.assign(1, Node());
+  first_.assign(1, 0);
+  labels_.clear();
+  values_.clear();
+}
+
+template <typename T>
+void CompactTrie<T>::BuildNode(const std::vector<Entry> &entries, size_t lo,
+                               size_t hi, size_t depth, uint32_t idx) {
+  // Since entries are sorted, the key ending at this node comes first
+  if (std::get<0>(entries[lo]).size() == depth) {
+    nodes_[idx].leaf = true;
+    nodes_[idx].prefix = std::get<2>(entries[lo]);
+    nodes_[idx].value = values_.size();
+    values_.push_back(std::get<1>(entries[lo]));
+    lo++;
+  }
+
+  // Group the rest by their next byte, one group per child
+  std::vector<std::pair<size_t, size_t>> groups;
+  for (size_t i = lo; i < hi;) {
+    uint8_t c = std::get<0>(entries[i])[depth];
+    size_t j = i + 1;
+    while (j < hi && static_cast<uint8_t>(std::get<0>(entries[j])[depth]) == c) {
+      j++;
+    }
+    groups.emplace_back(i, j);
+    i = j;
+  }
+
+  uint32_t children = nodes_.size();
+  nodes_[idx].children = children;
+  nodes_[idx].num_children = groups.size();
+  nodes_.resize(children + groups.size());
+  first_.resize(children + groups.size());
+
+  for (size_t k = 0; k < groups.size(); k++) {
+    // The label is the longest common prefix of the group, which is that of
+    // the first and the last key as they are sorted.
+    const std::string &first = std::get<0>(entries[groups[k].first]);
+    const std::string &last = std::get<0>(entries[groups[k].second - 1]);
+    size_t end = std::min({first.size(), last.size(), depth + kMaxLabelLen});
+    size_t len = 1;
+    while (depth + len < end && first[depth + len] == last[depth + len]) {
+      len++;
+    }
+
+    Node &child = nodes_[children + k];
+    child.label = labels_.size();
+    child.label_len = len;
+    first_[children + k] = first[depth];
+    labels_.append(first, depth, len);
+
+    BuildNode(entries, groups[k].first, groups[k].second, depth + len,
+              children + k);
+  }
+}
+
+template <typename T>
+inline bool CompactTrie<T>::Match(const char *key, size_t len) const {
+  const Node *node = &nodes_[0];
+  size_t pos = 0;
+
+  while (true) {
+    if (node->prefix) {
+      return true;
+    }
+    if (pos == len) {
+      return node->leaf;
+    }
+
+    uint32_t child = FindChild(*node, key[pos]);
+    if (child == kNone) {
+      return false;
+    }
+
+    node = &nodes_[child];
+    if (!MatchLabel(*node, key + pos, len - pos)) {
+      return false;
+    }
+    pos += node->label_len;
+  }
+}
+
+template <typename T>
+inline bool CompactTrie<T>::MatchPrefix(const char *prefix, size_t len) const {
+  const Node *node = &nodes_[0];
+  size_t pos = 0;
+
+  while (true) {
+    if (node->prefix || pos == len) {
+      return true;
+    }
+
+    uint32_t child = FindChild(*node, prefix[pos]);
+    if (child == kNone) {
+      return false;
+    }
+
+    node = &nodes_[child];
+    size_t n = std::min<size_t>(len - pos, node->label_len);
+    if (memcmp(&labels_[node->label], prefix + pos, n) != 0) {
+      return false;
+    }
+    pos += n;
+
+    if (n < node->label_len) {
+      return true;  // prefix ends in the middle of the label
+    }
+  }
+}
+
+template <typename T>
+inline std::pair<bool, T> CompactTrie<T>::Lookup(const char *key,
+                                                 size_t len) const {
+  const Node *node = &nodes_[0];
+  const Node *prefix_match = nullptr;
+  size_t pos = 0;
+
+  while (true) {
+    if (node->prefix) {
+      prefix_match = node;
+    }
+    if (pos == len) {
+      if (node->leaf) {
+        return {true, values_[node->value]};
+      }
+      break;
+    }
+
+    uint32_t child = FindChild(*node, key[pos]);
+    if (child == kNone) {
+      break;
+    }
+
+    node = &nodes_[child];
+    if (!MatchLabel(*node, key + pos, len - pos)) {
+      break;
+    }
+    pos += node->label_len;
+  }
+
+  if (prefix_match != nullptr) {
+    return {true, values_[prefix_match->value]};
+  }
+  return {false, T()};
+}
+
+template <typename T>
+void CompactTrie<T>::DumpNode(uint32_t idx, std::string *prelude,
+                              std::vector<Entry> *ret) const {
+  const Node &node = nodes_[idx];
+
+  prelude->append(labels_, node.label, node.label_len);
+  if (node.leaf) {
+    ret->emplace_back(*prelude, values_[node.value], node.prefix);
+  }
+  for (uint32_t i = 0; i < node.num_children; i++) {
+    DumpNode(node.children + i, prelude, ret);
+  }
+  prelude->resize(prelude->size() - node.label_len);
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_COMPACT_TRIE_H_
@@ -0,0 +1,265 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "compact_trie.h"
+
+#include <gtest/gtest.h>
+#include <tuple>
+
+#include "trie.h"
+
+using bess::utils::CompactTrie;
+using bess::utils::Trie;
+
+namespace {
+
+TEST(CompactTrieTest, Match) {
+  CompactTrie<int32_t> trie;
+
+  trie.Build({{"Hello world!", 5, false}, {"123456", 10, false}});
+
+  EXPECT_FALSE(trie.Match("234"));
+  EXPECT_FALSE(trie.Match("ello"));
+  EXPECT_FALSE(trie.Match("H"));
+  EXPECT_FALSE(trie.Match(""));
+  EXPECT_FALSE(trie.Match("Hello world!!"));
+
+  EXPECT_TRUE(trie.Match("Hello world!"));
+  EXPECT_TRUE(trie.Match("123456"));
+}
+
+TEST(CompactTrieTest, MatchPrefix) {
+  CompactTrie<int32_t> trie;
+
+  trie.Build({{"Hello world!", 5, false}, {"123456", 10, false}});
+
+  EXPECT_FALSE(trie.MatchPrefix("234"));
+  EXPECT_FALSE(trie.MatchPrefix("ello"));
+  EXPECT_FALSE(trie.MatchPrefix("Help"));
+
+  EXPECT_TRUE(trie.MatchPrefix("H"));
+  EXPECT_TRUE(trie.MatchPrefix(""));
+  EXPECT_TRUE(trie.MatchPrefix("Hello"));
+  EXPECT_TRUE(trie.MatchPrefix("123456"));
+}
+
+TEST(CompactTrieTest, Lookup) {
+  CompactTrie<int32_t> trie;
+
+  trie.Build({{"Hello world!", 5, false},
+              {"123456", 10, false},
+              {"123456", 11, false}});
+
+  EXPECT_EQ(trie.size(), 2);
+
+  EXPECT_FALSE(trie.Lookup("234").first);
+  EXPECT_FALSE(trie.Lookup("ello").first);
+  EXPECT_FALSE(trie.Lookup("H").first);
+  EXPECT_FALSE(trie.Lookup("").first);
+
+  EXPECT_TRUE(trie.Lookup("Hello world!").first);
+  EXPECT_EQ(trie.Lookup("Hello world!").second, 5);
+  EXPECT_TRUE(trie.Lookup("123456").first);
+  EXPECT_EQ(trie.Lookup("123456").second, 11);  // the last one wins
+}
+
+TEST(CompactTrieTest, LookupWithEmptyValue) {
+  CompactTrie<std::tuple<>> trie;
+
+  trie.Build({{"Hello world!", {}, false}, {"123456", {}, false}});
+
+  EXPECT_FALSE(trie.Lookup("234").first);
+  EXPECT_FALSE(trie.Lookup("ello").first);
+  EXPECT_FALSE(trie.Lookup("H").first);
+  EXPECT_FALSE(trie.Lookup("").first);
+
+  EXPECT_TRUE(trie.Lookup("Hello world!").first);
+  EXPECT_TRUE(trie.Lookup("123456").first);
+}
+
+// Check whether prefix keys work, especially in combination with non-prefix
+// keys.
+TEST(CompactTrieTest, InsertPrefixes) {
+  CompactTrie<int32_t> trie;
+
+  trie.Build({{"Hel", 1, true},
+              {"Hello", 2, true},
+              {"12", 3, true},
+              {"Hello World", 4, false}});
+
+  EXPECT_FALSE(trie.Lookup("He2").first);
+  EXPECT_FALSE(trie.Lookup("1").first);
+  EXPECT_FALSE(trie.Match("He2"));
+  EXPECT_FALSE(trie.Match("1"));
+
+  EXPECT_TRUE(trie.Match("Hel"));
+  EXPECT_TRUE(trie.Match("Hell"));
+  EXPECT_TRUE(trie.Match("Hello"));
+  EXPECT_TRUE(trie.Match("Hello World"));
+  EXPECT_TRUE(trie.Match("12"));
+  EXPECT_TRUE(trie.Match("123"));
+  EXPECT_TRUE(trie.Match("1234"));
+
+  EXPECT_TRUE(trie.Lookup("Hel").first);
+  EXPECT_TRUE(trie.Lookup("Hell").first);
+  EXPECT_TRUE(trie.Lookup("Hello").first);
+  EXPECT_TRUE(trie.Lookup("Hello ").first);
+
+  EXPECT_EQ(trie.Lookup("Hel").second, 1);
+  EXPECT_EQ(trie.Lookup("Hell").second, 1);
+  EXPECT_EQ(trie.Lookup("Hello").second, 2);
+  EXPECT_EQ(trie.Lookup("Hello y'all").second, 2);
+  EXPECT_EQ(trie.Lookup("Hello World").second, 4);
+  EXPECT_EQ(trie.Lookup("Hello World!!!").second, 2);
+
+  EXPECT_TRUE(trie.Lookup("12").first);
+  EXPECT_TRUE(trie.Lookup("123").first);
+  EXPECT_TRUE(trie.Lookup("123456").first);
+
+  EXPECT_EQ(trie.Lookup("12").second, 3);
+  EXPECT_EQ(trie.Lookup("123").second, 3);
+  EXPECT_EQ(trie.Lookup("123456").second, 3);
+}
+
+// Whether an empty CompactTrie behaves correctly
+TEST(CompactTrieTest, Empty) {
+  CompactTrie<int32_t> trie;
+
+  EXPECT_FALSE(trie.Match("234"));
+  EXPECT_FALSE(trie.Match("H"));
+
+  EXPECT_TRUE(trie.MatchPrefix(""));
+  EXPECT_FALSE(trie.MatchPrefix(" "));
+
+  EXPECT_FALSE(trie.Lookup("234").first);
+  EXPECT_FALSE(trie.Lookup("").first);
+
+  trie.Build({{"Hello", 1, false}});
+  trie.Clear();
+  EXPECT_EQ(trie.size(), 0);
+  EXPECT_FALSE(trie.Match("Hello"));
+  EXPECT_FALSE(trie.MatchPrefix("H"));
+}
+
+// Whether a CompactTrie with the "" prefix behaves correctly
+TEST(CompactTrieTest, EmptyPrefix) {
+  CompactTrie<int32_t> trie;
+  trie.Build({{"", 2, true}});
+
+  EXPECT_TRUE(trie.Match(""));
+  EXPECT_TRUE(trie.Match("234"));
+  EXPECT_TRUE(trie.Match("H"));
+  EXPECT_TRUE(trie.MatchPrefix("Hello"));
+  EXPECT_TRUE(trie.MatchPrefix(""));
+
+  EXPECT_TRUE(trie.Lookup("Hello").first);
+  EXPECT_EQ(trie.Lookup("Hello").second, 2);
+}
+
+// Keys with bytes >= 0x80 and labels longer than a node can hold
+TEST(CompactTrieTest, LongAndBinaryKeys) {
+  CompactTrie<int32_t> trie;
+  std::string high = "a\xff\x80z";
+  std::string low = "a\x01";
+  std::string huge(100000, 'x');
+
+  trie.Build({{high, 1, false}, {low, 2, false}, {huge, 3, false}});
+
+  EXPECT_EQ(trie.Lookup(high).second, 1);
+  EXPECT_EQ(trie.Lookup(low).second, 2);
+  EXPECT_EQ(trie.Lookup(huge).second, 3);
+  EXPECT_FALSE(trie.Match(huge.substr(1)));
+  EXPECT_TRUE(trie.MatchPrefix(huge.substr(1)));
+
+  // unsigned byte order
+  auto dump = trie.Dump();
+  ASSERT_EQ(dump.size(), 3);
+  EXPECT_EQ(std::get<0>(dump[0]), low);
+  EXPECT_EQ(std::get<0>(dump[1]), high);
+  EXPECT_EQ(std::get<0>(dump[2]), huge);
+}
+
+// Test the Dump() operation
+TEST(CompactTrieTest, Dump) {
+  CompactTrie<int32_t> trie;
+
+  // Dump order is raw-key sorted (ASCII sort, shorter before longer).
+  std::vector<CompactTrie<int32_t>::Entry> expected_results = {
+      std::make_tuple("", 1, true),
+      std::make_tuple("12", 4, false),
+      std::make_tuple("Hel", 2, false),
+      std::make_tuple("Hello", 3, true),
+      std::make_tuple("Hello World", 5, true),
+  };
+
+  // Dump order should not depend on build order.
+  trie.Build({{"Hello World", 5, true},
+              {"12", 4, false},
+              {"", 1, true},
+              {"Hel", 2, false},
+              {"Hello", 3, true}});
+
+  EXPECT_EQ(expected_results, trie.Dump());
+}
+
+// Results must be the same as with Trie
+TEST(CompactTrieTest, SameAsTrie) {
+  Trie<int32_t> trie;
+  std::vector<CompactTrie<int32_t>::Entry> entries;
+  uint32_t seed = 1;
+
+  auto random_key = [&seed]() {
+    std::string key;
+    size_t len = (seed = seed * 1103515245 + 12345) % 8;
+    for (size_t i = 0; i < len; i++) {
+      key.push_back('a' + (seed = seed * 1103515245 + 12345) % 4);
+    }
+    return key;
+  };
+
+  for (int i = 0; i < 200; i++) {
+    std::string key = random_key();
+    bool prefix = (i % 7 == 0);
+    trie.Insert(key, i, prefix);
+    entries.emplace_back(key, i, prefix);
+  }
+
+  CompactTrie<int32_t> compact;
+  compact.Build(entries);
+
+  for (int i = 0; i < 1000; i++) {
+    std::string key = random_key();
+    EXPECT_EQ(trie.Match(key), compact.Match(key)) << key;
+    EXPECT_EQ(trie.MatchPrefix(key), compact.MatchPrefix(key)) << key;
+    EXPECT_EQ(trie.Lookup(key), compact.Lookup(key)) << key;
+  }
+}
+
+}  // namespace (unnamed)
@@ -252,6 +252,63 @@ class CuckooMap {
     return ret;
   }
 
+  // Return the hash value of the key, for use with Prefetch() and
+  // FindByHash(). This lets callers hash a key only once while overlapping
+  // the bucket cache misses of several lookups.
+  HashResult GetHash(const K& key, const H& hasher = H()) const {
+    return Hash(key, hasher);
+  }
+
+  // Prefetch the primary bucket of a key, given its hash value.
+  void Prefetch(HashResult primary) const {
+    __builtin_prefetch(&buckets_[primary & bucket_mask_]);
+  }
+
+  // Same as Find(), but with the hash value returned by GetHash()
+  const Entry* FindByHash(HashResult primary, const K& key,
+                          const E& eq = E()) const {
+    EntryIndex idx = FindWithHash(primary, key, eq);
+    if (idx == kInvalidEntryIdx) {
+      return nullptr;
+    }
+
+    return &entries_[idx];
+  }
+
+  // Find multiple keys at once. results[i] is set to the entry of keys[i], or
+  // nullptr if it does not exist. Lookups are pipelined in groups: all keys
+  // are hashed and their buckets prefetched first, then their entries, so
+  // that the cache misses of independent lookups overlap. This pays off for
+  // tables larger than the cache; for small tables Find() is faster.
+  void FindBatch(const K* keys, size_t n, Entry** results,
+                 const H& hasher = H(), const E& eq = E()) {
+    EntryIndex indices[kFindBatchSize];
+
+    for (size_t base = 0; base < n; base += kFindBatchSize) {
+      size_t cnt = std::min(n - base, kFindBatchSize);
+      FindBatchIndices(keys + base, cnt, indices, hasher, eq);
+      for (size_t i = 0; i < cnt; i++) {
+        results[base + i] =
+            (indices[i] == kInvalidEntryIdx) ? nullptr : &entries_[indices[i]];
+      }
+    }
+  }
+
+  // const version of FindBatch()
+  void FindBatch(const K* keys, size_t n, const Entry** results,
+                 const H& hasher = H(), const E& eq = E()) const {
+    EntryIndex indices[kFindBatchSize];
+
+    for (size_t base = 0; base < n; base += kFindBatchSize) {
+      size_t cnt = std::min(n - base, kFindBatchSize);
+      FindBatchIndices(keys + base, cnt, indices, hasher, eq);
+      for (size_t i = 0; i < cnt; i++) {
+        results[base + i] =
+            (indices[i] == kInvalidEntryIdx) ? nullptr : &entries_[indices[i]];
+      }
+    }
+  }
+
   // Remove the stored entry by the key
   // Return false if not exist.
   bool Remove(const K& key, const H& hasher = H(), const E& eq = E()) {
@@ -300,6 +357,9 @@ class CuckooMap {
   // of insertion will grow exponentially, so be careful.
   static const int kMaxCuckooPath = 3;
 
+  // The number of lookups FindBatch() keeps in flight
+  static const size_t kFindBatchSize = 32;
+
   /* non-tunable macros */
   static const EntryIndex kInvalidEntryIdx =
       std::numeric_limits<EntryIndex>::max();
@@ -444,6 +504,54 @@ class CuckooMap {
     return -1;
   }
 
+  // Return the entry index of the first slot in the bucket whose hash value
+  // matches, without comparing keys. Return kInvalidEntryIdx if none.
+  EntryIndex FindTag(const Bucket& bucket, HashResult primary) const {
+    for (int i = 0; i < kEntriesPerBucket; i++) {
+      if (bucket.hash_values[i] == primary) {
+        return bucket.entry_indices[i];
+      }
+    }
+    return kInvalidEntryIdx;
+  }
+
+  // Look up cnt (<= kFindBatchSize) keys in three stages, prefetching the
+  // data needed by the next stage for all keys before moving on to it.
+  void FindBatchIndices(const K* keys, size_t cnt, EntryIndex* indices,
+                        const H& hasher, const E& eq) const {
+    HashResult primary[kFindBatchSize];
+
+    // Stage 1: hash keys and prefetch their primary buckets. Most keys are
+    // found there, so prefetching secondary buckets as well costs more memory
+    // bandwidth than it saves.
+    for (size_t i = 0; i < cnt; i++) {
+      primary[i] = Hash(keys[i], hasher);
+      __builtin_prefetch(&buckets_[primary[i] & bucket_mask_]);
+    }
+
+    // Stage 2: match hash values in the buckets and prefetch the entries
+    for (size_t i = 0; i < cnt; i++) {
+      EntryIndex idx = FindTag(buckets_[primary[i] & bucket_mask_], primary[i]);
+      if (idx == kInvalidEntryIdx) {
+        idx = FindTag(buckets_[HashSecondary(primary[i]) & bucket_mask_],
+                      primary[i]);
+      }
+      if (idx != kInvalidEntryIdx) {
+        __builtin_prefetch(&entries_[idx]);
+      }
+      indices[i] = idx;
+    }
+
+    // Stage 3: compare keys. Different keys may share the same hash value,
+    // in which case we fall back to the full lookup.
+    for (size_t i = 0; i < cnt; i++) {
+      if (indices[i] != kInvalidEntryIdx &&
+          unlikely(!Eq(entries_[indices[i]].first, keys[i], eq))) {
+        indices[i] = FindWithHash(primary[i], keys[i], eq);
+      }
+    }
+  }
+
   // Recursively try making an empty slot in the bucket
   // Returns a slot index in [0, kEntriesPerBucket) for successful operation,
   // or -1 if failed.
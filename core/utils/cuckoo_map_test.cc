@@ -86,6 +86,7 @@ struct std::hash<MoveConstructorOnly> {
 namespace {
 
 using bess::utils::CuckooMap;
+using bess::utils::HashResult;
 
 // Test Insert function
 TEST(CuckooMapTest, Insert) {
@@ -169,6 +170,47 @@ TEST(CuckooMapTest, Find) {
   EXPECT_EQ(cuckoo.Find(4), nullptr);
 }
 
+// Test FindByHash function
+TEST(CuckooMapTest, FindByHash) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+
+  cuckoo.Insert(1, 99);
+  cuckoo.Insert(2, 98);
+
+  HashResult hash1 = cuckoo.GetHash(1);
+  HashResult hash3 = cuckoo.GetHash(3);
+  cuckoo.Prefetch(hash1);
+  cuckoo.Prefetch(hash3);
+
+  EXPECT_EQ(cuckoo.FindByHash(hash1, 1)->second, 99);
+  EXPECT_EQ(cuckoo.FindByHash(cuckoo.GetHash(2), 2)->second, 98);
+  EXPECT_EQ(cuckoo.FindByHash(hash3, 3), nullptr);
+}
+
+// Test FindBatch function
+TEST(CuckooMapTest, FindBatch) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+  std::vector<uint32_t> keys;
+
+  for (uint32_t i = 0; i < 100; i++) {
+    cuckoo.Insert(i * 2, i);
+    keys.push_back(i);  // only even numbers exist
+  }
+
+  std::vector<std::pair<uint32_t, uint16_t> *> results(keys.size());
+  cuckoo.FindBatch(keys.data(), keys.size(), results.data());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (keys[i] % 2 == 0) {
+      ASSERT_NE(results[i], nullptr);
+      EXPECT_EQ(results[i]->first, keys[i]);
+      EXPECT_EQ(results[i]->second, keys[i] / 2);
+    } else {
+      EXPECT_EQ(results[i], nullptr);
+    }
+  }
+}
+
 // Test Remove function
 TEST(CuckooMapTest, Remove) {
   CuckooMap<uint32_t, uint16_t> cuckoo;
@@ -262,6 +304,19 @@ TEST(CuckooMapTest, CollisionTest) {
     CHECK_NOTNULL(ret);
     EXPECT_EQ(i + 100, ret->second);
   }
+
+  int keys[n + 1];
+  std::pair<int, int> *results[n + 1];
+  for (int i = 0; i <= n; i++) {
+    keys[i] = n - i;
+  }
+
+  cuckoo.FindBatch(keys, n + 1, results);
+  EXPECT_EQ(nullptr, results[0]);
+  for (int i = 1; i <= n; i++) {
+    CHECK_NOTNULL(results[i]);
+    EXPECT_EQ(keys[i] + 100, results[i]->second);
+  }
 }
 
 // RandomTest
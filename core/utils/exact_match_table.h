@@ -31,6 +31,7 @@
 #ifndef BESS_UTILS_EXACT_MATCH_TABLE_H_
 #define BESS_UTILS_EXACT_MATCH_TABLE_H_
 
+#include <algorithm>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -313,6 +314,14 @@ class ExactMatchTable {
     return DoAddField(f, mt_attr_name, idx, m);
   }
 
+  // Copy the field layout, but not the rules, of `other` into this table.
+  void CopyFields(const ExactMatchTable &other) {
+    raw_key_size_ = other.raw_key_size_;
+    total_key_size_ = other.total_key_size_;
+    num_fields_ = other.num_fields_;
+    std::copy(other.fields_, other.fields_ + MAX_FIELDS, fields_);
+  }
+
   size_t num_fields() const { return num_fields_; }
 
   // Returns the ith field.
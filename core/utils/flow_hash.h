@@ -0,0 +1,76 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_UTILS_FLOW_HASH_H_
+#define BESS_UTILS_FLOW_HASH_H_
+
+#include <rte_hash_crc.h>
+
+#include "../packet.h"
+
+namespace bess {
+namespace utils {
+
+// Hash of the IPv4 5-tuple of an untagged Ethernet frame. Symmetric: both
+// directions of a connection have the same hash.
+static inline uint32_t SoftwareL4Hash(const bess::Packet *pkt) {
+  const int ip_offset = 14;
+
+  const char *ip = pkt->head_data<const char *>(ip_offset);
+  const char *l4 = ip + ((*reinterpret_cast<const uint8_t *>(ip) & 0x0F) << 2);
+
+  uint32_t v0 = *reinterpret_cast<const uint32_t *>(ip + 12);  // src IP
+  v0 ^= *reinterpret_cast<const uint32_t *>(ip + 16);          // dst IP
+  v0 ^= *reinterpret_cast<const uint16_t *>(l4);               // src port
+  v0 ^= *reinterpret_cast<const uint16_t *>(l4 + 2);           // dst port
+  v0 ^= *reinterpret_cast<const uint8_t *>(ip + 9);            // protocol
+
+#if __x86_64
+  return crc32c_sse42_u32(v0, 0);
+#else
+  return crc32c_1word(v0, 0);
+#endif
+}
+
+// Per-flow hash of a packet: the RSS hash computed by the NIC if available,
+// or SoftwareL4Hash() otherwise (e.g., for packets from UnixSocketPort,
+// PCAPPort or VPort). The two differ for the same flow, so a flow should
+// enter through a single kind of port.
+static inline uint32_t FlowHash(const bess::Packet *pkt) {
+  if (pkt->has_rss_hash()) {
+    return pkt->rss_hash();
+  }
+  return SoftwareL4Hash(pkt);
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_FLOW_HASH_H_
@@ -42,6 +42,78 @@
 
 #include <glog/logging.h>
 
+// Summary of a histogram
+template <typename T>
+struct HistogramSummary {
+  size_t count;        // # of all samples. If 0, min, max and avg are also 0
+  size_t above_range;  // # of samples beyond the histogram range
+  T min;               // Min value
+  T max;               // Max value. May be underestimated if above_range > 0
+  T avg;               // Average of all samples (== total / count)
+  T total;             // Total sum of all samples
+  std::vector<T> percentile_values;
+};
+
+// Summarizes histogram buckets, the last of which counts samples above the
+// range. value(i) returns the representative value of bucket i. See
+// Histogram::Summarize() for the definition of percentiles.
+template <typename T, typename F>
+HistogramSummary<T> SummarizeBuckets(
+    const std::vector<std::atomic<uint64_t>> &buckets, F value,
+    const std::vector<double> &percentiles) {
+  HistogramSummary<T> ret = {};
+  uint64_t count =
+      std::accumulate(buckets.begin(), buckets.end(), uint64_t{0});
+  ret.count = count;
+  ret.above_range = buckets.back();
+  ret.percentile_values = std::vector<T>(percentiles.size());
+
+  bool found_min = false;
+  size_t count_so_far = 0;
+  T total = 0;
+  auto percentile_it = percentiles.cbegin();
+  auto percentile_value_it = ret.percentile_values.begin();
+
+  for (size_t i = 0; i < buckets.size(); i++) {
+    T val = value(i);
+    T freq = buckets[i];
+    total += val * freq;
+    count_so_far += freq;
+
+    if (freq > 0) {
+      if (!found_min) {
+        ret.min = val;
+        found_min = true;
+      }
+      ret.max = val;
+
+      while (percentile_it != percentiles.end()) {
+        DCHECK_LE(0.0, *percentile_it);
+        DCHECK_LE(*percentile_it, 100.0);
+
+        // Perform integer comparison first for the special case 100'th %-ile
+        if (count_so_far < count &&
+            (count_so_far * 100.0) / count - *percentile_it <
+                std::numeric_limits<double>::epsilon()) {
+          break;
+        }
+
+        *percentile_value_it = val;
+        percentile_value_it++;
+        percentile_it++;
+
+        // should be monotonic
+        DCHECK(percentile_it == percentiles.end() ||
+               *(percentile_it - 1) < *percentile_it);
+      }
+    }
+  }
+
+  ret.avg = (count > 0) ? total / count : 0;
+  ret.total = total;
+  return ret;
+}
+
 // Class for general purpose histogram. T generally should be an
 // integral type, though floating point types will also work.
 // A bin b_i corresponds for the range [i * width, (i + 1) * width)
@@ -51,15 +123,7 @@ template <typename T = uint64_t>
 class Histogram {
  public:
   static_assert(std::is_arithmetic<T>::value, "Arithmetic type required.");
-  struct Summary {
-    size_t count;        // # of all samples. If 0, min, max and avg are also 0
-    size_t above_range;  // # of samples beyond the histogram range
-    T min;               // Min value
-    T max;               // Max value. May be underestimated if above_range > 0
-    T avg;               // Average of all samples (== total / count)
-    T total;             // Total sum of all samples
-    std::vector<T> percentile_values;
-  };
+  typedef HistogramSummary<T> Summary;
 
   // Construct a new histogram with "num_buckets" buckets of width
   // "bucket_width".
@@ -112,6 +176,30 @@ class Histogram {
     buckets_[index].fetch_add(1);
   }
 
+  // Adds the counts of "other", which must have the same buckets, to this
+  // histogram. "other" may be updated concurrently, but this one may not.
+  void Add(const Histogram &other) {
+    DCHECK_EQ(buckets_.size(), other.buckets_.size());
+    DCHECK_EQ(bucket_width_, other.bucket_width_);
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) +
+                            other.buckets_[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+  }
+
+  // Subtracts the counts of "other", e.g., an earlier snapshot of this
+  // histogram, which must have the same buckets and no greater counts.
+  void Subtract(const Histogram &other) {
+    DCHECK_EQ(buckets_.size(), other.buckets_.size());
+    DCHECK_EQ(bucket_width_, other.bucket_width_);
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) -
+                            other.buckets_[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+  }
+
   // Returns the summary of the histogram.
   // "percentiles" is a vector of doubles, whose values are in the range of
   // [0.0, 100.0] and monotonically increasing. E.g., {50.0, 90.0, 99.0, 99.9}
@@ -123,65 +211,19 @@ class Histogram {
   // Each of percentiles is calculated and its value is returned in
   // percentile_values
   const Summary Summarize(const std::vector<double> &percentiles = {}) const {
-    Summary ret = {};
-    uint64_t count = std::accumulate(buckets_.begin(), buckets_.end(), 0);
-    ret.count = count;
-    ret.above_range = buckets_.back();
-    ret.percentile_values = std::vector<T>(percentiles.size());
-
-    bool found_min = false;
-    size_t count_so_far = 0;
-    T total = 0;
-    auto percentile_it = percentiles.cbegin();
-    auto percentile_value_it = ret.percentile_values.begin();
-
-    for (size_t i = 0; i < buckets_.size(); i++) {
-      T val = i * bucket_width_;
-      T freq = buckets_[i];
-      total += val * freq;
-      count_so_far += freq;
-
-      if (freq > 0) {
-        if (!found_min) {
-          ret.min = val;
-          found_min = true;
-        }
-        ret.max = val;
-
-        while (percentile_it != percentiles.end()) {
-          DCHECK_LE(0.0, *percentile_it);
-          DCHECK_LE(*percentile_it, 100.0);
-
-          // Perform integer comparison first for the special case 100'th %-ile
-          if (count_so_far < count &&
-              (count_so_far * 100.0) / count - *percentile_it <
-                  std::numeric_limits<double>::epsilon()) {
-            break;
-          }
-
-          *percentile_value_it = val;
-          percentile_value_it++;
-          percentile_it++;
-
-          // should be monotonic
-          DCHECK(percentile_it == percentiles.end() ||
-                 *(percentile_it - 1) < *percentile_it);
-        }
-      }
-    }
-
-    ret.avg = (count > 0) ? total / count : 0;
-    ret.total = total;
-    return ret;
+    return SummarizeBuckets<T>(
+        buckets_, [this](size_t i) -> T { return i * bucket_width_; },
+        percentiles);
   }
 
   size_t num_buckets() const { return buckets_.size(); }
   T bucket_width() const { return bucket_width_; }
 
-  size_t max_num_buckets() const {
+  static size_t max_num_buckets() {
     // This constant is mainly to keep resets to a reasonable speed.
     const size_t max_buckets = 10'000'000;
-    return std::min(max_buckets, buckets_.max_size());
+    return std::min(max_buckets,
+                    std::vector<std::atomic<uint64_t>>().max_size());
   }
 
   // Resets all counters, and the count of such counters.
@@ -201,4 +243,159 @@ class Histogram {
   std::vector<std::atomic<uint64_t>> buckets_;
 };
 
+// Log-linear (HDR-style) histogram of non-negative integers, for values
+// spanning many orders of magnitude such as latencies. Values are counted in
+// units of "resolution". Each power-of-two range of values [2^e, 2^(e+1)) is
+// split into 2^precision_bits buckets of equal width, so the relative error of
+// a value is below 2^-precision_bits, while values below
+// 2^(precision_bits + 1) units are exact. Like Histogram, the lower bound of a
+// bucket is used as its representative value, and the last bucket counts
+// values above max_value, represented by max_value.
+//
+// Memory is proportional to log2(max_value / resolution), e.g., 1792 buckets
+// (14KB) for up to 100ms at 100ns resolution, with precision_bits = 7.
+template <typename T = uint64_t>
+class LogHistogram {
+ public:
+  static_assert(std::is_integral<T>::value, "Integral type required.");
+  typedef HistogramSummary<T> Summary;
+
+  static const int kDefaultPrecisionBits = 7;  // < 1% error
+
+  LogHistogram(T max_value, T resolution,
+               int precision_bits = kDefaultPrecisionBits) {
+    Resize(max_value, resolution, precision_bits);
+  }
+
+  void swap(LogHistogram &other) noexcept {
+    using std::swap;
+    swap(resolution_, other.resolution_);
+    swap(max_value_, other.max_value_);
+    swap(precision_bits_, other.precision_bits_);
+    swap(buckets_, other.buckets_);
+  }
+
+  LogHistogram(LogHistogram &&other) noexcept
+      : resolution_(other.resolution_),
+        max_value_(other.max_value_),
+        precision_bits_(other.precision_bits_),
+        buckets_(std::move(other.buckets_)) {}
+
+  LogHistogram &operator=(LogHistogram &&other) noexcept {
+    resolution_ = other.resolution_;
+    max_value_ = other.max_value_;
+    precision_bits_ = other.precision_bits_;
+    buckets_ = std::move(other.buckets_);
+    return *this;
+  }
+
+  // Inserts x into the histogram.
+  // Note: this particular insert is NOT atomic.
+  void Insert(T x) {
+    size_t index = BucketIndex(x);
+    buckets_[index].store(1 + buckets_[index].load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  }
+
+  // Inserts x into the histogram.
+  // Note: this particular insert IS atomic.
+  void AtomicInsert(T x) { buckets_[BucketIndex(x)].fetch_add(1); }
+
+  // Adds the counts of "other", which must have the same buckets, to this
+  // histogram. "other" may be updated concurrently, but this one may not.
+  void Add(const LogHistogram &other) {
+    DCHECK_EQ(buckets_.size(), other.buckets_.size());
+    DCHECK_EQ(resolution_, other.resolution_);
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) +
+                            other.buckets_[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+  }
+
+  // Subtracts the counts of "other", e.g., an earlier snapshot of this
+  // histogram, which must have the same buckets and no greater counts.
+  void Subtract(const LogHistogram &other) {
+    DCHECK_EQ(buckets_.size(), other.buckets_.size());
+    DCHECK_EQ(resolution_, other.resolution_);
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) -
+                            other.buckets_[i].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+  }
+
+  // Returns the summary of the histogram. See Histogram::Summarize().
+  const Summary Summarize(const std::vector<double> &percentiles = {}) const {
+    return SummarizeBuckets<T>(
+        buckets_, [this](size_t i) -> T { return BucketValue(i); },
+        percentiles);
+  }
+
+  size_t num_buckets() const { return buckets_.size(); }
+  T resolution() const { return resolution_; }
+  T max_value() const { return max_value_; }
+
+  // Resets all counters. Note that the number of buckets remains unchanged.
+  void Reset() {
+    for (auto &bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Resize the histogram.  Note that this resets it.
+  void Resize(T max_value, T resolution,
+              int precision_bits = kDefaultPrecisionBits) {
+    CHECK_GT(resolution, 0);
+    CHECK_GE(precision_bits, 0);
+    CHECK_LT(precision_bits, 32);
+
+    resolution_ = resolution;
+    max_value_ = max_value;
+    precision_bits_ = precision_bits;
+
+    // Buckets up to that of max_value, and one for values above
+    size_t num_buckets = BucketIndex(max_value) + 2;
+    buckets_ = std::vector<std::atomic<uint64_t>>(num_buckets);
+  }
+
+ private:
+  // Returns the index of the bucket for x, or of the last bucket if x is
+  // above max_value_
+  size_t BucketIndex(T x) const {
+    if (x > max_value_) {
+      return buckets_.size() - 1;
+    }
+
+    uint64_t v = x / resolution_;
+    if (v < (uint64_t{2} << precision_bits_)) {
+      return v;
+    }
+
+    // v is in [2^e, 2^(e+1)), where e > precision_bits_
+    int shift = 63 - __builtin_clzll(v) - precision_bits_;
+    return (static_cast<size_t>(shift + 1) << precision_bits_) + (v >> shift) -
+           (uint64_t{1} << precision_bits_);
+  }
+
+  // Returns the lowest value of bucket i, or max_value_ for the last one
+  T BucketValue(size_t i) const {
+    if (i == buckets_.size() - 1) {
+      return max_value_;
+    }
+    if (i < (size_t{2} << precision_bits_)) {
+      return i * resolution_;
+    }
+
+    int shift = (i >> precision_bits_) - 1;
+    uint64_t sub = i & ((uint64_t{1} << precision_bits_) - 1);
+    return (((uint64_t{1} << precision_bits_) + sub) << shift) * resolution_;
+  }
+
+  T resolution_;
+  T max_value_;
+  int precision_bits_;
+  std::vector<std::atomic<uint64_t>> buckets_;
+};
+
 #endif  // BESS_UTILS_HISTOGRAM_H_
@@ -31,6 +31,9 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <random>
+
 namespace {
 
 TEST(HistogramTest, U32Quartiles) {
@@ -78,4 +81,131 @@ TEST(HistogramTest, DoubleQuartiles) {
   EXPECT_DOUBLE_EQ(6.0, ret.percentile_values[3]);  // 100th percentile
 }
 
+// Merging shards gives the same summary as a single histogram, and subtracting
+// a snapshot leaves only what came after it.
+TEST(HistogramTest, AddSubtract) {
+  Histogram<uint32_t> shard0(1000, 1);
+  Histogram<uint32_t> shard1(1000, 1);
+  Histogram<uint32_t> all(1000, 1);
+
+  for (uint32_t x : {1, 2, 3}) {
+    shard0.Insert(x);
+    all.Insert(x);
+  }
+  for (uint32_t x : {4, 5, 1002}) {
+    shard1.Insert(x);
+    all.Insert(x);
+  }
+
+  Histogram<uint32_t> merged(1000, 1);
+  merged.Add(shard0);
+  merged.Add(shard1);
+
+  auto expected = all.Summarize({25.0, 50.0, 75.0, 100.0});
+  auto ret = merged.Summarize({25.0, 50.0, 75.0, 100.0});
+  EXPECT_EQ(expected.count, ret.count);
+  EXPECT_EQ(expected.above_range, ret.above_range);
+  EXPECT_EQ(expected.min, ret.min);
+  EXPECT_EQ(expected.max, ret.max);
+  EXPECT_EQ(expected.total, ret.total);
+  EXPECT_EQ(expected.percentile_values, ret.percentile_values);
+
+  merged.Subtract(shard0);
+  ret = merged.Summarize();
+  EXPECT_EQ(3, ret.count);
+  EXPECT_EQ(4, ret.min);
+  EXPECT_EQ(1000, ret.max);
+}
+
+// Small values are exact, and the rest fall into log-linear buckets.
+TEST(LogHistogramTest, Buckets) {
+  LogHistogram<uint64_t> hist(1'000'000, 1, 2);
+
+  // 0..7 are exact, then 4 buckets per power of two: 8, 10, 12, 14, 16, 20...
+  // 1'000'001 is above the range.
+  for (uint64_t x : {0, 1, 7, 8, 9, 10, 15, 16, 19, 20, 1'000'000, 1'000'001}) {
+    hist.Insert(x);
+  }
+
+  auto ret = hist.Summarize({10.0, 30.0, 50.0, 70.0, 80.0, 90.0});
+  EXPECT_EQ(12, ret.count);
+  EXPECT_EQ(1, ret.above_range);
+  EXPECT_EQ(0, ret.min);
+  EXPECT_EQ(1, ret.percentile_values[0]);
+  EXPECT_EQ(8, ret.percentile_values[1]);   // 8 and 9
+  EXPECT_EQ(14, ret.percentile_values[2]);  // 15
+  EXPECT_EQ(16, ret.percentile_values[3]);  // 16 and 19
+  EXPECT_EQ(20, ret.percentile_values[4]);  // 20
+  EXPECT_EQ((1 << 19) + 3 * (1 << 17), ret.percentile_values[5]);
+  EXPECT_EQ(1'000'000, ret.max);  // above the range
+
+  // 1'000'000 falls in [2^19 + 3 * 2^17, 2^20)
+  hist.Reset();
+  hist.Insert(999'999);
+  EXPECT_EQ((1 << 19) + 3 * (1 << 17), hist.Summarize().max);
+}
+
+// Percentiles must be within the relative error bound of those of a Histogram
+// with a bucket per unit, for a long-tailed distribution.
+TEST(LogHistogramTest, PercentileError) {
+  const uint64_t max_ns = 100'000'000;
+  const uint64_t resolution_ns = 100;
+  const std::vector<double> percentiles = {1.0,  10.0, 25.0, 50.0,  75.0,
+                                           90.0, 99.0, 99.9, 100.0};
+
+  Histogram<uint64_t> flat(max_ns / resolution_ns, resolution_ns);
+  LogHistogram<uint64_t> log(max_ns, resolution_ns);
+
+  // 1792 buckets (+2), instead of a million
+  EXPECT_LE(log.num_buckets(), 1800);
+
+  std::mt19937_64 rng(0);
+  std::lognormal_distribution<double> dist(std::log(20'000.0), 1.5);
+  for (int i = 0; i < 100'000; i++) {
+    uint64_t x = std::min<uint64_t>(dist(rng), max_ns - 1);
+    flat.Insert(x);
+    log.Insert(x);
+  }
+
+  auto expected = flat.Summarize(percentiles);
+  auto ret = log.Summarize(percentiles);
+  const double max_error = 1.0 / (1 << LogHistogram<>::kDefaultPrecisionBits);
+
+  EXPECT_EQ(expected.count, ret.count);
+  EXPECT_EQ(expected.above_range, ret.above_range);
+  EXPECT_EQ(expected.min, ret.min);
+  EXPECT_NEAR(expected.max, ret.max, expected.max * max_error);
+  EXPECT_NEAR(expected.avg, ret.avg, expected.avg * max_error);
+  for (size_t i = 0; i < percentiles.size(); i++) {
+    EXPECT_LE(ret.percentile_values[i], expected.percentile_values[i])
+        << percentiles[i];
+    EXPECT_NEAR(expected.percentile_values[i], ret.percentile_values[i],
+                expected.percentile_values[i] * max_error)
+        << percentiles[i];
+  }
+}
+
+TEST(LogHistogramTest, AddSubtract) {
+  LogHistogram<uint64_t> shard0(1'000'000, 10);
+  LogHistogram<uint64_t> shard1(1'000'000, 10);
+  LogHistogram<uint64_t> merged(1'000'000, 10);
+
+  shard0.Insert(5);
+  shard0.Insert(123'456);
+  shard1.AtomicInsert(2'000'000);
+
+  merged.Add(shard0);
+  merged.Add(shard1);
+  auto ret = merged.Summarize();
+  EXPECT_EQ(3, ret.count);
+  EXPECT_EQ(1, ret.above_range);
+  EXPECT_EQ(0, ret.min);
+
+  merged.Subtract(shard1);
+  ret = merged.Summarize({100.0});
+  EXPECT_EQ(2, ret.count);
+  EXPECT_EQ(0, ret.above_range);
+  EXPECT_NEAR(123'456, ret.percentile_values[0], 123'456 / 128);
+}
+
 }  // namespace (unnamed)
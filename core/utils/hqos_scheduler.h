@@ -0,0 +1,595 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_HQOS_SCHEDULER_H_
+#define BESS_UTILS_HQOS_SCHEDULER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "timer_wheel.h"
+
+namespace bess {
+namespace utils {
+
+// A hierarchical packet scheduler for subscriber shaping, along the lines of
+// DPDK's librte_sched: port -> subports -> pipes -> traffic classes -> queues.
+//
+// * The port, every subport, and every pipe is shaped by a token bucket.
+// * Within a subport, pipes with packets are served in Deficit Round Robin
+//   order; subports with such pipes are served round robin.
+// * Each pipe has kTrafficClasses traffic classes of kQueuesPerClass queues.
+//   Traffic classes are strictly prioritized (0 is the highest), and the
+//   queues of a traffic class are served round robin.
+//
+// Only pipes (and subports) with packets that may be sent right away are
+// visited, so the cost of Dequeue() does not depend on the number of pipes.
+// When a pipe or subport runs out of tokens, it leaves the round robin and is
+// scheduled on a timer wheel for the time when it will have enough tokens for
+// its next packet; token buckets are only refilled when they are checked.
+//
+// Packets are held in a descriptor pool shared by all queues, allocated on
+// construction. T is the packet type, providing total_len(). Not thread-safe.
+template <typename T>
+class HQoSScheduler {
+ public:
+  static const int kTrafficClasses = 4;
+  static const int kQueuesPerClass = 4;
+  static const int kQueuesPerPipe = kTrafficClasses * kQueuesPerClass;
+
+  // Preamble, IFG, and CRC, which the wire rate must account for
+  static const uint32_t kFrameOverhead = 24;
+
+  // Granularity of token refill timers
+  static const uint64_t kTimerTickNs = 10000;
+
+  struct Config {
+    uint32_t num_subports;
+    uint32_t pipes_per_subport;
+    uint32_t queue_size;   // max # of packets in each queue
+    uint32_t max_packets;  // max # of packets over all queues
+    uint32_t quantum;      // bytes a pipe may send on each round
+  };
+
+  // A token bucket of 'rate' bytes per second, holding up to 'burst' bytes.
+  // Rate 0 means unlimited.
+  struct Profile {
+    uint64_t rate;
+    uint64_t burst;
+  };
+
+  struct Stats {
+    uint64_t enqueued;
+    uint64_t dequeued;
+    uint64_t queue_drops;    // dropped as their queue was full
+    uint64_t pool_drops;     // dropped as the descriptor pool was empty
+    uint64_t pipe_throttles;     // # of times a pipe ran out of tokens
+    uint64_t subport_throttles;  // # of times a subport ran out of tokens
+  };
+
+  explicit HQoSScheduler(const Config &config)
+      : config_(config),
+        num_pipes_(config.num_subports * config.pipes_per_subport),
+        port_(),
+        port_bucket_(),
+        subports_(config.num_subports),
+        pipes_(num_pipes_),
+        queues_(static_cast<size_t>(num_pipes_) * kQueuesPerPipe),
+        descs_(config.max_packets),
+        free_desc_(kNone),
+        backlog_(),
+        pipe_profiles_(1),
+        active_(),
+        wheel_(kTimerTickNs),
+        stats_() {
+    CHECK_GT(config.num_subports, 0);
+    CHECK_GT(config.pipes_per_subport, 0);
+    CHECK_GT(config.quantum, 0);
+
+    for (Subport &s : subports_) {
+      s.profile = {0, 0, 0};
+      s.bucket = {0, 0};
+      s.pipes = {kNone, kNone};
+      s.next = kNone;
+      s.state = kIdle;
+    }
+
+    for (Pipe &p : pipes_) {
+      p.bucket = {0, 0};
+      p.next = kNone;
+      p.profile = 0;
+      p.packets = 0;
+      p.deficit = 0;
+      p.nonempty = 0;
+      p.state = kIdle;
+      std::fill(p.rr, p.rr + kTrafficClasses, 0);
+    }
+
+    for (Queue &q : queues_) {
+      q = {kNone, kNone, 0};
+    }
+
+    for (uint32_t i = 0; i < config.max_packets; i++) {
+      descs_[i].pkt = nullptr;
+      descs_[i].next = (i + 1 < config.max_packets) ? i + 1 : kNone;
+    }
+    free_desc_ = config.max_packets ? 0 : kNone;
+
+    active_ = {kNone, kNone};
+  }
+
+  void SetPortProfile(const Profile &profile) {
+    port_ = MakeBucketProfile(profile);
+    port_bucket_ = {port_.burst_nb, 0};
+  }
+
+  // Returns false if the subport does not exist
+  bool SetSubportProfile(uint32_t subport, const Profile &profile) {
+    if (subport >= config_.num_subports) {
+      return false;
+    }
+    Subport &s = subports_[subport];
+    s.profile = MakeBucketProfile(profile);
+    s.bucket = {s.profile.burst_nb, 0};
+    return true;
+  }
+
+  // Returns the index of the new pipe profile. Profile 0, which all pipes
+  // start with, is unlimited.
+  uint32_t AddPipeProfile(const Profile &profile) {
+    pipe_profiles_.push_back(MakeBucketProfile(profile));
+    return pipe_profiles_.size() - 1;
+  }
+
+  // Returns false if the pipe or the profile does not exist
+  bool SetPipeProfile(uint32_t pipe, uint32_t profile) {
+    if (pipe >= num_pipes_ || profile >= pipe_profiles_.size()) {
+      return false;
+    }
+    Pipe &p = pipes_[pipe];
+    p.profile = profile;
+    p.bucket = {pipe_profiles_[profile].burst_nb, 0};
+    return true;
+  }
+
+  // Queues the packet on 'queue' (0 to kQueuesPerPipe - 1; the traffic class
+  // is queue / kQueuesPerClass) of 'pipe' (subport * pipes_per_subport +
+  // the pipe index in the subport). Returns false if the packet was not
+  // queued, in which case the caller still owns it.
+  bool Enqueue(T *pkt, uint32_t pipe, uint32_t queue) {
+    DCHECK_LT(pipe, num_pipes_);
+    DCHECK_LT(queue, static_cast<uint32_t>(kQueuesPerPipe));
+
+    Queue &q = queues_[static_cast<size_t>(pipe) * kQueuesPerPipe + queue];
+    if (q.len >= config_.queue_size) {
+      stats_.queue_drops++;
+      return false;
+    }
+
+    uint32_t d = free_desc_;
+    if (d == kNone) {
+      stats_.pool_drops++;
+      return false;
+    }
+    free_desc_ = descs_[d].next;
+    descs_[d] = {pkt, kNone};
+
+    if (q.tail == kNone) {
+      q.head = d;
+    } else {
+      descs_[q.tail].next = d;
+    }
+    q.tail = d;
+    q.len++;
+
+    Pipe &p = pipes_[pipe];
+    p.nonempty |= 1 << queue;
+    p.packets++;
+    backlog_++;
+    stats_.enqueued++;
+
+    if (p.state == kIdle) {
+      Activate(pipe);
+    }
+    return true;
+  }
+
+  // Dequeues up to 'cnt' packets into 'pkts' as of 'now_ns', which must not go
+  // backwards. Returns the number of packets, and their total size in
+  // '*bytes'.
+  size_t Dequeue(T **pkts, size_t cnt, uint64_t now_ns, uint64_t *bytes) {
+    size_t n = 0;
+    uint64_t total_bytes = 0;
+
+    wheel_.Advance(now_ns, [this](uint32_t id) { Wake(id); });
+
+    while (n < cnt && active_.head != kNone) {
+      uint32_t s = active_.head;
+      Subport &subport = subports_[s];
+      uint32_t pipe_idx = subport.pipes.head;
+      Pipe &p = pipes_[pipe_idx];
+      Queue *queues = &queues_[static_cast<size_t>(pipe_idx) * kQueuesPerPipe];
+
+      // Serve the pipe at the head of the subport at the head of the port
+      // until it is empty, its deficit runs out, or something runs out of
+      // tokens.
+      while (true) {
+        if (p.nonempty == 0) {
+          p.state = kIdle;
+          PopFront(&subport.pipes);
+          PopFrontSubport();
+          if (subport.pipes.head == kNone) {
+            subport.state = kIdle;
+          } else {
+            PushBackSubport(s);
+          }
+          break;
+        }
+
+        uint32_t qi = PickQueue(p);
+        Queue &q = queues[qi];
+        T *pkt = descs_[q.head].pkt;
+        uint32_t len = pkt->total_len() + kFrameOverhead;
+
+        if (static_cast<int64_t>(len) > p.deficit) {
+          p.deficit += config_.quantum;
+          PopFront(&subport.pipes);
+          PushBack(&subport.pipes, pipe_idx);
+          PopFrontSubport();
+          PushBackSubport(s);
+          break;
+        }
+
+        uint64_t need_nb = len * kNsPerSec;
+
+        const BucketProfile &pipe_profile = pipe_profiles_[p.profile];
+        if (!Conform(&p.bucket, pipe_profile, need_nb, now_ns)) {
+          stats_.pipe_throttles++;
+          p.state = kThrottled;
+          PopFront(&subport.pipes);
+          wheel_.Schedule(now_ns + WaitNs(p.bucket, pipe_profile, need_nb),
+                          pipe_idx);
+          PopFrontSubport();
+          if (subport.pipes.head == kNone) {
+            subport.state = kIdle;
+          } else {
+            PushBackSubport(s);
+          }
+          break;
+        }
+
+        if (!Conform(&subport.bucket, subport.profile, need_nb, now_ns)) {
+          stats_.subport_throttles++;
+          subport.state = kThrottled;
+          PopFrontSubport();
+          wheel_.Schedule(
+              now_ns + WaitNs(subport.bucket, subport.profile, need_nb),
+              kSubportFlag | s);
+          break;
+        }
+
+        if (!Conform(&port_bucket_, port_, need_nb, now_ns)) {
+          goto out;  // retry on the next call
+        }
+
+        Consume(&p.bucket, pipe_profile, need_nb);
+        Consume(&subport.bucket, subport.profile, need_nb);
+        Consume(&port_bucket_, port_, need_nb);
+        p.deficit -= len;
+
+        uint32_t d = q.head;
+        q.head = descs_[d].next;
+        if (--q.len == 0) {
+          q.tail = kNone;
+          p.nonempty &= ~(1 << qi);
+        }
+        descs_[d].pkt = nullptr;
+        descs_[d].next = free_desc_;
+        free_desc_ = d;
+        p.packets--;
+        backlog_--;
+
+        pkts[n++] = pkt;
+        total_bytes += len - kFrameOverhead;
+        if (n == cnt) {
+          goto out;  // the pipe resumes at the head on the next call
+        }
+      }
+    }
+
+  out:
+    stats_.dequeued += n;
+    *bytes = total_bytes;
+    return n;
+  }
+
+  // Removes all queued packets, calling f(pkt) for each of them
+  template <typename F>
+  void Flush(F &&f) {
+    for (size_t i = 0; i < queues_.size(); i++) {
+      Queue &q = queues_[i];
+      for (uint32_t d = q.head; d != kNone;) {
+        uint32_t next = descs_[d].next;
+        f(descs_[d].pkt);
+        descs_[d].pkt = nullptr;
+        descs_[d].next = free_desc_;
+        free_desc_ = d;
+        d = next;
+      }
+      q = {kNone, kNone, 0};
+    }
+
+    for (Pipe &p : pipes_) {
+      p.packets = 0;
+      p.nonempty = 0;
+    }
+    backlog_ = 0;
+  }
+
+  const Stats &stats() const { return stats_; }
+  void ClearStats() { stats_ = {}; }
+
+  // # of queued packets
+  uint32_t backlog() const { return backlog_; }
+
+  // # of queued packets of a pipe
+  uint32_t pipe_backlog(uint32_t pipe) const { return pipes_[pipe].packets; }
+
+  uint32_t num_subports() const { return config_.num_subports; }
+  uint32_t num_pipes() const { return num_pipes_; }
+  uint32_t num_pipe_profiles() const { return pipe_profiles_.size(); }
+
+  // # of pipes and subports waiting for tokens
+  size_t throttled() const { return wheel_.size(); }
+
+ private:
+  static const uint32_t kNone = UINT32_MAX;
+  static const uint32_t kSubportFlag = 1u << 31;
+  static const uint64_t kNsPerSec = 1000000000ull;
+
+  enum State : uint8_t {
+    kIdle = 0,       // nothing to send
+    kActive = 1,     // in the round robin of its parent
+    kThrottled = 2,  // waiting for tokens on the timer wheel
+  };
+
+  // Tokens are counted in nanobytes (bytes * 10^9), so that refilling for a
+  // number of nanoseconds is a single multiplication by the rate in bytes/s.
+  struct BucketProfile {
+    uint64_t rate;      // bytes per second, 0 if unlimited
+    uint64_t burst_nb;  // bucket size
+    uint64_t fill_ns;   // time to fill an empty bucket
+  };
+
+  struct Bucket {
+    uint64_t tokens;
+    uint64_t last_ns;  // when the bucket was last refilled
+  };
+
+  struct List {
+    uint32_t head;
+    uint32_t tail;
+  };
+
+  struct Subport {
+    BucketProfile profile;
+    Bucket bucket;
+    List pipes;     // active pipes
+    uint32_t next;  // link in active_
+    uint8_t state;
+  };
+
+  struct Pipe {
+    Bucket bucket;
+    uint32_t next;  // link in the active list of its subport
+    uint32_t profile;
+    uint32_t packets;
+    int32_t deficit;
+    uint16_t nonempty;  // bitmap of queues with packets
+    uint8_t state;
+    uint8_t rr[kTrafficClasses];  // next queue to serve in each class
+  };
+
+  struct Queue {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t len;
+  };
+
+  struct Desc {
+    T *pkt;
+    uint32_t next;
+  };
+
+  static_assert(kQueuesPerPipe <= 16, "Pipe::nonempty is too small");
+
+  static BucketProfile MakeBucketProfile(const Profile &profile) {
+    BucketProfile ret = {profile.rate, profile.burst * kNsPerSec, 0};
+    if (ret.rate) {
+      ret.fill_ns = ret.burst_nb / ret.rate;
+    }
+    return ret;
+  }
+
+  // Refills the bucket if it does not have 'need_nb' tokens, and returns
+  // whether it does now. Packets larger than the bucket only need a full one.
+  static bool Conform(Bucket *b, const BucketProfile &profile, uint64_t need_nb,
+                      uint64_t now_ns) {
+    if (profile.rate == 0) {
+      return true;
+    }
+
+    need_nb = std::min(need_nb, profile.burst_nb);
+    if (b->tokens >= need_nb) {
+      return true;
+    }
+
+    uint64_t elapsed_ns = now_ns - std::min(now_ns, b->last_ns);
+    if (elapsed_ns >= profile.fill_ns) {
+      b->tokens = profile.burst_nb;
+    } else {
+      b->tokens = std::min(profile.burst_nb,
+                           b->tokens + elapsed_ns * profile.rate);
+    }
+    b->last_ns = now_ns;
+
+    return b->tokens >= need_nb;
+  }
+
+  static void Consume(Bucket *b, const BucketProfile &profile,
+                      uint64_t need_nb) {
+    if (profile.rate) {
+      b->tokens -= std::min(need_nb, b->tokens);
+    }
+  }
+
+  // Time until the bucket will have 'need_nb' tokens
+  static uint64_t WaitNs(const Bucket &b, const BucketProfile &profile,
+                         uint64_t need_nb) {
+    need_nb = std::min(need_nb, profile.burst_nb);
+    return (need_nb - b.tokens + profile.rate - 1) / profile.rate;
+  }
+
+  // The queue to serve next: round robin within the highest priority traffic
+  // class with packets.
+  uint32_t PickQueue(Pipe &p) {
+    uint32_t tc = __builtin_ctz(p.nonempty) / kQueuesPerClass;
+    uint32_t mask = (p.nonempty >> (tc * kQueuesPerClass)) &
+                    ((1u << kQueuesPerClass) - 1);
+    uint32_t start = p.rr[tc];
+    uint32_t rotated = (mask >> start) | (mask << (kQueuesPerClass - start));
+    uint32_t q = (start + __builtin_ctz(rotated)) % kQueuesPerClass;
+    p.rr[tc] = (q + 1) % kQueuesPerClass;
+    return tc * kQueuesPerClass + q;
+  }
+
+  void PushBack(List *list, uint32_t pipe) {
+    pipes_[pipe].next = kNone;
+    if (list->tail == kNone) {
+      list->head = pipe;
+    } else {
+      pipes_[list->tail].next = pipe;
+    }
+    list->tail = pipe;
+  }
+
+  void PopFront(List *list) {
+    list->head = pipes_[list->head].next;
+    if (list->head == kNone) {
+      list->tail = kNone;
+    }
+  }
+
+  void PushBackSubport(uint32_t s) {
+    subports_[s].next = kNone;
+    if (active_.tail == kNone) {
+      active_.head = s;
+    } else {
+      subports_[active_.tail].next = s;
+    }
+    active_.tail = s;
+  }
+
+  void PopFrontSubport() {
+    active_.head = subports_[active_.head].next;
+    if (active_.head == kNone) {
+      active_.tail = kNone;
+    }
+  }
+
+  // Puts a pipe with packets in the round robin of its subport, and the
+  // subport in that of the port if it was idle.
+  void Activate(uint32_t pipe) {
+    Pipe &p = pipes_[pipe];
+    uint32_t s = pipe / config_.pipes_per_subport;
+    Subport &subport = subports_[s];
+
+    p.state = kActive;
+    p.deficit = config_.quantum;
+    PushBack(&subport.pipes, pipe);
+
+    if (subport.state == kIdle) {
+      subport.state = kActive;
+      PushBackSubport(s);
+    }
+  }
+
+  // Called by the timer wheel when a pipe or subport may have enough tokens
+  void Wake(uint32_t id) {
+    if (id & kSubportFlag) {
+      uint32_t s = id & ~kSubportFlag;
+      Subport &subport = subports_[s];
+      DCHECK_EQ(subport.state, kThrottled);
+      if (subport.pipes.head == kNone) {
+        subport.state = kIdle;
+      } else {
+        subport.state = kActive;
+        PushBackSubport(s);
+      }
+    } else {
+      Pipe &p = pipes_[id];
+      DCHECK_EQ(p.state, kThrottled);
+      p.state = kIdle;
+      if (p.packets) {
+        Activate(id);
+      }
+    }
+  }
+
+  const Config config_;
+  const uint32_t num_pipes_;
+
+  BucketProfile port_;
+  Bucket port_bucket_;
+
+  std::vector<Subport> subports_;
+  std::vector<Pipe> pipes_;
+  std::vector<Queue> queues_;
+  std::vector<Desc> descs_;
+  uint32_t free_desc_;
+  uint32_t backlog_;
+
+  std::vector<BucketProfile> pipe_profiles_;
+
+  // Subports with active pipes
+  List active_;
+
+  // Throttled pipes and subports (with kSubportFlag)
+  TimerWheel<uint32_t> wheel_;
+
+  Stats stats_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_HQOS_SCHEDULER_H_
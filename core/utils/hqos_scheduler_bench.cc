@@ -0,0 +1,132 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for HQoSScheduler dequeue throughput with many pipes.
+//
+// All pipes start with kBacklog packets. Every iteration dequeues a batch and
+// puts the packets back on random queues of random pipes, so the backlog
+// stays the same. Time advances by the wire time of a batch of 64B packets on
+// a 10GbE link. In the shaped configuration, the port is limited to 10Gbps
+// and every pipe to twice its fair share of it.
+
+#include "hqos_scheduler.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "random.h"
+
+namespace {
+
+struct FakePacket {
+  uint32_t len;
+
+  uint32_t total_len() const { return len; }
+};
+
+using Scheduler = bess::utils::HQoSScheduler<FakePacket>;
+
+static const size_t kBatchSize = 32;
+static const uint32_t kBacklog = 4;
+static const uint32_t kPacketSize = 64;
+static const uint32_t kSubports = 16;
+static const uint64_t kPortRate = 1250000000;  // 10Gbps in bytes/s
+
+// Arguments: number of pipes, whether pipes and the port are shaped
+class HQoSFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const uint32_t num_pipes = state.range(0);
+    const bool shaped = state.range(1);
+
+    sched_ = new Scheduler({kSubports, num_pipes / kSubports, kBacklog * 2,
+                            num_pipes * kBacklog, 1514});
+
+    if (shaped) {
+      sched_->SetPortProfile({kPortRate, 16384});
+      uint32_t profile =
+          sched_->AddPipeProfile({kPortRate * 2 / num_pipes + 1, 1514});
+      for (uint32_t i = 0; i < num_pipes; i++) {
+        CHECK(sched_->SetPipeProfile(i, profile));
+      }
+    }
+
+    pkts_.assign(num_pipes * kBacklog, {kPacketSize});
+    for (uint32_t i = 0; i < num_pipes * kBacklog; i++) {
+      CHECK(sched_->Enqueue(&pkts_[i], i % num_pipes,
+                            rng_.GetRange(Scheduler::kQueuesPerPipe)));
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    delete sched_;
+    pkts_.clear();
+  }
+
+ protected:
+  Scheduler *sched_;
+  std::vector<FakePacket> pkts_;
+  Random rng_;
+};
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(HQoSFixture, Dequeue)(benchmark::State &state) {
+  const uint32_t num_pipes = state.range(0);
+  const uint64_t step_ns =
+      kBatchSize * (kPacketSize + Scheduler::kFrameOverhead) * 1000000000ull /
+      kPortRate;
+  FakePacket *batch[kBatchSize];
+  uint64_t now_ns = 0;
+  uint64_t packets = 0;
+  uint64_t bytes;
+
+  while (state.KeepRunning()) {
+    size_t cnt = sched_->Dequeue(batch, kBatchSize, now_ns, &bytes);
+    for (size_t i = 0; i < cnt; i++) {
+      sched_->Enqueue(batch[i], rng_.GetRange(num_pipes),
+                      rng_.GetRange(Scheduler::kQueuesPerPipe));
+    }
+    packets += cnt;
+    now_ns += step_ns;
+  }
+
+  state.SetItemsProcessed(packets);
+  state.counters["throttles"] = sched_->stats().pipe_throttles;
+}
+
+BENCHMARK_REGISTER_F(HQoSFixture, Dequeue)
+    ->Args({1024, 0})
+    ->Args({1024, 1})
+    ->Args({65536, 0})
+    ->Args({65536, 1});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,239 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hqos_scheduler.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct FakePacket {
+  uint32_t len;
+  int id;
+
+  uint32_t total_len() const { return len; }
+};
+
+using Scheduler = bess::utils::HQoSScheduler<FakePacket>;
+
+// Packets of this size take 1000 bytes of tokens, with the frame overhead
+static const uint32_t kLen = 1000 - Scheduler::kFrameOverhead;
+
+static Scheduler::Config MakeConfig(uint32_t num_subports,
+                                    uint32_t pipes_per_subport,
+                                    uint32_t quantum = 1000) {
+  return {num_subports, pipes_per_subport, 64, 4096, quantum};
+}
+
+// Dequeues all packets that can be sent at 'now_ns', returning their ids
+static std::vector<int> DequeueAll(Scheduler *s, uint64_t now_ns) {
+  std::vector<int> ids;
+  FakePacket *pkts[32];
+  uint64_t bytes;
+  size_t cnt;
+
+  while ((cnt = s->Dequeue(pkts, 32, now_ns, &bytes)) > 0) {
+    for (size_t i = 0; i < cnt; i++) {
+      ids.push_back(pkts[i]->id);
+    }
+  }
+  return ids;
+}
+
+// Tests strict priority between traffic classes, and round robin between the
+// queues of a traffic class.
+TEST(HQoSSchedulerTest, PipeClassesAndQueues) {
+  Scheduler s(MakeConfig(1, 1, 100000));
+  FakePacket pkts[] = {{kLen, 0}, {kLen, 1}, {kLen, 2}, {kLen, 3},
+                       {kLen, 4}, {kLen, 5}};
+
+  ASSERT_TRUE(s.Enqueue(&pkts[0], 0, 4));   // class 1
+  ASSERT_TRUE(s.Enqueue(&pkts[1], 0, 4));   // class 1
+  ASSERT_TRUE(s.Enqueue(&pkts[2], 0, 0));   // class 0
+  ASSERT_TRUE(s.Enqueue(&pkts[3], 0, 1));   // class 0
+  ASSERT_TRUE(s.Enqueue(&pkts[4], 0, 1));   // class 0
+  ASSERT_TRUE(s.Enqueue(&pkts[5], 0, 15));  // class 3
+  EXPECT_EQ(6, s.backlog());
+
+  EXPECT_EQ(std::vector<int>({2, 3, 4, 0, 1, 5}), DequeueAll(&s, 0));
+  EXPECT_EQ(0, s.backlog());
+  EXPECT_EQ(6, s.stats().dequeued);
+}
+
+// Tests DRR between pipes
+TEST(HQoSSchedulerTest, PipeFairness) {
+  Scheduler s(MakeConfig(1, 2));
+  FakePacket pkts[] = {{kLen, 0}, {kLen, 1}, {kLen, 2},
+                       {kLen, 3}, {kLen, 10}, {kLen, 11}};
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(s.Enqueue(&pkts[i], 0, 0));
+  }
+  ASSERT_TRUE(s.Enqueue(&pkts[4], 1, 0));
+  ASSERT_TRUE(s.Enqueue(&pkts[5], 1, 0));
+
+  EXPECT_EQ(std::vector<int>({0, 10, 1, 11, 2, 3}), DequeueAll(&s, 0));
+}
+
+// Tests that a pipe sends its burst, then one packet per refill
+TEST(HQoSSchedulerTest, PipeShaping) {
+  Scheduler s(MakeConfig(1, 2));
+  FakePacket pkts[] = {{kLen, 0}, {kLen, 1}, {kLen, 2}, {kLen, 3},
+                       {kLen, 10}};
+
+  // 1000 bytes per ms, with room for 2 packets
+  uint32_t profile = s.AddPipeProfile({1000000, 2000});
+  ASSERT_TRUE(s.SetPipeProfile(0, profile));
+  ASSERT_FALSE(s.SetPipeProfile(2, profile));
+  ASSERT_FALSE(s.SetPipeProfile(0, profile + 1));
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(s.Enqueue(&pkts[i], 0, 0));
+  }
+  ASSERT_TRUE(s.Enqueue(&pkts[4], 1, 0));
+
+  // The unlimited pipe is not held back by the throttled one
+  EXPECT_EQ(std::vector<int>({0, 10, 1}), DequeueAll(&s, 0));
+  EXPECT_EQ(1, s.throttled());
+  EXPECT_EQ(1, s.stats().pipe_throttles);
+
+  EXPECT_TRUE(DequeueAll(&s, 500000).empty());
+  EXPECT_EQ(std::vector<int>({2}), DequeueAll(&s, 1000000));
+  EXPECT_TRUE(DequeueAll(&s, 1500000).empty());
+  EXPECT_EQ(std::vector<int>({3}), DequeueAll(&s, 2000000));
+  EXPECT_EQ(0, s.backlog());
+
+  // Idle for long enough to fill the bucket
+  ASSERT_TRUE(s.Enqueue(&pkts[0], 0, 0));
+  ASSERT_TRUE(s.Enqueue(&pkts[1], 0, 0));
+  ASSERT_TRUE(s.Enqueue(&pkts[2], 0, 0));
+  EXPECT_EQ(std::vector<int>({0, 1}), DequeueAll(&s, 10000000));
+}
+
+// Tests that a subport shapes all of its pipes, but not other subports
+TEST(HQoSSchedulerTest, SubportShaping) {
+  Scheduler s(MakeConfig(2, 2));
+  FakePacket pkts[] = {{kLen, 0},  {kLen, 1},  {kLen, 2},
+                       {kLen, 10}, {kLen, 11}, {kLen, 12},
+                       {kLen, 20}};
+
+  s.SetSubportProfile(0, {1000000, 2000});
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(s.Enqueue(&pkts[i], 0, 0));
+    ASSERT_TRUE(s.Enqueue(&pkts[3 + i], 1, 0));
+  }
+  ASSERT_TRUE(s.Enqueue(&pkts[6], 2, 0));  // pipe 0 of subport 1
+
+  EXPECT_EQ(std::vector<int>({0, 20, 10}), DequeueAll(&s, 0));
+  EXPECT_EQ(1, s.stats().subport_throttles);
+  EXPECT_EQ(0, s.stats().pipe_throttles);
+
+  EXPECT_EQ(std::vector<int>({1}), DequeueAll(&s, 1000000));
+  EXPECT_EQ(std::vector<int>({11}), DequeueAll(&s, 2000000));
+  EXPECT_EQ(std::vector<int>({2, 12}), DequeueAll(&s, 10000000));
+}
+
+// Tests that the port rate caps everything
+TEST(HQoSSchedulerTest, PortShaping) {
+  Scheduler s(MakeConfig(2, 2));
+  FakePacket pkts[] = {{kLen, 0}, {kLen, 1}, {kLen, 2}, {kLen, 3}};
+
+  s.SetPortProfile({1000000, 3000});
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(s.Enqueue(&pkts[i], i, 0));
+  }
+
+  EXPECT_EQ(std::vector<int>({0, 2, 1}), DequeueAll(&s, 0));
+  EXPECT_TRUE(DequeueAll(&s, 999999).empty());
+  EXPECT_EQ(std::vector<int>({3}), DequeueAll(&s, 1000000));
+}
+
+TEST(HQoSSchedulerTest, QueueAndPoolLimits) {
+  Scheduler s({1, 1, 2, 3, 1000});
+  FakePacket pkts[5] = {};
+
+  EXPECT_TRUE(s.Enqueue(&pkts[0], 0, 0));
+  EXPECT_TRUE(s.Enqueue(&pkts[1], 0, 0));
+  EXPECT_FALSE(s.Enqueue(&pkts[2], 0, 0));
+  EXPECT_EQ(1, s.stats().queue_drops);
+
+  EXPECT_TRUE(s.Enqueue(&pkts[3], 0, 1));
+  EXPECT_FALSE(s.Enqueue(&pkts[4], 0, 2));
+  EXPECT_EQ(1, s.stats().pool_drops);
+  EXPECT_EQ(3, s.backlog());
+
+  int flushed = 0;
+  s.Flush([&flushed](FakePacket *) { flushed++; });
+  EXPECT_EQ(3, flushed);
+  EXPECT_EQ(0, s.backlog());
+  EXPECT_TRUE(DequeueAll(&s, 0).empty());
+
+  // The descriptors are back in the pool
+  EXPECT_TRUE(s.Enqueue(&pkts[0], 0, 0));
+  EXPECT_TRUE(s.Enqueue(&pkts[1], 0, 1));
+  EXPECT_TRUE(s.Enqueue(&pkts[2], 0, 2));
+  EXPECT_EQ(3, DequeueAll(&s, 0).size());
+}
+
+// Tests many shaped pipes, each of which should get its own rate
+TEST(HQoSSchedulerTest, ManyPipes) {
+  const uint32_t kSubports = 4;
+  const uint32_t kPipes = 16384;
+  const uint32_t kNumPipes = kSubports * kPipes;
+  Scheduler s({kSubports, kPipes, 4, kNumPipes * 2, 1000});
+  std::vector<FakePacket> pkts(kNumPipes * 2);
+
+  // 1000 bytes per ms, 1 packet of burst
+  uint32_t profile = s.AddPipeProfile({1000000, 1000});
+  for (uint32_t i = 0; i < kNumPipes; i++) {
+    ASSERT_TRUE(s.SetPipeProfile(i, profile));
+    for (int j = 0; j < 2; j++) {
+      pkts[i * 2 + j] = {kLen, static_cast<int>(i)};
+      ASSERT_TRUE(s.Enqueue(&pkts[i * 2 + j], i, j));
+    }
+  }
+
+  std::vector<int> ids = DequeueAll(&s, 0);
+  ASSERT_EQ(kNumPipes, ids.size());
+  std::vector<int> count(kNumPipes);
+  for (int id : ids) {
+    count[id]++;
+  }
+  EXPECT_EQ(std::vector<int>(kNumPipes, 1), count);
+  EXPECT_EQ(kNumPipes, s.throttled());
+
+  EXPECT_EQ(kNumPipes, DequeueAll(&s, 1000000).size());
+  EXPECT_EQ(0, s.backlog());
+  EXPECT_EQ(0, s.throttled());
+}
+
+}  // namespace
@@ -29,6 +29,10 @@
 
 #include "ip.h"
 
+#include <arpa/inet.h>
+
+#include <algorithm>
+
 #include <glog/logging.h>
 
 #include "bits.h"
@@ -60,6 +64,27 @@ std::string ToIpv4Address(be32_t addr) {
                              t.bytes[2], t.bytes[3]);
 }
 
+bool ParseIpv6Address(const std::string &str, Ipv6Address *addr) {
+  Ipv6Address tmp;
+
+  if (inet_pton(AF_INET6, str.c_str(), &tmp) != 1) {
+    return false;
+  }
+
+  *addr = tmp;
+  return true;
+}
+
+std::string ToIpv6Address(const Ipv6Address &addr) {
+  char buf[INET6_ADDRSTRLEN];
+
+  if (inet_ntop(AF_INET6, &addr, buf, sizeof(buf)) == nullptr) {
+    return "";
+  }
+
+  return buf;
+}
+
 Ipv4Prefix::Ipv4Prefix(const std::string &prefix) {
   size_t delim_pos = prefix.find('/');
 
@@ -78,5 +103,31 @@ Ipv4Prefix::Ipv4Prefix(const std::string &prefix) {
   mask = be32_t(SetBitsLow<uint32_t>(len));
 }
 
+Ipv6Prefix::Ipv6Prefix(const std::string &prefix) {
+  size_t delim_pos = prefix.find('/');
+
+  // default values in case of parser failure
+  addr = Ipv6Address();
+  mask = Ipv6Address();
+
+  if (prefix.length() == 0 || delim_pos == std::string::npos ||
+      delim_pos >= prefix.length()) {
+    return;
+  }
+
+  ParseIpv6Address(prefix.substr(0, delim_pos), &addr);
+
+  const int len = std::stoi(prefix.substr(delim_pos + 1));
+  mask = Mask(len);
+}
+
+Ipv6Address Ipv6Prefix::Mask(size_t prefix_len) {
+  Ipv6Address ret;
+  ret.hi = be64_t(SetBitsLow<uint64_t>(std::min(prefix_len, size_t{64})));
+  ret.lo = be64_t(
+      SetBitsLow<uint64_t>(prefix_len > 64 ? prefix_len - 64 : size_t{0}));
+  return ret;
+}
+
 }  // namespace utils
 }  // namespace bess
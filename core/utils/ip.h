@@ -43,6 +43,44 @@ bool ParseIpv4Address(const std::string &str, be32_t *addr);
 // be32 -> string
 std::string ToIpv4Address(be32_t addr);
 
+// An IPv6 address in network byte order. Being two 64-bit words, it can be
+// masked and compared without byte-wise loops.
+struct[[gnu::packed]] Ipv6Address {
+  Ipv6Address operator&(const Ipv6Address &o) const {
+    return {hi & o.hi, lo & o.lo};
+  }
+
+  Ipv6Address operator~() const { return {~hi, ~lo}; }
+
+  bool operator==(const Ipv6Address &o) const {
+    return hi == o.hi && lo == o.lo;
+  }
+
+  bool operator!=(const Ipv6Address &o) const { return !(*this == o); }
+
+  bool operator<(const Ipv6Address &o) const {
+    return hi < o.hi || (hi == o.hi && lo < o.lo);
+  }
+
+  // Returns the i-th byte of the address (0 is the most significant one)
+  uint8_t byte(size_t i) const {
+    return reinterpret_cast<const uint8_t *>(this)[i];
+  }
+
+  be64_t hi;  // bits 0-63
+  be64_t lo;  // bits 64-127
+};
+
+static_assert(std::is_pod<Ipv6Address>::value, "not a POD type");
+static_assert(sizeof(Ipv6Address) == 16, "struct Ipv6Address is incorrect");
+
+// return false if string -> Ipv6Address conversion failed (*addr is
+// unmodified)
+bool ParseIpv6Address(const std::string &str, Ipv6Address *addr);
+
+// Ipv6Address -> string (in the RFC 5952 format)
+std::string ToIpv6Address(const Ipv6Address &addr);
+
 // An IPv4 header definition loosely based on the BSD version.
 struct[[gnu::packed]] Ipv4 {
   enum Flag : uint16_t {
@@ -89,6 +127,19 @@ struct[[gnu::packed]] Ipv4 {
 static_assert(std::is_pod<Ipv4>::value, "not a POD type");
 static_assert(sizeof(Ipv4) == 20, "struct Ipv4 is incorrect");
 
+// IPv6 header definition, as in RFC 8200. Extension headers are not included.
+struct[[gnu::packed]] Ipv6 {
+  be32_t vtc_flow;        // Version, traffic class, and flow label.
+  be16_t payload_length;  // Payload length.
+  uint8_t next_header;    // Next header (see Ipv4::Proto).
+  uint8_t hop_limit;      // Hop limit.
+  Ipv6Address src;        // Source address.
+  Ipv6Address dst;        // Destination address.
+};
+
+static_assert(std::is_pod<Ipv6>::value, "not a POD type");
+static_assert(sizeof(Ipv6) == 40, "struct Ipv6 is incorrect");
+
 struct Ipv4Prefix {
   // Implicit default constructor is not allowed
   Ipv4Prefix() = delete;
@@ -113,6 +164,38 @@ struct Ipv4Prefix {
   be32_t mask;
 };
 
+struct Ipv6Prefix {
+  // Implicit default constructor is not allowed
+  Ipv6Prefix() = delete;
+
+  // Construct Ipv6Prefix from a string like "2001:db8::/32"
+  explicit Ipv6Prefix(const std::string &prefix);
+
+  // Returns the mask of a prefix length (0-128)
+  static Ipv6Address Mask(size_t prefix_len);
+
+  // Returns true if ip is within the range of Ipv6Prefix
+  bool Match(const Ipv6Address &ip) const {
+    return (addr & mask) == (ip & mask);
+  }
+
+  // Returns the prefix length
+  uint32_t prefix_length() const {
+    uint64_t hi = mask.hi.value();
+    uint64_t lo = mask.lo.value();
+    if (lo != 0) {
+      return 128 - __builtin_ctzll(lo);
+    } else if (hi != 0) {
+      return 64 - __builtin_ctzll(hi);
+    } else {
+      return 0;
+    }
+  }
+
+  Ipv6Address addr;
+  Ipv6Address mask;
+};
+
 }  // namespace utils
 }  // namespace bess
 
@@ -32,10 +32,13 @@
 #include <gtest/gtest.h>
 
 using bess::utils::be32_t;
+using bess::utils::be64_t;
 
 namespace {
 
 using bess::utils::Ipv4Prefix;
+using bess::utils::Ipv6Address;
+using bess::utils::Ipv6Prefix;
 
 TEST(IPTest, AddressInStr) {
   be32_t a(192 << 24 | 168 << 16 | 100 << 8 | 199);
@@ -99,4 +102,73 @@ TEST(IPTest, PrefixCalc) {
   }
 }
 
+TEST(IPTest, Ipv6AddressInStr) {
+  Ipv6Address a = {be64_t(0x20010db800000000), be64_t(0x0000000000000001)};
+
+  std::string str = ToIpv6Address(a);
+  EXPECT_EQ(str, "2001:db8::1");
+
+  Ipv6Address b;
+  bool ret = ParseIpv6Address(str, &b);
+  EXPECT_TRUE(ret);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(0x20, b.byte(0));
+  EXPECT_EQ(0x01, b.byte(15));
+
+  EXPECT_TRUE(ParseIpv6Address("::", &b));
+  EXPECT_EQ(Ipv6Address(), b);
+
+  EXPECT_FALSE(ParseIpv6Address("hello", &b));
+  EXPECT_FALSE(ParseIpv6Address("1.1.1.1", &b));
+  EXPECT_FALSE(ParseIpv6Address("2001:db8::1::1", &b));
+}
+
+// Check if Ipv6Prefix can be correctly constructed from strings
+TEST(IPTest, Ipv6PrefixInStr) {
+  Ipv6Prefix prefix_1("2001:db8::1/32");
+  EXPECT_EQ(0x20010db800000000, prefix_1.addr.hi.value());
+  EXPECT_EQ(1, prefix_1.addr.lo.value());
+  EXPECT_EQ(0xffffffff00000000, prefix_1.mask.hi.value());
+  EXPECT_EQ(0, prefix_1.mask.lo.value());
+
+  Ipv6Prefix prefix_2("::/0");
+  EXPECT_EQ(Ipv6Address(), prefix_2.addr);
+  EXPECT_EQ(Ipv6Address(), prefix_2.mask);
+
+  Ipv6Prefix prefix_3("2001:db8::/96");
+  EXPECT_EQ(0xffffffffffffffff, prefix_3.mask.hi.value());
+  EXPECT_EQ(0xffffffff00000000, prefix_3.mask.lo.value());
+}
+
+// Check if Ipv6Prefix::Match() behaves correctly
+TEST(IPTest, Ipv6PrefixMatch) {
+  Ipv6Address a;
+  Ipv6Address b;
+  ASSERT_TRUE(ParseIpv6Address("2001:db8:0:1::1", &a));
+  ASSERT_TRUE(ParseIpv6Address("2001:db8:0:2::1", &b));
+
+  Ipv6Prefix prefix_1("2001:db8::/48");
+  EXPECT_TRUE(prefix_1.Match(a));
+  EXPECT_TRUE(prefix_1.Match(b));
+
+  Ipv6Prefix prefix_2("2001:db8:0:1::/64");
+  EXPECT_TRUE(prefix_2.Match(a));
+  EXPECT_FALSE(prefix_2.Match(b));
+
+  Ipv6Prefix prefix_3("::/0");
+  EXPECT_TRUE(prefix_3.Match(a));
+
+  Ipv6Prefix prefix_4("2001:db8:0:1::1/128");
+  EXPECT_TRUE(prefix_4.Match(a));
+  EXPECT_FALSE(prefix_4.Match(b));
+}
+
+TEST(IPTest, Ipv6PrefixCalc) {
+  // exhaustive test
+  for (int i = 0; i <= 128; i++) {
+    Ipv6Prefix p("::/" + std::to_string(i));
+    EXPECT_EQ(i, p.prefix_length());
+  }
+}
+
 }  // namespace (unnamed)
@@ -0,0 +1,258 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "lpm6.h"
+
+#include <algorithm>
+#include <cerrno>
+
+namespace bess {
+namespace utils {
+
+// Returns bits [start, start + stride) of the address. stride is either 16
+// (for the root table) or 8, and start is a multiple of 8.
+static inline size_t addr_bits(const Ipv6Address &addr, size_t start,
+                               size_t stride) {
+  if (stride == 16) {
+    return (addr.byte(start / 8) << 8) | addr.byte(start / 8 + 1);
+  } else {
+    return addr.byte(start / 8);
+  }
+}
+
+int Lpm6::Add(const Ipv6Address &prefix, size_t prefix_len,
+              uint32_t next_hop) {
+  if (prefix_len > 128 || next_hop > kMaxNextHop) {
+    return -EINVAL;
+  }
+
+  Ipv6Address masked = prefix & Ipv6Prefix::Mask(prefix_len);
+
+  // Check in advance, so that a failure leaves the table untouched
+  size_t needed = GroupsNeeded(masked, prefix_len);
+  if (needed > free_groups_.size() + (kMaxGroups - num_groups_)) {
+    return -ENOSPC;
+  }
+
+  rules_[std::make_pair(masked, prefix_len)] = next_hop;
+
+  uint32_t new_entry = MakeEntry(prefix_len, next_hop);
+  Update(0, 0, kRootBits, masked, prefix_len, true, [=](uint32_t e) {
+    // Do not override longer prefixes
+    return (!(e & kValid) || Depth(e) <= prefix_len) ? new_entry : e;
+  });
+
+  return 0;
+}
+
+int Lpm6::Delete(const Ipv6Address &prefix, size_t prefix_len) {
+  if (prefix_len > 128) {
+    return -EINVAL;
+  }
+
+  Ipv6Address masked = prefix & Ipv6Prefix::Mask(prefix_len);
+
+  auto it = rules_.find(std::make_pair(masked, prefix_len));
+  if (it == rules_.end()) {
+    return -ENOENT;
+  }
+  rules_.erase(it);
+
+  // Entries of this prefix now fall back to the longest covering prefix
+  uint32_t replacement = 0;
+  for (size_t len = prefix_len; len-- > 0;) {
+    auto parent = rules_.find(
+        std::make_pair(masked & Ipv6Prefix::Mask(len), len));
+    if (parent != rules_.end()) {
+      replacement = MakeEntry(len, parent->second);
+      break;
+    }
+  }
+
+  Update(0, 0, kRootBits, masked, prefix_len, false, [=](uint32_t e) {
+    return ((e & kValid) && Depth(e) == prefix_len) ? replacement : e;
+  });
+
+  return 0;
+}
+
+void Lpm6::Clear() {
+  tbl_.assign(kRootSize, 0);
+  tbl_.shrink_to_fit();
+  num_groups_ = 0;
+  free_groups_.clear();
+  rules_.clear();
+}
+
+void Lpm6::LookupBatch(const Ipv6Address *addrs, size_t cnt,
+                       uint32_t *next_hops, uint32_t miss) const {
+  bool descend = false;
+
+  for (size_t i = 0; i < cnt; i++) {
+    next_hops[i] = tbl_[(addrs[i].byte(0) << 8) | addrs[i].byte(1)];
+    descend |= (next_hops[i] & kGroup) != 0;
+  }
+
+  // The loads within each round are independent of each other, so the CPU
+  // can keep the cache misses of all addresses in flight.
+  for (size_t byte = 2; descend; byte++) {
+    descend = false;
+    for (size_t i = 0; i < cnt; i++) {
+      // Branch-free, since addresses stop descending at unpredictable levels:
+      // those already done reload the first entry and keep what they have.
+      uint32_t e = next_hops[i];
+      bool group = e & kGroup;
+      uint32_t next = tbl_[group ? GroupBase(e) + addrs[i].byte(byte) : 0];
+      next_hops[i] = group ? next : e;
+      descend |= (next_hops[i] & kGroup) != 0;
+    }
+  }
+
+  for (size_t i = 0; i < cnt; i++) {
+    next_hops[i] = (next_hops[i] & kValid) ? (next_hops[i] & kValueMask) : miss;
+  }
+}
+
+template <typename F>
+void Lpm6::Update(size_t base, size_t start, size_t stride,
+                  const Ipv6Address &prefix, size_t prefix_len, bool create,
+                  const F &update) {
+  size_t end = start + stride;
+  size_t idx = base + addr_bits(prefix, start, stride);
+
+  if (prefix_len > end) {
+    // The prefix ends in a deeper level
+    if (!(tbl_[idx] & kGroup)) {
+      if (!create) {
+        return;
+      }
+      uint32_t group = AllocGroup(tbl_[idx]);
+      tbl_[idx] = kGroup | group;
+    }
+
+    Update(GroupBase(tbl_[idx]), end, kGroupBits, prefix, prefix_len, create,
+           update);
+    TryCollapse(idx, end);
+    return;
+  }
+
+  // The prefix covers 2^(end - prefix_len) entries in this table. Tables are
+  // aligned to their size, so masking the low bits gives the first one.
+  size_t span = size_t{1} << (end - prefix_len);
+  idx &= ~(span - 1);
+  for (size_t i = idx; i < idx + span; i++) {
+    UpdateEntry(i, end, update);
+  }
+}
+
+template <typename F>
+void Lpm6::UpdateEntry(size_t idx, size_t end, const F &update) {
+  if (!(tbl_[idx] & kGroup)) {
+    tbl_[idx] = update(tbl_[idx]);
+    return;
+  }
+
+  size_t base = GroupBase(tbl_[idx]);
+  for (size_t i = base; i < base + kGroupSize; i++) {
+    UpdateEntry(i, end + kGroupBits, update);
+  }
+  TryCollapse(idx, end);
+}
+
+size_t Lpm6::GroupsNeeded(const Ipv6Address &prefix, size_t prefix_len) const {
+  size_t needed = 0;
+  size_t start = 0;
+  size_t stride = kRootBits;
+  size_t base = 0;
+
+  while (prefix_len > start + stride) {
+    uint32_t e = tbl_[base + addr_bits(prefix, start, stride)];
+    if (e & kGroup) {
+      base = GroupBase(e);
+    } else {
+      // All the levels below must be created
+      needed++;
+      base = 0;
+      while (prefix_len > start + stride + kGroupBits) {
+        needed++;
+        start += stride;
+        stride = kGroupBits;
+      }
+      break;
+    }
+    start += stride;
+    stride = kGroupBits;
+  }
+
+  return needed;
+}
+
+uint32_t Lpm6::AllocGroup(uint32_t e) {
+  uint32_t group;
+
+  if (!free_groups_.empty()) {
+    group = free_groups_.back();
+    free_groups_.pop_back();
+  } else {
+    group = num_groups_++;
+    // Grow by 1/4 rather than doubling, as large tables take hundreds of MBs
+    if (tbl_.size() == tbl_.capacity()) {
+      tbl_.reserve(tbl_.size() + tbl_.size() / 4);
+    }
+    tbl_.resize(tbl_.size() + kGroupSize);
+  }
+
+  size_t base = kRootSize + group * kGroupSize;
+  std::fill(tbl_.begin() + base, tbl_.begin() + base + kGroupSize, e);
+  return group;
+}
+
+void Lpm6::TryCollapse(size_t idx, size_t start) {
+  size_t base = GroupBase(tbl_[idx]);
+  uint32_t first = tbl_[base];
+
+  // Entries of prefixes longer than start must stay in the group, even if
+  // all of them are the same, so that Delete() can find them.
+  if ((first & kGroup) || ((first & kValid) && Depth(first) > start)) {
+    return;
+  }
+
+  for (size_t i = base + 1; i < base + kGroupSize; i++) {
+    if (tbl_[i] != first) {
+      return;
+    }
+  }
+
+  free_groups_.push_back(tbl_[idx] & kValueMask);
+  tbl_[idx] = first;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,159 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_UTILS_LPM6_H_
+#define BESS_UTILS_LPM6_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ip.h"
+
+namespace bess {
+namespace utils {
+
+// Longest prefix match table for IPv6 addresses.
+//
+// This is a multibit trie in the style of DIR-24-8 (and DPDK's rte_lpm6): the
+// first 16 bits of an address index a root table of 64k entries, and each of
+// the following bytes indexes a group of 256 entries. Prefixes are expanded to
+// the stride boundaries, so that every entry holds either the next hop of the
+// longest prefix covering it, or the index of a group for the next byte.
+// A lookup takes one memory access per level and stops at the first level
+// without longer prefixes; typical BGP routes (/29-/48) need 3 to 5 accesses.
+//
+// Lookups are thread-safe, but updates are not. See rcu.h for hitless updates.
+class Lpm6 {
+ public:
+  static const uint32_t kMaxNextHop = (1u << 22) - 1;
+  static const uint32_t kMaxGroups = 1u << 22;
+
+  Lpm6() : tbl_(kRootSize), num_groups_(), free_groups_(), rules_() {}
+
+  // Adds (or updates) a route. Bits of prefix beyond prefix_len are ignored.
+  // Returns 0 on success, -EINVAL for invalid arguments, or -ENOSPC if the
+  // table has run out of groups.
+  int Add(const Ipv6Address &prefix, size_t prefix_len, uint32_t next_hop);
+
+  // Removes a route. Returns 0 on success, or -ENOENT if there is no such
+  // route.
+  int Delete(const Ipv6Address &prefix, size_t prefix_len);
+
+  // Removes all routes.
+  void Clear();
+
+  // Returns true and sets *next_hop if a route matches the address.
+  bool Lookup(const Ipv6Address &addr, uint32_t *next_hop) const {
+    uint32_t e = tbl_[(addr.byte(0) << 8) | addr.byte(1)];
+    for (size_t i = 2; e & kGroup; i++) {
+      e = tbl_[GroupBase(e) + addr.byte(i)];
+    }
+
+    if (e & kValid) {
+      *next_hop = e & kValueMask;
+      return true;
+    }
+    return false;
+  }
+
+  // Looks up cnt addresses at once, setting next_hops[i] to the next hop of
+  // addrs[i], or to miss if no route matches. All addresses descend the trie
+  // one level at a time, so that their memory accesses overlap.
+  void LookupBatch(const Ipv6Address *addrs, size_t cnt, uint32_t *next_hops,
+                   uint32_t miss) const;
+
+  size_t num_routes() const { return rules_.size(); }
+
+  // The number of groups in use
+  size_t num_groups() const { return num_groups_ - free_groups_.size(); }
+
+  // Memory used by the trie, in bytes
+  size_t memory_usage() const { return tbl_.capacity() * sizeof(uint32_t); }
+
+ private:
+  // Entry format: valid (1 bit), group (1 bit), depth (8 bits), value (22 bits)
+  // where value is a next hop, or a group index if the group bit is set.
+  static const uint32_t kValid = 1u << 31;
+  static const uint32_t kGroup = 1u << 30;
+  static const int kDepthShift = 22;
+  static const uint32_t kValueMask = (1u << kDepthShift) - 1;
+
+  static const size_t kRootBits = 16;
+  static const size_t kRootSize = 1 << kRootBits;
+  static const size_t kGroupBits = 8;
+  static const size_t kGroupSize = 1 << kGroupBits;
+
+  static uint32_t MakeEntry(size_t depth, uint32_t next_hop) {
+    return kValid | (depth << kDepthShift) | next_hop;
+  }
+
+  static size_t Depth(uint32_t e) { return (e & ~(kValid | kGroup)) >> kDepthShift; }
+
+  static size_t GroupBase(uint32_t e) {
+    return kRootSize + (e & kValueMask) * kGroupSize;
+  }
+
+  // Applies update() to all non-group entries covered by the prefix, in the
+  // table at base, which is indexed by the bits [start, start + stride) of an
+  // address. Missing groups are created if create is true.
+  template <typename F>
+  void Update(size_t base, size_t start, size_t stride,
+              const Ipv6Address &prefix, size_t prefix_len, bool create,
+              const F &update);
+
+  // Applies update() to the entry at idx, or to all entries of its group.
+  // end is the first address bit after those indexing the table of idx.
+  template <typename F>
+  void UpdateEntry(size_t idx, size_t end, const F &update);
+
+  // Returns the number of groups Add() would need to create
+  size_t GroupsNeeded(const Ipv6Address &prefix, size_t prefix_len) const;
+
+  // Returns a new group, with all entries set to e
+  uint32_t AllocGroup(uint32_t e);
+
+  // Merges the group at tbl_[idx], which is indexed by the bits
+  // [start, start + 8), back into the entry if it is no longer needed
+  void TryCollapse(size_t idx, size_t start);
+
+  // The root table, followed by groups
+  std::vector<uint32_t> tbl_;
+  size_t num_groups_;
+  std::vector<uint32_t> free_groups_;
+
+  // (masked prefix, prefix length) -> next hop
+  std::map<std::pair<Ipv6Address, size_t>, uint32_t> rules_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_LPM6_H_
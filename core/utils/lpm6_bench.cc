@@ -0,0 +1,160 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmarks for the IPv6 longest prefix match table.
+
+#include "lpm6.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "random.h"
+
+using bess::utils::be64_t;
+using bess::utils::Ipv6Address;
+using bess::utils::Ipv6Prefix;
+using bess::utils::Lpm6;
+
+static const size_t kNumAddrs = 1 << 20;
+static const size_t kBatchSize = 32;
+
+// Prefix length distribution, loosely following the global IPv6 BGP table
+static const struct {
+  size_t len;
+  int percent;
+} kPrefixLens[] = {{48, 45}, {32, 12}, {44, 8}, {40, 8}, {36, 5},
+                   {29, 5},  {46, 4},  {47, 3}, {64, 3}, {56, 3},
+                   {28, 2},  {24, 2}};
+
+static Random rng;
+
+// Builds a table of state.range(0) routes, and addresses to look up
+class Lpm6Fixture : public benchmark::Fixture {
+ public:
+  Lpm6Fixture() : lpm_(), addrs_() {}
+
+  virtual void SetUp(benchmark::State &state) {
+    const size_t num_routes = state.range(0);
+    std::vector<Ipv6Address> prefixes;
+
+    rng.SetSeed(0);
+    lpm_ = new Lpm6();
+
+    // Routes are more specifics of a few thousand /24 allocations in
+    // 2000::/3, which gives a realistic amount of sharing in the trie.
+    std::vector<uint64_t> allocations;
+    for (size_t i = 0; i < std::max(num_routes / 50, size_t{1}); i++) {
+      allocations.push_back((uint64_t{0x2} << 60) |
+                            (uint64_t{rng.GetRange(1 << 21)} << 40));
+    }
+
+    while (prefixes.size() < num_routes) {
+      size_t len = 48;
+      int dice = rng.GetRange(100);
+      for (const auto &l : kPrefixLens) {
+        if (dice < l.percent) {
+          len = l.len;
+          break;
+        }
+        dice -= l.percent;
+      }
+
+      Ipv6Address prefix;
+      prefix.hi = be64_t(allocations[rng.GetRange(allocations.size())] |
+                         (uint64_t{rng.Get()} << 8) | rng.GetRange(256));
+      prefix.lo = be64_t(0);
+      prefix = prefix & Ipv6Prefix::Mask(len);
+
+      CHECK_EQ(lpm_->Add(prefix, len, rng.GetRange(Lpm6::kMaxNextHop)), 0);
+      prefixes.push_back(prefix);
+    }
+
+    // Mostly addresses covered by some route, and some random ones
+    addrs_.resize(kNumAddrs);
+    for (auto &addr : addrs_) {
+      if (rng.GetRange(10) != 0) {
+        addr = prefixes[rng.GetRange(prefixes.size())];
+        addr.lo = be64_t((uint64_t{rng.Get()} << 32) | rng.Get());
+      } else {
+        addr.hi = be64_t((uint64_t{rng.Get()} << 32) | rng.Get());
+        addr.lo = be64_t((uint64_t{rng.Get()} << 32) | rng.Get());
+      }
+    }
+  }
+
+  virtual void TearDown(benchmark::State &state) {
+    state.counters["groups"] = lpm_->num_groups();
+    state.counters["MB"] = lpm_->memory_usage() / 1e6;
+    delete lpm_;
+    addrs_.clear();
+  }
+
+ protected:
+  Lpm6 *lpm_;
+  std::vector<Ipv6Address> addrs_;
+};
+
+// Benchmarks Lookup(), one address at a time
+BENCHMARK_DEFINE_F(Lpm6Fixture, Lookup)(benchmark::State &state) {
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    uint32_t next_hop;
+    benchmark::DoNotOptimize(lpm_->Lookup(addrs_[i], &next_hop));
+    benchmark::DoNotOptimize(next_hop);
+    i = (i + 1) % kNumAddrs;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(Lpm6Fixture, Lookup)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Arg(200000);
+
+// Benchmarks LookupBatch(), with batches as large as a PacketBatch
+BENCHMARK_DEFINE_F(Lpm6Fixture, LookupBatch)(benchmark::State &state) {
+  size_t i = 0;
+  uint32_t next_hops[kBatchSize];
+  while (state.KeepRunning()) {
+    lpm_->LookupBatch(&addrs_[i], kBatchSize, next_hops, 0);
+    benchmark::DoNotOptimize(next_hops[0]);
+    i = (i + kBatchSize) % kNumAddrs;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(Lpm6Fixture, LookupBatch)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Arg(200000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,214 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "lpm6.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+using bess::utils::be64_t;
+using bess::utils::Ipv6Address;
+using bess::utils::Ipv6Prefix;
+using bess::utils::Lpm6;
+
+namespace {
+
+Ipv6Address Addr(const std::string &str) {
+  Ipv6Address addr;
+  EXPECT_TRUE(bess::utils::ParseIpv6Address(str, &addr));
+  return addr;
+}
+
+TEST(Lpm6Test, Basic) {
+  Lpm6 lpm;
+  uint32_t next_hop;
+
+  EXPECT_FALSE(lpm.Lookup(Addr("2001:db8::1"), &next_hop));
+
+  EXPECT_EQ(0, lpm.Add(Addr("2001:db8::"), 32, 1));
+  EXPECT_EQ(0, lpm.Add(Addr("2001:db8:1::"), 48, 2));
+  EXPECT_EQ(0, lpm.Add(Addr("2001:db8:1::1"), 128, 3));
+  EXPECT_EQ(3, lpm.num_routes());
+
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8::1"), &next_hop));
+  EXPECT_EQ(1, next_hop);
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8:1::2"), &next_hop));
+  EXPECT_EQ(2, next_hop);
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8:1::1"), &next_hop));
+  EXPECT_EQ(3, next_hop);
+  EXPECT_FALSE(lpm.Lookup(Addr("2001:db9::1"), &next_hop));
+
+  // Update an existing route
+  EXPECT_EQ(0, lpm.Add(Addr("2001:db8::"), 32, 4));
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8::1"), &next_hop));
+  EXPECT_EQ(4, next_hop);
+
+  EXPECT_EQ(0, lpm.Delete(Addr("2001:db8:1::"), 48));
+  EXPECT_EQ(-ENOENT, lpm.Delete(Addr("2001:db8:1::"), 48));
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8:1::2"), &next_hop));
+  EXPECT_EQ(4, next_hop);
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8:1::1"), &next_hop));
+  EXPECT_EQ(3, next_hop);
+
+  EXPECT_EQ(-EINVAL, lpm.Add(Addr("::"), 129, 1));
+  EXPECT_EQ(-EINVAL, lpm.Add(Addr("::"), 64, Lpm6::kMaxNextHop + 1));
+
+  lpm.Clear();
+  EXPECT_EQ(0, lpm.num_routes());
+  EXPECT_EQ(0, lpm.num_groups());
+  EXPECT_FALSE(lpm.Lookup(Addr("2001:db8:1::1"), &next_hop));
+}
+
+TEST(Lpm6Test, DefaultRoute) {
+  Lpm6 lpm;
+  uint32_t next_hop;
+
+  EXPECT_EQ(0, lpm.Add(Addr("::"), 0, 7));
+  EXPECT_EQ(0, lpm.Add(Addr("ff00::"), 8, 8));
+
+  ASSERT_TRUE(lpm.Lookup(Addr("2001:db8::1"), &next_hop));
+  EXPECT_EQ(7, next_hop);
+  ASSERT_TRUE(lpm.Lookup(Addr("ff02::1"), &next_hop));
+  EXPECT_EQ(8, next_hop);
+
+  EXPECT_EQ(0, lpm.Delete(Addr("::"), 0));
+  EXPECT_FALSE(lpm.Lookup(Addr("2001:db8::1"), &next_hop));
+  ASSERT_TRUE(lpm.Lookup(Addr("ff02::1"), &next_hop));
+  EXPECT_EQ(8, next_hop);
+}
+
+// Routes that fill a whole group with the same next hop must still be
+// individually deletable.
+TEST(Lpm6Test, SiblingRoutes) {
+  Lpm6 lpm;
+  uint32_t next_hop;
+
+  EXPECT_EQ(0, lpm.Add(Addr("2001::"), 16, 1));
+  for (int i = 0; i < 256; i++) {
+    Ipv6Address addr = Addr("2001::");
+    addr.hi = addr.hi | be64_t(static_cast<uint64_t>(i) << 40);
+    EXPECT_EQ(0, lpm.Add(addr, 24, 2));
+  }
+
+  Ipv6Address addr = Addr("2001:500::1");
+  ASSERT_TRUE(lpm.Lookup(addr, &next_hop));
+  EXPECT_EQ(2, next_hop);
+
+  EXPECT_EQ(0, lpm.Delete(Addr("2001:500::"), 24));
+  ASSERT_TRUE(lpm.Lookup(addr, &next_hop));
+  EXPECT_EQ(1, next_hop);
+}
+
+// Compares Lpm6 against a linear scan, with random routes added and deleted
+TEST(Lpm6Test, RandomTest) {
+  const int kRoutes = 2000;
+  Random rd;
+  Lpm6 lpm;
+  std::map<std::pair<Ipv6Address, size_t>, uint32_t> routes;
+
+  // Draw addresses from a small space so that routes overlap
+  auto random_addr = [&]() {
+    Ipv6Address addr;
+    addr.hi = be64_t((uint64_t{0x2001} << 48) |
+                     (uint64_t{rd.GetRange(4)} << 40) |
+                     (uint64_t{rd.GetRange(4)} << 32) |
+                     (uint64_t{rd.GetRange(4)} << 16));
+    addr.lo = be64_t(rd.GetRange(4));
+    return addr;
+  };
+
+  auto check = [&]() {
+    std::vector<Ipv6Address> addrs;
+    for (int i = 0; i < 1000; i++) {
+      addrs.push_back(random_addr());
+    }
+
+    std::vector<uint32_t> next_hops(addrs.size());
+    lpm.LookupBatch(addrs.data(), addrs.size(), next_hops.data(), 0xffff);
+
+    for (size_t i = 0; i < addrs.size(); i++) {
+      int best_len = -1;
+      uint32_t expected = 0xffff;
+      for (const auto &route : routes) {
+        Ipv6Prefix prefix("::/" + std::to_string(route.first.second));
+        prefix.addr = route.first.first;
+        if (prefix.Match(addrs[i]) && int(route.first.second) > best_len) {
+          best_len = route.first.second;
+          expected = route.second;
+        }
+      }
+
+      uint32_t next_hop;
+      bool found = lpm.Lookup(addrs[i], &next_hop);
+      EXPECT_EQ(expected != 0xffff, found);
+      if (found) {
+        EXPECT_EQ(expected, next_hop);
+      }
+      EXPECT_EQ(expected, next_hops[i]);
+    }
+  };
+
+  for (int i = 0; i < kRoutes; i++) {
+    size_t len = rd.GetRange(129);
+    Ipv6Address prefix = random_addr() & Ipv6Prefix::Mask(len);
+    uint32_t next_hop = rd.GetRange(100);
+    ASSERT_EQ(0, lpm.Add(prefix, len, next_hop));
+    routes[std::make_pair(prefix, len)] = next_hop;
+  }
+  EXPECT_EQ(routes.size(), lpm.num_routes());
+  check();
+
+  // Delete half of the routes
+  for (auto it = routes.begin(); it != routes.end();) {
+    if (rd.GetRange(2)) {
+      ASSERT_EQ(0, lpm.Delete(it->first.first, it->first.second));
+      it = routes.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  EXPECT_EQ(routes.size(), lpm.num_routes());
+  check();
+
+  // All groups must be reclaimed once all routes are gone
+  for (const auto &route : routes) {
+    ASSERT_EQ(0, lpm.Delete(route.first.first, route.first.second));
+  }
+  routes.clear();
+  EXPECT_EQ(0, lpm.num_groups());
+  check();
+}
+
+}  // namespace (unnamed)
@@ -30,6 +30,10 @@
 #ifndef BESS_UTILS_TCP_FLOW_RECONSTRUCT_H_
 #define BESS_UTILS_TCP_FLOW_RECONSTRUCT_H_
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "../packet.h"
@@ -45,9 +49,14 @@ namespace utils {
 class TcpFlowReconstruct {
  public:
   // Constructs a TCP flow reconstruction object that can hold initial_buflen
-  // bytes to start with.
-  explicit TcpFlowReconstruct(size_t initial_buflen = 1024)
-      : initialized_(false), init_seq_(0), buf_(initial_buflen) {}
+  // bytes to start with, and at most max_buflen bytes of the flow.
+  explicit TcpFlowReconstruct(size_t initial_buflen = 1024,
+                              size_t max_buflen = UINT32_MAX)
+      : initialized_(false),
+        init_seq_(0),
+        initial_buflen_(initial_buflen),
+        max_buflen_(std::max(initial_buflen, max_buflen)),
+        buf_(initial_buflen) {}
 
   virtual ~TcpFlowReconstruct() {}
 
@@ -58,6 +67,15 @@ class TcpFlowReconstruct {
   // Returns the size of the underlying buffer
   size_t buf_size() const { return buf_.size(); }
 
+  // Returns the maximum number of bytes of the flow to be reconstructed
+  size_t max_buf_size() const { return max_buflen_; }
+
+  // Sets the maximum number of bytes of the flow to be reconstructed. Data
+  // already received beyond it is kept.
+  void set_max_buf_size(size_t max_buflen) {
+    max_buflen_ = std::max(initial_buflen_, max_buflen);
+  }
+
   // Returns the initial data sequence number extracted from the SYN.
   uint32_t init_seq() const { return init_seq_; }
 
@@ -68,12 +86,24 @@ class TcpFlowReconstruct {
     return (it == received_map_.end()) ? 0 : (it->second - it->first);
   }
 
+  // Forgets the flow, to start over with a new one. The buffer shrinks back to
+  // its initial size if it has grown.
+  void Reset() {
+    initialized_ = false;
+    init_seq_ = 0;
+    received_map_.clear();
+    if (buf_.size() > initial_buflen_) {
+      std::vector<char>(initial_buflen_).swap(buf_);
+    }
+  }
+
   // Adds the data of the given packet based upon its TCP sequence number.  If
   // the packet is a SYN then we use the SYN to set the initial sequence number
   // offset.
   //
   // Returns true upon success.  Returns false if the given packet is not a SYN
-  // but if we have not been given a SYN previously.
+  // but if we have not been given a SYN previously, or if its data would go
+  // beyond max_buf_size() bytes of the flow.
   //
   // Behavior is undefined the packet is not a TCP packet.
   bool InsertPacket(Packet *p) {
@@ -116,9 +146,16 @@ class TcpFlowReconstruct {
       return true;
     }
 
+    if (static_cast<uint64_t>(buf_offset) + datalen > max_buflen_) {
+      VLOG(1) << "Flow too long. Offset: " << buf_offset
+              << ", Length: " << datalen;
+      return false;
+    }
+
     // If we will run out of space, make more room.
     if ((buf_offset + datalen) > buf_.size()) {
-      size_t new_buflen = (buf_offset + datalen) * 2;
+      size_t new_buflen = std::min<size_t>((buf_offset + datalen) * 2,
+                                           max_buflen_);
       buf_.resize(new_buflen);
     }
 
@@ -165,6 +202,9 @@ class TcpFlowReconstruct {
   // The initial sequence number of data bytes in the TCP flow.
   uint32_t init_seq_;
 
+  const size_t initial_buflen_;
+  size_t max_buflen_;
+
   // A buffer (potentially with holes) of received data.
   std::vector<char> buf_;
 
@@ -176,6 +216,275 @@ class TcpFlowReconstruct {
   DISALLOW_COPY_AND_ASSIGN(TcpFlowReconstruct);
 };
 
+// A pool of buffers for ArenaTcpFlowReconstruct objects, so that flows do not
+// allocate memory of their own. Buffers are of power-of-two sizes, carved out
+// of larger slabs, and kept in per-size free lists once freed. Slabs are only
+// released when the arena is destroyed. Not thread-safe: use one per worker.
+class TcpFlowArena {
+ public:
+  static constexpr size_t kMinBufSize = 128;
+  static constexpr size_t kSlabSize = 64 * 1024;
+
+  TcpFlowArena() : bytes_(0) {}
+
+  // Returns a buffer of at least size bytes. Its actual size is stored in
+  // *buf_size.
+  char *Alloc(size_t size, size_t *buf_size) {
+    int cls = SizeClass(size);
+    if (free_[cls].empty()) {
+      Refill(cls);
+    }
+
+    char *buf = free_[cls].back();
+    free_[cls].pop_back();
+    *buf_size = kMinBufSize << cls;
+    return buf;
+  }
+
+  // Returns a buffer from Alloc(), of buf_size bytes, to the arena
+  void Free(char *buf, size_t buf_size) {
+    free_[SizeClass(buf_size)].push_back(buf);
+  }
+
+  // Returns the number of bytes allocated from the system
+  size_t bytes_allocated() const { return bytes_; }
+
+ private:
+  // Up to 128 << 25 = 4GB
+  static const int kNumSizeClasses = 26;
+
+  static int SizeClass(size_t size) {
+    if (size <= kMinBufSize) {
+      return 0;
+    }
+    int cls = 64 - __builtin_clzll((size - 1) / kMinBufSize);
+    CHECK_LT(cls, kNumSizeClasses);
+    return cls;
+  }
+
+  void Refill(int cls) {
+    size_t buf_size = kMinBufSize << cls;
+    size_t slab_size = std::max(buf_size, kSlabSize);
+
+    slabs_.emplace_back(new char[slab_size]);
+    for (size_t offset = 0; offset < slab_size; offset += buf_size) {
+      free_[cls].push_back(slabs_.back().get() + offset);
+    }
+    bytes_ += slab_size;
+  }
+
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  std::vector<char *> free_[kNumSizeClasses];
+  size_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(TcpFlowArena);
+};
+
+// TcpFlowReconstruct backed by a TcpFlowArena, for a large number of flows.
+// The buffer is taken from the arena when the first data arrives and returned
+// by Reset(), and received segments are tracked in a small inline array
+// instead of a std::map: in-order data only extends the last segment. Since
+// only kMaxSegments segments are tracked, data that would leave more holes in
+// the flow is rejected.
+class ArenaTcpFlowReconstruct {
+ public:
+  static constexpr int kMaxSegments = 8;
+
+  explicit ArenaTcpFlowReconstruct(TcpFlowArena *arena,
+                                   size_t max_buflen = UINT32_MAX)
+      : arena_(arena),
+        initialized_(false),
+        init_seq_(0),
+        num_segments_(0),
+        max_buflen_(max_buflen),
+        buf_(nullptr),
+        buf_size_(0) {}
+
+  ArenaTcpFlowReconstruct(ArenaTcpFlowReconstruct &&other) noexcept
+      : arena_(other.arena_),
+        initialized_(other.initialized_),
+        init_seq_(other.init_seq_),
+        num_segments_(other.num_segments_),
+        max_buflen_(other.max_buflen_),
+        buf_(other.buf_),
+        buf_size_(other.buf_size_) {
+    std::copy_n(other.segments_, num_segments_, segments_);
+    other.buf_ = nullptr;
+    other.buf_size_ = 0;
+  }
+
+  ~ArenaTcpFlowReconstruct() { FreeBuf(); }
+
+  // Returns the underlying buffer of reconstructed flow bytes.  Not guaranteed
+  // to return the same pointer between calls to InsertPacket().
+  const char *buf() const { return buf_; }
+
+  // Returns the size of the underlying buffer
+  size_t buf_size() const { return buf_size_; }
+
+  // Returns the maximum number of bytes of the flow to be reconstructed
+  size_t max_buf_size() const { return max_buflen_; }
+
+  // Sets the maximum number of bytes of the flow to be reconstructed
+  void set_max_buf_size(size_t max_buflen) { max_buflen_ = max_buflen; }
+
+  // Returns the initial data sequence number extracted from the SYN.
+  uint32_t init_seq() const { return init_seq_; }
+
+  // Returns the length of contiguous data available in the buffer starting from
+  // the beginning.  Updated every time InsertPacket() is called.
+  size_t contiguous_len() const {
+    return (num_segments_ > 0 && segments_[0].start == 0) ? segments_[0].end
+                                                          : 0;
+  }
+
+  // Forgets the flow, to start over with a new one, and returns the buffer to
+  // the arena.
+  void Reset() {
+    initialized_ = false;
+    init_seq_ = 0;
+    num_segments_ = 0;
+    FreeBuf();
+  }
+
+  // Same as TcpFlowReconstruct::InsertPacket(). Also returns false if there
+  // would be more than kMaxSegments segments.
+  bool InsertPacket(Packet *p) {
+    const Ethernet *eth = p->head_data<const Ethernet *>();
+    const Ipv4 *ip = (const Ipv4 *)(eth + 1);
+    const Tcp *tcp =
+        (const Tcp *)(((const char *)ip) + (ip->header_length * 4));
+
+    uint32_t seq = tcp->seq_num.value();
+    if (tcp->flags & Tcp::Flag::kSyn) {
+      init_seq_ = seq + 1;
+      initialized_ = true;
+      return true;
+    }
+
+    if (!initialized_) {
+      VLOG(1) << "Non-SYN received but not yet initialized.";
+      return false;
+    }
+
+    if ((int32_t)(seq - init_seq_) < 0) {
+      VLOG(1) << "Sequence number not match. Initial seq: " << init_seq_
+              << ", Seq: " << seq;
+      return false;
+    }
+
+    uint32_t buf_offset = seq - init_seq_;
+
+    const char *datastart = ((const char *)tcp) + (tcp->offset * 4);
+    uint32_t datalen =
+        ip->length.value() - (tcp->offset * 4) - (ip->header_length * 4);
+
+    if (datalen == 0) {
+      return true;
+    }
+
+    if (static_cast<uint64_t>(buf_offset) + datalen > max_buflen_) {
+      VLOG(1) << "Flow too long. Offset: " << buf_offset
+              << ", Length: " << datalen;
+      return false;
+    }
+
+    if (!AddSegment(buf_offset, buf_offset + datalen)) {
+      VLOG(1) << "Too many holes in the flow";
+      return false;
+    }
+
+    if (buf_offset + datalen > buf_size_) {
+      Grow(buf_offset + datalen);
+    }
+
+    bess::utils::CopyInlined(buf_ + buf_offset, datastart, datalen);
+    return true;
+  }
+
+ private:
+  struct Segment {
+    uint32_t start;
+    uint32_t end;
+  };
+
+  // Merges [start, end) into segments_, which are sorted and do not overlap or
+  // touch each other. Returns false if there is no room for a new segment.
+  bool AddSegment(uint32_t start, uint32_t end) {
+    int n = num_segments_;
+
+    // The common case: in-order data
+    if (n > 0 && segments_[n - 1].end == start) {
+      segments_[n - 1].end = end;
+      return true;
+    }
+
+    int i = 0;
+    while (i < n && segments_[i].end < start) {
+      i++;
+    }
+
+    int j = i;
+    while (j < n && segments_[j].start <= end) {
+      start = std::min(start, segments_[j].start);
+      end = std::max(end, segments_[j].end);
+      j++;
+    }
+
+    if (i == j) {
+      if (n == kMaxSegments) {
+        return false;
+      }
+      memmove(&segments_[i + 1], &segments_[i], (n - i) * sizeof(Segment));
+      num_segments_++;
+    } else if (j - i > 1) {
+      memmove(&segments_[i + 1], &segments_[j], (n - j) * sizeof(Segment));
+      num_segments_ -= j - i - 1;
+    }
+
+    segments_[i] = {start, end};
+    return true;
+  }
+
+  // Replaces the buffer with one of at least size bytes, keeping its data
+  void Grow(size_t size) {
+    size_t new_size;
+    char *new_buf = arena_->Alloc(size, &new_size);
+
+    if (buf_ != nullptr) {
+      memcpy(new_buf, buf_, buf_size_);
+      arena_->Free(buf_, buf_size_);
+    }
+
+    buf_ = new_buf;
+    buf_size_ = new_size;
+  }
+
+  void FreeBuf() {
+    if (buf_ != nullptr) {
+      arena_->Free(buf_, buf_size_);
+      buf_ = nullptr;
+      buf_size_ = 0;
+    }
+  }
+
+  TcpFlowArena *arena_;
+
+  bool initialized_;
+  uint32_t init_seq_;
+
+  // Sorted list of received segments, with offsets from init_seq_
+  int num_segments_;
+  Segment segments_[kMaxSegments];
+
+  size_t max_buflen_;
+  char *buf_;
+  size_t buf_size_;
+
+  ArenaTcpFlowReconstruct(const ArenaTcpFlowReconstruct &) = delete;
+  ArenaTcpFlowReconstruct &operator=(const ArenaTcpFlowReconstruct &) = delete;
+};
+
 }  // namespace utils
 }  // namespace bess
 
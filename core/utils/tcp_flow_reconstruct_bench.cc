@@ -0,0 +1,165 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmarks for reconstructing TCP flows with TcpFlowReconstruct vs.
+// ArenaTcpFlowReconstruct, as done by UrlFilter for each new flow. Flows of
+// state.range(0) segments are reconstructed, either in order or with every
+// pair of segments swapped, as in tcp_flow_reconstruct_test.cc.
+
+#include "tcp_flow_reconstruct.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../packet_pool.h"
+
+namespace {
+
+using bess::utils::ArenaTcpFlowReconstruct;
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+using bess::utils::TcpFlowArena;
+using bess::utils::TcpFlowReconstruct;
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+
+static const size_t kSegmentSize = 1000;
+
+class TcpFlowFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    const uint32_t isn = 12345;
+    const int num_segments = state.range(0);
+
+    pkts_.push_back(NewPacket(isn, Tcp::Flag::kSyn, 0));
+    for (int i = 0; i < num_segments; i++) {
+      pkts_.push_back(NewPacket(isn + 1 + i * kSegmentSize, 0, kSegmentSize));
+    }
+
+    if (state.range(1)) {
+      for (size_t i = 1; i + 1 < pkts_.size(); i += 2) {
+        std::swap(pkts_[i], pkts_[i + 1]);
+      }
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    for (bess::Packet *pkt : pkts_) {
+      bess::Packet::Free(pkt);
+    }
+    pkts_.clear();
+  }
+
+ protected:
+  bess::Packet *NewPacket(uint32_t seq, uint8_t flags, size_t data_len) {
+    size_t len = sizeof(Ethernet) + sizeof(Ipv4) + sizeof(Tcp) + data_len;
+    bess::Packet *pkt = pool_.Alloc(len);
+    CHECK(pkt);
+
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    eth->ether_type = be16_t(Ethernet::Type::kIpv4);
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    ip->header_length = 5;
+    ip->length = be16_t(len - sizeof(Ethernet));
+    ip->protocol = Ipv4::Proto::kTcp;
+
+    Tcp *tcp = reinterpret_cast<Tcp *>(ip + 1);
+    tcp->offset = 5;
+    tcp->seq_num = be32_t(seq);
+    tcp->flags = flags;
+    memset(tcp + 1, 'x', data_len);
+
+    return pkt;
+  }
+
+  void SetCounters(benchmark::State &state) {
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0) *
+                            kSegmentSize);
+  }
+
+  bess::PlainPacketPool pool_;
+  std::vector<bess::Packet *> pkts_;
+};
+
+// A new TcpFlowReconstruct for each flow
+BENCHMARK_DEFINE_F(TcpFlowFixture, TcpFlowReconstruct)
+(benchmark::State &state) {
+  const size_t flow_len = state.range(0) * kSegmentSize;
+
+  while (state.KeepRunning()) {
+    TcpFlowReconstruct t(128);
+    for (bess::Packet *pkt : pkts_) {
+      t.InsertPacket(pkt);
+    }
+    CHECK_EQ(t.contiguous_len(), flow_len);
+  }
+
+  SetCounters(state);
+}
+
+// An ArenaTcpFlowReconstruct reset for each flow
+BENCHMARK_DEFINE_F(TcpFlowFixture, ArenaTcpFlowReconstruct)
+(benchmark::State &state) {
+  const size_t flow_len = state.range(0) * kSegmentSize;
+  TcpFlowArena arena;
+  ArenaTcpFlowReconstruct t(&arena);
+
+  while (state.KeepRunning()) {
+    t.Reset();
+    for (bess::Packet *pkt : pkts_) {
+      t.InsertPacket(pkt);
+    }
+    CHECK_EQ(t.contiguous_len(), flow_len);
+  }
+
+  SetCounters(state);
+}
+
+// {# of segments, reordered}
+static void Args(benchmark::internal::Benchmark *b) {
+  for (int segments : {1, 4, 16}) {
+    for (int reordered : {0, 1}) {
+      b->Args({segments, reordered});
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(TcpFlowFixture, TcpFlowReconstruct)->Apply(Args);
+BENCHMARK_REGISTER_F(TcpFlowFixture, ArenaTcpFlowReconstruct)->Apply(Args);
+
+}  // namespace
+
+BENCHMARK_MAIN();
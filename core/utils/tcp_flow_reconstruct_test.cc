@@ -152,6 +152,150 @@ TEST_F(TcpFlowReconstructTest, MissingSyn) {
   ASSERT_TRUE(t.InsertPacket(nonsyn));
 }
 
+// Tests that data beyond the maximum buffer size is rejected, and that the
+// object can be reused for another flow after Reset().
+TEST_F(TcpFlowReconstructTest, MaxBufSizeAndReset) {
+  Packet *syn = pkts_[0];
+  size_t max_len = bytestream_.size() - 1;
+
+  TcpFlowReconstruct t(1, max_len);
+  EXPECT_EQ(max_len, t.max_buf_size());
+  ASSERT_TRUE(t.InsertPacket(syn));
+
+  bool rejected = false;
+  for (size_t i = 1; i < pkts_.size(); ++i) {
+    if (!t.InsertPacket(pkts_[i])) {
+      rejected = true;
+      break;
+    }
+  }
+  EXPECT_TRUE(rejected);
+  EXPECT_LE(t.buf_size(), max_len);
+  EXPECT_LE(t.contiguous_len(), max_len);
+
+  t.Reset();
+  EXPECT_EQ(1, t.buf_size());
+  EXPECT_EQ(0, t.contiguous_len());
+  ASSERT_FALSE(t.InsertPacket(pkts_[1]));  // needs a SYN again
+  ASSERT_TRUE(t.InsertPacket(syn));
+  for (size_t i = 1; i < pkts_.size() && t.InsertPacket(pkts_[i]); ++i) {
+  }
+  EXPECT_LT(0, t.contiguous_len());
+  EXPECT_EQ(0, memcmp(t.buf(), bytestream_.data(), t.contiguous_len()));
+}
+
+// Tests that buffers are of power-of-two sizes and reused once freed.
+TEST(TcpFlowArena, AllocFree) {
+  TcpFlowArena arena;
+  size_t size;
+
+  char *buf1 = arena.Alloc(1, &size);
+  EXPECT_EQ(TcpFlowArena::kMinBufSize, size);
+  EXPECT_EQ(TcpFlowArena::kSlabSize, arena.bytes_allocated());
+
+  char *buf2 = arena.Alloc(TcpFlowArena::kMinBufSize + 1, &size);
+  EXPECT_EQ(TcpFlowArena::kMinBufSize * 2, size);
+  EXPECT_NE(buf1, buf2);
+
+  arena.Free(buf2, size);
+  EXPECT_EQ(buf2, arena.Alloc(TcpFlowArena::kMinBufSize * 2, &size));
+
+  char *buf3 = arena.Alloc(TcpFlowArena::kSlabSize * 2, &size);
+  EXPECT_EQ(TcpFlowArena::kSlabSize * 2, size);
+  memset(buf3, 0, size);
+  EXPECT_EQ(TcpFlowArena::kSlabSize * 4, arena.bytes_allocated());
+}
+
+// The same as StandardReconstruction, with ArenaTcpFlowReconstruct
+TEST_F(TcpFlowReconstructTest, ArenaStandardReconstruction) {
+  TcpFlowArena arena;
+  ArenaTcpFlowReconstruct t(&arena);
+
+  for (Packet *p : pkts_) {
+    ASSERT_TRUE(t.InsertPacket(p));
+  }
+
+  ASSERT_EQ(bytestream_.size(), t.contiguous_len());
+  EXPECT_EQ(0, memcmp(t.buf(), bytestream_.data(), bytestream_.size()));
+}
+
+// The same as ReorderedReconstruction, with ArenaTcpFlowReconstruct, reusing
+// the same object and buffers for every permutation.
+TEST_F(TcpFlowReconstructTest, ArenaReorderedReconstruction) {
+  Packet *syn = pkts_[0];
+
+  std::vector<Packet *> pkt_rotation;
+  for (size_t i = 1; i < pkts_.size(); ++i) {
+    int ack_size = sizeof(Ethernet) + sizeof(Ipv4) + sizeof(Tcp);
+    // Skip pure ACK packets for the permutations
+    if (pkts_[i]->head_len() > ack_size) {
+      pkt_rotation.push_back(pkts_[i]);
+    }
+  }
+  ASSERT_LE(pkt_rotation.size(), ArenaTcpFlowReconstruct::kMaxSegments * 2);
+  std::sort(pkt_rotation.begin(), pkt_rotation.end());
+
+  TcpFlowArena arena;
+  ArenaTcpFlowReconstruct t(&arena);
+  size_t bytes_allocated = 0;
+
+  do {
+    t.Reset();
+    ASSERT_TRUE(t.InsertPacket(syn));
+
+    for (Packet *p : pkt_rotation) {
+      ASSERT_TRUE(t.InsertPacket(p));
+    }
+
+    ASSERT_EQ(bytestream_.size(), t.contiguous_len());
+    EXPECT_EQ(0, memcmp(t.buf(), bytestream_.data(), bytestream_.size()));
+
+    // No more memory after the first round
+    if (bytes_allocated == 0) {
+      bytes_allocated = arena.bytes_allocated();
+    }
+    EXPECT_EQ(bytes_allocated, arena.bytes_allocated());
+  } while (std::next_permutation(pkt_rotation.begin(), pkt_rotation.end()));
+}
+
+// The same as MissingSyn, with ArenaTcpFlowReconstruct
+TEST_F(TcpFlowReconstructTest, ArenaMissingSyn) {
+  Packet *syn = pkts_[0];
+  Packet *nonsyn = pkts_[1];
+
+  TcpFlowArena arena;
+  ArenaTcpFlowReconstruct t(&arena);
+  ASSERT_FALSE(t.InsertPacket(nonsyn));
+  ASSERT_TRUE(t.InsertPacket(syn));
+  ASSERT_TRUE(t.InsertPacket(nonsyn));
+}
+
+// The same as MaxBufSizeAndReset, with ArenaTcpFlowReconstruct
+TEST_F(TcpFlowReconstructTest, ArenaMaxBufSizeAndReset) {
+  Packet *syn = pkts_[0];
+  size_t max_len = bytestream_.size() - 1;
+
+  TcpFlowArena arena;
+  ArenaTcpFlowReconstruct t(&arena, max_len);
+  EXPECT_EQ(0, t.buf_size());
+  ASSERT_TRUE(t.InsertPacket(syn));
+
+  bool rejected = false;
+  for (size_t i = 1; i < pkts_.size(); ++i) {
+    if (!t.InsertPacket(pkts_[i])) {
+      rejected = true;
+      break;
+    }
+  }
+  EXPECT_TRUE(rejected);
+  EXPECT_LE(t.contiguous_len(), max_len);
+
+  t.Reset();
+  EXPECT_EQ(0, t.buf_size());
+  EXPECT_EQ(0, t.contiguous_len());
+  ASSERT_FALSE(t.InsertPacket(pkts_[1]));  // needs a SYN again
+}
+
 }  // namespace
 }  // namespace utils
 }  // namespace bess
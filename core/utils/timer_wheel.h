@@ -0,0 +1,179 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef BESS_UTILS_TIMER_WHEEL_H_
+#define BESS_UTILS_TIMER_WHEEL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace bess {
+namespace utils {
+
+// A hierarchical timer wheel (Varghese and Lauck, 1987) for coarse-grained
+// timeouts of a large number of items, e.g., idle flows.
+//
+// Time is divided into ticks of tick_ns nanoseconds. Level 0 has one slot per
+// tick, and each slot of level l covers a whole rotation of level l-1. Both
+// Schedule() and firing an item are O(1); an item moves down at most
+// kLevels - 1 times before it fires. Deadlines beyond the horizon
+// (2^(kLevels * kBits) ticks from now) are clamped to it.
+//
+// Items cannot be canceled. Instead, the callback is expected to check whether
+// the item is still relevant when it fires, and schedule it again if needed.
+// This keeps the fast path of users (e.g., refreshing a flow) free of any
+// timer operations.
+//
+// The wheel starts at time 0 and fast-forwards whenever it is empty, so
+// Advance() should be called with the current time before the first item is
+// scheduled.
+template <typename T, int kLevels = 3, int kBits = 8>
+class TimerWheel {
+ public:
+  static_assert(kLevels > 0 && kLevels * kBits < 64, "invalid geometry");
+
+  explicit TimerWheel(uint64_t tick_ns) : tick_ns_(tick_ns), now_(), size_() {
+    CHECK_GT(tick_ns, 0);
+  }
+
+  // The item will be fired by the first Advance() at or after deadline_ns.
+  // Can be called from the callback of Advance().
+  void Schedule(uint64_t deadline_ns, const T &item) {
+    Insert((deadline_ns + tick_ns_ - 1) / tick_ns_, item);
+    size_++;
+  }
+
+  // Fires all items due by now_ns, by calling f(item) for each of them.
+  // Time must not go backwards. Returns the number of fired items.
+  template <typename F>
+  size_t Advance(uint64_t now_ns, F &&f) {
+    uint64_t target = now_ns / tick_ns_;
+    size_t fired = 0;
+
+    while (now_ <= target) {
+      if (size_ == 0) {
+        now_ = target + 1;  // fast forward
+        break;
+      }
+
+      size_t idx = now_ & kMask;
+      if (idx == 0) {
+        Cascade(1);
+      }
+
+      scratch_.clear();
+      scratch_.swap(slots_[0][idx]);
+      now_++;
+
+      size_ -= scratch_.size();
+      fired += scratch_.size();
+      for (const Timer &t : scratch_) {
+        f(t.item);
+      }
+    }
+
+    return fired;
+  }
+
+  // Drops all items
+  void Clear() {
+    for (auto &level : slots_) {
+      for (auto &slot : level) {
+        slot.clear();
+      }
+    }
+    size_ = 0;
+  }
+
+  // The number of scheduled items
+  size_t size() const { return size_; }
+
+  uint64_t tick_ns() const { return tick_ns_; }
+
+ private:
+  static const uint64_t kSlots = 1ull << kBits;
+  static const uint64_t kMask = kSlots - 1;
+
+  struct Timer {
+    uint64_t tick;
+    T item;
+  };
+
+  void Insert(uint64_t tick, const T &item) {
+    if (tick < now_) {
+      tick = now_;  // overdue: fire at the next tick
+    }
+
+    uint64_t delta = tick - now_;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ull << (kBits * (level + 1)))) {
+      level++;
+    }
+
+    if (delta >= (1ull << (kBits * kLevels))) {
+      tick = now_ + (1ull << (kBits * kLevels)) - 1;
+    }
+
+    slots_[level][(tick >> (kBits * level)) & kMask].push_back({tick, item});
+  }
+
+  // Redistributes the items of the current slot of the level to lower levels
+  void Cascade(int level) {
+    size_t idx = (now_ >> (kBits * level)) & kMask;
+    if (idx == 0 && level + 1 < kLevels) {
+      Cascade(level + 1);
+    }
+
+    scratch_.clear();
+    scratch_.swap(slots_[level][idx]);
+    for (const Timer &t : scratch_) {
+      Insert(t.tick, t.item);
+    }
+  }
+
+  const uint64_t tick_ns_;
+
+  // The next tick to be processed
+  uint64_t now_;
+
+  size_t size_;
+
+  std::vector<Timer> slots_[kLevels][kSlots];
+
+  // Reused to avoid memory allocation for every tick
+  std::vector<Timer> scratch_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_TIMER_WHEEL_H_
@@ -0,0 +1,127 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+namespace {
+
+using bess::utils::TimerWheel;
+
+// Tests that items fire at the first Advance() at or after their deadline.
+TEST(TimerWheelTest, Basic) {
+  TimerWheel<int> wheel(10);
+  std::vector<int> fired;
+  auto f = [&fired](int i) { fired.push_back(i); };
+
+  wheel.Advance(1000, f);
+  wheel.Schedule(1005, 1);
+  wheel.Schedule(1010, 2);
+  wheel.Schedule(1011, 3);
+  wheel.Schedule(500, 4);  // overdue
+  EXPECT_EQ(4, wheel.size());
+
+  EXPECT_EQ(0, wheel.Advance(1009, f));
+  EXPECT_TRUE(fired.empty());
+
+  EXPECT_EQ(3, wheel.Advance(1010, f));
+  EXPECT_EQ(std::vector<int>({1, 2, 4}), fired);
+
+  EXPECT_EQ(0, wheel.Advance(1019, f));
+  EXPECT_EQ(1, wheel.Advance(1020, f));
+  EXPECT_EQ(std::vector<int>({1, 2, 4, 3}), fired);
+  EXPECT_EQ(0, wheel.size());
+}
+
+// Tests items that go through all levels of the wheel, in random order.
+TEST(TimerWheelTest, Cascade) {
+  const uint64_t kTick = 7;
+  const int kItems = 10000;
+  TimerWheel<int, 3, 4> wheel(kTick);  // 16 slots per level
+  Random rng;
+
+  std::vector<uint64_t> deadlines;
+  for (int i = 0; i < kItems; i++) {
+    deadlines.push_back(100 + rng.GetRange(4000 * kTick));
+    wheel.Schedule(deadlines[i], i);
+  }
+
+  uint64_t now = 0;
+  int fired = 0;
+  while (wheel.size() > 0) {
+    now += rng.GetRange(5 * kTick);
+    fired += wheel.Advance(now, [&](int i) {
+      // Fired on time: at or after the deadline, but within the tick
+      EXPECT_LE(deadlines[i], now);
+      EXPECT_GT(deadlines[i] + 5 * kTick + kTick, now);
+      deadlines[i] = 0;
+    });
+  }
+
+  EXPECT_EQ(kItems, fired);
+  EXPECT_EQ(0, *std::max_element(deadlines.begin(), deadlines.end()));
+}
+
+// Tests that items can be rescheduled from the callback, and that deadlines
+// beyond the horizon are clamped.
+TEST(TimerWheelTest, Reschedule) {
+  TimerWheel<int, 2, 4> wheel(1);  // horizon: 256 ticks
+  int count = 0;
+
+  wheel.Schedule(10, 0);
+  wheel.Schedule(1000000, 1);
+
+  for (uint64_t now = 0; now < 300; now++) {
+    wheel.Advance(now, [&](int i) {
+      if (i == 0) {
+        EXPECT_EQ(0, now % 10);
+        count++;
+        wheel.Schedule(now + 10, 0);
+      } else {
+        EXPECT_EQ(255, now);
+      }
+    });
+  }
+
+  EXPECT_EQ(29, count);
+  EXPECT_EQ(1, wheel.size());
+
+  wheel.Clear();
+  EXPECT_EQ(0, wheel.size());
+}
+
+}  // namespace
@@ -51,6 +51,7 @@
 #include "resume_hook.h"
 #include "resume_hooks/metadata.h"
 #include "scheduler.h"
+#include "steal_queue.h"
 #include "utils/random.h"
 #include "utils/time.h"
 
@@ -111,6 +112,9 @@ void pause_worker(int wid) {
 
     FULL_BARRIER();
 
+    // Do not wait for an idle worker to wake up by itself
+    workers[wid]->Wakeup();
+
     while (workers[wid]->status() == WORKER_PAUSING) {
     } /* spin */
   }
@@ -237,6 +241,7 @@ void Worker::SetNonWorker() {
   core_ = INT_MIN;
   socket_ = INT_MIN;
   fd_event_ = INT_MIN;
+  fd_idle_ = INT_MIN;
 
   if (!packet_pool_) {
     // Packet pools should be available to non-worker threads.
@@ -273,6 +278,15 @@ int Worker::BlockWorker() {
   return 0;
 }
 
+void Worker::Wakeup() {
+  uint64_t one = 1;
+
+  // Failure (EAGAIN) means that a wakeup is already pending
+  if (write(fd_idle_, &one, sizeof(one)) < 0) {
+    DCHECK_EQ(errno, EAGAIN);
+  }
+}
+
 /* The entry point of worker threads */
 void *Worker::Run(void *_arg) {
   struct thread_arg *arg = (struct thread_arg *)_arg;
@@ -302,6 +316,9 @@ void *Worker::Run(void *_arg) {
   fd_event_ = eventfd(0, 0);
   CHECK_GE(fd_event_, 0);
 
+  fd_idle_ = eventfd(0, EFD_NONBLOCK);
+  CHECK_GE(fd_idle_, 0);
+
   scheduler_ = arg->scheduler;
 
   current_tsc_ = rdtsc();
@@ -309,6 +326,8 @@ void *Worker::Run(void *_arg) {
   packet_pool_ = bess::PacketPool::GetDefaultPool(socket_);
   CHECK_NOTNULL(packet_pool_);
 
+  bess::StealQueue::Init(wid_, socket_);
+
   status_ = WORKER_PAUSING;
 
   STORE_BARRIER();
@@ -338,10 +357,13 @@ void *run_worker(void *_arg) {
 }
 
 void launch_worker(int wid, int core,
-                   [[maybe_unused]] const std::string &scheduler) {
+                   [[maybe_unused]] const std::string &scheduler,
+                   const bess::IdleConfig &idle) {
   struct thread_arg arg = {.wid = wid, .core = core, .scheduler = nullptr};
   if (scheduler == "") {
-    arg.scheduler = new DefaultScheduler();
+    DefaultScheduler *s = new DefaultScheduler();
+    s->set_idle_config(idle);
+    arg.scheduler = s;
   } else if (scheduler == "experimental") {
     arg.scheduler = new ExperimentalScheduler();
   } else {
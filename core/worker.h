@@ -68,6 +68,17 @@ typedef enum {
 namespace bess {
 class Scheduler;
 class PacketPool;
+
+// Power-saving idle mode of a worker (see DefaultScheduler::Idle()).
+struct IdleConfig {
+  // The worker goes to sleep after this many consecutive scheduling rounds
+  // without any packet. 0 disables the idle mode (busy polling).
+  uint64_t rounds;
+
+  // Upper bound of a single sleep. Tasks that cannot notify the worker of new
+  // work (see Module::ArmIdleWakeup()) may be delayed for up to this long.
+  uint64_t max_sleep_ns;
+};
 }  // namespace bess
 
 class Task;
@@ -93,6 +104,9 @@ class Worker {
   /* The entry point of worker threads */
   void *Run(void *_arg);
 
+  /* Interrupts the sleep of an idle worker (may be called by any thread) */
+  void Wakeup();
+
   worker_status_t status() { return status_; }
   void set_status(worker_status_t status) { status_ = status; }
 
@@ -100,6 +114,7 @@ class Worker {
   int core() { return core_; }
   int socket() { return socket_; }
   int fd_event() { return fd_event_; }
+  int fd_idle() { return fd_idle_; }
 
   bess::PacketPool *packet_pool() { return packet_pool_; }
 
@@ -124,6 +139,7 @@ class Worker {
   int core_;  // TODO: should be cpuset_t
   int socket_;
   int fd_event_;
+  int fd_idle_;  // to interrupt idle sleeps
 
   bess::PacketPool *packet_pool_;
 
@@ -186,8 +202,9 @@ inline bool is_worker_running(int wid) {
 }
 
 // arg (int) is the core id the worker should run on, and optionally the
-// scheduler to use.
-void launch_worker(int wid, int core, const std::string &scheduler = "");
+// scheduler to use and its idle mode configuration.
+void launch_worker(int wid, int core, const std::string &scheduler = "",
+                   const bess::IdleConfig &idle = {});
 
 Worker *get_next_active_worker();
 
@@ -478,6 +478,17 @@ class BESS(object):
         request.name = name
         return self._request('GetModuleInfo', request)
 
+    def set_profiling(self, enable, reset=False):
+        request = bess_msg.SetProfilingRequest()
+        request.enable = enable
+        request.reset = reset
+        return self._request('SetProfiling', request)
+
+    def get_module_profile(self, clear=False):
+        request = bess_msg.GetModuleProfileRequest()
+        request.clear = clear
+        return self._request('GetModuleProfile', request)
+
     def connect_modules(self, m1, m2, ogate=0, igate=0):
         request = bess_msg.ConnectModulesRequest()
         request.m1 = m1
@@ -600,10 +611,15 @@ class BESS(object):
         request.arg.Pack(arg)
         return self._request('ConfigureResumeHook', request)
 
-    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                     snaplen=0, filter='', sample_one_in_n=0, sample_pps=0):
         arg = bess_msg.TcpdumpArg()
         if fifo is not None:
             arg.fifo = fifo
+        arg.snaplen = snaplen
+        arg.filter = filter
+        arg.sample_one_in_n = sample_one_in_n
+        arg.sample_pps = sample_pps
         return self._configure_gate_hook('TcpDump', name, m, arg, enable,
                                          direction, gate)
 
@@ -614,21 +630,29 @@ class BESS(object):
         return self._configure_gate_hook('Track', name, m, arg, enable,
                                          direction, gate)
 
-    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                    snaplen=0, filter='', sample_one_in_n=0, sample_pps=0):
         arg = bess_msg.PcapngArg()
         if fifo is not None:
             arg.fifo = fifo
+        arg.snaplen = snaplen
+        arg.filter = filter
+        arg.sample_one_in_n = sample_one_in_n
+        arg.sample_pps = sample_pps
         return self._configure_gate_hook('PcapNg', name, m, arg, enable,
                                          direction, gate)
 
     def list_workers(self):
         return self._request('ListWorkers')
 
-    def add_worker(self, wid, core, scheduler=None):
+    def add_worker(self, wid, core, scheduler=None, idle_rounds=0,
+                   idle_max_sleep_ns=0):
         request = bess_msg.AddWorkerRequest()
         request.wid = wid
         request.core = core
         request.scheduler = scheduler or ''
+        request.idle_rounds = idle_rounds
+        request.idle_max_sleep_ns = idle_max_sleep_ns
         return self._request('AddWorker', request)
 
     def destroy_worker(self, wid):